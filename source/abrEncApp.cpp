@@ -44,6 +44,225 @@ static void sigint_handler(int)
 namespace X265_NS {
     // private namespace
 #define X265_INPUT_QUEUE_SIZE 250
+#define X265_SCALER_BAND_ROWS 64 // minimum height of the bands scaled in parallel
+
+    static inline int32_t atomicLoad(volatile int32_t* ptr)
+    {
+        return ATOMIC_ADD(ptr, 0);
+    }
+
+    void AbrPicture::release()
+    {
+        if (!ATOMIC_DEC(&m_refCount) && m_source->m_waiting)
+            m_source->m_wake.trigger();
+    }
+
+    AbrPicQueue::AbrPicQueue()
+    {
+        m_items = NULL;
+        m_size = 0;
+        m_head = m_tail = 0;
+        m_closed = m_detached = m_pushing = m_popWaiting = 0;
+        m_source = NULL;
+        m_pushCount = 0;
+        m_depthSum = 0;
+        m_maxDepth = 0;
+        m_fullWaits = m_emptyWaits = 0;
+    }
+
+    bool AbrPicQueue::init(uint32_t size)
+    {
+        m_size = size;
+        CHECKED_MALLOC_ZERO(m_items, AbrPicture*, size);
+        return true;
+    fail:
+        return false;
+    }
+
+    /* Returns the next picture, waiting for the producer if needed, or NULL
+     * once the producer closed the queue and it is drained */
+    AbrPicture* AbrPicQueue::pop()
+    {
+        bool bWaited = false;
+        while (m_head == atomicLoad(&m_tail))
+        {
+            if (atomicLoad(&m_closed))
+            {
+                if (m_head == atomicLoad(&m_tail))
+                    return NULL;
+                break;
+            }
+            bWaited = true;
+            ATOMIC_INC(&m_popWaiting);
+            if (m_head == m_tail && !m_closed)
+                m_notEmpty.wait();
+            ATOMIC_DEC(&m_popWaiting);
+        }
+        m_emptyWaits += bWaited;
+
+        AbrPicture* pic = m_items[(uint32_t)m_head % m_size];
+        ATOMIC_INC(&m_head);
+        if (m_source->m_waiting)
+            m_source->m_wake.trigger();
+        return pic;
+    }
+
+    /* Called by the consumer once it takes no more pictures. The producer
+     * skips the queue from then on; the pictures left in it are released
+     * here, after any push in progress completed */
+    void AbrPicQueue::detach()
+    {
+        if (m_detached || !m_source)
+            return;
+        ATOMIC_INC(&m_detached);
+        while (atomicLoad(&m_pushing))
+            GIVE_UP_TIME();
+        while (m_head != m_tail)
+        {
+            m_items[(uint32_t)m_head % m_size]->release();
+            ATOMIC_INC(&m_head);
+        }
+        m_source->wake();
+    }
+
+    void AbrPicQueue::logStats(x265_param* param, const char* stage, const char* encName)
+    {
+        if (!m_pushCount)
+            return;
+        x265_log(param, X265_LOG_INFO, "%s queue of %s: %u frames, depth avg %.1f max %d of %u, %u full waits, %u empty waits\n",
+                 stage, encName, m_pushCount, (double)m_depthSum / m_pushCount, m_maxDepth, m_size, m_fullWaits, m_emptyWaits);
+    }
+
+    AbrPicSource::AbrPicSource()
+    {
+        m_pics = NULL;
+        m_numPics = 0;
+        m_next = 0;
+        m_waiting = 0;
+    }
+
+    void AbrPicSource::addQueue(AbrPicQueue* queue)
+    {
+        queue->m_source = this;
+        m_queues.push_back(queue);
+    }
+
+    /* the planes are allocated by the producer on first use */
+    bool AbrPicSource::init(uint32_t numPics, x265_param* param)
+    {
+        CHECKED_MALLOC_ZERO(m_pics, AbrPicture, numPics);
+        m_numPics = numPics;
+        for (uint32_t i = 0; i < numPics; i++)
+        {
+            m_pics[i].m_source = this;
+            m_pics[i].m_pic = x265_picture_alloc();
+            if (!m_pics[i].m_pic)
+                return false;
+            x265_picture_init(param, m_pics[i].m_pic);
+        }
+        return true;
+    fail:
+        return false;
+    }
+
+    void AbrPicSource::destroy()
+    {
+        for (uint32_t i = 0; m_pics && i < m_numPics; i++)
+        {
+            if (m_pics[i].m_pic)
+            {
+                X265_FREE(m_pics[i].m_pic->planes[0]);
+                x265_picture_free(m_pics[i].m_pic);
+            }
+        }
+        X265_FREE(m_pics);
+        m_pics = NULL;
+        m_numPics = 0;
+    }
+
+    void AbrPicSource::wake()
+    {
+        if (atomicLoad(&m_waiting))
+            m_wake.trigger();
+    }
+
+    /* Returns the next picture of the pool, in ring order, once every consumer
+     * released it. The caller holds the only reference until it publishes it */
+    AbrPicture* AbrPicSource::acquire()
+    {
+        AbrPicture* pic = &m_pics[m_next++ % m_numPics];
+        while (atomicLoad(&pic->m_refCount))
+        {
+            ATOMIC_INC(&m_waiting);
+            if (pic->m_refCount)
+                m_wake.wait();
+            ATOMIC_DEC(&m_waiting);
+        }
+        pic->m_refCount = 1;
+        return pic;
+    }
+
+    bool AbrPicSource::push(AbrPicQueue* queue, AbrPicture* pic)
+    {
+        bool bWaited = false;
+        while ((uint32_t)(queue->m_tail - atomicLoad(&queue->m_head)) >= queue->m_size)
+        {
+            if (atomicLoad(&queue->m_detached))
+                return false;
+            bWaited = true;
+            ATOMIC_INC(&m_waiting);
+            if ((uint32_t)(queue->m_tail - queue->m_head) >= queue->m_size && !queue->m_detached)
+                m_wake.wait();
+            ATOMIC_DEC(&m_waiting);
+        }
+
+        /* the queue cannot fill up meanwhile, only the consumer detaching
+         * can race with the write */
+        ATOMIC_INC(&queue->m_pushing);
+        if (queue->m_detached)
+        {
+            ATOMIC_DEC(&queue->m_pushing);
+            return false;
+        }
+        int32_t depth = queue->m_tail - queue->m_head;
+        queue->m_items[(uint32_t)queue->m_tail % queue->m_size] = pic;
+        ATOMIC_INC(&queue->m_tail);
+        ATOMIC_DEC(&queue->m_pushing);
+
+        queue->m_pushCount++;
+        queue->m_depthSum += depth;
+        queue->m_maxDepth = X265_MAX(queue->m_maxDepth, depth + 1);
+        queue->m_fullWaits += bWaited;
+        if (queue->m_popWaiting)
+            queue->m_notEmpty.trigger();
+        return true;
+    }
+
+    /* Hands the picture to every consumer still taking pictures, consuming
+     * the caller's reference. Returns false once no consumer is left */
+    bool AbrPicSource::publish(AbrPicture* pic)
+    {
+        bool bTaken = false;
+        for (size_t i = 0; i < m_queues.size(); i++)
+        {
+            ATOMIC_INC(&pic->m_refCount);
+            if (push(m_queues[i], pic))
+                bTaken = true;
+            else
+                pic->release();
+        }
+        pic->release();
+        return bTaken;
+    }
+
+    void AbrPicSource::close()
+    {
+        for (size_t i = 0; i < m_queues.size(); i++)
+        {
+            ATOMIC_INC(&m_queues[i]->m_closed);
+            m_queues[i]->m_notEmpty.trigger();
+        }
+    }
 
     AbrEncoder::AbrEncoder(CLIOptions cliopt[], uint8_t numEncodes, int &ret)
     {
@@ -51,6 +270,30 @@ namespace X265_NS {
         m_numActiveEncodes.set(numEncodes);
         m_queueSize = (numEncodes > 1) ? X265_INPUT_QUEUE_SIZE : 1;
         m_passEnc = X265_MALLOC(PassEncoder*, m_numEncodes);
+        m_scalerPool = NULL;
+
+        /* One pool serves the Scalers of all rungs; the worker pools of the
+         * encoders are private to libx265. The Scalers register themselves as
+         * job providers of the pool as they are created */
+        for (uint8_t i = 1; i < m_numEncodes; i++)
+        {
+            if (!cliopt[i].enableScaler)
+                continue;
+
+            int numThreads = X265_MIN(ThreadPool::getCpuCount(), (int)MAX_POOL_THREADS);
+            int numNodes = ThreadPool::getNumaNodeCount();
+            uint64_t nodeMask = numNodes >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << numNodes) - 1;
+            if (numThreads > 1)
+            {
+                m_scalerPool = new ThreadPool;
+                if (!m_scalerPool->create(numThreads, m_numEncodes, nodeMask))
+                {
+                    delete m_scalerPool;
+                    m_scalerPool = NULL;
+                }
+            }
+            break;
+        }
 
         for (uint8_t i = 0; i < m_numEncodes; i++)
         {
@@ -63,6 +306,16 @@ namespace X265_NS {
             m_passEnc[i]->init(ret);
         }
 
+        if (m_scalerPool && (!m_scalerPool->m_numProviders || !m_scalerPool->start()))
+        {
+            /* no scaler splits its pictures; they scale on their own threads */
+            for (uint8_t i = 0; i < m_numEncodes; i++)
+                if (m_passEnc[i]->m_scaler)
+                    m_passEnc[i]->m_scaler->m_pool = NULL;
+            delete m_scalerPool;
+            m_scalerPool = NULL;
+        }
+
         if (!allocBuffers())
         {
             x265_log(NULL, X265_LOG_ERROR, "Unable to allocate memory for buffers\n");
@@ -76,73 +329,119 @@ namespace X265_NS {
 
     bool AbrEncoder::allocBuffers()
     {
-        m_inputPicBuffer = X265_MALLOC(x265_picture**, m_numEncodes);
         m_analysisBuffer = X265_MALLOC(x265_analysis_data*, m_numEncodes);
 
-        m_picWriteCnt = new ThreadSafeInteger[m_numEncodes];
-        m_picReadCnt = new ThreadSafeInteger[m_numEncodes];
         m_analysisWriteCnt = new ThreadSafeInteger[m_numEncodes];
         m_analysisReadCnt = new ThreadSafeInteger[m_numEncodes];
 
-        m_picIdxReadCnt = X265_MALLOC(ThreadSafeInteger*, m_numEncodes);
         m_analysisWrite = X265_MALLOC(ThreadSafeInteger*, m_numEncodes);
         m_analysisRead = X265_MALLOC(ThreadSafeInteger*, m_numEncodes);
-        m_readFlag = X265_MALLOC(int*, m_numEncodes);
 
         for (uint8_t pass = 0; pass < m_numEncodes; pass++)
         {
-            m_inputPicBuffer[pass] = X265_MALLOC(x265_picture*, m_queueSize);
-            for (uint32_t idx = 0; idx < m_queueSize; idx++)
-            {
-                m_inputPicBuffer[pass][idx] = x265_picture_alloc();
-                x265_picture_init(m_passEnc[pass]->m_param, m_inputPicBuffer[pass][idx]);
-            }
-
             CHECKED_MALLOC_ZERO(m_analysisBuffer[pass], x265_analysis_data, m_queueSize);
-            m_picIdxReadCnt[pass] = new ThreadSafeInteger[m_queueSize];
             m_analysisWrite[pass] = new ThreadSafeInteger[m_queueSize];
             m_analysisRead[pass] = new ThreadSafeInteger[m_queueSize];
-            m_readFlag[pass] = X265_MALLOC(int, m_queueSize);
         }
-        return true;
+
+        return initQueues();
     fail:
         return false;
     }
 
-    void AbrEncoder::destroy()
+    bool AbrEncoder::initQueues()
     {
-        x265_cleanup(); /* Free library singletons */
+        /* a Reader reads for every rung it feeds, up to the longest encode */
+        uint32_t frameLimit = 0;
+        for (uint8_t pass = 0; pass < m_numEncodes; pass++)
+        {
+            uint32_t frames = m_passEnc[pass]->m_cliopt.framesToBeEncoded;
+            if (!frames)
+            {
+                frameLimit = 0;
+                break;
+            }
+            frameLimit = X265_MAX(frameLimit, frames);
+        }
+
+        /* each rung has its own input queue, fed by its Scaler or by the
+         * Reader it shares with the rungs of identical input; a Scaler has one
+         * fed by the source of the rung above */
         for (uint8_t pass = 0; pass < m_numEncodes; pass++)
         {
-            for (uint32_t index = 0; index < m_queueSize; index++)
+            PassEncoder* enc = m_passEnc[pass];
+            if (!enc->m_inputQueue.init(m_queueSize))
+                return false;
+            enc->inputSource()->addQueue(&enc->m_inputQueue);
+            if (enc->m_scaler)
             {
-                X265_FREE(m_inputPicBuffer[pass][index]->planes[0]);
-                x265_picture_free(m_inputPicBuffer[pass][index]);
+                if (!enc->m_scaler->m_inputQueue.init(m_queueSize))
+                    return false;
+                m_passEnc[pass - 1]->inputSource()->addQueue(&enc->m_scaler->m_inputQueue);
             }
+            if (enc->m_reader)
+                enc->m_reader->m_frameLimit = frameLimit;
+        }
+
+        /* a picture can be in every queue of its source, with one being
+         * filled and one being encoded; rungs reusing the analysis of an
+         * encode without lookahead take them out of order */
+        uint32_t numPics = m_queueSize + 2;
+        for (uint8_t pass = 0; pass < m_numEncodes; pass++)
+        {
+            if (m_passEnc[pass]->m_cliopt.loadLevel && m_passEnc[pass]->m_param->bDisableLookahead)
+                numPics = m_queueSize + X265_BFRAME_MAX + 2;
+        }
+
+        for (uint8_t pass = 0; pass < m_numEncodes; pass++)
+        {
+            AbrPicSource* source = NULL;
+            if (m_passEnc[pass]->m_reader)
+                source = &m_passEnc[pass]->m_reader->m_output;
+            else if (m_passEnc[pass]->m_scaler)
+                source = &m_passEnc[pass]->m_scaler->m_output;
+            if (!source)
+                continue;
+
+            if (!source->init(numPics, m_passEnc[pass]->m_param))
+                return false;
+        }
+
+        return true;
+    }
 
-            X265_FREE(m_inputPicBuffer[pass]);
+    void AbrEncoder::destroy()
+    {
+        x265_cleanup(); /* Free library singletons */
+        /* the pool workers may still reference the Scalers */
+        if (m_scalerPool)
+            m_scalerPool->stopWorkers();
+
+        /* a Reader or Scaler may feed any rung, every thread ends before the
+         * pictures and queues are freed */
+        for (uint8_t pass = 0; pass < m_numEncodes; pass++)
+            m_passEnc[pass]->stopThreads();
+
+        for (uint8_t pass = 0; pass < m_numEncodes; pass++)
+        {
             X265_FREE(m_analysisBuffer[pass]);
-            X265_FREE(m_readFlag[pass]);
-            delete[] m_picIdxReadCnt[pass];
             delete[] m_analysisWrite[pass];
             delete[] m_analysisRead[pass];
             m_passEnc[pass]->destroy();
             delete m_passEnc[pass];
         }
-        X265_FREE(m_inputPicBuffer);
         X265_FREE(m_analysisBuffer);
-        X265_FREE(m_readFlag);
 
-        delete[] m_picWriteCnt;
-        delete[] m_picReadCnt;
         delete[] m_analysisWriteCnt;
         delete[] m_analysisReadCnt;
 
-        X265_FREE(m_picIdxReadCnt);
         X265_FREE(m_analysisWrite);
         X265_FREE(m_analysisRead);
 
         X265_FREE(m_passEnc);
+
+        delete m_scalerPool;
+        m_scalerPool = NULL;
     }
 
     PassEncoder::PassEncoder(uint32_t id, CLIOptions cliopt, AbrEncoder *parent)
@@ -153,7 +452,10 @@ namespace X265_NS {
         if(!(m_cliopt.enableScaler && m_id))
             m_input = m_cliopt.input;
         m_param = cliopt.param;
-        m_inputOver = false;
+        m_readerId = id;
+        m_curPic = NULL;
+        m_picsRead = 0;
+        m_ditherBuf = NULL;
         m_lastIdx = -1;
         m_encoder = NULL;
         m_scaler = NULL;
@@ -167,9 +469,27 @@ namespace X265_NS {
             setReuseLevel();
 
         if (!(m_cliopt.enableScaler && m_id))
-            m_reader = new Reader(m_id, this);
+        {
+            /* rungs of the same input share the pictures of a single Reader */
+            for (uint32_t i = 0; i < m_id; i++)
+            {
+                if (sharesInput(m_parent->m_passEnc[i]))
+                {
+                    m_readerId = i;
+                    break;
+                }
+            }
+            if (m_readerId == m_id)
+                m_reader = new Reader(m_id, this);
+            else if (m_cliopt.input)
+                m_cliopt.input->stopReader();
+        }
         else
         {
+            /* the pictures come from the Scaler, not from our own input */
+            if (m_cliopt.input)
+                m_cliopt.input->stopReader();
+
             VideoDesc *src = NULL, *dst = NULL;
             dst = new VideoDesc(m_param->sourceWidth, m_param->sourceHeight, m_param->internalCsp, m_param->internalBitDepth);
             int dstW = m_parent->m_passEnc[m_id - 1]->m_param->sourceWidth;
@@ -177,7 +497,7 @@ namespace X265_NS {
             src = new VideoDesc(dstW, dstH, m_param->internalCsp, m_param->internalBitDepth);
             if (src != NULL && dst != NULL)
             {
-                m_scaler = new Scaler(0, 1, m_id, src, dst, this);
+                m_scaler = new Scaler(m_id, src, dst, this);
                 if (!m_scaler)
                 {
                     x265_log(m_param, X265_LOG_ERROR, "\n MALLOC failure in Scaler");
@@ -196,6 +516,13 @@ namespace X265_NS {
             }
         }
 
+        /* the pictures of the input queue are recycled once encoded */
+        if (m_param && !m_param->bCopyPicToFrame)
+        {
+            x265_log(m_param, X265_LOG_WARNING, "copy-pic is required when encoding from the input queues, enabling it\n");
+            m_param->bCopyPicToFrame = 1;
+        }
+
         /* note: we could try to acquire a different libx265 API here based on
         * the profile found during option parsing, but it must be done before
         * opening an encoder */
@@ -277,6 +604,27 @@ namespace X265_NS {
         }
     }
 
+    bool PassEncoder::sharesInput(PassEncoder* enc)
+    {
+        if (!enc->m_reader || !m_cliopt.input || !enc->m_cliopt.input || !m_cliopt.inputName || !enc->m_cliopt.inputName)
+            return false;
+        x265_param* p = enc->m_param;
+        return !strcmp(m_cliopt.inputName, enc->m_cliopt.inputName) &&
+               !strcmp(m_cliopt.input->getName(), enc->m_cliopt.input->getName()) &&
+               m_cliopt.seek == enc->m_cliopt.seek &&
+               m_cliopt.input->getWidth() == enc->m_cliopt.input->getWidth() &&
+               m_cliopt.input->getHeight() == enc->m_cliopt.input->getHeight() &&
+               m_param->internalCsp == p->internalCsp &&
+               m_param->sourceBitDepth == p->sourceBitDepth;
+    }
+
+    AbrPicSource* PassEncoder::inputSource()
+    {
+        if (m_scaler)
+            return &m_scaler->m_output;
+        return &m_parent->m_passEnc[m_readerId]->m_reader->m_output;
+    }
+
     void PassEncoder::startThreads()
     {
         /* Start slave worker threads */
@@ -309,7 +657,14 @@ namespace X265_NS {
 
         int overwrite = written / m_parent->m_queueSize;
         bool emptyIdxFound = 0;
-        while (!emptyIdxFound && overwrite)
+
+        /* encodes following our lookahead read the slots in coding order */
+        while (m_param->bDisableLookahead && overwrite && read != write * (int)m_cliopt.numRefs)
+        {
+            read = m_parent->m_analysisRead[m_id][index].waitForChange(read);
+            write = m_parent->m_analysisWrite[m_id][index].get();
+        }
+        while (!emptyIdxFound && overwrite && !m_param->bDisableLookahead)
         {
             for (uint32_t i = 0; i < m_parent->m_queueSize; i++)
             {
@@ -339,6 +694,11 @@ namespace X265_NS {
             memcpy(m_analysisInfo->lookahead.intraVbvCost, src->lookahead.intraVbvCost, src->numCUsInFrame * sizeof(uint32_t));
             memcpy(m_analysisInfo->lookahead.vbvCost, src->lookahead.vbvCost, src->numCUsInFrame * sizeof(uint32_t));
         }
+        if (src->qpAqOffset && m_analysisInfo->qpAqOffset)
+        {
+            memcpy(m_analysisInfo->qpAqOffset, src->qpAqOffset, src->qpOffsetCols * src->qpOffsetRows * sizeof(double));
+            memcpy(m_analysisInfo->qpCuTreeOffset, src->qpCuTreeOffset, src->qpOffsetCols * src->qpOffsetRows * sizeof(double));
+        }
 
         if (src->sliceType == X265_TYPE_IDR || src->sliceType == X265_TYPE_I)
         {
@@ -402,22 +762,35 @@ ret:
     }
 
 
+    /* Pictures leave the input queue in input order; the ones taken ahead of
+     * their turn wait in m_pending */
+    AbrPicture* PassEncoder::takePicture(uint32_t index)
+    {
+        for (size_t i = 0; i < m_pending.size(); i++)
+        {
+            if (m_pending[i]->m_index == index)
+            {
+                AbrPicture* pic = m_pending[i];
+                m_pending.erase(m_pending.begin() + i);
+                return pic;
+            }
+        }
+
+        AbrPicture* pic;
+        while ((pic = m_inputQueue.pop()) != NULL && pic->m_index != index)
+            m_pending.push_back(pic);
+        return pic;
+    }
+
     bool PassEncoder::readPicture(x265_picture *dstPic)
     {
-        /*Check and wait if there any input frames to read*/
-        int ipread = m_parent->m_picReadCnt[m_id].get();
-        int ipwrite = m_parent->m_picWriteCnt[m_id].get();
+        int ipread = (int)m_picsRead;
+        uint32_t picIndex = m_picsRead;
 
         bool isAbrLoad = m_cliopt.loadLevel && (m_parent->m_numEncodes > 1);
-        while (!m_inputOver && (ipread == ipwrite))
-        {
-            ipwrite = m_parent->m_picWriteCnt[m_id].waitForChange(ipwrite);
-        }
 
-        if (m_threadActive && ipread < ipwrite)
+        if (m_threadActive)
         {
-            /*Get input index to read from inputQueue. If doesn't need analysis info, it need not wait to fetch poc from analysisQueue*/
-            int readPos = ipread % m_parent->m_queueSize;
             x265_analysis_data* analysisData = 0;
 
             if (isAbrLoad)
@@ -464,13 +837,15 @@ ret:
                     }
                     else
                     {
-                        analysisIdx = analysisRead % m_parent->m_queueSize;
+                        /* the reference hands out its frames in coding order, one
+                         * slot each, and each encode following it keeps its own place */
+                        while (m_threadActive && (uint32_t)analysisWrite <= m_picsRead)
+                            analysisWrite = m_parent->m_analysisWriteCnt[analysisQId].waitForChange(analysisWrite);
+                        if (!m_threadActive)
+                            return false;
+                        analysisIdx = m_picsRead % m_parent->m_queueSize;
                         analysisData = &m_parent->m_analysisBuffer[analysisQId][analysisIdx];
-                        readPos = analysisData->poc % m_parent->m_queueSize;
-                        while ((ipwrite < readPos) || ((ipwrite - 1) < (int)analysisData->poc))
-                        {
-                            ipwrite = m_parent->m_picWriteCnt[m_id].waitForChange(ipwrite);
-                        }
+                        picIndex = analysisData->poc;
                     }
 
                     m_lastIdx = analysisIdx;
@@ -479,8 +854,12 @@ ret:
                     return false;
             }
 
+            m_curPic = takePicture(picIndex);
+            if (!m_curPic)
+                return false;
+            m_picsRead++;
 
-            x265_picture *srcPic = (x265_picture*)(m_parent->m_inputPicBuffer[m_id][readPos]);
+            x265_picture *srcPic = m_curPic->m_pic;
 
             x265_picture *pic = (x265_picture*)(dstPic);
             pic->colorSpace = srcPic->colorSpace;
@@ -523,6 +902,8 @@ ret:
             ReconPlay* reconPlay = NULL;
             if (m_cliopt.reconPlayCmd)
                 reconPlay = new ReconPlay(m_cliopt.reconPlayCmd, *m_param);
+            BitstreamWriter* bitstreamWriter = NULL;
+            ReconWriter* reconWriter = NULL;
             char* profileName = m_cliopt.encName ? m_cliopt.encName : (char *)"x265";
 
             if (signal(SIGINT, sigint_handler) == SIG_ERR)
@@ -559,6 +940,15 @@ ret:
                     m_cliopt.totalbytes += m_cliopt.output->writeHeaders(p_nal, nal);
             }
 
+            /* access units and recon pictures are written by threads of their own */
+            bitstreamWriter = new BitstreamWriter(m_cliopt.output, api, m_encoder);
+            bitstreamWriter->startWriter();
+            if (m_cliopt.recon)
+            {
+                reconWriter = new ReconWriter(m_cliopt.recon, m_param->sourceHeight);
+                reconWriter->startWriter();
+            }
+
             if (m_param->bField && m_param->interlaceMode)
             {
                 api->picture_init(m_param, &picField1);
@@ -578,6 +968,10 @@ ret:
                     bDolbyVisionRPU = true;
             }
 
+            /* with encoder-dither the library dithers its own copy of the input */
+            if (m_param->bEncoderDither)
+                m_cliopt.bDither = false;
+
             if (m_cliopt.bDither)
             {
                 errorBuf = X265_MALLOC(int16_t, m_param->sourceWidth + 1);
@@ -609,10 +1003,27 @@ ret:
                 else
                     pic_in = NULL;
 
-                if (pic_in)
+                if (!pic_in)
+                    closeInput();
+                else
                 {
                     if (pic_in->bitDepth > m_param->internalBitDepth && m_cliopt.bDither)
                     {
+                        /* the picture may be shared with other rungs, dither a private copy */
+                        if (m_parent->m_numEncodes > 1)
+                        {
+                            if (!m_ditherBuf)
+                                m_ditherBuf = X265_MALLOC(char, pic_in->framesize);
+                            if (!m_ditherBuf)
+                            {
+                                m_ret = 4;
+                                goto fail;
+                            }
+                            char* planes0 = (char*)pic_in->planes[0];
+                            memcpy(m_ditherBuf, planes0, pic_in->framesize);
+                            for (int i = 0; i < x265_cli_csps[pic_in->colorSpace].planes; i++)
+                                pic_in->planes[i] = m_ditherBuf + ((char*)pic_in->planes[i] - planes0);
+                        }
                         x265_dither_image(pic_in, m_cliopt.input->getWidth(), m_cliopt.input->getHeight(), errorBuf, m_param->internalBitDepth);
                         pic_in->bitDepth = m_param->internalBitDepth;
                     }
@@ -717,9 +1128,6 @@ ret:
 
                     int numEncoded = api->encoder_encode(m_encoder, &p_nal, &nal, picInput, pic_recon);
 
-                    int idx = (inFrameCount - 1) % m_parent->m_queueSize;
-                    m_parent->m_picIdxReadCnt[m_id][idx].incr();
-                    m_parent->m_picReadCnt[m_id].incr();
                     if (m_cliopt.loadLevel && picInput)
                     {
                         m_parent->m_analysisReadCnt[m_cliopt.refId].incr();
@@ -744,10 +1152,10 @@ ret:
                     }
 
                     if (numEncoded && pic_recon && m_cliopt.recon)
-                        m_cliopt.recon->writePicture(pic_out);
+                        reconWriter->writePicture(pic_out);
                     if (nal)
                     {
-                        m_cliopt.totalbytes += m_cliopt.output->writeFrame(p_nal, nal, pic_out);
+                        m_cliopt.totalbytes += bitstreamWriter->writeFrame(p_nal, nal, pic_out);
                         if (pts_queue)
                         {
                             pts_queue->push(-pic_out.pts);
@@ -757,6 +1165,13 @@ ret:
                     }
                     m_cliopt.printStatus(outFrameCount);
                 }
+
+                /* the encoder copied the picture, its source may reuse it */
+                if (m_curPic)
+                {
+                    m_curPic->release();
+                    m_curPic = NULL;
+                }
             }
 
             /* Flush the encoder */
@@ -779,10 +1194,10 @@ ret:
                 }
 
                 if (numEncoded && pic_recon && m_cliopt.recon)
-                    m_cliopt.recon->writePicture(pic_out);
+                    reconWriter->writePicture(pic_out);
                 if (nal)
                 {
-                    m_cliopt.totalbytes += m_cliopt.output->writeFrame(p_nal, nal, pic_out);
+                    m_cliopt.totalbytes += bitstreamWriter->writeFrame(p_nal, nal, pic_out);
                     if (pts_queue)
                     {
                         pts_queue->push(-pic_out.pts);
@@ -812,7 +1227,10 @@ ret:
 
         fail:
 
+            closeInput();
             delete reconPlay;
+            delete reconWriter;
+            delete bitstreamWriter;
 
             api->encoder_get_stats(m_encoder, &stats, sizeof(stats));
             if (m_param->csvfn && !b_ctrl_c)
@@ -843,33 +1261,59 @@ ret:
                 m_input->stopReader(); // signal to stop requesting new frames if reader uses any prefetching algo
             }
 
+            if (m_parent->m_numEncodes > 1)
+            {
+                m_inputQueue.logStats(m_param, "input", profileName);
+                if (m_scaler)
+                    m_scaler->m_inputQueue.logStats(m_param, "scaler", profileName);
+            }
+
             api->param_free(m_param);
 
             X265_FREE(errorBuf);
             X265_FREE(rpuPayload);
+            X265_FREE(m_ditherBuf);
 
             m_threadActive = false;
             m_parent->m_numActiveEncodes.decr();
         }
     }
 
-    void PassEncoder::destroy()
+    /* No more pictures are taken from the input queue; release the ones held
+     * so that its source never waits for this rung */
+    void PassEncoder::closeInput()
+    {
+        if (m_curPic)
+        {
+            m_curPic->release();
+            m_curPic = NULL;
+        }
+        for (size_t i = 0; i < m_pending.size(); i++)
+            m_pending[i]->release();
+        m_pending.clear();
+        m_inputQueue.detach();
+    }
+
+    void PassEncoder::stopThreads()
     {
         stop();
         if (m_reader)
-        {
             m_reader->stop();
-            delete m_reader;
-        }
-        else
-        {
+        if (m_scaler)
             m_scaler->stop();
+    }
+
+    void PassEncoder::destroy()
+    {
+        delete m_reader;
+        if (m_scaler)
+        {
             m_scaler->destroy();
             delete m_scaler;
         }
     }
 
-    Scaler::Scaler(int threadId, int threadNum, int id, VideoDesc *src, VideoDesc *dst, PassEncoder *parentEnc)
+    Scaler::Scaler(int id, VideoDesc *src, VideoDesc *dst, PassEncoder *parentEnc)
     {
         m_parentEnc = parentEnc;
         m_id = id;
@@ -878,8 +1322,13 @@ ret:
         m_threadActive = false;
         m_scaleFrameSize = 0;
         m_filterManager = NULL;
-        m_threadId = threadId;
-        m_threadTotal = threadNum;
+        m_numBands = 0;
+        m_bandRows = 0;
+        m_bandsTaken = m_bandsFinished = 0;
+        memset(m_bandSrc, 0, sizeof(m_bandSrc));
+        memset(m_bandDst, 0, sizeof(m_bandDst));
+        memset(m_bandSrcStride, 0, sizeof(m_bandSrcStride));
+        memset(m_bandDstStride, 0, sizeof(m_bandDstStride));
 
         int csp = dst->m_csp;
         uint32_t pixelbytes = dst->m_inputDepth > 8 ? 2 : 1;
@@ -893,8 +1342,26 @@ ret:
 
         if (src->m_height != dst->m_height || src->m_width != dst->m_width)
         {
-            m_filterManager = new ScalerFilterManager;
-            m_filterManager->init(4, m_srcFormat, m_dstFormat);
+            /* bands start on chroma row pairs so that no chroma row is shared */
+            ThreadPool* pool = parentEnc->m_parent->m_scalerPool;
+            int maxBands = pool ? pool->m_numWorkers + 1 : 1;
+            m_numBands = x265_clip3(1, maxBands, dst->m_height / X265_SCALER_BAND_ROWS);
+            m_bandRows = ((dst->m_height + m_numBands - 1) / m_numBands + 1) & ~1;
+            m_numBands = (dst->m_height + m_bandRows - 1) / m_bandRows;
+
+            m_filterManager = new ScalerFilterManager*[m_numBands];
+            for (int i = 0; i < m_numBands; i++)
+            {
+                m_filterManager[i] = new ScalerFilterManager;
+                m_filterManager[i]->init(4, m_srcFormat, m_dstFormat);
+            }
+
+            if (pool && m_numBands > 1)
+            {
+                m_pool = pool;
+                m_jpId = pool->m_numProviders++;
+                pool->m_jpTable[m_jpId] = this;
+            }
         }
     }
 
@@ -906,8 +1373,6 @@ ret:
         int pixelBytes = m_dstFormat->m_inputDepth > 8 ? 2 : 1;
         if (m_srcFormat->m_height != m_dstFormat->m_height || m_srcFormat->m_width != m_dstFormat->m_width)
         {
-            void **srcPlane = NULL, **dstPlane = NULL;
-            int srcStride[3], dstStride[3];
             destination->bitDepth = source->bitDepth;
             destination->colorSpace = source->colorSpace;
             destination->pts = source->pts;
@@ -915,23 +1380,42 @@ ret:
             destination->reorderedPts = source->reorderedPts;
             destination->poc = source->poc;
             destination->userSEI = source->userSEI;
-            srcPlane = source->planes;
-            dstPlane = destination->planes;
-            srcStride[0] = source->stride[0];
             destination->stride[0] = m_dstFormat->m_width * pixelBytes;
-            dstStride[0] = destination->stride[0];
             if (param->internalCsp != X265_CSP_I400)
             {
-                srcStride[1] = source->stride[1];
-                srcStride[2] = source->stride[2];
                 destination->stride[1] = destination->stride[0] >> x265_cli_csps[param->internalCsp].width[1];
                 destination->stride[2] = destination->stride[0] >> x265_cli_csps[param->internalCsp].width[2];
-                dstStride[1] = destination->stride[1];
-                dstStride[2] = destination->stride[2];
             }
             if (m_scaleFrameSize)
             {
-                m_filterManager->scale_pic(srcPlane, dstPlane, srcStride, dstStride);
+                int planes = param->internalCsp != X265_CSP_I400 ? 3 : 1;
+                m_bandLock.acquire();
+                for (int i = 0; i < planes; i++)
+                {
+                    m_bandSrc[i] = source->planes[i];
+                    m_bandDst[i] = destination->planes[i];
+                    m_bandSrcStride[i] = source->stride[i];
+                    m_bandDstStride[i] = destination->stride[i];
+                }
+                m_bandsTaken = m_bandsFinished = 0;
+                m_bandLock.release();
+
+                if (m_pool)
+                {
+                    m_helpWanted = true;
+                    tryWakeOne();
+                }
+                while (scaleBand())
+                {}
+
+                m_bandLock.acquire();
+                while (m_bandsFinished < m_numBands)
+                {
+                    m_bandLock.release();
+                    m_bandsDone.wait();
+                    m_bandLock.acquire();
+                }
+                m_bandLock.release();
                 return true;
             }
             else
@@ -940,108 +1424,105 @@ ret:
         return false;
     }
 
+    /* Take the next band of the current picture and scale it, returns false
+     * once all its bands are taken */
+    bool Scaler::scaleBand()
+    {
+        void* src[4];
+        void* dst[4];
+        int srcStride[4], dstStride[4];
+
+        m_bandLock.acquire();
+        int band = m_bandsTaken < m_numBands ? m_bandsTaken++ : -1;
+        bool more = m_bandsTaken < m_numBands;
+        m_helpWanted = more;
+        memcpy(src, m_bandSrc, sizeof(src));
+        memcpy(dst, m_bandDst, sizeof(dst));
+        memcpy(srcStride, m_bandSrcStride, sizeof(srcStride));
+        memcpy(dstStride, m_bandDstStride, sizeof(dstStride));
+        m_bandLock.release();
+
+        if (band < 0)
+            return false;
+
+        /* recruit another worker for the bands left */
+        if (more && m_pool)
+            tryWakeOne();
+
+        m_filterManager[band]->scale_pic(src, dst, srcStride, dstStride, band * m_bandRows, (band + 1) * m_bandRows);
+
+        m_bandLock.acquire();
+        if (++m_bandsFinished == m_numBands)
+            m_bandsDone.trigger();
+        m_bandLock.release();
+        return true;
+    }
+
+    void Scaler::findJob(int /*workerThreadId*/)
+    {
+        scaleBand();
+    }
+
     void Scaler::threadMain()
     {
         THREAD_NAME("Scaler", m_id);
 
-        /* unscaled picture is stored in the last index */
-        uint32_t srcId = m_id - 1;
-        int QDepth = m_parentEnc->m_parent->m_queueSize;
-        while (!m_parentEnc->m_inputOver)
+        while (m_threadActive && !b_ctrl_c)
         {
-
-            uint32_t scaledWritten = m_parentEnc->m_parent->m_picWriteCnt[m_id].get();
-
-            if (m_parentEnc->m_cliopt.framesToBeEncoded && scaledWritten >= m_parentEnc->m_cliopt.framesToBeEncoded)
+            AbrPicture* in = m_inputQueue.pop();
+            if (!in)
                 break;
 
-            if (m_threadTotal > 1 && (m_threadId != scaledWritten % m_threadTotal))
+            /* same resolution as the rung above, share its picture */
+            if (!m_filterManager)
             {
+                if (!m_output.publish(in))
+                    break;
                 continue;
             }
-            uint32_t written = m_parentEnc->m_parent->m_picWriteCnt[srcId].get();
 
-            /*If all the input pictures are scaled by the current scale worker thread wait for input pictures*/
-            while (m_threadActive && (scaledWritten == written)) {
-                written = m_parentEnc->m_parent->m_picWriteCnt[srcId].waitForChange(written);
-            }
+            AbrPicture* out = m_output.acquire();
 
-            if (m_threadActive && scaledWritten < written)
+            /* the pool pictures are allocated without planes; allocate them
+             * as one block, as the Reader does */
+            x265_picture* scaledPic = out->m_pic;
+            if (!scaledPic->planes[0])
             {
-
-                int scaledWriteIdx = scaledWritten % QDepth;
-                int overWritePicBuffer = scaledWritten / QDepth;
-                int read = m_parentEnc->m_parent->m_picIdxReadCnt[m_id][scaledWriteIdx].get();
-
-                while (overWritePicBuffer && read < overWritePicBuffer)
+                int framesize = 0;
+                int planesize[3];
+                int csp = m_dstFormat->m_csp;
+                int stride[3];
+                stride[0] = m_dstFormat->m_width * (m_dstFormat->m_inputDepth > 8 ? 2 : 1);
+                stride[1] = stride[0] >> x265_cli_csps[csp].width[1];
+                stride[2] = stride[0] >> x265_cli_csps[csp].width[2];
+                for (int i = 0; i < x265_cli_csps[csp].planes; i++)
                 {
-                    read = m_parentEnc->m_parent->m_picIdxReadCnt[m_id][scaledWriteIdx].waitForChange(read);
+                    uint32_t h = m_dstFormat->m_height >> x265_cli_csps[csp].height[i];
+                    planesize[i] = h * stride[i];
+                    framesize += planesize[i];
                 }
 
-                if (!m_parentEnc->m_parent->m_inputPicBuffer[m_id][scaledWriteIdx])
-                {
-                    int framesize = 0;
-                    int planesize[3];
-                    int csp = m_dstFormat->m_csp;
-                    int stride[3];
-                    stride[0] = m_dstFormat->m_width;
-                    stride[1] = stride[0] >> x265_cli_csps[csp].width[1];
-                    stride[2] = stride[0] >> x265_cli_csps[csp].width[2];
-                    for (int i = 0; i < x265_cli_csps[csp].planes; i++)
-                    {
-                        uint32_t h = m_dstFormat->m_height >> x265_cli_csps[csp].height[i];
-                        planesize[i] = h * stride[i];
-                        framesize += planesize[i];
-                    }
-
-                    m_parentEnc->m_parent->m_inputPicBuffer[m_id][scaledWriteIdx] = x265_picture_alloc();
-                    x265_picture_init(m_parentEnc->m_param, m_parentEnc->m_parent->m_inputPicBuffer[m_id][scaledWriteIdx]);
-
-                    ((x265_picture*)m_parentEnc->m_parent->m_inputPicBuffer[m_id][scaledWritten % QDepth])->framesize = framesize;
-                    for (int32_t j = 0; j < x265_cli_csps[csp].planes; j++)
-                    {
-                        m_parentEnc->m_parent->m_inputPicBuffer[m_id][scaledWritten % QDepth]->planes[j] = X265_MALLOC(char, planesize[j]);
-                    }
-                }
+                scaledPic->framesize = framesize;
+                scaledPic->planes[0] = X265_MALLOC(char, framesize);
+                for (int32_t j = 1; j < x265_cli_csps[csp].planes; j++)
+                    scaledPic->planes[j] = (char*)scaledPic->planes[j - 1] + planesize[j - 1];
+            }
 
-                x265_picture *srcPic = m_parentEnc->m_parent->m_inputPicBuffer[srcId][scaledWritten % QDepth];
-                x265_picture* destPic = m_parentEnc->m_parent->m_inputPicBuffer[m_id][scaledWriteIdx];
+            bool bScaled = scalePic(out->m_pic, in->m_pic);
+            out->m_index = in->m_index;
+            in->release();
 
-                // Enqueue this picture up with the current encoder so that it will asynchronously encode
-                if (!scalePic(destPic, srcPic))
-                    x265_log(NULL, X265_LOG_ERROR, "Unable to copy scaled input picture to input queue \n");
-                else
-                    m_parentEnc->m_parent->m_picWriteCnt[m_id].incr();
-                m_scaledWriteCnt.incr();
-                m_parentEnc->m_parent->m_picIdxReadCnt[srcId][scaledWriteIdx].incr();
-            }
-            if (m_threadTotal > 1)
-            {
-                written = m_parentEnc->m_parent->m_picWriteCnt[srcId].get();
-                int totalWrite = written / m_threadTotal;
-                if (written % m_threadTotal > m_threadId)
-                    totalWrite++;
-                if (totalWrite == m_scaledWriteCnt.get())
-                {
-                    m_parentEnc->m_parent->m_picWriteCnt[srcId].poke();
-                    m_parentEnc->m_parent->m_picWriteCnt[m_id].poke();
-                    break;
-                }
-            }
-            else
+            // Enqueue this picture up with the current encoder so that it will asynchronously encode
+            if (!bScaled)
             {
-                /* Once end of video is reached and all frames are scaled, release wait on picwritecount */
-                scaledWritten = m_parentEnc->m_parent->m_picWriteCnt[m_id].get();
-                written = m_parentEnc->m_parent->m_picWriteCnt[srcId].get();
-                if (written == scaledWritten)
-                {
-                    m_parentEnc->m_parent->m_picWriteCnt[srcId].poke();
-                    m_parentEnc->m_parent->m_picWriteCnt[m_id].poke();
-                    break;
-                }
+                x265_log(NULL, X265_LOG_ERROR, "Unable to copy scaled input picture to input queue \n");
+                out->release();
             }
-
+            else if (!m_output.publish(out))
+                break;
         }
+        m_inputQueue.detach();
+        m_output.close();
         m_threadActive = false;
         destroy();
     }
@@ -1057,26 +1538,14 @@ ret:
     {
         THREAD_NAME("Reader", m_id);
 
-        int QDepth = m_parentEnc->m_parent->m_queueSize;
         x265_picture* src = x265_picture_alloc();
         x265_picture_init(m_parentEnc->m_param, src);
+        uint32_t written = 0;
 
-        while (m_threadActive)
+        while (m_threadActive && !(m_frameLimit && written >= m_frameLimit))
         {
-            uint32_t written = m_parentEnc->m_parent->m_picWriteCnt[m_id].get();
-            uint32_t writeIdx = written % QDepth;
-            uint32_t read = m_parentEnc->m_parent->m_picIdxReadCnt[m_id][writeIdx].get();
-            uint32_t overWritePicBuffer = written / QDepth;
-
-            if (m_parentEnc->m_cliopt.framesToBeEncoded && written >= m_parentEnc->m_cliopt.framesToBeEncoded)
-                break;
-
-            while (overWritePicBuffer && read < overWritePicBuffer)
-            {
-                read = m_parentEnc->m_parent->m_picIdxReadCnt[m_id][writeIdx].waitForChange(read);
-            }
-
-            x265_picture* dest = m_parentEnc->m_parent->m_inputPicBuffer[m_id][writeIdx];
+            AbrPicture* pic = m_output.acquire();
+            x265_picture* dest = pic->m_pic;
             if (m_input->readPicture(*src) && !b_ctrl_c)
             {
                 dest->poc = src->poc;
@@ -1100,15 +1569,20 @@ ret:
                 memcpy(dest->planes[0], src->planes[0], src->framesize * sizeof(char));
                 dest->planes[1] = (char*)dest->planes[0] + src->stride[0] * src->height;
                 dest->planes[2] = (char*)dest->planes[1] + src->stride[1] * (src->height >> x265_cli_csps[src->colorSpace].height[1]);
-                m_parentEnc->m_parent->m_picWriteCnt[m_id].incr();
+                pic->m_index = written++;
+
+                /* stop once every rung it feeds is done */
+                if (!m_output.publish(pic))
+                    break;
             }
             else
             {
-                m_threadActive = false;
-                m_parentEnc->m_inputOver = true;
-                m_parentEnc->m_parent->m_picWriteCnt[m_id].poke();
+                pic->release();
+                break;
             }
         }
+        m_output.close();
+        m_threadActive = false;
         x265_picture_free(src);
     }
 }
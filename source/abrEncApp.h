@@ -29,14 +29,89 @@
 #include "x265.h"
 #include "scaler.h"
 #include "threading.h"
+#include "threadpool.h"
 #include "x265cli.h"
 
+#include <vector>
+
 namespace X265_NS {
     // private namespace
 
     class PassEncoder;
     class Scaler;
     class Reader;
+    class AbrPicSource;
+
+    /* A picture read or scaled once and shared by every stage consuming it;
+     * its source recycles it once the last of them released it */
+    struct AbrPicture
+    {
+        x265_picture*    m_pic;
+        AbrPicSource*    m_source;
+        uint32_t         m_index;    // input frame number
+        int32_t          m_refCount;
+
+        void release();
+    };
+
+    /* Bounded single producer, single consumer queue of pictures between a
+     * Reader or Scaler and one of its consumers. The producer owns m_tail and
+     * the consumer m_head; either side only sleeps when the queue is full (or
+     * empty) after announcing it, so passing a picture takes no lock */
+    class AbrPicQueue
+    {
+    public:
+        AbrPicture**     m_items;
+        uint32_t         m_size;
+        volatile int32_t m_head;
+        volatile int32_t m_tail;
+        volatile int32_t m_closed;      // the producer is done
+        volatile int32_t m_detached;    // the consumer is done
+        volatile int32_t m_pushing;     // the producer is writing an item
+        volatile int32_t m_popWaiting;
+        Event            m_notEmpty;
+        AbrPicSource*    m_source;
+
+        /* queue depth statistics, updated by the producer */
+        uint32_t         m_pushCount;
+        uint64_t         m_depthSum;
+        int32_t          m_maxDepth;
+        uint32_t         m_fullWaits;   // pushes which waited for the consumer
+        uint32_t         m_emptyWaits;  // pops which waited for the producer
+
+        AbrPicQueue();
+        ~AbrPicQueue()                  { X265_FREE(m_items); }
+        bool init(uint32_t size);
+        AbrPicture* pop();
+        void detach();
+        void logStats(x265_param* param, const char* stage, const char* encName);
+    };
+
+    /* Output side of a Reader or Scaler: the pool of pictures it fills, reused
+     * in ring order, and the queues of the stages consuming them */
+    class AbrPicSource
+    {
+    public:
+        AbrPicture*      m_pics;
+        uint32_t         m_numPics;
+        uint32_t         m_next;
+        std::vector<AbrPicQueue*> m_queues;
+        Event            m_wake;        // a picture was released or a queue has room
+        volatile int32_t m_waiting;
+
+        AbrPicSource();
+        ~AbrPicSource()                 { destroy(); }
+        void addQueue(AbrPicQueue* queue);
+        bool init(uint32_t numPics, x265_param* param);
+        void destroy();
+        AbrPicture* acquire();
+        bool publish(AbrPicture* pic);
+        void close();
+        void wake();
+
+    protected:
+        bool push(AbrPicQueue* queue, AbrPicture* pic);
+    };
 
     class AbrEncoder
     {
@@ -46,20 +121,19 @@ namespace X265_NS {
         uint32_t           m_queueSize;
         ThreadSafeInteger  m_numActiveEncodes;
 
-        x265_picture       ***m_inputPicBuffer; //[numEncodes][queueSize]
         x265_analysis_data **m_analysisBuffer; //[numEncodes][queueSize]
-        int                **m_readFlag;
 
-        ThreadSafeInteger  *m_picWriteCnt;
-        ThreadSafeInteger  *m_picReadCnt;
-        ThreadSafeInteger  **m_picIdxReadCnt;
         ThreadSafeInteger  *m_analysisWriteCnt; //[numEncodes][queueSize]
         ThreadSafeInteger  *m_analysisReadCnt; //[numEncodes][queueSize]
         ThreadSafeInteger  **m_analysisWrite; //[numEncodes][queueSize]
         ThreadSafeInteger  **m_analysisRead; //[numEncodes][queueSize]
 
+        /* workers scaling the bands of the pictures of every scaled rung */
+        ThreadPool         *m_scalerPool;
+
         AbrEncoder(CLIOptions cliopt[], uint8_t numEncodes, int& ret);
         bool allocBuffers();
+        bool initQueues();
         void destroy();
 
     };
@@ -74,13 +148,20 @@ namespace X265_NS {
         x265_encoder *m_encoder;
         Reader *m_reader;
         Scaler *m_scaler;
-        bool m_inputOver;
+        uint32_t m_readerId;    // rung whose Reader feeds this one, unless it scales
 
         int m_threadActive;
         int m_lastIdx;
         uint32_t m_outputNalsCount;
 
-        x265_picture **m_inputPicBuffer;
+        /* pictures to encode, the one being encoded and the ones taken ahead
+         * of their turn when reusing the analysis of an encode without lookahead */
+        AbrPicQueue m_inputQueue;
+        AbrPicture* m_curPic;
+        std::vector<AbrPicture*> m_pending;
+        uint32_t m_picsRead;
+        char* m_ditherBuf;
+
         x265_analysis_data **m_analysisBuffer;
         x265_nal **m_outputNals;
         x265_picture **m_outputRecon;
@@ -102,36 +183,59 @@ namespace X265_NS {
         void startThreads();
         void copyInfo(x265_analysis_data *src);
 
+        bool sharesInput(PassEncoder* enc);
+        AbrPicSource* inputSource();
+        AbrPicture* takePicture(uint32_t index);
         bool readPicture(x265_picture*);
+        void closeInput();
+        void stopThreads();
         void destroy();
 
     private:
         void threadMain();
     };
 
-    class Scaler : public Thread
+    /* Scales the pictures of the rung above for this rung. Each picture is
+     * split in horizontal bands, each with its own filter manager, which are
+     * scaled by the Scaler thread and the workers of the scaler pool */
+    class Scaler : public Thread, public JobProvider
     {
     public:
         PassEncoder *m_parentEnc;
         int m_id;
         int m_scalePlanes[3];
         int m_scaleFrameSize;
-        uint32_t m_threadId;
-        uint32_t m_threadTotal;
-        ThreadSafeInteger m_scaledWriteCnt;
+        AbrPicQueue m_inputQueue;   // pictures of the rung above
+        AbrPicSource m_output;
         VideoDesc* m_srcFormat;
         VideoDesc* m_dstFormat;
         int m_threadActive;
-        ScalerFilterManager* m_filterManager;
+        ScalerFilterManager** m_filterManager; // [m_numBands]
+        int m_numBands;
+        int m_bandRows;
+
+        /* the picture being scaled and the progress of its bands */
+        Lock  m_bandLock;
+        Event m_bandsDone;
+        int   m_bandsTaken;
+        int   m_bandsFinished;
+        void* m_bandSrc[4];
+        void* m_bandDst[4];
+        int   m_bandSrcStride[4];
+        int   m_bandDstStride[4];
 
-        Scaler(int threadId, int threadNum, int id, VideoDesc *src, VideoDesc * dst, PassEncoder *parentEnc);
+        Scaler(int id, VideoDesc *src, VideoDesc * dst, PassEncoder *parentEnc);
         bool scalePic(x265_picture *destination, x265_picture *source);
+        bool scaleBand();
+        void findJob(int workerThreadId);
         void threadMain();
         void destroy()
         {
             if (m_filterManager)
             {
-                delete m_filterManager;
+                for (int i = 0; i < m_numBands; i++)
+                    delete m_filterManager[i];
+                delete[] m_filterManager;
                 m_filterManager = NULL;
             }
         }
@@ -144,6 +248,8 @@ namespace X265_NS {
         int m_id;
         InputFile* m_input;
         int m_threadActive;
+        uint32_t m_frameLimit;  // frames needed by the rungs it feeds, 0 for all
+        AbrPicSource m_output;
 
         Reader(int id, PassEncoder *parentEnc);
         void threadMain();
@@ -1,6 +1,7 @@
 #include "common.h"
 #include "slicetype.h"      // LOWRES_COST_MASK
 #include "primitives.h"
+#include "constants.h"      // g_crcTable
 #include "x265.h"
 
 #include "pixel-prim.h"
@@ -1691,6 +1692,580 @@ sse_t pixel_ssd_s_neon(const int16_t *a, intptr_t dstride)
     return sum + vaddvq_s32(vsum);
 }
 
+static inline int32x4_t mcstf_load4(const pixel *src)
+{
+#if HIGH_BIT_DEPTH
+    return vreinterpretq_s32_u32(vmovl_u16(vld1_u16(src)));
+#else
+    uint32_t val;
+    memcpy(&val, src, sizeof(val));
+    uint8x8_t in = vreinterpret_u8_u32(vdup_n_u32(val));
+    return vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(vmovl_u8(in))));
+#endif
+}
+
+static inline void mcstf_store4(pixel *dst, int32x4_t val)
+{
+    uint16x4_t out = vqmovun_s32(val);
+#if HIGH_BIT_DEPTH
+    vst1_u16(dst, out);
+#else
+    uint32_t packed = vget_lane_u32(vreinterpret_u32_u8(vqmovn_u16(vcombine_u16(out, out))), 0);
+    memcpy(dst, &packed, sizeof(packed));
+#endif
+}
+
+/* (num + den / 2) / den with a single precision quotient corrected to be bit
+ * exact with the integer division of the C reference */
+static inline int32x4_t mcstf_divround(int32x4_t num, int32x4_t den)
+{
+    int32x4_t val = vaddq_s32(num, vshrq_n_s32(den, 1));
+    int32x4_t quo = vcvtq_s32_f32(vdivq_f32(vcvtq_f32_s32(val), vcvtq_f32_s32(den)));
+    int32x4_t rem = vmlsq_s32(val, quo, den);
+    int32x4_t neg = vshrq_n_s32(rem, 31);
+    quo = vaddq_s32(quo, neg);
+    rem = vaddq_s32(rem, vandq_s32(neg, den));
+    return vsubq_s32(quo, vreinterpretq_s32_u32(vcgeq_s32(rem, den)));
+}
+
+void mcstfBilateral_neon(pixel *src, intptr_t srcStride, const pixel *const *refs, intptr_t refStride,
+                         const int32_t *refWeights, const uint16_t *const *weightLuts, int numRefs, int width, int height)
+{
+    for (int y = 0; y < height; y++)
+    {
+        int x = 0;
+        for (; x + 4 <= width; x += 4)
+        {
+            int32x4_t org = mcstf_load4(src + x);
+            int32x4_t num = vshlq_n_s32(org, MCSTF_WEIGHT_SHIFT);
+            int32x4_t den = vdupq_n_s32(1 << MCSTF_WEIGHT_SHIFT);
+
+            for (int i = 0; i < numRefs; i++)
+            {
+                const uint16_t *lut = weightLuts[i];
+                int32x4_t ref = mcstf_load4(refs[i] + y * refStride + x);
+                int32x4_t diff = vabdq_s32(ref, org);
+                int32_t w[4] = { lut[vgetq_lane_s32(diff, 0)], lut[vgetq_lane_s32(diff, 1)],
+                                 lut[vgetq_lane_s32(diff, 2)], lut[vgetq_lane_s32(diff, 3)] };
+                int32x4_t weight = vrshrq_n_s32(vmulq_n_s32(vld1q_s32(w), refWeights[i]), MCSTF_WEIGHT_SHIFT);
+                num = vmlaq_s32(num, weight, ref);
+                den = vaddq_s32(den, weight);
+            }
+
+            mcstf_store4(src + x, mcstf_divround(num, den));
+        }
+
+        for (; x < width; x++)
+        {
+            int orgVal = src[x];
+            int num = orgVal << MCSTF_WEIGHT_SHIFT;
+            int den = 1 << MCSTF_WEIGHT_SHIFT;
+
+            for (int i = 0; i < numRefs; i++)
+            {
+                int refVal = refs[i][y * refStride + x];
+                int weight = (refWeights[i] * weightLuts[i][abs(refVal - orgVal)] + (1 << (MCSTF_WEIGHT_SHIFT - 1))) >> MCSTF_WEIGHT_SHIFT;
+                num += weight * refVal;
+                den += weight;
+            }
+
+            src[x] = (pixel)((num + (den >> 1)) / den);
+        }
+
+        src += srcStride;
+    }
+}
+
+static inline void histogram_count4(uint32_t (*bank)[256], uint32_t bins)
+{
+    bank[0][bins & 255]++;
+    bank[1][(bins >> 8) & 255]++;
+    bank[2][(bins >> 16) & 255]++;
+    bank[3][bins >> 24]++;
+}
+
+/* four banks of counters so runs of equal samples do not serialise on the
+ * increment of a single counter */
+uint64_t histogram_neon(const pixel *src, intptr_t stride, int width, int height, int step, uint32_t *hist)
+{
+    uint32_t bank[4][256];
+    memset(bank, 0, sizeof(bank));
+    uint64_t sum = 0;
+
+    for (int y = 0; y < height; y += step)
+    {
+        int x = 0;
+        if (step == 1)
+        {
+            for (; x + 16 <= width; x += 16)
+            {
+#if HIGH_BIT_DEPTH
+                uint8x16_t bins = vcombine_u8(vshrn_n_u16(vld1q_u16(src + x), X265_DEPTH - 8),
+                                              vshrn_n_u16(vld1q_u16(src + x + 8), X265_DEPTH - 8));
+#else
+                uint8x16_t bins = vld1q_u8(src + x);
+#endif
+                sum += vaddlvq_u8(bins);
+
+                uint32x4_t words = vreinterpretq_u32_u8(bins);
+                histogram_count4(bank, vgetq_lane_u32(words, 0));
+                histogram_count4(bank, vgetq_lane_u32(words, 1));
+                histogram_count4(bank, vgetq_lane_u32(words, 2));
+                histogram_count4(bank, vgetq_lane_u32(words, 3));
+            }
+        }
+
+        for (int i = 0; x < width; x += step, i++)
+        {
+            int val = src[x] >> (X265_DEPTH - 8);
+            bank[i & 3][val]++;
+            sum += val;
+        }
+
+        src += stride * step;
+    }
+
+    for (int i = 0; i < 256; i += 4)
+    {
+        uint32x4_t acc = vld1q_u32(hist + i);
+        acc = vaddq_u32(acc, vld1q_u32(bank[0] + i));
+        acc = vaddq_u32(acc, vld1q_u32(bank[1] + i));
+        acc = vaddq_u32(acc, vld1q_u32(bank[2] + i));
+        acc = vaddq_u32(acc, vld1q_u32(bank[3] + i));
+        vst1q_u32(hist + i, acc);
+    }
+
+    return sum;
+}
+
+void propagateList_neon(int32_t *output, const int32_t *propagateAmount, const MV *mvs, const uint16_t *lowresCosts,
+                        int32_t bipredWeight, int list, int blocky, int len)
+{
+    int32_t *amounts = output;
+    int32_t *cuxs = output + len;
+    int32_t *cuys = output + 2 * len;
+    int32_t *shares = output + 3 * len;
+
+    const int32x4_t thirtyTwo = vdupq_n_s32(32);
+    const int32x4_t mask31 = vdupq_n_s32(31);
+    const int32x4_t row = vdupq_n_s32(blocky);
+    const int32x4_t listShift = vdupq_n_s32(-list);
+    const int32_t columnInit[4] = { 0, 1, 2, 3 };
+    int32x4_t column = vld1q_s32(columnInit);
+
+    int i = 0;
+    for (; i + 4 <= len; i += 4)
+    {
+        int32x4_t amount = vld1q_s32(propagateAmount + i);
+        int32x4_t listsUsed = vreinterpretq_s32_u32(vshrq_n_u32(vmovl_u16(vld1_u16(lowresCosts + i)), LOWRES_COST_SHIFT));
+
+        /* zero intra blocks and blocks not predicted from this list */
+        uint32x4_t keep = vandq_u32(vtstq_s32(vshlq_s32(listsUsed, listShift), vdupq_n_s32(1)), vcgtq_s32(amount, vdupq_n_s32(0)));
+        int32x4_t bipred = vshrq_n_s32(vaddq_s32(vmulq_n_s32(amount, bipredWeight), thirtyTwo), 6);
+        amount = vbslq_s32(vceqq_s32(listsUsed, vdupq_n_s32(3)), bipred, amount);
+        amount = vandq_s32(amount, vreinterpretq_s32_u32(keep));
+
+        /* de-interleave the (x, y) pairs of four MVs */
+        int32x4x2_t mv = vld2q_s32((const int32_t *)(mvs + i));
+        int32x4_t x = mv.val[0];
+        int32x4_t y = mv.val[1];
+
+        vst1q_s32(amounts + i, amount);
+        vst1q_s32(cuxs + i, vaddq_s32(vshrq_n_s32(x, 5), column));
+        vst1q_s32(cuys + i, vaddq_s32(vshrq_n_s32(y, 5), row));
+
+        x = vandq_s32(x, mask31);
+        y = vandq_s32(y, mask31);
+        int32x4_t x0 = vsubq_s32(thirtyTwo, x);
+        int32x4_t y0 = vsubq_s32(thirtyTwo, y);
+
+        /* (amount * weight + 512) >> 10, wrapping like the C reference */
+        vst1q_s32(shares + i, vshrq_n_s32(vaddq_s32(vmulq_s32(amount, vmulq_s32(y0, x0)), vdupq_n_s32(512)), 10));
+        vst1q_s32(shares + i + len, vshrq_n_s32(vaddq_s32(vmulq_s32(amount, vmulq_s32(y0, x)), vdupq_n_s32(512)), 10));
+        vst1q_s32(shares + i + 2 * len, vshrq_n_s32(vaddq_s32(vmulq_s32(amount, vmulq_s32(y, x0)), vdupq_n_s32(512)), 10));
+        vst1q_s32(shares + i + 3 * len, vshrq_n_s32(vaddq_s32(vmulq_s32(amount, vmulq_s32(y, x)), vdupq_n_s32(512)), 10));
+
+        column = vaddq_s32(column, vdupq_n_s32(4));
+    }
+
+    for (; i < len; i++)
+    {
+        int32_t listsUsed = lowresCosts[i] >> LOWRES_COST_SHIFT;
+        int32_t amount = propagateAmount[i];
+        if (amount <= 0 || !((listsUsed >> list) & 1))
+            amount = 0;
+        else if (listsUsed == 3)
+            amount = (amount * bipredWeight + 32) >> 6;
+
+        int32_t x = mvs[i].x;
+        int32_t y = mvs[i].y;
+        amounts[i] = amount;
+        cuxs[i] = (x >> 5) + i;
+        cuys[i] = (y >> 5) + blocky;
+        x &= 31;
+        y &= 31;
+        shares[i] = (amount * (32 - y) * (32 - x) + 512) >> 10;
+        shares[i + len] = (amount * (32 - y) * x + 512) >> 10;
+        shares[i + 2 * len] = (amount * y * (32 - x) + 512) >> 10;
+        shares[i + 3 * len] = (amount * y * x + 512) >> 10;
+    }
+}
+
+static inline int16x8_t scaler_load8(const pixel *src)
+{
+#if HIGH_BIT_DEPTH
+    return vreinterpretq_s16_u16(vld1q_u16(src));
+#else
+    return vreinterpretq_s16_u16(vmovl_u8(vld1_u8(src)));
+#endif
+}
+
+static inline int16x4_t scaler_load4(const pixel *src)
+{
+#if HIGH_BIT_DEPTH
+    return vreinterpret_s16_u16(vld1_u16(src));
+#else
+    uint32_t four;
+    memcpy(&four, src, sizeof(four));
+    return vget_low_s16(vreinterpretq_s16_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(four)))));
+#endif
+}
+
+/* The taps are consumed in chunks of eight (four for short filters); the last
+ * chunk is aligned to the end of the filter and masks the taps it shares with
+ * the previous chunk, so nothing outside the filter support is read */
+void scalerHFilter_neon(int16_t *dst, int dstW, const pixel *src, const int16_t *filter, const int32_t *filterPos, int filterSize)
+{
+    if (filterSize < 4)
+    {
+        for (int i = 0; i < dstW; i++)
+        {
+            int val = 0;
+            for (int j = 0; j < filterSize; j++)
+                val += (int)src[filterPos[i] + j] * filter[filterSize * i + j];
+            dst[i] = (int16_t)x265_clip3(-(1 << 15), (1 << 15) - 1, val >> SCALER_H_SHIFT);
+        }
+        return;
+    }
+
+    const int16_t lanes[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    if (filterSize >= 8)
+    {
+        const int last = filterSize - 8;
+        const int16x8_t tailMask = vreinterpretq_s16_u16(vcgeq_s16(vld1q_s16(lanes), vdupq_n_s16((int16_t)(8 - (filterSize & 7)))));
+        for (int i = 0; i < dstW; i++)
+        {
+            const pixel *s = src + filterPos[i];
+            const int16_t *f = filter + filterSize * i;
+            int32x4_t acc = vdupq_n_s32(0);
+            int j = 0;
+            for (; j < last; j += 8)
+            {
+                int16x8_t v = scaler_load8(s + j);
+                int16x8_t c = vld1q_s16(f + j);
+                acc = vmlal_s16(acc, vget_low_s16(v), vget_low_s16(c));
+                acc = vmlal_high_s16(acc, v, c);
+            }
+            int16x8_t v = scaler_load8(s + last);
+            int16x8_t c = vld1q_s16(f + last);
+            if (j != last)
+                c = vandq_s16(c, tailMask);
+            acc = vmlal_s16(acc, vget_low_s16(v), vget_low_s16(c));
+            acc = vmlal_high_s16(acc, v, c);
+            dst[i] = (int16_t)x265_clip3(-(1 << 15), (1 << 15) - 1, vaddvq_s32(acc) >> SCALER_H_SHIFT);
+        }
+    }
+    else
+    {
+        const int last = filterSize - 4;
+        const int16x4_t tailMask = vreinterpret_s16_u16(vcge_s16(vld1_s16(lanes), vdup_n_s16((int16_t)(4 - last))));
+        for (int i = 0; i < dstW; i++)
+        {
+            const pixel *s = src + filterPos[i];
+            const int16_t *f = filter + filterSize * i;
+            int32x4_t acc = vmull_s16(scaler_load4(s), vld1_s16(f));
+            if (last)
+                acc = vmlal_s16(acc, scaler_load4(s + last), vand_s16(vld1_s16(f + last), tailMask));
+            dst[i] = (int16_t)x265_clip3(-(1 << 15), (1 << 15) - 1, vaddvq_s32(acc) >> SCALER_H_SHIFT);
+        }
+    }
+}
+
+void scalerVFilter_neon(const int16_t *filter, int filterSize, const int16_t **src, pixel *dst, int dstW)
+{
+    const int32x4_t round = vdupq_n_s32(1 << (SCALER_V_SHIFT - 1));
+    int i = 0;
+
+    for (; i + 8 <= dstW; i += 8)
+    {
+        int32x4_t lo = round;
+        int32x4_t hi = round;
+        for (int j = 0; j < filterSize; j++)
+        {
+            int16x8_t s = vld1q_s16(src[j] + i);
+            lo = vmlal_n_s16(lo, vget_low_s16(s), filter[j]);
+            hi = vmlal_high_n_s16(hi, s, filter[j]);
+        }
+        lo = vshrq_n_s32(lo, SCALER_V_SHIFT);
+        hi = vshrq_n_s32(hi, SCALER_V_SHIFT);
+#if HIGH_BIT_DEPTH
+        vst1q_u16(dst + i, vminq_u16(vcombine_u16(vqmovun_s32(lo), vqmovun_s32(hi)), vdupq_n_u16(SCALER_PIXEL_MAX)));
+#else
+        vst1_u8(dst + i, vqmovun_s16(vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi))));
+#endif
+    }
+
+    for (; i < dstW; i++)
+    {
+        int val = 1 << (SCALER_V_SHIFT - 1);
+        for (int j = 0; j < filterSize; j++)
+            val += src[j][i] * filter[j];
+        dst[i] = (pixel)x265_clip3(0, SCALER_PIXEL_MAX, val >> SCALER_V_SHIFT);
+    }
+}
+
+static inline uint8_t *nal_escape_bytes(uint8_t *dst, const uint8_t *src, const uint8_t *end)
+{
+    while (src < end)
+    {
+        if (*src <= 0x03 && !dst[-2] && !dst[-1])
+        {
+            *dst++ = 0x03;
+        }
+        *dst++ = *src++;
+    }
+    return dst;
+}
+
+/* runs of 16 bytes that need no escaping are stored as they are, testing the
+ * preceding source bytes in place of the output ones (see nalEscape_avx2) */
+uint8_t *nalEscape_neon(uint8_t *dst, const uint8_t *src, const uint8_t *end)
+{
+    const uint8_t *head = src + 2 < end ? src + 2 : end;
+    dst = nal_escape_bytes(dst, src, head);
+    src = head;
+
+    while (end - src >= 16)
+    {
+        uint8x16_t cur = vld1q_u8(src);
+        uint8x16_t hit = vandq_u8(vceqzq_u8(vld1q_u8(src - 2)), vceqzq_u8(vld1q_u8(src - 1)));
+        hit = vandq_u8(hit, vcleq_u8(cur, vdupq_n_u8(3)));
+
+        if (!vmaxvq_u8(hit))
+        {
+            vst1q_u8(dst, cur);
+            dst += 16;
+        }
+        else
+        {
+            dst = nal_escape_bytes(dst, src, src + 16);
+        }
+        src += 16;
+    }
+
+    return nal_escape_bytes(dst, src, end);
+}
+
+static inline uint32_t crc_bytes(uint32_t crc, const uint8_t *buf, intptr_t len)
+{
+    for (intptr_t i = 0; i < len; i++)
+    {
+        crc = ((crc << 8) & 0xffff) ^ g_crcTable[(crc >> 8) ^ buf[i]];
+    }
+    return crc;
+}
+
+#if defined(__ARM_FEATURE_AES) || defined(__ARM_FEATURE_CRYPTO)
+static inline uint8x16_t reverse_bytes(uint8x16_t v)
+{
+    v = vrev64q_u8(v);
+    return vextq_u8(v, v, 8);
+}
+
+/* 16 byte folding with polynomial multiplies, as pictureCRC_avx2 */
+uint32_t pictureCRC_neon(uint32_t crc, const uint8_t *buf, intptr_t len)
+{
+    if (len >= 32)
+    {
+        const poly64_t k128 = 0xaefc; // x^128 mod P
+        const poly64_t k192 = 0x650b; // x^192 mod P
+
+        uint8x16_t f = reverse_bytes(vld1q_u8(buf));
+        f = veorq_u8(f, vreinterpretq_u8_u16(vsetq_lane_u16((uint16_t)crc, vdupq_n_u16(0), 7)));
+        buf += 16;
+        len -= 16;
+
+        for (; len >= 16; buf += 16, len -= 16)
+        {
+            uint64x2_t f64 = vreinterpretq_u64_u8(f);
+            poly128_t hi = vmull_p64((poly64_t)vgetq_lane_u64(f64, 1), k192);
+            poly128_t lo = vmull_p64((poly64_t)vgetq_lane_u64(f64, 0), k128);
+            f = veorq_u8(vreinterpretq_u8_p128(hi), vreinterpretq_u8_p128(lo));
+            f = veorq_u8(f, reverse_bytes(vld1q_u8(buf)));
+        }
+
+        uint8_t folded[16];
+        vst1q_u8(folded, reverse_bytes(f));
+        crc = crc_bytes(0, folded, 16);
+    }
+
+    return crc_bytes(crc, buf, len);
+}
+#endif
+
+uint32_t pictureChecksum_neon(const pixel *src, int width, int y)
+{
+    const uint32_t rowMask = (y & 0xff) ^ (y >> 8);
+    uint32x4_t acc = vdupq_n_u32(0);
+    int x = 0;
+
+#if HIGH_BIT_DEPTH
+    const uint16_t lane[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+    const uint16x8_t lanes = vld1q_u16(lane);
+    const uint16x8_t lowByte = vdupq_n_u16(0xff);
+
+    for (; x + 8 <= width; x += 8)
+    {
+        uint16x8_t mask = vaddq_u16(lanes, vdupq_n_u16((uint16_t)(x & 0xff)));
+        mask = veorq_u16(mask, vdupq_n_u16((uint8_t)((x >> 8) ^ rowMask)));
+
+        uint16x8_t p = vld1q_u16(src + x);
+        uint16x8_t terms = vaddq_u16(veorq_u16(vandq_u16(p, lowByte), mask), veorq_u16(vshrq_n_u16(p, 8), mask));
+        acc = vpadalq_u16(acc, terms);
+    }
+#else
+    const uint8_t lane[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    const uint8x16_t lanes = vld1q_u8(lane);
+
+    for (; x + 16 <= width; x += 16)
+    {
+        uint8x16_t mask = vaddq_u8(lanes, vdupq_n_u8((uint8_t)(x & 0xff)));
+        mask = veorq_u8(mask, vdupq_n_u8((uint8_t)((x >> 8) ^ rowMask)));
+        acc = vpadalq_u16(acc, vpaddlq_u8(veorq_u8(vld1q_u8(src + x), mask)));
+    }
+#endif
+
+    uint32_t checksum = vaddvq_u32(acc);
+    for (; x < width; x++)
+    {
+        uint32_t mask = (uint8_t)((x & 0xff) ^ (x >> 8) ^ rowMask);
+        checksum += (src[x] & 0xff) ^ mask;
+#if HIGH_BIT_DEPTH
+        checksum += (src[x] >> 8) ^ mask;
+#endif
+    }
+    return checksum;
+}
+
+/* two blocks per iteration; the products of each block are kept in their own
+ * register of four column sums */
+void ssimRowSums_neon(const pixel *pix1, intptr_t stride1, const pixel *pix2, intptr_t stride2, int sums[][4], int width)
+{
+    for (int x = 0; x < width; x += 2)
+    {
+        uint16x8_t s1 = vdupq_n_u16(0);
+        uint16x8_t s2 = vdupq_n_u16(0);
+        uint32x4_t ss0 = vdupq_n_u32(0), ss1 = vdupq_n_u32(0);
+        uint32x4_t s120 = vdupq_n_u32(0), s121 = vdupq_n_u32(0);
+
+        for (int y = 0; y < 4; y++)
+        {
+#if HIGH_BIT_DEPTH
+            uint16x8_t a = vld1q_u16(pix1 + 4 * x + y * stride1);
+            uint16x8_t b = vld1q_u16(pix2 + 4 * x + y * stride2);
+#else
+            uint16x8_t a = vmovl_u8(vld1_u8(pix1 + 4 * x + y * stride1));
+            uint16x8_t b = vmovl_u8(vld1_u8(pix2 + 4 * x + y * stride2));
+#endif
+            s1 = vaddq_u16(s1, a);
+            s2 = vaddq_u16(s2, b);
+            ss0 = vmlal_u16(vmlal_u16(ss0, vget_low_u16(a), vget_low_u16(a)), vget_low_u16(b), vget_low_u16(b));
+            ss1 = vmlal_high_u16(vmlal_high_u16(ss1, a, a), b, b);
+            s120 = vmlal_u16(s120, vget_low_u16(a), vget_low_u16(b));
+            s121 = vmlal_high_u16(s121, a, b);
+        }
+
+        /* s1 s2 and ss s12 of both blocks, then one block per register */
+        uint32x4_t first = vpaddq_u32(vpaddlq_u16(s1), vpaddlq_u16(s2));
+        uint32x4_t second = vpaddq_u32(vpaddq_u32(ss0, ss1), vpaddq_u32(s120, s121));
+        vst1q_s32(sums[x], vreinterpretq_s32_u32(vuzp1q_u32(first, second)));
+        vst1q_s32(sums[x + 1], vreinterpretq_s32_u32(vuzp2q_u32(first, second)));
+    }
+}
+
+/* four windows per iteration, with the arithmetic of ssim_end_1 in each lane */
+float ssimRowEnd_neon(int sum0[][4], int sum1[][4], int width)
+{
+#if HIGH_BIT_DEPTH
+    const float c1 = (float)(.01 * .01 * PIXEL_MAX * PIXEL_MAX * 64);
+    const float c2 = (float)(.03 * .03 * PIXEL_MAX * PIXEL_MAX * 64 * 63);
+#else
+    const int c1 = (int)(.01 * .01 * PIXEL_MAX * PIXEL_MAX * 64 + .5);
+    const int c2 = (int)(.03 * .03 * PIXEL_MAX * PIXEL_MAX * 64 * 63 + .5);
+#endif
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    int x = 0;
+
+    for (; x + 4 <= width; x += 4)
+    {
+        int32x4x4_t a = vld4q_s32(sum0[x]);
+        int32x4x4_t b = vld4q_s32(sum1[x]);
+        int32x4x4_t c = vld4q_s32(sum0[x + 1]);
+        int32x4x4_t d = vld4q_s32(sum1[x + 1]);
+        int32x4_t w[4];
+        for (int k = 0; k < 4; k++)
+        {
+            w[k] = vaddq_s32(vaddq_s32(a.val[k], b.val[k]), vaddq_s32(c.val[k], d.val[k]));
+        }
+
+#if HIGH_BIT_DEPTH
+        float32x4_t fs1 = vcvtq_f32_s32(w[0]);
+        float32x4_t fs2 = vcvtq_f32_s32(w[1]);
+        float32x4_t fss = vcvtq_f32_s32(w[2]);
+        float32x4_t fs12 = vcvtq_f32_s32(w[3]);
+        float32x4_t s1s1 = vmulq_f32(fs1, fs1);
+        float32x4_t s2s2 = vmulq_f32(fs2, fs2);
+        float32x4_t vars = vsubq_f32(vsubq_f32(vmulq_n_f32(fss, 64.0f), s1s1), s2s2);
+        float32x4_t covar = vsubq_f32(vmulq_n_f32(fs12, 64.0f), vmulq_f32(fs1, fs2));
+        float32x4_t num1 = vaddq_f32(vmulq_f32(vmulq_n_f32(fs1, 2.0f), fs2), vdupq_n_f32(c1));
+        float32x4_t num2 = vaddq_f32(vmulq_n_f32(covar, 2.0f), vdupq_n_f32(c2));
+        float32x4_t den1 = vaddq_f32(vaddq_f32(s1s1, s2s2), vdupq_n_f32(c1));
+        float32x4_t den2 = vaddq_f32(vars, vdupq_n_f32(c2));
+#else
+        int32x4_t s1s2 = vmulq_s32(w[0], w[1]);
+        int32x4_t s1s1 = vmulq_s32(w[0], w[0]);
+        int32x4_t s2s2 = vmulq_s32(w[1], w[1]);
+        int32x4_t vars = vsubq_s32(vsubq_s32(vshlq_n_s32(w[2], 6), s1s1), s2s2);
+        int32x4_t covar = vsubq_s32(vshlq_n_s32(w[3], 6), s1s2);
+        float32x4_t num1 = vcvtq_f32_s32(vaddq_s32(vshlq_n_s32(s1s2, 1), vdupq_n_s32(c1)));
+        float32x4_t num2 = vcvtq_f32_s32(vaddq_s32(vshlq_n_s32(covar, 1), vdupq_n_s32(c2)));
+        float32x4_t den1 = vcvtq_f32_s32(vaddq_s32(vaddq_s32(s1s1, s2s2), vdupq_n_s32(c1)));
+        float32x4_t den2 = vcvtq_f32_s32(vaddq_s32(vars, vdupq_n_s32(c2)));
+#endif
+        acc = vaddq_f32(acc, vdivq_f32(vmulq_f32(num1, num2), vmulq_f32(den1, den2)));
+    }
+
+    float ssim = vaddvq_f32(acc);
+    for (; x < width; x++)
+    {
+        int s1 = sum0[x][0] + sum0[x + 1][0] + sum1[x][0] + sum1[x + 1][0];
+        int s2 = sum0[x][1] + sum0[x + 1][1] + sum1[x][1] + sum1[x + 1][1];
+        int ss = sum0[x][2] + sum0[x + 1][2] + sum1[x][2] + sum1[x + 1][2];
+        int s12 = sum0[x][3] + sum0[x + 1][3] + sum1[x][3] + sum1[x + 1][3];
+#if HIGH_BIT_DEPTH
+        float fs1 = (float)s1, fs2 = (float)s2, fss = (float)ss, fs12 = (float)s12;
+        float vars = fss * 64 - fs1 * fs1 - fs2 * fs2;
+        float covar = fs12 * 64 - fs1 * fs2;
+        ssim += (2 * fs1 * fs2 + c1) * (2 * covar + c2) / ((fs1 * fs1 + fs2 * fs2 + c1) * (vars + c2));
+#else
+        int vars = ss * 64 - s1 * s1 - s2 * s2;
+        int covar = s12 * 64 - s1 * s2;
+        ssim += (float)(2 * s1 * s2 + c1) * (float)(2 * covar + c2) / ((float)(s1 * s1 + s2 * s2 + c1) * (float)(vars + c2));
+#endif
+    }
+    return ssim;
+}
+
 
 };
 
@@ -2048,6 +2623,18 @@ void setupPixelPrimitives_neon(EncoderPrimitives &p)
     p.chroma[X265_CSP_I422].cu[BLOCK_32x32].sa8d = sa8d16<16, 32>;
     p.chroma[X265_CSP_I422].cu[BLOCK_64x64].sa8d = sa8d16<32, 64>;
 
+    p.mcstfBilateral = mcstfBilateral_neon;
+    p.propagateList = propagateList_neon;
+    p.histogram = histogram_neon;
+    p.scalerHFilter = scalerHFilter_neon;
+    p.scalerVFilter = scalerVFilter_neon;
+    p.nalEscape = nalEscape_neon;
+#if defined(__ARM_FEATURE_AES) || defined(__ARM_FEATURE_CRYPTO)
+    p.pictureCRC = pictureCRC_neon;
+#endif
+    p.pictureChecksum = pictureChecksum_neon;
+    p.ssimRowSums = ssimRowSums_neon;
+    p.ssimRowEnd = ssimRowEnd_neon;
 
 }
 
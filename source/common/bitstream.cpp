@@ -13,33 +13,38 @@ using namespace X265_NS;
 Bitstream::Bitstream()
 {
     m_fifo = X265_MALLOC(uint8_t, MIN_FIFO_SIZE);
-    m_byteAlloc = MIN_FIFO_SIZE;
+    m_byteAlloc = m_fifo ? MIN_FIFO_SIZE : 0;
     resetBits();
 }
 
-void Bitstream::push_back(uint8_t val)
+bool Bitstream::grow(uint32_t minSize)
 {
     if (!m_fifo)
-        return;
+        return false;
+
+    /** reallocate buffer with doubled size */
+    uint32_t newSize = m_byteAlloc * 2;
+    while (newSize < minSize)
+        newSize *= 2;
 
-    if (m_byteOccupancy >= m_byteAlloc)
+    uint8_t *temp = X265_MALLOC(uint8_t, newSize);
+    if (!temp)
     {
-        /** reallocate buffer with doubled size */
-        uint8_t *temp = X265_MALLOC(uint8_t, m_byteAlloc * 2);
-        if (temp)
-        {
-            memcpy(temp, m_fifo, m_byteOccupancy);
-            X265_FREE(m_fifo);
-            m_fifo = temp;
-            m_byteAlloc *= 2;
-        }
-        else
-        {
-            x265_log(NULL, X265_LOG_ERROR, "Unable to realloc bitstream buffer");
-            return;
-        }
+        x265_log(NULL, X265_LOG_ERROR, "Unable to realloc bitstream buffer");
+        return false;
     }
-    m_fifo[m_byteOccupancy++] = val;
+
+    memcpy(temp, m_fifo, m_byteOccupancy);
+    X265_FREE(m_fifo);
+    m_fifo = temp;
+    m_byteAlloc = newSize;
+    return true;
+}
+
+void Bitstream::push_back(uint8_t val)
+{
+    if (m_byteOccupancy < m_byteAlloc || grow(m_byteOccupancy + 1))
+        m_fifo[m_byteOccupancy++] = val;
 }
 
 void Bitstream::write(uint32_t val, uint32_t numBits)
@@ -47,62 +52,63 @@ void Bitstream::write(uint32_t val, uint32_t numBits)
     X265_CHECK(numBits <= 32, "numBits out of range\n");
     X265_CHECK(numBits == 32 || ((val & (~0u << numBits)) == 0), "numBits & val out of range\n");
 
-    uint32_t totalPartialBits = m_partialByteBits + numBits;
-    uint32_t nextPartialBits = totalPartialBits & 7;
-    uint8_t  nextHeldByte = val << (8 - nextPartialBits);
-    uint32_t writeBytes = totalPartialBits >> 3;
+    /* the cache holds at most 31 bits here, so the new ones cannot overflow it */
+    m_cache = (m_cache << numBits) | val;
+    m_cacheBits += numBits;
 
-    if (writeBytes)
+    if (m_cacheBits >= 32)
     {
-        /* topword aligns m_partialByte with the msb of val */
-        uint32_t topword = (numBits - nextPartialBits) & ~7;
-#if USING_FTRAPV
-        uint32_t write_bits = (topword < 32 ? m_partialByte << topword : 0) | (val >> nextPartialBits);
-#else
-        uint32_t write_bits = (m_partialByte << topword) | (val >> nextPartialBits);
-#endif
+        m_cacheBits -= 32;
+        uint32_t word = (uint32_t)(m_cache >> m_cacheBits);
 
-        switch (writeBytes)
+        if (m_byteOccupancy + 4 <= m_byteAlloc || grow(m_byteOccupancy + 4))
         {
-        case 4: push_back(write_bits >> 24);  // fall-through
-        case 3: push_back(write_bits >> 16);  // fall-through
-        case 2: push_back(write_bits >> 8);   // fall-through
-        case 1: push_back(write_bits);
+            uint8_t *out = m_fifo + m_byteOccupancy;
+            out[0] = (uint8_t)(word >> 24);
+            out[1] = (uint8_t)(word >> 16);
+            out[2] = (uint8_t)(word >> 8);
+            out[3] = (uint8_t)word;
+            m_byteOccupancy += 4;
         }
-
-        m_partialByte = nextHeldByte;
-        m_partialByteBits = nextPartialBits;
-    }
-    else
-    {
-        m_partialByte |= nextHeldByte;
-        m_partialByteBits = nextPartialBits;
     }
 }
 
 void Bitstream::writeByte(uint32_t val)
 {
     // Only CABAC will call writeByte, the fifo must be byte aligned
-    X265_CHECK(!m_partialByteBits, "expecting m_partialByteBits = 0\n");
+    X265_CHECK(!(m_cacheBits & 7), "expecting byte aligned bitstream\n");
+
+    if (m_cacheBits)
+        write(val & 0xff, 8);
+    else
+        push_back(val);
+}
 
-    push_back(val);
+/* store the whole bytes held in the cache */
+void Bitstream::flushBytes()
+{
+    while (m_cacheBits >= 8)
+    {
+        m_cacheBits -= 8;
+        push_back((uint8_t)(m_cache >> m_cacheBits));
+    }
 }
 
 void Bitstream::writeAlignOne()
 {
-    uint32_t numBits = (8 - m_partialByteBits) & 0x7;
+    uint32_t numBits = (8 - m_cacheBits) & 0x7;
 
     write((1 << numBits) - 1, numBits);
+    flushBytes();
 }
 
 void Bitstream::writeAlignZero()
 {
-    if (m_partialByteBits)
-    {
-        push_back(m_partialByte);
-        m_partialByte = 0;
-        m_partialByteBits = 0;
-    }
+    uint32_t numBits = (8 - m_cacheBits) & 0x7;
+
+    m_cache <<= numBits;
+    m_cacheBits += numBits;
+    flushBytes();
 }
 
 void Bitstream::writeByteAlignment()
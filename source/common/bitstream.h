@@ -60,6 +60,9 @@ public:
 };
 
 
+/* Bits are gathered MSB first in a 64-bit cache and stored to the FIFO 32 at a
+ * time; fewer than 32 bits are held between writes. The FIFO holds all the
+ * written bits once the stream has been byte aligned */
 class Bitstream : public BitInterface
 {
 public:
@@ -67,11 +70,11 @@ public:
     Bitstream();
     ~Bitstream()                             { X265_FREE(m_fifo); }
 
-    void     resetBits()                     { m_partialByteBits = m_byteOccupancy = 0; m_partialByte = 0; }
+    void     resetBits()                     { m_cacheBits = m_byteOccupancy = 0; m_cache = 0; }
     uint32_t getNumberOfWrittenBytes() const { return m_byteOccupancy; }
-    uint32_t getNumberOfWrittenBits()  const { return m_byteOccupancy * 8 + m_partialByteBits; }
+    uint32_t getNumberOfWrittenBits()  const { return m_byteOccupancy * 8 + m_cacheBits; }
     const uint8_t* getFIFO() const           { return m_fifo; }
-    void     copyBits(Bitstream* stream)     { m_partialByteBits = stream->m_partialByteBits; m_byteOccupancy = stream->m_byteOccupancy; m_partialByte = stream->m_partialByte; }
+    void     copyBits(Bitstream* stream)     { m_cacheBits = stream->m_cacheBits; m_byteOccupancy = stream->m_byteOccupancy; m_cache = stream->m_cache; }
 
     void     write(uint32_t val, uint32_t numBits);
     void     writeByte(uint32_t val);
@@ -85,10 +88,12 @@ private:
     uint8_t *m_fifo;
     uint32_t m_byteAlloc;
     uint32_t m_byteOccupancy;
-    uint32_t m_partialByteBits;
-    uint8_t  m_partialByte;
+    uint32_t m_cacheBits;
+    uint64_t m_cache;
 
+    bool     grow(uint32_t minSize);
     void     push_back(uint8_t val);
+    void     flushBytes();
 };
 
 static const uint8_t bitSize[256] =
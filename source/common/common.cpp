@@ -33,6 +33,8 @@
 #include <fcntl.h>
 #else
 #include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #endif
 
 namespace X265_NS {
@@ -306,4 +308,51 @@ error:
     return NULL;
 }
 
+
+/* Map a whole file read-only. Returns NULL when the file is empty or cannot be
+ * mapped (or does not fit the address space), in which case callers fall back
+ * to stdio. The mapping stays valid after the file is closed */
+uint8_t* x265_map_file(FILE* fh, uint64_t* size)
+{
+    uint8_t* map = NULL;
+#if _WIN32
+    HANDLE file = (HANDLE)_get_osfhandle(_fileno(fh));
+    LARGE_INTEGER fileSize;
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize) || fileSize.QuadPart <= 0)
+        return NULL;
+    *size = (uint64_t)fileSize.QuadPart;
+    if ((uint64_t)(size_t)*size != *size)
+        return NULL;
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping)
+        return NULL;
+    map = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+#else
+    struct stat st;
+    int fd = fileno(fh);
+    if (fstat(fd, &st) || st.st_size <= 0)
+        return NULL;
+    *size = (uint64_t)st.st_size;
+    if ((uint64_t)(size_t)*size != *size)
+        return NULL;
+    void* addr = mmap(NULL, (size_t)*size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr != MAP_FAILED)
+        map = (uint8_t*)addr;
+#endif
+    return map;
+}
+
+void x265_unmap_file(uint8_t* map, uint64_t size)
+{
+    if (!map)
+        return;
+#if _WIN32
+    (void)size;
+    UnmapViewOfFile(map);
+#else
+    munmap(map, (size_t)size);
+#endif
+}
+
 }
@@ -48,6 +48,7 @@
 #if ENABLE_PPA
 #include "profile/PPA/ppa.h"
 #define ProfileScopeEvent(x) PPAScopeEvent(x)
+#define ProfileScopeEventArg(x, a) PPAScopeEvent(x)
 #define THREAD_NAME(n,i)
 #define PROFILE_INIT()       PPA_INIT()
 #define PROFILE_PAUSE()
@@ -55,13 +56,15 @@
 #elif ENABLE_VTUNE
 #include "profile/vtune/vtune.h"
 #define ProfileScopeEvent(x) VTuneScopeEvent _vtuneTask(x)
+#define ProfileScopeEventArg(x, a) VTuneScopeEvent _vtuneTask(x)
 #define THREAD_NAME(n,i)     vtuneSetThreadName(n, i)
 #define PROFILE_INIT()       vtuneInit()
 #define PROFILE_PAUSE()      __itt_pause()
 #define PROFILE_RESUME()     __itt_resume()
 #else
-#define ProfileScopeEvent(x)
-#define THREAD_NAME(n,i)
+#define ProfileScopeEvent(x) TraceScopeEvent _traceEvent_##x(x)
+#define ProfileScopeEventArg(x, a) TraceScopeEvent _traceEvent_##x(x, a)
+#define THREAD_NAME(n,i)     traceSetThreadName(n, i)
 #define PROFILE_INIT()
 #define PROFILE_PAUSE()
 #define PROFILE_RESUME()
@@ -455,6 +458,8 @@ uint32_t x265_picturePlaneSize(int csp, int width, int height, int plane);
 void*    x265_malloc(size_t size);
 void     x265_free(void *ptr);
 char*    x265_slurp_file(const char *filename);
+uint8_t* x265_map_file(FILE* fh, uint64_t* size);
+void     x265_unmap_file(uint8_t* map, uint64_t size);
 
 /* located in primitives.cpp */
 void     x265_setup_primitives(x265_param* param);
@@ -462,5 +467,6 @@ void     x265_report_simd(x265_param* param);
 }
 
 #include "constants.h"
+#include "trace.h"
 
 #endif // ifndef X265_COMMON_H
@@ -33,12 +33,15 @@ Frame::Frame()
 {
     m_bChromaExtended = false;
     m_lowresInit = false;
+    m_lowresInitClaimed = false;
     m_reconRowFlag = NULL;
     m_reconColCount = NULL;
     m_countRefEncoders = 0;
     m_encData = NULL;
     m_reconPic = NULL;
     m_quantOffsets = NULL;
+    m_releasePlanes = NULL;
+    m_planesOpaque = NULL;
     m_next = NULL;
     m_prev = NULL;
     m_param = NULL;
@@ -222,6 +225,14 @@ bool Frame::allocEncodeData(x265_param *param, const SPS& sps)
             m_reconPic->m_cuOffsetC = sps.cuOffsetC;
             m_reconPic->m_buOffsetC = sps.buOffsetC;
         }
+
+        /* without the planes, every half-pel candidate is interpolated on demand */
+        if (param->bEnableHpelCache && param->maxSlices == 1)
+        {
+            size_t padHeight = maxHeight + 2 * m_reconPic->m_lumaMarginY;
+            for (int i = 0; i < 3; i++)
+                m_encData->m_hpelBuffer[i] = X265_MALLOC(pixel, m_reconPic->m_stride * padHeight);
+        }
     }
     return ok;
 }
@@ -234,8 +245,29 @@ void Frame::reinit(const SPS& sps)
     m_encData->reinit(sps);
 }
 
+/* Without --copy-pic the source picture aliases the user's planes; hand them
+ * back once the frame leaves the DPB (or the encoder) */
+void Frame::releaseInput()
+{
+    if (m_param && m_param->bCopyPicToFrame)
+        return;
+
+    if (m_fencPic)
+        m_fencPic->m_picOrg[0] = m_fencPic->m_picOrg[1] = m_fencPic->m_picOrg[2] = NULL;
+
+    if (m_releasePlanes)
+    {
+        void (*release)(void*) = m_releasePlanes;
+        m_releasePlanes = NULL;
+        release(m_planesOpaque);
+    }
+    m_planesOpaque = NULL;
+}
+
 void Frame::destroy()
 {
+    releaseInput();
+
     if (m_encData)
     {
         m_encData->destroy();
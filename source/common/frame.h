@@ -96,9 +96,12 @@ public:
     int64_t                m_dts;
     int32_t                m_forceqp;            // Force to use the qp specified in qp file
     void*                  m_userData;           // user provided pointer passed in with this picture
+    void                 (*m_releasePlanes)(void*); // zero-copy input: returns the aliased planes to the user
+    void*                  m_planesOpaque;
 
     Lowres                 m_lowres;
     bool                   m_lowresInit;         // lowres init complete (pre-analysis)
+    bool                   m_lowresInitClaimed;  // pre-analysis started by a lookahead thread
     bool                   m_bChromaExtended;    // orig chroma planes motion extended for weight analysis
     bool                   m_reconfigureRc;
 
@@ -112,6 +115,7 @@ public:
     ThreadSafeInteger*     m_reconColCount;      // count of CTU cols completely reconstructed and extended for motion reference
     int32_t                m_numRows;
     volatile uint32_t      m_countRefEncoders;   // count of FrameEncoder threads monitoring m_reconRowCount
+    Lock                   m_hpelLock;           // serializes the interpolation of m_encData->m_hpelBuffer
 
     Frame*                 m_next;               // PicList doubly linked list pointers
     Frame*                 m_prev;
@@ -144,6 +148,7 @@ public:
     Frame*                 m_nextMCSTF;           // PicList doubly linked list pointers
     Frame*                 m_prevMCSTF;
     int*                   m_isSubSampled;
+    Lock                   m_subSampleLock;       // serializes the MCSTF subsampling of this frame
 
     /* aq-mode 4 : Gaussian, edge and theta frames for edge information */
     pixel*                 m_edgePic;
@@ -167,6 +172,7 @@ public:
     bool createSubSample();
     bool allocEncodeData(x265_param *param, const SPS& sps);
     void reinit(const SPS& sps);
+    void releaseInput();
     void destroy();
 };
 }
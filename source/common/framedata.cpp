@@ -64,6 +64,16 @@ bool FrameData::create(const x265_param& param, const SPS& sps, int csp)
         return false;
     CHECKED_MALLOC_ZERO(m_cuStat, RCStatCU, sps.numCUsInFrame + 1);
     CHECKED_MALLOC(m_rowStat, RCStatRow, sps.numCuInHeight);
+    if (param.bEnableCtuMetrics)
+    {
+        if (param.bEnablePsnr)
+        {
+            for (int plane = 0; plane < (param.internalCsp != X265_CSP_I400 ? 3 : 1); plane++)
+                CHECKED_MALLOC_ZERO(m_ctuPsnr[plane], double, sps.numCUsInFrame);
+        }
+        if (param.bEnableSsim)
+            CHECKED_MALLOC_ZERO(m_ctuSsim, double, sps.numCUsInFrame);
+    }
     reinit(sps);
     
     for (int i = 0; i < INTEGRAL_PLANE_NUM; i++)
@@ -79,6 +89,7 @@ fail:
 
 void FrameData::reinit(const SPS& sps)
 {
+    m_hpelLines = INT_MIN;
     memset(m_cuStat, 0, sps.numCUsInFrame * sizeof(*m_cuStat));
     memset(m_rowStat, 0, sps.numCuInHeight * sizeof(*m_rowStat));
     if (m_param->bDynamicRefine)
@@ -105,6 +116,11 @@ void FrameData::destroy()
     }
     X265_FREE(m_cuStat);
     X265_FREE(m_rowStat);
+    for (int plane = 0; plane < 3; plane++)
+        X265_FREE(m_ctuPsnr[plane]);
+    X265_FREE(m_ctuSsim);
+    for (int i = 0; i < 3; i++)
+        X265_FREE(m_hpelBuffer[i]);
     for (int i = 0; i < INTEGRAL_PLANE_NUM; i++)
     {
         if (m_meBuffer[i] != NULL)
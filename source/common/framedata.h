@@ -168,9 +168,20 @@ public:
     double         m_rateFactor; /* calculated based on the Frame QP */
     int            m_picCsp;
 
+    /* per-CTU metric maps exported through x265_frame_stats (--ctu-metrics) */
+    double*        m_ctuPsnr[3];
+    double*        m_ctuSsim;
+
     uint32_t*              m_meIntegral[INTEGRAL_PLANE_NUM];       // 12 integral planes for 32x32, 32x24, 32x8, 24x32, 16x16, 16x12, 16x4, 12x16, 8x32, 8x8, 4x16 and 4x4.
     uint32_t*              m_meBuffer[INTEGRAL_PLANE_NUM];
 
+    /* --hpel-cache: H, V and HV half-pel planes of the reconstructed luma, with
+     * the margins of m_reconPic, shared by every frame encoder referencing this
+     * picture unweighted. Lines above m_hpelLines are interpolated, under the
+     * frame's m_hpelLock; see MotionReference::applyHpel() */
+    pixel*                 m_hpelBuffer[3];
+    int                    m_hpelLines;
+
     FrameData();
 
     bool create(const x265_param& param, const SPS& sps, int csp);
@@ -69,10 +69,112 @@ fail:
     return false;
 }
 
+LowresSlicePool::LowresSlicePool(int bframes)
+{
+    for (int i = 0; i < NUM_SLICE_TYPES; i++)
+    {
+        m_freeList[i] = NULL;
+        m_sliceSize[i] = 0;
+        m_inUse[i] = 0;
+        m_allocated[i] = 0;
+    }
+    m_refCount = m_peakRefCount = 1;
+    m_bframes = bframes;
+}
+
+LowresSlicePool::~LowresSlicePool()
+{
+    for (int i = 0; i < NUM_SLICE_TYPES; i++)
+    {
+        while (m_freeList[i])
+        {
+            FreeSlice* slice = m_freeList[i];
+            m_freeList[i] = slice->next;
+            X265_FREE(slice);
+        }
+    }
+}
+
+void* LowresSlicePool::take(int type, size_t size)
+{
+    ScopedLock lock(m_lock);
+
+    X265_CHECK(!m_sliceSize[type] || m_sliceSize[type] == size, "lowres slice size changed\n");
+    FreeSlice* slice = m_freeList[type];
+    if (slice)
+        m_freeList[type] = slice->next;
+    else
+    {
+        slice = (FreeSlice*)X265_MALLOC(uint8_t, size);
+        if (!slice)
+        {
+            x265_log(NULL, X265_LOG_ERROR, "malloc of size %d failed\n", (int)size);
+            return NULL;
+        }
+        m_sliceSize[type] = size;
+        m_allocated[type]++;
+    }
+    m_inUse[type]++;
+    return slice;
+}
+
+void LowresSlicePool::give(int type, void* slice)
+{
+    ScopedLock lock(m_lock);
+
+    FreeSlice* freeSlice = (FreeSlice*)slice;
+    freeSlice->next = m_freeList[type];
+    m_freeList[type] = freeSlice;
+    m_inUse[type]--;
+}
+
+void LowresSlicePool::addRef()
+{
+    ScopedLock lock(m_lock);
+    m_refCount++;
+    m_peakRefCount = X265_MAX(m_peakRefCount, m_refCount);
+}
+
+void LowresSlicePool::release()
+{
+    m_lock.acquire();
+    bool bLast = !--m_refCount;
+    m_lock.release();
+    if (bLast)
+        delete this;
+}
+
+/* Report the high-water mark of the slices against the memory the frames
+ * would have held with every (p0, p1) combination allocated up front */
+void LowresSlicePool::logStats(const x265_param* param)
+{
+    ScopedLock lock(m_lock);
+
+    int frames = m_peakRefCount - 1; // the lookahead holds the first reference
+    if (!frames || !m_allocated[COST_SLICE])
+        return;
+
+    double peakBytes = (double)m_allocated[COST_SLICE] * m_sliceSize[COST_SLICE] + (double)m_allocated[MV_SLICE] * m_sliceSize[MV_SLICE];
+    double fullBytes = (double)frames * (m_bframes + 2) * ((m_bframes + 2) * m_sliceSize[COST_SLICE] + 2 * m_sliceSize[MV_SLICE]);
+    x265_log(param, X265_LOG_INFO, "lookahead: %u cost and %u mv slices at high-water, %.2f MiB of %.2f MiB for %d frames\n",
+             m_allocated[COST_SLICE], m_allocated[MV_SLICE], peakBytes / (1024 * 1024), fullBytes / (1024 * 1024), frames);
+}
+
 bool Lowres::create(x265_param* param, PicYuv *origPic, uint32_t qgSize)
 {
     isLowres = true;
     bframes = param->bframes;
+
+    /* the cost and MV slices are taken on first use by the lookahead */
+    slicePool = NULL;
+    lowresCostForRc = NULL;
+    memset(rowSatds, 0, sizeof(rowSatds));
+    memset(lowresCosts, 0, sizeof(lowresCosts));
+    memset(lowresMvs, 0, sizeof(lowresMvs));
+    memset(lowresMvCosts, 0, sizeof(lowresMvCosts));
+    memset(lowerResMvs, 0, sizeof(lowerResMvs));
+    memset(lowerResMvCosts, 0, sizeof(lowerResMvCosts));
+
     widthFullRes = origPic->m_picWidth;
     heightFullRes = origPic->m_picHeight;
     width = origPic->m_picWidth / 2;
@@ -185,33 +287,6 @@ bool Lowres::create(x265_param* param, PicYuv *origPic, uint32_t qgSize)
     CHECKED_MALLOC(intraCost, int32_t, cuCount);
     CHECKED_MALLOC(intraMode, uint8_t, cuCount);
 
-    for (int i = 0; i < bframes + 2; i++)
-    {
-        for (int j = 0; j < bframes + 2; j++)
-        {
-            CHECKED_MALLOC(rowSatds[i][j], int32_t, maxBlocksInCol);
-            CHECKED_MALLOC(lowresCosts[i][j], uint16_t, cuCount);
-        }
-    }
-
-    for (int i = 0; i < bframes + 2; i++)
-    {
-        CHECKED_MALLOC(lowresMvs[0][i], MV, cuCount);
-        CHECKED_MALLOC(lowresMvs[1][i], MV, cuCount);
-        CHECKED_MALLOC(lowresMvCosts[0][i], int32_t, cuCount);
-        CHECKED_MALLOC(lowresMvCosts[1][i], int32_t, cuCount);
-        if (bEnableHME)
-        {
-            int maxBlocksInRowLowerRes = ((width/2) + X265_LOWRES_CU_SIZE - 1) >> X265_LOWRES_CU_BITS;
-            int maxBlocksInColLowerRes = ((lines/2) + X265_LOWRES_CU_SIZE - 1) >> X265_LOWRES_CU_BITS;
-            int cuCountLowerRes = maxBlocksInRowLowerRes * maxBlocksInColLowerRes;
-            CHECKED_MALLOC(lowerResMvs[0][i], MV, cuCountLowerRes);
-            CHECKED_MALLOC(lowerResMvs[1][i], MV, cuCountLowerRes);
-            CHECKED_MALLOC(lowerResMvCosts[0][i], int32_t, cuCountLowerRes);
-            CHECKED_MALLOC(lowerResMvCosts[1][i], int32_t, cuCountLowerRes);
-        }
-    }
-
     if (param->bHistBasedSceneCut)
     {
         quarterSampleLowResWidth = widthFullRes / 4;
@@ -258,29 +333,11 @@ void Lowres::destroy(x265_param* param)
     X265_FREE(intraCost);
     X265_FREE(intraMode);
 
-    for (int i = 0; i < bframes + 2; i++)
-    {
-        for (int j = 0; j < bframes + 2; j++)
-        {
-            X265_FREE(rowSatds[i][j]);
-            X265_FREE(lowresCosts[i][j]);
-        }
-    }
+    releaseSlices();
+    if (slicePool)
+        slicePool->release();
+    slicePool = NULL;
 
-    for (int i = 0; i < bframes + 2; i++)
-    {
-        X265_FREE(lowresMvs[0][i]);
-        X265_FREE(lowresMvs[1][i]);
-        X265_FREE(lowresMvCosts[0][i]);
-        X265_FREE(lowresMvCosts[1][i]);
-        if (bEnableHME)
-        {
-            X265_FREE(lowerResMvs[0][i]);
-            X265_FREE(lowerResMvs[1][i]);
-            X265_FREE(lowerResMvCosts[0][i]);
-            X265_FREE(lowerResMvCosts[1][i]);
-        }
-    }
     X265_FREE(qpAqOffset);
     X265_FREE(invQscaleFactor);
     X265_FREE(qpCuTreeOffset);
@@ -333,6 +390,101 @@ void Lowres::destroy(x265_param* param)
 
     }
 }
+/* Take the cost slice of a (b - p0, p1 - b) estimate from the pool, marked as
+ * not estimated, unless the frame holds it already */
+bool Lowres::takeCostSlice(int dist0, int dist1)
+{
+    if (rowSatds[dist0][dist1])
+        return true;
+
+    X265_CHECK(slicePool, "lowres slice taken outside of the lookahead\n");
+    size_t satdSize = ((maxBlocksInCol * sizeof(int32_t)) + 63) & ~(size_t)63;
+    uint8_t* slice = (uint8_t*)slicePool->take(LowresSlicePool::COST_SLICE, satdSize + maxBlocksInRow * maxBlocksInCol * sizeof(uint16_t));
+    if (!slice)
+        return false;
+
+    rowSatds[dist0][dist1] = (int32_t*)slice;
+    lowresCosts[dist0][dist1] = (uint16_t*)(slice + satdSize);
+    rowSatds[dist0][dist1][0] = -1;
+    return true;
+}
+
+/* Take every slice the estimate of (b - p0, p1 - b) writes: its cost slice and
+ * the L0 (and for bidir, L1) MV slices, each holding the lowres MVs and their
+ * costs, followed by the lower resolution ones when HME is enabled */
+bool Lowres::takeSlices(int dist0, int dist1)
+{
+    if (!takeCostSlice(dist0, dist1))
+        return false;
+
+    int cuCount = maxBlocksInRow * maxBlocksInCol;
+    int cuCountLowerRes = 0;
+    if (bEnableHME)
+    {
+        int maxBlocksInRowLowerRes = ((width/2) + X265_LOWRES_CU_SIZE - 1) >> X265_LOWRES_CU_BITS;
+        int maxBlocksInColLowerRes = ((lines/2) + X265_LOWRES_CU_SIZE - 1) >> X265_LOWRES_CU_BITS;
+        cuCountLowerRes = maxBlocksInRowLowerRes * maxBlocksInColLowerRes;
+    }
+    size_t mvSize = ((cuCount * sizeof(MV)) + 63) & ~(size_t)63;
+    size_t costSize = ((cuCount * sizeof(int32_t)) + 63) & ~(size_t)63;
+    size_t lowerMvSize = ((cuCountLowerRes * sizeof(MV)) + 63) & ~(size_t)63;
+    size_t sliceSize = mvSize + costSize + lowerMvSize + cuCountLowerRes * sizeof(int32_t);
+
+    for (int list = 0; list < 2; list++)
+    {
+        int dist = list ? dist1 : dist0;
+        if ((list && !dist) || lowresMvs[list][dist])
+            continue;
+
+        uint8_t* slice = (uint8_t*)slicePool->take(LowresSlicePool::MV_SLICE, sliceSize);
+        if (!slice)
+            return false;
+
+        lowresMvs[list][dist] = (MV*)slice;
+        lowresMvCosts[list][dist] = (int32_t*)(slice + mvSize);
+        if (bEnableHME)
+        {
+            lowerResMvs[list][dist] = (MV*)(slice + mvSize + costSize);
+            lowerResMvCosts[list][dist] = (int32_t*)(slice + mvSize + costSize + lowerMvSize);
+        }
+        lowresMvs[list][dist][0].x = 0x7FFF;
+    }
+    return true;
+}
+
+/* Give all slices back to the pool, once the frame no longer needs them */
+void Lowres::releaseSlices()
+{
+    for (int i = 0; i < bframes + 2; i++)
+    {
+        for (int j = 0; j < bframes + 2; j++)
+        {
+            if (rowSatds[i][j])
+            {
+                slicePool->give(LowresSlicePool::COST_SLICE, rowSatds[i][j]);
+                rowSatds[i][j] = NULL;
+                lowresCosts[i][j] = NULL;
+            }
+        }
+    }
+
+    for (int i = 0; i < bframes + 2; i++)
+    {
+        for (int list = 0; list < 2; list++)
+        {
+            if (lowresMvs[list][i])
+            {
+                slicePool->give(LowresSlicePool::MV_SLICE, lowresMvs[list][i]);
+                lowresMvs[list][i] = NULL;
+                lowresMvCosts[list][i] = NULL;
+                lowerResMvs[list][i] = NULL;
+                lowerResMvCosts[list][i] = NULL;
+            }
+        }
+    }
+    lowresCostForRc = NULL;
+}
+
 // (re) initialize lowres state
 void Lowres::init(PicYuv *origPic, int poc)
 {
@@ -348,15 +500,7 @@ void Lowres::init(PicYuv *origPic, int poc)
     if (qpAqOffset && invQscaleFactor)
         memset(costEstAq, -1, sizeof(costEstAq));
 
-    for (int y = 0; y < bframes + 2; y++)
-        for (int x = 0; x < bframes + 2; x++)
-            rowSatds[y][x][0] = -1;
-
-    for (int i = 0; i < bframes + 2; i++)
-    {
-        lowresMvs[0][i][0].x = 0x7FFF;
-        lowresMvs[1][i][0].x = 0x7FFF;
-    }
+    releaseSlices();
 
     for (int i = 0; i < bframes + 2; i++)
         intraMbs[i] = 0;
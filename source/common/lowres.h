@@ -28,6 +28,7 @@
 #include "common.h"
 #include "picyuv.h"
 #include "mv.h"
+#include "threading.h"
 
 namespace X265_NS {
 // private namespace
@@ -48,6 +49,11 @@ struct ReferencePlanes
     pixel*   fpelLowerResPlane[3];
     pixel*   lowerResPlane[4];
 
+    /* full resolution half-pel planes (H, V and HV), valid above line
+     * hpelLines; see MotionReference::applyHpel() */
+    pixel*   hpelPlane[3];
+    volatile int hpelLines;
+
     bool     isWeighted;
     bool     isLowres;
     bool     isHMELowres;
@@ -167,6 +173,48 @@ struct PicQPAdaptationLayer
     void  destroy();
 };
 
+/* Arena of the lowres cost and motion vector slices of one encoder. A frame
+ * takes the slice of a (p0, p1) cost estimate or of a motion search the first
+ * time the lookahead performs it, and gives them back once the frame is
+ * encoded, so only the combinations the lookahead actually visits hold memory,
+ * and only for the frames between lookahead and output. Slices are
+ * never freed until the pool is; every frame holds a reference to the pool and
+ * the last one released deletes it */
+class LowresSlicePool
+{
+public:
+
+    enum { COST_SLICE, MV_SLICE, NUM_SLICE_TYPES };
+
+    LowresSlicePool(int bframes);
+
+    void* take(int type, size_t size);
+    void  give(int type, void* slice);
+
+    void  addRef();
+    void  release();
+
+    void  logStats(const x265_param* param);
+
+protected:
+
+    ~LowresSlicePool();
+
+    struct FreeSlice
+    {
+        FreeSlice* next;
+    };
+
+    Lock       m_lock;
+    FreeSlice* m_freeList[NUM_SLICE_TYPES];
+    size_t     m_sliceSize[NUM_SLICE_TYPES];
+    uint32_t   m_inUse[NUM_SLICE_TYPES];
+    uint32_t   m_allocated[NUM_SLICE_TYPES]; // high-water mark of m_inUse
+    int        m_refCount;
+    int        m_peakRefCount;
+    int        m_bframes;
+};
+
 /* lowres buffers, sizes and strides */
 struct Lowres : public ReferencePlanes
 {
@@ -187,7 +235,9 @@ struct Lowres : public ReferencePlanes
 
     double ipCostRatio;
 
-    /* lookahead output data */
+    /* lookahead output data; the per (p0, p1) cost slices and the per list and
+     * distance MV slices are NULL until taken from slicePool */
+    LowresSlicePool* slicePool;
     int64_t   costEst[X265_BFRAME_MAX + 2][X265_BFRAME_MAX + 2];
     int64_t   costEstAq[X265_BFRAME_MAX + 2][X265_BFRAME_MAX + 2];
     int32_t*  rowSatds[X265_BFRAME_MAX + 2][X265_BFRAME_MAX + 2];
@@ -260,6 +310,13 @@ struct Lowres : public ReferencePlanes
     bool create(x265_param* param, PicYuv *origPic, uint32_t qgSize);
     void destroy(x265_param* param);
     void init(PicYuv *origPic, int poc);
+
+    bool takeCostSlice(int dist0, int dist1);
+    bool takeSlices(int dist0, int dist1);
+    void releaseSlices();
+
+    /* true once the lookahead has searched (or is searching) these MVs */
+    bool hasMvs(int list, int dist) const { return lowresMvs[list][dist] && lowresMvs[list][dist][0].x != 0x7FFF; }
 };
 }
 
@@ -120,18 +120,22 @@ void x265_param_default(x265_param* param)
     /* Applying default values to all elements in the param structure */
     param->cpuid = X265_NS::cpu_detect(false);
     param->bEnableWavefront = 1;
+    param->bEnableWorkStealing = 0;
     param->frameNumThreads = 0;
 
     param->logLevel = X265_LOG_INFO;
     param->csvLogLevel = 0;
     param->csvfn = NULL;
+    param->traceFile = NULL;
     param->rc.lambdaFileName = NULL;
     param->bLogCuStats = 0;
     param->decodedPictureHashSEI = 0;
+    param->bHashAsync = 0;
 
     /* Quality Measurement Metrics */
     param->bEnablePsnr = 0;
     param->bEnableSsim = 0;
+    param->bEnableCtuMetrics = 0;
 
     /* Source specifications */
     param->internalBitDepth = X265_DEPTH;
@@ -206,6 +210,7 @@ void x265_param_default(x265_param* param)
     param->searchMethod = X265_HEX_SEARCH;
     param->subpelRefine = 2;
     param->searchRange = 57;
+    param->bEnableHpelCache = 0;
     param->maxNumMergeCand = 3;
     param->limitReferences = 3;
     param->limitModes = 0;
@@ -291,6 +296,8 @@ void x265_param_default(x265_param* param)
     param->rc.bStatWrite = 0;
     param->rc.dataShareMode = X265_SHARE_MODE_FILE;
     param->rc.statFileName = NULL;
+    param->bBinaryStats = 0;
+    param->sharedMemReaders = 1;
     param->rc.sharedMemName = NULL;
     param->rc.bEncFocusedFramesOnly = 0;
     param->rc.complexityBlur = 20;
@@ -368,6 +375,7 @@ void x265_param_default(x265_param* param)
     param->forceFlush = 0;
     param->bDisableLookahead = 0;
     param->bCopyPicToFrame = 1;
+    param->bEncoderDither = 0;
     param->maxAUSizeFactor = 1;
     param->naluFile = NULL;
 
@@ -1099,7 +1107,10 @@ int x265_param_parse(x265_param* p, const char* name, const char* value)
     OPT("sao-non-deblock") p->bSaoNonDeblocked = atobool(value);
     OPT("ssim") p->bEnableSsim = atobool(value);
     OPT("psnr") p->bEnablePsnr = atobool(value);
+    OPT("ctu-metrics") p->bEnableCtuMetrics = atobool(value);
     OPT("hash") p->decodedPictureHashSEI = atoi(value);
+    OPT("hash-async") p->bHashAsync = atobool(value);
+    OPT("hpel-cache") p->bEnableHpelCache = atobool(value);
     OPT("aud") p->bEnableAccessUnitDelimiters = atobool(value);
     OPT("info") p->bEmitInfoSEI = atobool(value);
     OPT("b-pyramid") p->bBPyramid = atobool(value);
@@ -1246,6 +1257,7 @@ int x265_param_parse(x265_param* p, const char* name, const char* value)
         p->rc.dataShareMode = X265_SHARE_MODE_FILE;
     }
     OPT("stats") p->rc.statFileName = strdup(value);
+    OPT("binary-stats") p->bBinaryStats = atobool(value);
     OPT("scaling-list") p->scalingLists = strdup(value);
     OPT2("pools", "numa-pools") p->numaPools = strdup(value);
     OPT("lambda-file") p->rc.lambdaFileName = strdup(value);
@@ -1264,6 +1276,7 @@ int x265_param_parse(x265_param* p, const char* name, const char* value)
     {
         if (0) ;
         OPT("csv") p->csvfn = strdup(value);
+        OPT("trace") p->traceFile = strdup(value);
         OPT("csv-log-level") p->csvLogLevel = atoi(value);
         OPT("qpmin") p->rc.qpMin = atoi(value);
         OPT("analyze-src-pics") p->bSourceReferenceEstimation = atobool(value);
@@ -1323,6 +1336,7 @@ int x265_param_parse(x265_param* p, const char* name, const char* value)
         OPT("vbv-end") p->vbvBufferEnd = atof(value);
         OPT("vbv-end-fr-adj") p->vbvEndFrameAdjust = atof(value);
         OPT("copy-pic") p->bCopyPicToFrame = atobool(value);
+        OPT("encoder-dither") p->bEncoderDither = atobool(value);
         OPT("refine-analysis-type")
         {
             if (strcmp(strdup(value), "avc") == 0)
@@ -1437,6 +1451,7 @@ int x265_param_parse(x265_param* p, const char* name, const char* value)
         OPT("aq-bias-strength") p->rc.aqBiasStrength = atof(value);
         OPT("mcstf") p->bEnableTemporalFilter = atobool(value);
         OPT("sbrc") p->bEnableSBRC = atobool(value);
+        OPT("work-stealing") p->bEnableWorkStealing = atobool(value);
         else
             return X265_PARAM_BAD_NAME;
     }
@@ -1908,6 +1923,8 @@ int x265_check_params(x265_param* param)
         }
     }
     CHECK(param->rc.dataShareMode != X265_SHARE_MODE_FILE && param->rc.dataShareMode != X265_SHARE_MODE_SHAREDMEM, "Invalid data share mode. It must be one of the X265_DATA_SHARE_MODES enum values\n" );
+    CHECK(param->rc.dataShareMode == X265_SHARE_MODE_SHAREDMEM && (param->sharedMemReaders < 1 || param->sharedMemReaders > 16),
+          "Shared memory readers must be between 1 and 16\n");
     return check_failed;
 }
 
@@ -2101,10 +2118,12 @@ char *x265_param2string(x265_param* p, int padx, int pady)
     if (p->numaPools)
         s += sprintf(s, " numa-pools=%s", p->numaPools);
     BOOL(p->bEnableWavefront, "wpp");
+    BOOL(p->bEnableWorkStealing, "work-stealing");
     BOOL(p->bDistributeModeAnalysis, "pmode");
     BOOL(p->bDistributeMotionEstimation, "pme");
     BOOL(p->bEnablePsnr, "psnr");
     BOOL(p->bEnableSsim, "ssim");
+    BOOL(p->bEnableCtuMetrics, "ctu-metrics");
     s += sprintf(s, " log-level=%d", p->logLevel);
     if (p->csvfn)
         s += sprintf(s, " csv csv-log-level=%d", p->csvLogLevel);
@@ -2131,6 +2150,7 @@ char *x265_param2string(x265_param* p, int padx, int pady)
     BOOL(p->bEmitHRDSEI, "hrd");
     BOOL(p->bEmitInfoSEI, "info");
     s += sprintf(s, " hash=%d", p->decodedPictureHashSEI);
+    BOOL(p->bHashAsync, "hash-async");
     s += sprintf(s, " temporal-layers=%d", p->bEnableTemporalSubLayers);
     BOOL(p->bOpenGOP, "open-gop");
     s += sprintf(s, " min-keyint=%d", p->keyframeMin);
@@ -2170,6 +2190,7 @@ char *x265_param2string(x265_param* p, int padx, int pady)
     s += sprintf(s, " me=%d", p->searchMethod);
     s += sprintf(s, " subme=%d", p->subpelRefine);
     s += sprintf(s, " merange=%d", p->searchRange);
+    BOOL(p->bEnableHpelCache, "hpel-cache");
     BOOL(p->bEnableTemporalMvp, "temporal-mvp");
     BOOL(p->bEnableFrameDuplication, "frame-dup");
     if(p->bEnableFrameDuplication)
@@ -2219,6 +2240,7 @@ char *x265_param2string(x265_param* p, int padx, int pady)
         s += sprintf(s, " qcomp=%.2f qpstep=%d", p->rc.qCompress, p->rc.qpStep);
         s += sprintf(s, " stats-write=%d", p->rc.bStatWrite);
         s += sprintf(s, " stats-read=%d", p->rc.bStatRead);
+        s += sprintf(s, " binary-stats=%d", p->bBinaryStats);
         if (p->rc.bStatRead)
             s += sprintf(s, " cplxblur=%.1f qblur=%.1f",
             p->rc.complexityBlur, p->rc.qblur);
@@ -2321,6 +2343,7 @@ char *x265_param2string(x265_param* p, int padx, int pady)
     BOOL(p->bLowPassDct, "lowpass-dct");
     s += sprintf(s, " refine-analysis-type=%d", p->bAnalysisType);
     s += sprintf(s, " copy-pic=%d", p->bCopyPicToFrame);
+    BOOL(p->bEncoderDither, "encoder-dither");
     s += sprintf(s, " max-ausize-factor=%.1f", p->maxAUSizeFactor);
     BOOL(p->bDynamicRefine, "dynamic-refine");
     BOOL(p->bSingleSeiNal, "single-sei");
@@ -2574,6 +2597,8 @@ void x265_copy_params(x265_param* dst, x265_param* src)
     dst->csvLogLevel = src->csvLogLevel;
     if (src->csvfn) dst->csvfn = strdup(src->csvfn);
     else dst->csvfn = NULL;
+    if (src->traceFile) dst->traceFile = strdup(src->traceFile);
+    else dst->traceFile = NULL;
     dst->internalBitDepth = src->internalBitDepth;
     dst->sourceBitDepth = src->sourceBitDepth;
     dst->internalCsp = src->internalCsp;
@@ -2595,6 +2620,8 @@ void x265_copy_params(x265_param* dst, x265_param* src)
     dst->bEnableEndOfSequence = src->bEnableEndOfSequence;
     dst->bEmitInfoSEI = src->bEmitInfoSEI;
     dst->decodedPictureHashSEI = src->decodedPictureHashSEI;
+    dst->bHashAsync = src->bHashAsync;
+    dst->bEnableCtuMetrics = src->bEnableCtuMetrics;
     dst->bEnableTemporalSubLayers = src->bEnableTemporalSubLayers;
     dst->bOpenGOP = src->bOpenGOP;
 	dst->craNal = src->craNal;
@@ -2633,6 +2660,7 @@ void x265_copy_params(x265_param* dst, x265_param* src)
     dst->searchMethod = src->searchMethod;
     dst->subpelRefine = src->subpelRefine;
     dst->searchRange = src->searchRange;
+    dst->bEnableHpelCache = src->bEnableHpelCache;
     dst->bEnableTemporalMvp = src->bEnableTemporalMvp;
     dst->bEnableFrameDuplication = src->bEnableFrameDuplication;
     dst->dupThreshold = src->dupThreshold;
@@ -2819,6 +2847,7 @@ void x265_copy_params(x265_param* dst, x265_param* src)
     dst->vbvEndFrameAdjust = src->vbvEndFrameAdjust;
     dst->bAnalysisType = src->bAnalysisType;
     dst->bCopyPicToFrame = src->bCopyPicToFrame;
+    dst->bEncoderDither = src->bEncoderDither;
     if (src->analysisSave) dst->analysisSave=strdup(src->analysisSave);
     else dst->analysisSave = NULL;
     if (src->analysisLoad) dst->analysisLoad=strdup(src->analysisLoad);
@@ -2868,6 +2897,9 @@ void x265_copy_params(x265_param* dst, x265_param* src)
     if (src->filmGrain)
         dst->filmGrain = src->filmGrain;
     dst->bEnableSBRC = src->bEnableSBRC;
+    dst->bEnableWorkStealing = src->bEnableWorkStealing;
+    dst->bBinaryStats = src->bBinaryStats;
+    dst->sharedMemReaders = src->sharedMemReaders;
 }
 
 #ifdef SVT_HEVC
@@ -256,6 +256,26 @@ void PicYuv::destroy()
     X265_FREE(m_picBuf[2]);
 }
 
+/* Without --copy-pic the planes of the x265_picture are used in place, so they
+ * must match the layout this PicYuv would have allocated: same sample format,
+ * same strides and the alignment the primitives expect of picture origins. The
+ * margins themselves cannot be checked; they are written lazily, by the pad
+ * below and by the border extensions done for weight analysis */
+bool PicYuv::canAliasPicture(const x265_picture& pic) const
+{
+    if (pic.bitDepth != X265_DEPTH || pic.colorSpace != m_param->internalCsp)
+        return false;
+    if (!pic.planes[0] || pic.stride[0] != m_stride * (int)sizeof(pixel) || ((intptr_t)pic.planes[0] & 15))
+        return false;
+    if (m_param->internalCsp != X265_CSP_I400)
+    {
+        for (int i = 1; i < 3; i++)
+            if (!pic.planes[i] || pic.stride[i] != m_strideC * (int)sizeof(pixel) || ((intptr_t)pic.planes[i] & 15))
+                return false;
+    }
+    return true;
+}
+
 /* Copy pixels from an x265_picture into internal PicYuv instance.
  * Shift pixels as necessary, mask off bits above X265_DEPTH for safety. */
 void PicYuv::copyFromPicture(const x265_picture& pic, const x265_param& param, int padx, int pady)
@@ -516,6 +536,7 @@ void PicYuv::copyFromPicture(const x265_picture& pic, const x265_param& param, i
 
 namespace X265_NS {
 
+#ifdef ARCH_BIG_ENDIAN
 template<uint32_t OUTPUT_BITDEPTH_DIV8>
 static void md5_block(MD5Context& md5, const pixel* plane, uint32_t n)
 {
@@ -555,71 +576,40 @@ static void md5_plane(MD5Context& md5, const pixel* plane, uint32_t width, uint3
         md5_block<OUTPUT_BITDEPTH_DIV8>(md5, &plane[y * stride + width_less_modN], width_modN);
     }
 }
+#endif
 
+/* The CRC and the MD5 hash the samples as little-endian bytes, one per sample
+ * when X265_DEPTH is 8 and two otherwise, which is how pixel rows are stored
+ * on little-endian hosts */
 void updateCRC(const pixel* plane, uint32_t& crcVal, uint32_t height, uint32_t width, intptr_t stride)
 {
-    uint32_t crcMsb;
-    uint32_t bitVal;
-    uint32_t bitIdx;
-
+#ifdef ARCH_BIG_ENDIAN
+    uint8_t buf[2];
     for (uint32_t y = 0; y < height; y++)
     {
         for (uint32_t x = 0; x < width; x++)
         {
-            // take CRC of first pictureData byte
-            for (bitIdx = 0; bitIdx < 8; bitIdx++)
-            {
-                crcMsb = (crcVal >> 15) & 1;
-                bitVal = (plane[y * stride + x] >> (7 - bitIdx)) & 1;
-                crcVal = (((crcVal << 1) + bitVal) & 0xffff) ^ (crcMsb * 0x1021);
-            }
-
-#if _MSC_VER
-#pragma warning(disable: 4127) // conditional expression is constant
-#endif
-            // take CRC of second pictureData byte if bit depth is greater than 8-bits
-            if (X265_DEPTH > 8)
-            {
-                for (bitIdx = 0; bitIdx < 8; bitIdx++)
-                {
-                    crcMsb = (crcVal >> 15) & 1;
-                    bitVal = (plane[y * stride + x] >> (15 - bitIdx)) & 1;
-                    crcVal = (((crcVal << 1) + bitVal) & 0xffff) ^ (crcMsb * 0x1021);
-                }
-            }
+            buf[0] = (uint8_t)plane[y * stride + x];
+            buf[1] = (uint8_t)(plane[y * stride + x] >> 7 >> 1);
+            crcVal = primitives.pictureCRC(crcVal, buf, sizeof(pixel));
         }
     }
+#else
+    for (uint32_t y = 0; y < height; y++)
+        crcVal = primitives.pictureCRC(crcVal, (const uint8_t*)(plane + y * stride), width * sizeof(pixel));
+#endif
 }
 
 void crcFinish(uint32_t& crcVal, uint8_t digest[16])
 {
-    uint32_t crcMsb;
-
-    for (int bitIdx = 0; bitIdx < 16; bitIdx++)
-    {
-        crcMsb = (crcVal >> 15) & 1;
-        crcVal = ((crcVal << 1) & 0xffff) ^ (crcMsb * 0x1021);
-    }
-
     digest[0] = (crcVal >> 8)  & 0xff;
     digest[1] =  crcVal        & 0xff;
 }
 
 void updateChecksum(const pixel* plane, uint32_t& checksumVal, uint32_t height, uint32_t width, intptr_t stride, int row, uint32_t cuHeight)
 {
-    uint8_t xor_mask;
-
     for (uint32_t y = row * cuHeight; y < ((row * cuHeight) + height); y++)
-    {
-        for (uint32_t x = 0; x < width; x++)
-        {
-            xor_mask = (uint8_t)((x & 0xff) ^ (y & 0xff) ^ (x >> 8) ^ (y >> 8));
-            checksumVal = (checksumVal + ((plane[y * stride + x] & 0xff) ^ xor_mask)) & 0xffffffff;
-
-            if (X265_DEPTH > 8)
-                checksumVal = (checksumVal + ((plane[y * stride + x] >> 7 >> 1) ^ xor_mask)) & 0xffffffff;
-        }
-    }
+        checksumVal += primitives.pictureChecksum(plane + y * stride, width, y);
 }
 
 void checksumFinish(uint32_t checksum, uint8_t digest[16])
@@ -632,11 +622,16 @@ void checksumFinish(uint32_t checksum, uint8_t digest[16])
 
 void updateMD5Plane(MD5Context& md5, const pixel* plane, uint32_t width, uint32_t height, intptr_t stride)
 {
+#ifdef ARCH_BIG_ENDIAN
     /* choose an md5_plane packing function based on the system bitdepth */
     typedef void(*MD5PlaneFunc)(MD5Context&, const pixel*, uint32_t, uint32_t, intptr_t);
     MD5PlaneFunc md5_plane_func;
     md5_plane_func = X265_DEPTH <= 8 ? (MD5PlaneFunc)md5_plane<1> : (MD5PlaneFunc)md5_plane<2>;
 
     md5_plane_func(md5, plane, width, height, stride);
+#else
+    for (uint32_t y = 0; y < height; y++)
+        MD5Update(&md5, (uint8_t*)(plane + y * stride), width * sizeof(pixel));
+#endif
 }
 }
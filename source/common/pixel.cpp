@@ -27,6 +27,7 @@
 
 #include "common.h"
 #include "slicetype.h"      // LOWRES_COST_MASK
+#include "constants.h"      // g_crcTable
 #include "primitives.h"
 #include "x265.h"
 
@@ -956,6 +957,134 @@ static void estimateCUPropagateCost(int* dst, const uint16_t* propagateIn, const
     //}
 }
 
+/* Follow the MVs of a row of blocks to the reference and split the propagate
+ * amount of each block between the four blocks its MV overlaps */
+static void cuTreePropagateList(int32_t* output, const int32_t* propagateAmount, const MV* mvs, const uint16_t* lowresCosts,
+                                int32_t bipredWeight, int list, int blocky, int len)
+{
+    int32_t* amounts = output;
+    int32_t* cuxs = output + len;
+    int32_t* cuys = output + 2 * len;
+    int32_t* shares = output + 3 * len;
+
+    for (int i = 0; i < len; i++)
+    {
+        int32_t listsUsed = lowresCosts[i] >> LOWRES_COST_SHIFT;
+        int32_t amount = propagateAmount[i];
+        if (amount <= 0 || !((listsUsed >> list) & 1))
+            amount = 0;
+        else if (listsUsed == 3)
+            amount = (amount * bipredWeight + 32) >> 6;
+
+        int32_t x = mvs[i].x;
+        int32_t y = mvs[i].y;
+        amounts[i] = amount;
+        cuxs[i] = (x >> 5) + i;
+        cuys[i] = (y >> 5) + blocky;
+        x &= 31;
+        y &= 31;
+        shares[i] = (amount * (32 - y) * (32 - x) + 512) >> 10;
+        shares[i + len] = (amount * (32 - y) * x + 512) >> 10;
+        shares[i + 2 * len] = (amount * y * (32 - x) + 512) >> 10;
+        shares[i + 3 * len] = (amount * y * x + 512) >> 10;
+    }
+}
+
+static uint64_t histogram_c(const pixel* src, intptr_t stride, int width, int height, int step, uint32_t* hist)
+{
+    uint64_t sum = 0;
+
+    for (int y = 0; y < height; y += step)
+    {
+        for (int x = 0; x < width; x += step)
+        {
+            int val = src[x] >> (X265_DEPTH - 8);
+            hist[val]++;
+            sum += val;
+        }
+
+        src += stride * step;
+    }
+
+    return sum;
+}
+
+static void scalerHFilter_c(int16_t* dst, int dstW, const pixel* src, const int16_t* filter, const int32_t* filterPos, int filterSize)
+{
+    for (int i = 0; i < dstW; i++)
+    {
+        int val = 0;
+        const pixel* s = src + filterPos[i];
+        for (int j = 0; j < filterSize; j++)
+            val += (int)s[j] * filter[filterSize * i + j];
+        // the cubic equation does overflow
+        dst[i] = (int16_t)x265_clip3(-(1 << 15), (1 << 15) - 1, val >> SCALER_H_SHIFT);
+    }
+}
+
+static void scalerVFilter_c(const int16_t* filter, int filterSize, const int16_t** src, pixel* dst, int dstW)
+{
+    for (int i = 0; i < dstW; i++)
+    {
+        int val = 1 << (SCALER_V_SHIFT - 1);
+        for (int j = 0; j < filterSize; j++)
+            val += src[j][i] * filter[j];
+        dst[i] = (pixel)x265_clip3(0, SCALER_PIXEL_MAX, val >> SCALER_V_SHIFT);
+    }
+}
+
+static uint8_t* nalEscape_c(uint8_t* dst, const uint8_t* src, const uint8_t* end)
+{
+    while (src < end)
+    {
+        if (*src <= 0x03 && !dst[-2] && !dst[-1])
+            *dst++ = 0x03;
+        *dst++ = *src++;
+    }
+
+    return dst;
+}
+
+static uint32_t pictureCRC_c(uint32_t crc, const uint8_t* buf, intptr_t len)
+{
+    for (intptr_t i = 0; i < len; i++)
+        crc = ((crc << 8) & 0xffff) ^ g_crcTable[(crc >> 8) ^ buf[i]];
+
+    return crc;
+}
+
+static uint32_t pictureChecksum_c(const pixel* src, int width, int y)
+{
+    uint32_t sum = 0;
+
+    for (int x = 0; x < width; x++)
+    {
+        uint32_t mask = (uint8_t)((x & 0xff) ^ (y & 0xff) ^ (x >> 8) ^ (y >> 8));
+        sum += (src[x] & 0xff) ^ mask;
+#if HIGH_BIT_DEPTH
+        sum += (src[x] >> 8) ^ mask;
+#endif
+    }
+
+    return sum;
+}
+
+static void ssimRowSums_c(const pixel* pix1, intptr_t stride1, const pixel* pix2, intptr_t stride2, int sums[][4], int width)
+{
+    for (int x = 0; x < width; x += 2)
+        ssim_4x4x2_core(pix1 + 4 * x, stride1, pix2 + 4 * x, stride2, sums + x);
+}
+
+static float ssimRowEnd_c(int sum0[][4], int sum1[][4], int width)
+{
+    float ssim = 0.0;
+
+    for (int x = 0; x < width; x += 4)
+        ssim += ssim_end_4(sum0 + x, sum1 + x, X265_MIN(4, width - x));
+
+    return ssim;
+}
+
 /* Conversion between double and Q8.8 fixed point (big-endian) for storage */
 static void cuTreeFix8Pack(uint16_t *dst, double *src, int count)
 {
@@ -972,6 +1101,36 @@ static void cuTreeFix8Unpack(double *dst, uint16_t *src, int count)
     }
 }
 
+/* Replace each sample with the weighted average of itself (weight 1.0) and the
+ * co-located motion compensated reference samples. The weight of a reference
+ * sample is the block weight of its reference scaled by a table lookup on the
+ * absolute sample difference */
+static void mcstfBilateral_c(pixel* src, intptr_t srcStride, const pixel* const* refs, intptr_t refStride,
+                             const int32_t* refWeights, const uint16_t* const* weightLuts, int numRefs, int width, int height)
+{
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            int orgVal = src[x];
+            int num = orgVal << MCSTF_WEIGHT_SHIFT;
+            int den = 1 << MCSTF_WEIGHT_SHIFT;
+
+            for (int i = 0; i < numRefs; i++)
+            {
+                int refVal = refs[i][y * refStride + x];
+                int weight = (refWeights[i] * weightLuts[i][abs(refVal - orgVal)] + (1 << (MCSTF_WEIGHT_SHIFT - 1))) >> MCSTF_WEIGHT_SHIFT;
+                num += weight * refVal;
+                den += weight;
+            }
+
+            src[x] = (pixel)((num + (den >> 1)) / den);
+        }
+
+        src += srcStride;
+    }
+}
+
 template<int log2TrSize>
 static void ssimDist_c(const pixel* fenc, uint32_t fStride, const pixel* recon, intptr_t rstride, uint64_t *ssBlock, int shift, uint64_t *ac_k)
 {
@@ -1057,6 +1216,34 @@ void extendPicBorder(pixel* pic, intptr_t stride, int width, int height, int mar
         memcpy(bot + (y + 1) * stride, bot, stride * sizeof(pixel));
 }
 
+/* C reference of the dither primitive, also used by x265_dither_image()
+ * when the primitives of this build have not been set up */
+void ditherPlane_c(uint16_t* src, intptr_t srcStride, int width, int height, int16_t* errors, int bitDepth)
+{
+    const int lShift = 16 - bitDepth;
+    const int rShift = 16 - bitDepth + 2;
+    const int half = (1 << (16 - bitDepth + 1));
+    const int pixelMax = (1 << bitDepth) - 1;
+
+    memset(errors, 0, (width + 1) * sizeof(int16_t));
+
+    for (int y = 0; y < height; y++, src += srcStride)
+    {
+        uint8_t* dst8 = (uint8_t*)src;
+        int16_t err = 0;
+        for (int x = 0; x < width; x++)
+        {
+            err = err * 2 + errors[x] + errors[x + 1];
+            int tmpDst = x265_clip3(0, pixelMax, ((src[x] << 2) + err + half) >> rShift);
+            errors[x] = err = (int16_t)(src[x] - (tmpDst << lShift));
+            if (bitDepth == 8)
+                dst8[x] = (uint8_t)tmpDst;
+            else
+                src[x] = (uint16_t)tmpDst;
+        }
+    }
+}
+
 /* Initialize entries for pixel functions defined in this file */
 void setupPixelPrimitives_c(EncoderPrimitives &p)
 {
@@ -1361,6 +1548,17 @@ void setupPixelPrimitives_c(EncoderPrimitives &p)
     p.propagateCost = estimateCUPropagateCost;
     p.fix8Unpack = cuTreeFix8Unpack;
     p.fix8Pack = cuTreeFix8Pack;
+    p.propagateList = cuTreePropagateList;
+    p.histogram = histogram_c;
+    p.scalerHFilter = scalerHFilter_c;
+    p.scalerVFilter = scalerVFilter_c;
+    p.nalEscape = nalEscape_c;
+    p.pictureCRC = pictureCRC_c;
+    p.pictureChecksum = pictureChecksum_c;
+    p.ssimRowSums = ssimRowSums_c;
+    p.ssimRowEnd = ssimRowEnd_c;
+    p.mcstfBilateral = mcstfBilateral_c;
+    p.ditherPlane = ditherPlane_c;
 
     p.cu[BLOCK_4x4].ssimDist = ssimDist_c<2>;
     p.cu[BLOCK_8x8].ssimDist = ssimDist_c<3>;
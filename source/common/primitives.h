@@ -38,6 +38,8 @@
 namespace X265_NS {
 // x265 private namespace
 
+struct MV;
+
 enum LumaPU
 {
     // Square (the first 5 PUs match the block sizes)
@@ -214,6 +216,80 @@ typedef void (*cutree_propagate_cost) (int* dst, const uint16_t* propagateIn, co
 typedef void (*cutree_fix8_unpack)(double *dst, uint16_t *src, int count);
 typedef void (*cutree_fix8_pack)(uint16_t *dst, double *src, int count);
 
+/* cuTree MV splat of one row of lowres blocks for one reference list. For each
+ * of the len blocks, output receives in seven planes of len entries: the amount
+ * the block propagates through this list (zero for intra blocks and blocks not
+ * predicted from the list, bipred weighted when both lists are used), the
+ * block coordinates the MV points to, and the four bilinear shares of the
+ * amount for the blocks at (cux, cuy), (cux + 1, cuy), (cux, cuy + 1) and
+ * (cux + 1, cuy + 1). The caller clips and accumulates the shares */
+#define CUTREE_LIST_PLANES 7
+typedef void (*cutree_propagate_list)(int32_t* output, const int32_t* propagateAmount, const MV* mvs, const uint16_t* lowresCosts,
+                                      int32_t bipredWeight, int list, int blocky, int len);
+
+/* Add the samples of every step-th column of every step-th row of a block to
+ * a 256 bin histogram and return their sum. Samples of more than eight bits
+ * are binned and summed by their eight most significant bits */
+typedef uint64_t (*histogram_t)(const pixel* src, intptr_t stride, int width, int height, int step, uint32_t* hist);
+
+/* Polyphase filters of the ABR scaler. The horizontal pass filters one source
+ * row into dstW intermediate samples, output i being the dot product of the
+ * filterSize samples at src + filterPos[i] with filter + i * filterSize, scaled
+ * to 15 bits and saturated to int16. The vertical pass combines filterSize
+ * intermediate rows with one set of filterSize coefficients into a row of dstW
+ * output pixels */
+#if HIGH_BIT_DEPTH
+#define SCALER_H_SHIFT   9   // 10-bit samples, whatever the build depth
+#define SCALER_V_SHIFT   17
+#define SCALER_PIXEL_MAX ((1 << 10) - 1)
+#else
+#define SCALER_H_SHIFT   7
+#define SCALER_V_SHIFT   19
+#define SCALER_PIXEL_MAX ((1 << 8) - 1)
+#endif
+typedef void (*scaler_hfilter_t)(int16_t* dst, int dstW, const pixel* src, const int16_t* filter, const int32_t* filterPos, int filterSize);
+typedef void (*scaler_vfilter_t)(const int16_t* filter, int filterSize, const int16_t** src, pixel* dst, int dstW);
+
+/* Copy the bytes of [src, end) to dst, inserting an emulation prevention byte
+ * (0x03) before every byte of value 3 or less that follows two zero bytes of
+ * the output. The two output bytes preceding dst must be readable when src is
+ * not end. Returns the end of the output */
+typedef uint8_t* (*nal_escape_t)(uint8_t* dst, const uint8_t* src, const uint8_t* end);
+
+/* Decoded picture hash SEI. The CRC-16 (polynomial 0x1021, no reflection) is
+ * continued over len bytes, samples of more than eight bits being hashed as
+ * their little-endian byte pairs. It is kept in direct form: starting from
+ * PICTURE_CRC_INIT, the value after the last byte is the digest. The checksum
+ * returns the sum of the terms of width samples of picture row y, each sample
+ * byte XORed with the mask of its position */
+#define PICTURE_CRC_INIT 0x1d0f // the 0xffff initial value of the SEI's bitwise CRC
+typedef uint32_t (*picture_crc_t)(uint32_t crc, const uint8_t* buf, intptr_t len);
+typedef uint32_t (*picture_checksum_t)(const pixel* src, int width, int y);
+
+/* SSIM over a row of the picture: ssim_row_sums_t stores the sums of width
+ * horizontally adjacent 4x4 blocks (rounded up to an even count) in the layout
+ * of ssim_4x4x2_core, and ssim_row_end_t returns the sum of the SSIM of width
+ * 8x8 windows from the block sums of two consecutive rows of blocks, as
+ * ssim_end_4 without its limit of four windows */
+typedef void (*ssim_row_sums_t)(const pixel* pix1, intptr_t stride1, const pixel* pix2, intptr_t stride2, int sums[][4], int width);
+typedef float (*ssim_row_end_t)(int sum0[][4], int sum1[][4], int width);
+
+/* MCSTF bilateral filter: refWeights[] and the weightLuts[] tables (indexed by
+ * the absolute difference between reference and source sample) are fixed point
+ * with MCSTF_WEIGHT_SHIFT fractional bits. Reference weights may not exceed
+ * MCSTF_MAX_REF_WEIGHT so the per-sample accumulators fit in 32 bits, and each
+ * table has PIXEL_MAX + 2 entries (the last one zero) so that SIMD gathers of
+ * 32-bit words never read past its end */
+#define MCSTF_WEIGHT_SHIFT   12
+#define MCSTF_MAX_REF_WEIGHT ((1 << 15) - 1)
+typedef void (*mcstf_bilateral_t)(pixel* src, intptr_t srcStride, const pixel* const* refs, intptr_t refStride,
+                                  const int32_t* refWeights, const uint16_t* const* weightLuts, int numRefs, int width, int height);
+
+/* Sierra-2-4A error diffusion of a plane of 16-bit samples down to bitDepth
+ * bits, in place: 8-bit output is stored as bytes at the start of each source
+ * row. errors[] holds width + 1 values and is cleared before the first row */
+typedef void (*dither_t)(uint16_t* src, intptr_t srcStride, int width, int height, int16_t* errors, int bitDepth);
+
 typedef int (*scanPosLast_t)(const uint16_t *scan, const coeff_t *coeff, uint16_t *coeffSign, uint16_t *coeffFlag, uint8_t *coeffNum, int numSig, const uint16_t* scanCG4x4, const int trSize);
 typedef uint32_t (*findPosFirstLast_t)(const int16_t *dstCoeff, const intptr_t trSize, const uint16_t scanTbl[16]);
 
@@ -360,6 +436,18 @@ struct EncoderPrimitives
     cutree_propagate_cost propagateCost;
     cutree_fix8_unpack    fix8Unpack;
     cutree_fix8_pack      fix8Pack;
+    cutree_propagate_list propagateList;
+    histogram_t           histogram;
+    scaler_hfilter_t      scalerHFilter;
+    scaler_vfilter_t      scalerVFilter;
+    nal_escape_t          nalEscape;
+    picture_crc_t         pictureCRC;
+    picture_checksum_t    pictureChecksum;
+    ssim_row_sums_t       ssimRowSums;
+    ssim_row_end_t        ssimRowEnd;
+
+    mcstf_bilateral_t     mcstfBilateral;
+    dither_t              ditherPlane;
 
     extendCURowBorder_t   extendRowBorder;
     planecopy_cp_t        planecopy_cp;
@@ -473,6 +561,7 @@ void setupCPrimitives(EncoderPrimitives &p);
 void setupInstrinsicPrimitives(EncoderPrimitives &p, int cpuMask);
 void setupAssemblyPrimitives(EncoderPrimitives &p, int cpuMask);
 void setupAliasPrimitives(EncoderPrimitives &p);
+void ditherPlane_c(uint16_t* src, intptr_t srcStride, int width, int height, int16_t* errors, int bitDepth);
 #if X265_ARCH_ARM64
 void setupAliasCPrimitives(EncoderPrimitives &cp, EncoderPrimitives &asmp, int cpuMask);
 #endif
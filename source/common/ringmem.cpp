@@ -25,6 +25,7 @@
 
 #ifndef _WIN32
 #include <sys/mman.h>
+#include <sys/stat.h>
 #endif ////< _WIN32
 
 #ifdef _WIN32
@@ -38,13 +39,43 @@
 #endif
 
 #define RINGMEM_ALLIGNMENT                       64
+#define RINGMEM_SPIN_COUNT                       64
+
+namespace {
+    /* readers usually wait on an encoder running in another process, so after
+     * a short spin they sleep instead of burning a core */
+    void waitBackoff(int& spins)
+    {
+        if (++spins < RINGMEM_SPIN_COUNT)
+            GIVE_UP_TIME();
+        else
+        {
+#ifdef _WIN32
+            Sleep(1);
+#else
+            usleep(1000);
+#endif
+        }
+    }
+
+    int32_t atomicLoad(int32_t *ptr)
+    {
+        return ATOMIC_ADD(ptr, 0);
+    }
+}
 
 namespace X265_NS {
     RingMem::RingMem() 
         : m_initialized(false)
         , m_protectRW(false)
+        , m_bWriter(false)
         , m_itemSize(0)
         , m_itemCnt(0)
+        , m_shrMemSize(0)
+        , m_numReaders(0)
+        , m_readerId(-1)
+        , m_recordSize(-1)
+        , m_heldItem(NULL)
         , m_dataPool(NULL)
         , m_shrMem(NULL)
 #ifdef _WIN32
@@ -62,31 +93,124 @@ namespace X265_NS {
     {
     }
 
-    bool RingMem::skipRead(int32_t cnt) {
-        if (!m_initialized)
+    bool RingMem::attachReader()
+    {
+        if (m_readerId < 0 && !m_protectRW)
         {
-            return false;
+            int32_t id = ATOMIC_INC(&m_shrMem->m_numReaders) - 1;
+            if (id >= RINGMEM_MAX_READERS)
+            {
+                x265_log(NULL, X265_LOG_ERROR, "shared memory already has %d readers\n", RINGMEM_MAX_READERS);
+                return false;
+            }
+
+            ///< a slot starts at the first item. The writer holds that item for its expected
+            ///< readers however late they attach, but a reader it did not expect would read
+            ///< overwritten items once the ring wrapped
+            int32_t expected = atomicLoad(&m_shrMem->m_expectedReaders);
+            if (expected && id >= expected && atomicLoad(&m_shrMem->m_write) >= m_itemCnt)
+            {
+                ATOMIC_INC(&m_shrMem->m_readerDone[id]);
+                x265_log(NULL, X265_LOG_ERROR, "shared memory reader %d attached too late, the writer expects %d readers\n", id + 1, expected);
+                return false;
+            }
+            m_readerId = id;
         }
+        return true;
+    }
 
+    uint8_t *RingMem::acquireWrite()
+    {
+        if (!m_bWriter)
+        {
+            m_bWriter = true;
+            m_shrMem->m_expectedReaders = m_numReaders;
+        }
         if (m_protectRW)
         {
-            for (int i = 0; i < cnt; i++)
+            if (!m_writeSem->take())
             {
-                m_readSem->take();
+                return NULL;
+            }
+            return itemAt(m_shrMem->m_write);
+        }
+
+        ///< the item about to be written must have been read by every reader still attached
+        int32_t pos = m_shrMem->m_write;
+        int spins = 0;
+        while (true)
+        {
+            int32_t numReaders = X265_MIN(X265_MAX(m_numReaders, atomicLoad(&m_shrMem->m_numReaders)), RINGMEM_MAX_READERS);
+            int32_t lag = 0;
+            for (int32_t i = 0; i < numReaders; i++)
+            {
+                if (!atomicLoad(&m_shrMem->m_readerDone[i]))
+                {
+                    lag = X265_MAX(lag, pos - atomicLoad(&m_shrMem->m_readPos[i]));
+                }
+            }
+            if (lag < m_itemCnt)
+            {
+                break;
             }
+            waitBackoff(spins);
         }
-        
-        ATOMIC_ADD(&m_shrMem->m_read, cnt);
+        return itemAt(pos);
+    }
 
+    void RingMem::publishWrite()
+    {
+        ATOMIC_INC(&m_shrMem->m_write);
         if (m_protectRW)
         {
-            m_writeSem->give(cnt);
+            m_readSem->give(1);
         }
+    }
 
-        return true;
+    uint8_t *RingMem::acquireRead()
+    {
+        if (m_protectRW)
+        {
+            if (!m_readSem->take())
+            {
+                return NULL;
+            }
+            return itemAt(m_shrMem->m_read);
+        }
+
+        if (!attachReader())
+        {
+            return NULL;
+        }
+
+        int32_t pos = m_shrMem->m_readPos[m_readerId];
+        int spins = 0;
+        while (atomicLoad(&m_shrMem->m_write) - pos <= 0)
+        {
+            ///< the done flag is set after the last item was published
+            if (atomicLoad(&m_shrMem->m_writerDone) && atomicLoad(&m_shrMem->m_write) - pos <= 0)
+            {
+                return NULL;
+            }
+            waitBackoff(spins);
+        }
+        return itemAt(pos);
     }
 
-    bool RingMem::skipWrite(int32_t cnt) {
+    void RingMem::releaseRead()
+    {
+        if (m_protectRW)
+        {
+            ATOMIC_INC(&m_shrMem->m_read);
+            m_writeSem->give(1);
+        }
+        else
+        {
+            ATOMIC_INC(&m_shrMem->m_readPos[m_readerId]);
+        }
+    }
+
+    bool RingMem::skipRead(int32_t cnt) {
         if (!m_initialized)
         {
             return false;
@@ -96,25 +220,46 @@ namespace X265_NS {
         {
             for (int i = 0; i < cnt; i++)
             {
-                m_writeSem->take();
+                m_readSem->take();
             }
+
+            ATOMIC_ADD(&m_shrMem->m_read, cnt);
+            m_writeSem->give(cnt);
+            return true;
         }
 
-        ATOMIC_ADD(&m_shrMem->m_write, cnt);
+        if (!attachReader())
+        {
+            return false;
+        }
 
-        if (m_protectRW)
+        ATOMIC_ADD(&m_shrMem->m_readPos[m_readerId], cnt);
+        return true;
+    }
+
+    bool RingMem::skipWrite(int32_t cnt) {
+        if (!m_initialized)
         {
-            m_readSem->give(cnt);
+            return false;
+        }
+
+        for (int i = 0; i < cnt; i++)
+        {
+            if (!acquireWrite())
+            {
+                return false;
+            }
+            publishWrite();
         }
 
         return true;
     }
 
     ///< initialize
-    bool RingMem::init(int32_t itemSize, int32_t itemCnt, const char *name, bool protectRW)
+    bool RingMem::init(int32_t itemSize, int32_t itemCnt, const char *name, bool protectRW, int32_t numReaders)
     {
         ///< check parameters
-        if (itemSize <= 0 || itemCnt <= 0 || NULL == name)
+        if (itemSize <= 0 || itemCnt <= 0 || NULL == name || numReaders < 1 || numReaders > RINGMEM_MAX_READERS || (protectRW && numReaders > 1))
         {
             ///< invalid parameters 
             return false;
@@ -128,12 +273,12 @@ namespace X265_NS {
             ///< shared memory name
             snprintf(nameBuf, sizeof(nameBuf) - 1, "%s%s", X265_SHARED_MEM_NAME, name);
 
-            ///< create or open shared memory
-            bool newCreated = false;
-
-            ///< calculate the size of the shared memory
-            int32_t shrMemSize = (itemSize * itemCnt + sizeof(ShrMemCtrl) + RINGMEM_ALLIGNMENT - 1) & ~(RINGMEM_ALLIGNMENT - 1);
+            ///< calculate the size of the shared memory, the data pool starts on its own cache line
+            int32_t ctrlSize = (sizeof(ShrMemCtrl) + RINGMEM_ALLIGNMENT - 1) & ~(RINGMEM_ALLIGNMENT - 1);
+            int32_t shrMemSize = (itemSize * itemCnt + ctrlSize + RINGMEM_ALLIGNMENT - 1) & ~(RINGMEM_ALLIGNMENT - 1);
 
+            ///< a new mapping is zero filled, which is the initial state of the control block. It is
+            ///< not cleared here as a process which opened it meanwhile may already be using it
 #ifdef _WIN32
             HANDLE h = OpenFileMappingA(FILE_MAP_WRITE | FILE_MAP_READ, FALSE, nameBuf);
             if (!h)
@@ -144,8 +289,6 @@ namespace X265_NS {
                 {
                     return false;
                 }
-
-                newCreated = true;
             }
 
             void *pool = MapViewOfFile(h, FILE_MAP_ALL_ACCESS, 0, 0, 0);
@@ -161,28 +304,33 @@ namespace X265_NS {
 
 #else /* POSIX / pthreads */
             mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH;
-            int flag = O_RDWR;
-            int shrfd = -1;
-            if ((shrfd = open(nameBuf, flag, mode)) < 0)
+            int shrfd = open(nameBuf, O_RDWR | O_CREAT | O_EXCL, mode);
+            if (shrfd >= 0)
             {
-                flag |= O_CREAT;
-                
-                shrfd = open(nameBuf, flag, mode);
-                if (shrfd < 0)
+                if (ftruncate(shrfd, shrMemSize) < 0)
                 {
+                    close(shrfd);
+                    unlink(nameBuf);
                     return false;
                 }
-                newCreated = true;
-
-                lseek(shrfd, shrMemSize - 1, SEEK_SET);
-
-                if (-1 == write(shrfd, "\0", 1))
+            }
+            else
+            {
+                shrfd = open(nameBuf, O_RDWR, mode);
+                if (shrfd < 0)
                 {
-                    close(shrfd);
                     return false;
                 }
 
-                if (lseek(shrfd, 0, SEEK_END) < shrMemSize)
+                ///< the creator may not have sized the file yet
+                struct stat st;
+                st.st_size = 0;
+                int spins = 0;
+                while (!fstat(shrfd, &st) && st.st_size < shrMemSize && spins < 10 * RINGMEM_SPIN_COUNT)
+                {
+                    waitBackoff(spins);
+                }
+                if (st.st_size < shrMemSize)
                 {
                     close(shrfd);
                     return false;
@@ -205,16 +353,17 @@ namespace X265_NS {
             m_filepath = strdup(nameBuf);
 #endif ///< _WIN32
 
-            if (newCreated)
-            {
-                memset(pool, 0, shrMemSize);
-            }
-            
             m_shrMem = reinterpret_cast<ShrMemCtrl *>(pool);
-            m_dataPool = reinterpret_cast<uint8_t *>(pool) + sizeof(ShrMemCtrl);
+            m_dataPool = reinterpret_cast<uint8_t *>(pool) + ctrlSize;
             m_itemSize = itemSize;
             m_itemCnt = itemCnt;
+            m_shrMemSize = shrMemSize;
+            m_numReaders = numReaders;
+            m_readerId = -1;
+            m_recordSize = -1;
+            m_bWriter = false;
             m_initialized = true;
+            ATOMIC_INC(&m_shrMem->m_refCount);
 
             if (protectRW)
             {
@@ -262,14 +411,30 @@ namespace X265_NS {
 
             if (m_shrMem)
             {
+                ///< let the readers drain the ring and stop the writer from waiting on a reader which left
+                if (m_bWriter)
+                {
+                    ATOMIC_INC(&m_shrMem->m_writerDone);
+                }
+                if (m_readerId >= 0)
+                {
+                    ATOMIC_INC(&m_shrMem->m_readerDone[m_readerId]);
+                }
+                ///< a writer which finished before its readers attached leaves the data for them
+                bool bLast = !ATOMIC_DEC(&m_shrMem->m_refCount) &&
+                             (!atomicLoad(&m_shrMem->m_writerDone) || atomicLoad(&m_shrMem->m_numReaders) >= atomicLoad(&m_shrMem->m_expectedReaders));
+
 #ifdef _WIN32
                 UnmapViewOfFile(m_shrMem);
                 CloseHandle(m_handle);
                 m_handle = NULL;
+                (void)bLast;
 #else /* POSIX / pthreads */
-                int32_t shrMemSize = (m_itemSize * m_itemCnt + sizeof(ShrMemCtrl) + RINGMEM_ALLIGNMENT - 1) & (~RINGMEM_ALLIGNMENT - 1);
-                munmap(m_shrMem, shrMemSize);
-                unlink(m_filepath);
+                munmap(m_shrMem, m_shrMemSize);
+                if (bLast)
+                {
+                    unlink(m_filepath);
+                }
                 free(m_filepath);
                 m_filepath = NULL;
 #endif ///< _WIN32
@@ -277,6 +442,11 @@ namespace X265_NS {
                 m_dataPool = NULL;
                 m_itemSize = 0;
                 m_itemCnt = 0;
+                m_shrMemSize = 0;
+                m_readerId = -1;
+                m_recordSize = -1;
+                m_heldItem = NULL;
+                m_bWriter = false;
             }
             
             if (m_protectRW)
@@ -310,21 +480,14 @@ namespace X265_NS {
             return false;
         }
 
-        if (m_protectRW)
+        uint8_t *item = acquireRead();
+        if (!item)
         {
-            if (!m_readSem->take())
-            {
-                return false;
-            }
+            return false;
         }
 
-        int32_t index = ATOMIC_ADD(&m_shrMem->m_read, 1) % m_itemCnt;
-        (*callback)(dst, reinterpret_cast<uint8_t *>(m_dataPool) + index * m_itemSize, m_itemSize);
-
-        if (m_protectRW)
-        {
-            m_writeSem->give(1);
-        }
+        (*callback)(dst, item, m_itemSize);
+        releaseRead();
 
         return true;
     }
@@ -336,20 +499,111 @@ namespace X265_NS {
             return false;
         }
 
-        if (m_protectRW)
+        uint8_t *item = acquireWrite();
+        if (!item)
         {
-            if (!m_writeSem->take())
+            return false;
+        }
+
+        (*callback)(item, data, m_itemSize);
+        publishWrite();
+
+        return true;
+    }
+
+    ///< the first item of a record starts with its size, the payload fills the rest of the items
+    bool RingMem::writeRecord(const void *data, int32_t size)
+    {
+        if (!m_initialized || (size && !data) || size < 0 || m_itemSize <= (int32_t)sizeof(int32_t))
+        {
+            return false;
+        }
+
+        const uint8_t *src = reinterpret_cast<const uint8_t *>(data);
+        int32_t offset = 0;
+        int32_t header = sizeof(int32_t);
+        do
+        {
+            uint8_t *item = acquireWrite();
+            if (!item)
             {
                 return false;
             }
+
+            if (header)
+            {
+                memcpy(item, &size, sizeof(int32_t));
+            }
+            int32_t bytes = X265_MIN(size - offset, m_itemSize - header);
+            if (bytes)
+            {
+                memcpy(item + header, src + offset, bytes);
+            }
+            publishWrite();
+
+            offset += bytes;
+            header = 0;
         }
+        while (offset < size);
 
-        int32_t index = ATOMIC_ADD(&m_shrMem->m_write, 1) % m_itemCnt;
-        (*callback)(reinterpret_cast<uint8_t *>(m_dataPool) + index * m_itemSize, data, m_itemSize);
+        return true;
+    }
 
-        if (m_protectRW)
+    int32_t RingMem::nextRecordSize()
+    {
+        if (!m_initialized || m_itemSize <= (int32_t)sizeof(int32_t))
         {
-            m_readSem->give(1);
+            return -1;
+        }
+
+        if (m_recordSize < 0)
+        {
+            m_heldItem = acquireRead();
+            if (!m_heldItem)
+            {
+                return -1;
+            }
+            memcpy(&m_recordSize, m_heldItem, sizeof(int32_t));
+        }
+
+        return m_recordSize;
+    }
+
+    bool RingMem::readRecord(void *dst)
+    {
+        int32_t size = nextRecordSize();
+        if (size < 0 || (size && !dst))
+        {
+            return false;
+        }
+
+        uint8_t *out = reinterpret_cast<uint8_t *>(dst);
+        uint8_t *item = m_heldItem;
+        int32_t offset = 0;
+        int32_t header = sizeof(int32_t);
+        m_recordSize = -1;
+        m_heldItem = NULL;
+        while (true)
+        {
+            int32_t bytes = X265_MIN(size - offset, m_itemSize - header);
+            if (bytes)
+            {
+                memcpy(out + offset, item + header, bytes);
+            }
+            releaseRead();
+
+            offset += bytes;
+            header = 0;
+            if (offset >= size)
+            {
+                break;
+            }
+
+            item = acquireRead();
+            if (!item)
+            {
+                return false;
+            }
         }
 
         return true;
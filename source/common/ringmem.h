@@ -35,7 +35,14 @@
 namespace X265_NS {
 
 #define MAX_SHR_NAME_LEN                         256
-
+#define RINGMEM_MAX_READERS                      16
+
+    /* Shared memory ring of fixed size items between one writer and any
+     * number of readers, possibly in different processes. Every reader sees
+     * every item: each one keeps its own cursor in the shared control block
+     * and the writer only reuses an item once all attached readers moved past
+     * it. Without protectRW the writer and readers synchronise through the
+     * shared counters alone and never enter the kernel while data flows */
     class RingMem {
     public:
         RingMem();
@@ -46,8 +53,9 @@ namespace X265_NS {
         bool skipWrite(int32_t cnt);
 
         ///< initialize
-        ///< protectRW: if use the semaphore the protect the write and read operation.
-        bool init(int32_t itemSize, int32_t itemCnt, const char *name, bool protectRW = false);
+        ///< protectRW: if use the semaphore the protect the write and read operation. Only valid with a single reader.
+        ///< numReaders: readers the writer waits for before reusing an item, readers attaching later are added to them
+        bool init(int32_t itemSize, int32_t itemCnt, const char *name, bool protectRW = false, int32_t numReaders = 1);
         ///< finalize
         void release();
 
@@ -58,12 +66,27 @@ namespace X265_NS {
         ///< data write
         bool writeData(void *data, fnRWSharedData callback);
 
+        ///< variable sized record write, spread over as many items as it needs
+        bool writeRecord(const void *data, int32_t size);
+        ///< size of the next record, waiting for the writer if needed. -1 once the writer released the ring
+        int32_t nextRecordSize();
+        ///< read the next record, dst must hold nextRecordSize() bytes
+        bool readRecord(void *dst);
+
     private:        
         bool    m_initialized;
         bool    m_protectRW;
+        bool    m_bWriter;
 
         int32_t m_itemSize;
         int32_t m_itemCnt;
+        int32_t m_shrMemSize;
+        int32_t m_numReaders;
+        ///< reader slot in the control block, -1 until the first read
+        int32_t m_readerId;
+        ///< size of the record whose first item is held by nextRecordSize(), -1 if none
+        int32_t m_recordSize;
+        uint8_t *m_heldItem;
         ///< data pool
         void   *m_dataPool;
         typedef struct {
@@ -71,7 +94,18 @@ namespace X265_NS {
             int32_t m_write;
             ///< index to read
             int32_t m_read;
-            
+            ///< reader slots handed out
+            int32_t m_numReaders;
+            ///< processes mapping the ring, the last one to release it removes it
+            int32_t m_refCount;
+            ///< readers the writer waits for, the ring is kept until they all attached
+            int32_t m_expectedReaders;
+            ///< set when the writer released the ring
+            int32_t m_writerDone;
+            ///< next item of each reader
+            int32_t m_readPos[RINGMEM_MAX_READERS];
+            ///< set when a reader released the ring, the writer stops waiting for it
+            int32_t m_readerDone[RINGMEM_MAX_READERS];
         }ShrMemCtrl;
 
         ShrMemCtrl *m_shrMem;
@@ -84,6 +118,15 @@ namespace X265_NS {
         ///< Semaphores
         NamedSemaphore *m_writeSem;
         NamedSemaphore *m_readSem;
+
+        uint8_t *itemAt(int32_t index) { return reinterpret_cast<uint8_t *>(m_dataPool) + ((uint32_t)index % m_itemCnt) * m_itemSize; }
+        bool attachReader();
+        ///< wait for a free item and return it, publishWrite() hands it to the readers
+        uint8_t *acquireWrite();
+        void publishWrite();
+        ///< wait for the next unread item and return it, NULL once the writer is done. releaseRead() consumes it
+        uint8_t *acquireRead();
+        void releaseRead();
     };
 };
 
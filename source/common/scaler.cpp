@@ -22,16 +22,13 @@
 *****************************************************************************/
 
 #include "scaler.h"
+#include "primitives.h"
 
 #if _MSC_VER
 #pragma warning(disable: 4706) // assignment within conditional
 #pragma warning(disable: 4244) // '=' : possible loss of data
 #endif
 
-#define SHORT_MIN (-(1 << 15))
-#define SHORT_MAX ((1 << 15) - 1)
-#define SHORT_MAX_10 ((1 << 10) - 1)
-
 namespace X265_NS{
 
 ScalerFilterManager::ScalerFilterManager() :
@@ -62,66 +59,6 @@ inline static void filter_copy_c(int64_t* filter, int64_t* filter2, int size)
         filter2[i] = filter[i];
 }
 
-#if X265_DEPTH == 8
-static void doScaling_c(int16_t *dst, int dstW, const uint8_t *src, const int16_t *filter, const int32_t *filterPos, int filterSize)
-{
-    for (int i = 0; i < dstW; i++)
-    {
-        int val = 0;
-        int sourcePos = filterPos[i];
-        for (int j = 0; j < filterSize; j++)
-            val += ((int)src[sourcePos + j]) * filter[filterSize * i + j];
-        // the cubic equation does overflow ...
-        dst[i] = x265_clip3(SHORT_MIN, SHORT_MAX, val >> 7);
-    }
-}
-static uint8_t clipUint8(int a)
-{
-    if (a&(~0xFF))
-        return (-a) >> 31;
-    else
-        return a;
-}
-
-static void yuv2PlaneX_c(const int16_t *filter, int filterSize, const int16_t **src, uint8_t *dest, int dstW)
-{
-    for (int i = 0; i < dstW; i++)
-    {
-        int val = 64 << 12;
-        for (int j = 0; j < filterSize; j++)
-            val += src[j][i] * filter[j];
-        dest[i] = clipUint8(val >> 19);
-    }
-}
-#else
-static void yuv2PlaneX_c_h(const int16_t *filter, int filterSize, const int16_t **src, uint8_t *dest, int dstW)
-{
-    for (int i = 0; i < dstW; i++)
-    {
-        int val = 1 << 16;
-        uint16_t* dst16bit = (uint16_t *)dest;
-        for (int j = 0; j < filterSize; j++)
-            val += src[j][i] * filter[j];
-        uint16_t d = x265_clip3(0, SHORT_MAX_10, val >> 17);
-        ((uint8_t*)(&dst16bit[i]))[0] = (d);
-        ((uint8_t*)(&dst16bit[i]))[1] = (d) >> 8;
-    }
-}
-static void doScaling_c_h(int16_t *dst, int dstW, const uint8_t *src, const int16_t *filter, const int32_t *filterPos, int filterSize)
-{
-    const uint16_t *srcLocal = (const uint16_t *)src;
-    for (int i = 0; i < dstW; i++)
-    {
-        int val = 0;
-        int sourcePos = filterPos[i];
-        for (int j = 0; j < filterSize; j++)
-            val += ((int)srcLocal[sourcePos + j]) * filter[filterSize * i + j];
-        // the cubic equation does overflow
-        dst[i] = x265_clip3(SHORT_MIN, SHORT_MAX, val >> 9);
-    }
-}
-#endif
-
 ScalerFilter::ScalerFilter() :
     m_filtLen(0),
     m_filtPos(NULL),
@@ -180,32 +117,12 @@ void ScalerHCrFilter::process(int sliceVer, int sliceHor)
 
 void VFilterScaler8Bit::yuv2PlaneX(const int16_t *filter, int filterSize, const int16_t **src, uint8_t *dest, int dstW)
 {
-    int IdxW = FACTOR_4;
-    int IdxF = FIL_DEF;
-
-    (dstW % 4 == 0) && (filterSize == 6) && (IdxF = FIL_6) && (IdxW = FACTOR_4);
-    (dstW % 4 == 0) && (filterSize == 8) && (IdxF = FIL_8) && (IdxW = FACTOR_4);
-
-#if X265_DEPTH == 8
-    yuv2PlaneX_c(filter, filterSize, src, dest, dstW);
-#else
-    yuv2PlaneX_c_h(filter, filterSize, src, dest, dstW);
-#endif
+    primitives.scalerVFilter(filter, filterSize, src, (pixel*)dest, dstW);
 }
 
 void VFilterScaler10Bit::yuv2PlaneX(const int16_t *filter, int filterSize, const int16_t **src, uint8_t *dest, int dstW)
 {
-    int IdxW = FACTOR_4;
-    int IdxF = FIL_DEF;
-
-    (dstW % 4 == 0) && (filterSize == 6) && (IdxF = FIL_6) && (IdxW = FACTOR_4);
-    (dstW % 4 == 0) && (filterSize == 8) && (IdxF = FIL_8) && (IdxW = FACTOR_4);
-
-#if X265_DEPTH == 8
-    yuv2PlaneX_c(filter, filterSize, src, dest, dstW);
-#else
-    yuv2PlaneX_c_h(filter, filterSize, src, dest, dstW);
-#endif
+    primitives.scalerVFilter(filter, filterSize, src, (pixel*)dest, dstW);
 }
 
 void ScalerVLumFilter::process(int sliceVer, int sliceHor)
@@ -606,69 +523,15 @@ int ScalerFilterManager::init(int algorithmFlags, VideoDesc *srcVideoDesc, Video
 
 void HFilterScaler8Bit::doScaling(int16_t *dst, int dstW, const uint8_t *src, const int16_t *filter, const int32_t *filterPos, int filterSize)
 {
-    int IdxW = FACTOR_4;
-    int IdxF = FIL_DEF;
-
-    /* This is hard to read code, but much faster. Speed is crucial here */
-    (dstW % 8 == 0) && (filterSize == 6) && (IdxF = FIL_6) && (IdxW = FACTOR_8);
-    (dstW % 8 == 0) && (filterSize == 8) && (IdxF = FIL_8) && (IdxW = FACTOR_8);
-    (dstW % 8 == 0) && (filterSize == 16) && (IdxF = FIL_16) && (IdxW = FACTOR_8);
-    (dstW % 8 == 0) && (filterSize == 11) && (IdxF = FIL_11) && (IdxW = FACTOR_8);
-    (dstW % 8 == 0) && (filterSize == 10) && (IdxF = FIL_10) && (IdxW = FACTOR_8);
-    (dstW % 8 == 0) && (filterSize == 9) && (IdxF = FIL_9) && (IdxW = FACTOR_8);
-    (dstW % 8 == 0) && (filterSize == 15) && (IdxF = FIL_15) && (IdxW = FACTOR_8);
-    (dstW % 8 == 0) && (filterSize == 13) && (IdxF = FIL_13) && (IdxW = FACTOR_8);
-
-    /* Do not check multiple of width 4, if width is already multiple of 8 */
-    !(dstW % 8 == 0) && (dstW % 4 == 0) && (filterSize == 6) && (IdxF = FIL_6) && (IdxW = FACTOR_4);
-    !(dstW % 8 == 0) && (dstW % 4 == 0) && (filterSize == 8) && (IdxF = FIL_8) && (IdxW = FACTOR_4);
-    !(dstW % 8 == 0) && (dstW % 4 == 0) && (filterSize == 16) && (IdxF = FIL_16) && (IdxW = FACTOR_4);
-
-    (dstW % 4 == 0) && (filterSize == 24) && (IdxF = FIL_24) && (IdxW = FACTOR_4);
-    (dstW % 4 == 0) && (filterSize == 22) && (IdxF = FIL_22) && (IdxW = FACTOR_4);
-    (dstW % 4 == 0) && (filterSize == 19) && (IdxF = FIL_19) && (IdxW = FACTOR_4);
-    (dstW % 4 == 0) && (filterSize == 17) && (IdxF = FIL_17) && (IdxW = FACTOR_4);
-
-#if X265_DEPTH == 8
-    doScaling_c(dst, dstW, src, filter, filterPos, filterSize);
-#else
-    doScaling_c_h(dst, dstW, src, filter, filterPos, filterSize);
-#endif
+    primitives.scalerHFilter(dst, dstW, (const pixel*)src, filter, filterPos, filterSize);
 }
 
 void HFilterScaler10Bit::doScaling(int16_t *dst, int dstW, const uint8_t *src, const int16_t *filter, const int32_t *filterPos, int filterSize)
 {
-    int IdxW = FACTOR_4;
-    int IdxF = FIL_DEF;
-
-    /* This is hard to read code, but much faster. Speed is crucial here */
-    (dstW % 8 == 0) && (filterSize == 6) && (IdxF = FIL_6) && (IdxW = FACTOR_8);
-    (dstW % 8 == 0) && (filterSize == 8) && (IdxF = FIL_8) && (IdxW = FACTOR_8);
-    (dstW % 8 == 0) && (filterSize == 16) && (IdxF = FIL_16) && (IdxW = FACTOR_8);
-    (dstW % 8 == 0) && (filterSize == 11) && (IdxF = FIL_11) && (IdxW = FACTOR_8);
-    (dstW % 8 == 0) && (filterSize == 10) && (IdxF = FIL_10) && (IdxW = FACTOR_8);
-    (dstW % 8 == 0) && (filterSize == 9) && (IdxF = FIL_9) && (IdxW = FACTOR_8);
-    (dstW % 8 == 0) && (filterSize == 15) && (IdxF = FIL_15) && (IdxW = FACTOR_8);
-    (dstW % 8 == 0) && (filterSize == 13) && (IdxF = FIL_13) && (IdxW = FACTOR_8);
-
-    /* Do not check multiple of width 4, if width is already multiple of 8 */
-    !(dstW % 8 == 0) && (dstW % 4 == 0) && (filterSize == 6) && (IdxF = FIL_6) && (IdxW = FACTOR_4);
-    !(dstW % 8 == 0) && (dstW % 4 == 0) && (filterSize == 8) && (IdxF = FIL_8) && (IdxW = FACTOR_4);
-    !(dstW % 8 == 0) && (dstW % 4 == 0) && (filterSize == 16) && (IdxF = FIL_16) && (IdxW = FACTOR_4);
-
-    (dstW % 4 == 0) && (filterSize == 24) && (IdxF = FIL_24) && (IdxW = FACTOR_4);
-    (dstW % 4 == 0) && (filterSize == 22) && (IdxF = FIL_22) && (IdxW = FACTOR_4);
-    (dstW % 4 == 0) && (filterSize == 19) && (IdxF = FIL_19) && (IdxW = FACTOR_4);
-    (dstW % 4 == 0) && (filterSize == 17) && (IdxF = FIL_17) && (IdxW = FACTOR_4);
-
-#if X265_DEPTH == 8
-    doScaling_c(dst, dstW, src, filter, filterPos, filterSize);
-#else
-    doScaling_c_h(dst, dstW, src, filter, filterPos, filterSize);
-#endif
+    primitives.scalerHFilter(dst, dstW, (const pixel*)src, filter, filterPos, filterSize);
 }
 
-int ScalerFilterManager::scale_pic(void ** src, void ** dst, int * srcStride, int * dstStride)
+int ScalerFilterManager::scale_pic(void ** src, void ** dst, int * srcStride, int * dstStride, int dstYBegin, int dstYEnd)
 {
     uint8_t** src_8bit, **dst_8bit;
     src_8bit = (uint8_t**)src;
@@ -710,7 +573,10 @@ int ScalerFilterManager::scale_pic(void ** src, void ** dst, int * srcStride, in
     hout_slice->m_plane[3].sliceHor = 0;
     hout_slice->m_width = dstW;
 
-    for (int dstY = 0; dstY < dstH; dstY++)
+    if (dstYEnd < 0 || dstYEnd > dstH)
+        dstYEnd = dstH;
+
+    for (int dstY = dstYBegin; dstY < dstYEnd; dstY++)
     {
         const int crDstY = dstY >> m_crDstVSubSample;
         const int firstLumSrcY = x265_max(1 - vLumFilterSize, vLumFilterPos[dstY]);
@@ -923,7 +789,10 @@ void ScalerSlice::destroy()
     for (int i = 0; i < m_numSlicePlane; i++)
     {
         if (m_plane[i].lineBuf)
+        {
             X265_FREE(m_plane[i].lineBuf);
+            m_plane[i].lineBuf = NULL;
+        }
     }
 }
 
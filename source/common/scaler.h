@@ -156,7 +156,7 @@ private:
     HFilterScaler* m_hFilterScaler;
 public:
     ScalerHLumFilter(int bitDepth) { bitDepth == 8 ? m_hFilterScaler = new HFilterScaler8Bit : bitDepth == 10 ? m_hFilterScaler = new HFilterScaler10Bit : NULL;}
-    ~ScalerHLumFilter() { if (m_hFilterScaler) X265_FREE(m_hFilterScaler); }
+    ~ScalerHLumFilter() { delete m_hFilterScaler; }
     virtual void process(int sliceVer, int sliceHor);
 };
 
@@ -166,7 +166,7 @@ private:
     HFilterScaler* m_hFilterScaler;
 public:
     ScalerHCrFilter(int bitDepth) { bitDepth == 8 ? m_hFilterScaler = new HFilterScaler8Bit : bitDepth == 10 ? m_hFilterScaler = new HFilterScaler10Bit : NULL;}
-    ~ScalerHCrFilter() { if (m_hFilterScaler) X265_FREE(m_hFilterScaler); }
+    ~ScalerHCrFilter() { delete m_hFilterScaler; }
     virtual void process(int sliceVer, int sliceHor);
 };
 
@@ -176,7 +176,7 @@ private:
     VFilterScaler* m_vFilterScaler;
 public:
     ScalerVLumFilter(int bitDepth) { bitDepth == 8 ? m_vFilterScaler = new VFilterScaler8Bit : bitDepth == 10 ? m_vFilterScaler = new VFilterScaler10Bit : NULL;}
-    ~ScalerVLumFilter() { if (m_vFilterScaler) X265_FREE(m_vFilterScaler); }
+    ~ScalerVLumFilter() { delete m_vFilterScaler; }
     virtual void process(int sliceVer, int sliceHor);
 };
 
@@ -186,7 +186,7 @@ private:
     VFilterScaler*    m_vFilterScaler;
 public:
     ScalerVCrFilter(int bitDepth) { bitDepth == 8 ? m_vFilterScaler = new VFilterScaler8Bit : bitDepth == 10 ? m_vFilterScaler = new VFilterScaler10Bit : NULL;}
-    ~ScalerVCrFilter() { if (m_vFilterScaler) X265_FREE(m_vFilterScaler); }
+    ~ScalerVCrFilter() { delete m_vFilterScaler; }
     virtual void process(int sliceVer, int sliceHor);
 };
 
@@ -247,7 +247,10 @@ public:
             if (m_ScalerFilters[i]) { delete m_ScalerFilters[i]; m_ScalerFilters[i] = NULL; }
     }
     int init(int algorithmFlags, VideoDesc* srcVideoDesc, VideoDesc* dstVideoDesc);
-    int scale_pic(void** src, void** dst, int* srcStride, int* dstStride);
+    /* scale the destination rows [dstYBegin, dstYEnd) of a picture, the whole
+     * picture when dstYEnd is negative. Bands of a picture may be scaled
+     * concurrently by distinct managers if they start on chroma row pairs */
+    int scale_pic(void** src, void** dst, int* srcStride, int* dstStride, int dstYBegin = 0, int dstYEnd = -1);
 };
 }
 
@@ -151,6 +151,17 @@ TemporalFilter::TemporalFilter()
     m_sigmaMultiplier = 9.0;
     m_sigmaZeroPoint = 10.0;
     m_motionVectorFactor = 16;
+    m_pool = NULL;
+    m_metld = NULL;
+    m_numMETLD = 0;
+    m_weightLut = NULL;
+}
+
+TemporalFilter::~TemporalFilter()
+{
+    m_motionSearch.waitForExit();
+    delete [] m_metld;
+    X265_FREE(m_weightLut);
 }
 
 void TemporalFilter::init(const x265_param* param)
@@ -161,10 +172,6 @@ void TemporalFilter::init(const x265_param* param)
     m_sourceHeight = param->sourceHeight;
     m_internalCsp = param->internalCsp;
     m_numComponents = (m_internalCsp != X265_CSP_I400) ? MAX_NUM_COMPONENT : 1;
-
-    m_metld = new MotionEstimatorTLD;
-
-    predPUYuv.create(FENC_STRIDE, X265_CSP_I400);
 }
 
 int TemporalFilter::createRefPicInfo(TemporalFilterRefPicInfo* refFrame, x265_param* param)
@@ -192,6 +199,7 @@ fail:
 }
 
 int TemporalFilter::motionErrorLumaSAD(
+    MotionEstimatorTLD& tld,
     PicYuv *orig,
     PicYuv *buffer,
     int x,
@@ -230,9 +238,9 @@ int TemporalFilter::motionErrorLumaSAD(
 #else
         int partEnum = partitionFromSizes(bs, bs);
         /* copy PU block into cache */
-        primitives.pu[partEnum].copy_pp(predPUYuv.m_buf[0], FENC_STRIDE, bufferRowStart, buffStride);
+        primitives.pu[partEnum].copy_pp(tld.predPUYuv.m_buf[0], FENC_STRIDE, bufferRowStart, buffStride);
 
-        error = m_metld->me.bufSAD(predPUYuv.m_buf[0], FENC_STRIDE);
+        error = tld.me.bufSAD(tld.predPUYuv.m_buf[0], FENC_STRIDE);
 #endif
         if (error > besterror)
         {
@@ -296,6 +304,7 @@ int TemporalFilter::motionErrorLumaSAD(
 }
 
 int TemporalFilter::motionErrorLumaSSD(
+    MotionEstimatorTLD& tld,
     PicYuv *orig,
     PicYuv *buffer,
     int x,
@@ -334,9 +343,9 @@ int TemporalFilter::motionErrorLumaSSD(
 #else
         int partEnum = partitionFromSizes(bs, bs);
         /* copy PU block into cache */
-        primitives.pu[partEnum].copy_pp(predPUYuv.m_buf[0], FENC_STRIDE, bufferRowStart, buffStride);
+        primitives.pu[partEnum].copy_pp(tld.predPUYuv.m_buf[0], FENC_STRIDE, bufferRowStart, buffStride);
 
-        error = (int)primitives.cu[partEnum].sse_pp(m_metld->me.fencPUYuv.m_buf[0], FENC_STRIDE, predPUYuv.m_buf[0], FENC_STRIDE);
+        error = (int)primitives.cu[partEnum].sse_pp(tld.me.fencPUYuv.m_buf[0], FENC_STRIDE, tld.predPUYuv.m_buf[0], FENC_STRIDE);
 
 #endif
         if (error > besterror)
@@ -400,7 +409,7 @@ int TemporalFilter::motionErrorLumaSSD(
     return error;
 }
 
-void TemporalFilter::applyMotion(MV *mvs, uint32_t mvsStride, PicYuv *input, PicYuv *output)
+void TemporalFilter::applyMotion(MV *mvs, uint32_t mvsStride, PicYuv *input, PicYuv *output, int row)
 {
     static const int lumaBlockSize = 8;
     int srcStride = 0;
@@ -430,64 +439,65 @@ void TemporalFilter::applyMotion(MV *mvs, uint32_t mvsStride, PicYuv *input, Pic
         const int height = input->m_picHeight >> csy;
         const int width = input->m_picWidth >> csx;
 
-        for (int y = 0, blockNumY = 0; y + blockSizeY <= height; y += blockSizeY, blockNumY++)
+        const int y = row * blockSizeY;
+        if (y + blockSizeY > height)
+            continue;
+
+        for (int x = 0, blockNumX = 0; x + blockSizeX <= width; x += blockSizeX, blockNumX++)
         {
-            for (int x = 0, blockNumX = 0; x + blockSizeX <= width; x += blockSizeX, blockNumX++)
-            {
-                int mvIdx = blockNumY * mvsStride + blockNumX;
-                const MV &mv = mvs[mvIdx];
-                const int dx = mv.x >> csx;
-                const int dy = mv.y >> csy;
-                const int xInt = mv.x >> (4 + csx);
-                const int yInt = mv.y >> (4 + csy);
+            int mvIdx = row * mvsStride + blockNumX;
+            const MV &mv = mvs[mvIdx];
+            const int dx = mv.x >> csx;
+            const int dy = mv.y >> csy;
+            const int xInt = mv.x >> (4 + csx);
+            const int yInt = mv.y >> (4 + csy);
 
-                const int *xFilter = s_interpolationFilter[dx & 0xf];
-                const int *yFilter = s_interpolationFilter[dy & 0xf]; // will add 6 bit.
-                const int numFilterTaps = 7;
-                const int centreTapOffset = 3;
+            const int *xFilter = s_interpolationFilter[dx & 0xf];
+            const int *yFilter = s_interpolationFilter[dy & 0xf]; // will add 6 bit.
+            const int numFilterTaps = 7;
+            const int centreTapOffset = 3;
 
-                int tempArray[lumaBlockSize + numFilterTaps][lumaBlockSize];
+            int tempArray[lumaBlockSize + numFilterTaps][lumaBlockSize];
 
-                for (int by = 1; by < blockSizeY + numFilterTaps; by++)
+            for (int by = 1; by < blockSizeY + numFilterTaps; by++)
+            {
+                const int yOffset = y + by + yInt - centreTapOffset;
+                const pixel *sourceRow = pSrcImage + yOffset * srcStride;
+                for (int bx = 0; bx < blockSizeX; bx++)
                 {
-                    const int yOffset = y + by + yInt - centreTapOffset;
-                    const pixel *sourceRow = pSrcImage + yOffset * srcStride;
-                    for (int bx = 0; bx < blockSizeX; bx++)
-                    {
-                        int iBase = x + bx + xInt - centreTapOffset;
-                        const pixel *rowStart = sourceRow + iBase;
-
-                        int iSum = 0;
-                        iSum += xFilter[1] * rowStart[1];
-                        iSum += xFilter[2] * rowStart[2];
-                        iSum += xFilter[3] * rowStart[3];
-                        iSum += xFilter[4] * rowStart[4];
-                        iSum += xFilter[5] * rowStart[5];
-                        iSum += xFilter[6] * rowStart[6];
-
-                        tempArray[by][bx] = iSum;
-                    }
+                    int iBase = x + bx + xInt - centreTapOffset;
+                    const pixel *rowStart = sourceRow + iBase;
+
+                    int iSum = 0;
+                    iSum += xFilter[1] * rowStart[1];
+                    iSum += xFilter[2] * rowStart[2];
+                    iSum += xFilter[3] * rowStart[3];
+                    iSum += xFilter[4] * rowStart[4];
+                    iSum += xFilter[5] * rowStart[5];
+                    iSum += xFilter[6] * rowStart[6];
+
+                    tempArray[by][bx] = iSum;
                 }
+            }
 
-                pixel *pDstRow = pDstImage + y * dstStride;
-                for (int by = 0; by < blockSizeY; by++, pDstRow += dstStride)
+            pixel *pDstRow = pDstImage + y * dstStride;
+            for (int by = 0; by < blockSizeY; by++, pDstRow += dstStride)
+            {
+                pixel *pDstPel = pDstRow + x;
+                for (int bx = 0; bx < blockSizeX; bx++, pDstPel++)
                 {
-                    pixel *pDstPel = pDstRow + x;
-                    for (int bx = 0; bx < blockSizeX; bx++, pDstPel++)
-                    {
-                        int iSum = 0;
-
-                        iSum += yFilter[1] * tempArray[by + 1][bx];
-                        iSum += yFilter[2] * tempArray[by + 2][bx];
-                        iSum += yFilter[3] * tempArray[by + 3][bx];
-                        iSum += yFilter[4] * tempArray[by + 4][bx];
-                        iSum += yFilter[5] * tempArray[by + 5][bx];
-                        iSum += yFilter[6] * tempArray[by + 6][bx];
-
-                        iSum = (iSum + (1 << 11)) >> 12;
-                        iSum = iSum < 0 ? 0 : (iSum > maxValue ? maxValue : iSum);
-                        *pDstPel = (pixel)iSum;
-                    }
+                    int iSum = 0;
+
+                    iSum += yFilter[1] * tempArray[by + 1][bx];
+                    iSum += yFilter[2] * tempArray[by + 2][bx];
+                    iSum += yFilter[3] * tempArray[by + 3][bx];
+                    iSum += yFilter[4] * tempArray[by + 4][bx];
+                    iSum += yFilter[5] * tempArray[by + 5][bx];
+                    iSum += yFilter[6] * tempArray[by + 6][bx];
+
+                    iSum = (iSum + (1 << 11)) >> 12;
+                    iSum = iSum < 0 ? 0 : (iSum > maxValue ? maxValue : iSum);
+                    *pDstPel = (pixel)iSum;
                 }
             }
         }
@@ -501,149 +511,261 @@ void TemporalFilter::bilateralFilter(Frame* frame,
 
     const int numRefs = frame->m_mcstf->m_numRef;
 
-    for (int i = 0; i < numRefs; i++)
-    {
-        TemporalFilterRefPicInfo *ref = &m_mcstfRefList[i];
-        applyMotion(m_mcstfRefList[i].mvs, m_mcstfRefList[i].mvsStride, m_mcstfRefList[i].picBuffer, ref->compensatedPic);
-    }
+    if (!numRefs)
+        return;
 
-    int refStrengthRow = 2;
+    m_refStrengthRow = 2;
     if (numRefs == m_range * 2)
     {
-        refStrengthRow = 0;
+        m_refStrengthRow = 0;
     }
     else if (numRefs == m_range)
     {
-        refStrengthRow = 1;
+        m_refStrengthRow = 1;
+    }
+    m_overallStrength = overallStrength;
+
+    const int lutSize = PIXEL_MAX + 2;
+    if (!m_weightLut)
+    {
+        m_weightLut = X265_MALLOC(uint16_t, MAX_NUM_COMPONENT * 4 * lutSize);
+        if (!m_weightLut)
+        {
+            x265_log(m_param, X265_LOG_ERROR, "unable to allocate MCSTF weight tables\n");
+            return;
+        }
     }
 
     const double lumaSigmaSq = (m_QP - m_sigmaZeroPoint) * (m_QP - m_sigmaZeroPoint) * m_sigmaMultiplier;
     const double chromaSigmaSq = 30 * 30;
 
+    const int maxSampleValue = (1 << m_bitDepth) - 1;
+    const double bitDepthDiffWeighting = 1024.0 / (maxSampleValue + 1);
+
+    for (int c = 0; c < m_numComponents; c++)
+    {
+        const double sigmaSq = (!c)  ? lumaSigmaSq : chromaSigmaSq;
+
+        /* The noise and error levels of a block select its sample weight
+         * sigma; tabulate exp(-diff^2 / (2 * sw * sigma^2)) for each of the
+         * four possible values of sw. Class bit 1 is set for noisy blocks
+         * (noise >= 25), bit 0 for blocks with a poor match (error >= 50) */
+        for (int cls = 0; cls < 4; cls++)
+        {
+            const double sw = ((cls & 2) ? 0.8 : 1.3) * ((cls & 1) ? 1 : 1.3);
+            uint16_t* lut = m_weightLut + (c * 4 + cls) * lutSize;
+
+            for (int d = 0; d <= maxSampleValue; d++)
+            {
+                const double diff = d * bitDepthDiffWeighting;
+                const double w = sigmaSq > 0 ? exp(-(diff * diff) / (2 * sw * sigmaSq)) : (double)!d;
+                lut[d] = (uint16_t)(w * (1 << MCSTF_WEIGHT_SHIFT) + 0.5);
+            }
+            for (int d = maxSampleValue + 1; d < lutSize; d++)
+                lut[d] = 0;
+        }
+    }
+
+    /* motion compensation and filtering of each row of 8x8 luma blocks (and
+     * the co-located chroma) only touch that row, so rows are independent */
+    TemporalFilterGroup group(this, frame, m_mcstfRefList, false);
+    group.m_jobTotal = (frame->m_fencPic->m_picHeight + 7) / 8;
+    if (m_pool)
+        group.tryBondPeers(*m_pool, group.m_jobTotal);
+    group.processTasks(-1);
+    group.waitForExit();
+}
+
+void TemporalFilter::filterRow(Frame* frame, TemporalFilterRefPicInfo* m_mcstfRefList, int row)
+{
+    static const int lumaBlockSize = 8;
+    const int numRefs = frame->m_mcstf->m_numRef;
+
+    for (int i = 0; i < numRefs; i++)
+    {
+        TemporalFilterRefPicInfo *ref = &m_mcstfRefList[i];
+        applyMotion(ref->mvs, ref->mvsStride, ref->picBuffer, ref->compensatedPic, row);
+    }
+
+    const int lutSize = PIXEL_MAX + 2;
+
     PicYuv* orgPic = frame->m_fencPic;
 
+    const pixel* refPels[MAX_MCSTF_TEMPORAL_WINDOW_LENGTH];
+    const uint16_t* refLuts[MAX_MCSTF_TEMPORAL_WINDOW_LENGTH];
+    int32_t refWeights[MAX_MCSTF_TEMPORAL_WINDOW_LENGTH];
+    int noises[MAX_MCSTF_TEMPORAL_WINDOW_LENGTH];
+
     for (int c = 0; c < m_numComponents; c++)
     {
-        int height, width;
-        pixel *srcPelRow = NULL;
+        int height, width, csy = 0;
         intptr_t srcStride, correctedPicsStride = 0;
 
         if (!c)
         {
             height = orgPic->m_picHeight;
             width = orgPic->m_picWidth;
-            srcPelRow = orgPic->m_picOrg[c];
             srcStride = orgPic->m_stride;
+            correctedPicsStride = m_mcstfRefList[0].compensatedPic->m_stride;
         }
         else
         {
             int csx = CHROMA_H_SHIFT(m_internalCsp);
-            int csy = CHROMA_V_SHIFT(m_internalCsp);
+            csy = CHROMA_V_SHIFT(m_internalCsp);
 
             height = orgPic->m_picHeight >> csy;
             width = orgPic->m_picWidth >> csx;
-            srcPelRow = orgPic->m_picOrg[c];
             srcStride = (int)orgPic->m_strideC;
+            correctedPicsStride = m_mcstfRefList[0].compensatedPic->m_strideC;
         }
 
-        const double sigmaSq = (!c)  ? lumaSigmaSq : chromaSigmaSq;
-        const double weightScaling = overallStrength * ( (!c) ? 0.4 : m_chromaFactor);
-
-        const double maxSampleValue = (1 << m_bitDepth) - 1;
-        const double bitDepthDiffWeighting = 1024.0 / (maxSampleValue + 1);
+        const double weightScaling = m_overallStrength * ( (!c) ? 0.4 : m_chromaFactor);
 
         const int blkSize = (!c) ? 8 : 4;
+        const uint16_t* planeLuts = m_weightLut + c * 4 * lutSize;
 
-        for (int y = 0; y < height; y++, srcPelRow += srcStride)
+        const int yEnd = X265_MIN(((row + 1) * lumaBlockSize) >> csy, height);
+        for (int y = (row * lumaBlockSize) >> csy; y < yEnd; y += blkSize)
         {
-            pixel *srcPel = srcPelRow;
+            const int blkHeight = X265_MIN(blkSize, height - y);
+            pixel *srcPelRow = orgPic->m_picOrg[c] + y * srcStride;
 
-            for (int x = 0; x < width; x++, srcPel++)
+            for (int x = 0; x < width; x += blkSize)
             {
-                const int orgVal = (int)*srcPel;
-                double temporalWeightSum = 1.0;
-                double newVal = (double)orgVal;
+                pixel *srcPel = srcPelRow + x;
+                const int blkIdx = (y / blkSize) * m_mcstfRefList[0].mvsStride + (x / blkSize);
 
-                if ((y % blkSize == 0) && (x % blkSize == 0))
+                for (int i = 0; i < numRefs; i++)
                 {
-                    for (int i = 0; i < numRefs; i++)
-                    {
-                        TemporalFilterRefPicInfo *refPicInfo = &m_mcstfRefList[i];
-
-                        if (!c)
-                            correctedPicsStride = refPicInfo->compensatedPic->m_stride;
-                        else
-                            correctedPicsStride = refPicInfo->compensatedPic->m_strideC;
+                    TemporalFilterRefPicInfo *refPicInfo = &m_mcstfRefList[i];
+                    const pixel *refPel = refPicInfo->compensatedPic->m_picOrg[c] + y * correctedPicsStride + x;
 
-                        double variance = 0, diffsum = 0;
-                        for (int y1 = 0; y1 < blkSize - 1; y1++)
+                    int64_t variance = 0, diffsum = 0;
+                    for (int y1 = 0; y1 < blkSize - 1; y1++)
+                    {
+                        for (int x1 = 0; x1 < blkSize - 1; x1++)
                         {
-                            for (int x1 = 0; x1 < blkSize - 1; x1++)
-                            {
-                                int pix = *(srcPel + x1);
-                                int pixR = *(srcPel + x1 + 1);
-                                int pixD = *(srcPel + x1 + srcStride);
+                            int pix = *(srcPel + x1);
+                            int pixR = *(srcPel + x1 + 1);
+                            int pixD = *(srcPel + x1 + srcStride);
 
-                                int ref = *(refPicInfo->compensatedPic->m_picOrg[c] + ((y + y1) * correctedPicsStride + x + x1));
-                                int refR = *(refPicInfo->compensatedPic->m_picOrg[c] + ((y + y1) * correctedPicsStride + x + x1 + 1));
-                                int refD = *(refPicInfo->compensatedPic->m_picOrg[c] + ((y + y1 + 1) * correctedPicsStride + x + x1));
+                            int ref = *(refPel + y1 * correctedPicsStride + x1);
+                            int refR = *(refPel + y1 * correctedPicsStride + x1 + 1);
+                            int refD = *(refPel + (y1 + 1) * correctedPicsStride + x1);
 
-                                int diff = pix - ref;
-                                int diffR = pixR - refR;
-                                int diffD = pixD - refD;
+                            int diff = pix - ref;
+                            int diffR = pixR - refR;
+                            int diffD = pixD - refD;
 
-                                variance += diff * diff;
-                                diffsum += (diffR - diff) * (diffR - diff);
-                                diffsum += (diffD - diff) * (diffD - diff);
-                            }
+                            variance += diff * diff;
+                            diffsum += (diffR - diff) * (diffR - diff);
+                            diffsum += (diffD - diff) * (diffD - diff);
                         }
-
-                        refPicInfo->noise[(y / blkSize) * refPicInfo->mvsStride + (x / blkSize)] = (int)round((300 * variance + 50) / (10 * diffsum + 50));
                     }
+
+                    noises[i] = (int)round((300 * (double)variance + 50) / (10 * (double)diffsum + 50));
+                    /* chroma block indices of 4:2:2 and 4:4:4 overlap other
+                     * block rows, so only luma publishes its noise level */
+                    if (!c)
+                        refPicInfo->noise[blkIdx] = noises[i];
+                    refPels[i] = refPel;
                 }
 
                 double minError = 9999999;
                 for (int i = 0; i < numRefs; i++)
                 {
                     TemporalFilterRefPicInfo *refPicInfo = &m_mcstfRefList[i];
-                    minError = X265_MIN(minError, (double)refPicInfo->error[(y / blkSize) * refPicInfo->mvsStride + (x / blkSize)]);
+                    minError = X265_MIN(minError, (double)refPicInfo->error[blkIdx]);
                 }
 
                 for (int i = 0; i < numRefs; i++)
                 {
                     TemporalFilterRefPicInfo *refPicInfo = &m_mcstfRefList[i];
 
-                    const int error = refPicInfo->error[(y / blkSize) * refPicInfo->mvsStride + (x / blkSize)];
-                    const int noise = refPicInfo->noise[(y / blkSize) * refPicInfo->mvsStride + (x / blkSize)];
-
-                    const pixel *pCorrectedPelPtr = refPicInfo->compensatedPic->m_picOrg[c] + (y * correctedPicsStride + x);
-                    const int refVal = (int)*pCorrectedPelPtr;
-                    double diff = (double)(refVal - orgVal);
-                    diff *= bitDepthDiffWeighting;
-                    double diffSq = diff * diff;
+                    const int error = refPicInfo->error[blkIdx];
+                    const int noise = noises[i];
 
                     const int index = X265_MIN(3, std::abs(refPicInfo->origOffset) - 1);
-                    double ww = 1, sw = 1;
+                    double ww = 1;
                     ww *= (noise < 25) ? 1 : 1.2;
-                    sw *= (noise < 25) ? 1.3 : 0.8;
                     ww *= (error < 50) ? 1.2 : ((error > 100) ? 0.8 : 1);
-                    sw *= (error < 50) ? 1.3 : 1;
                     ww *= ((minError + 1) / (error + 1));
-                    const double weight = weightScaling * s_refStrengths[refStrengthRow][index] * ww * exp(-diffSq / (2 * sw * sigmaSq));
+                    const double weight = weightScaling * s_refStrengths[m_refStrengthRow][index] * ww;
 
-                    newVal += weight * refVal;
-                    temporalWeightSum += weight;
+                    refWeights[i] = X265_MIN((int)(weight * (1 << MCSTF_WEIGHT_SHIFT) + 0.5), MCSTF_MAX_REF_WEIGHT);
+                    refLuts[i] = planeLuts + ((noise >= 25) * 2 + (error >= 50)) * lutSize;
                 }
-                newVal /= temporalWeightSum;
-                double sampleVal = round(newVal);
-                sampleVal = (sampleVal < 0 ? 0 : (sampleVal > maxSampleValue ? maxSampleValue : sampleVal));
-                *srcPel = (pixel)sampleVal;
+
+                primitives.mcstfBilateral(srcPel, srcStride, refPels, correctedPicsStride, refWeights, refLuts,
+                                          numRefs, X265_MIN(blkSize, width - x), blkHeight);
             }
         }
     }
 }
 
-void TemporalFilter::motionEstimationLuma(MV *mvs, uint32_t mvStride, PicYuv *orig, PicYuv *buffer, int blockSize,
+/* Subsample the luma of a frame by 2 and 4 for the hierarchical search. A
+ * frame is searched against by several frame encoders at once, as their
+ * source and as a reference; the first one in does the work and the others
+ * wait for it */
+static void subsampleFrame(Frame* frame)
+{
+    ScopedLock lock(frame->m_subSampleLock);
+    if (*frame->m_isSubSampled)
+        return;
+
+    PicYuv* orig = frame->m_fencPic;
+    PicYuv* sub2 = frame->m_fencPicSubsampled2;
+    PicYuv* sub4 = frame->m_fencPicSubsampled4;
+    primitives.frameSubSampleLuma((const pixel *)orig->m_picOrg[0], sub2->m_picOrg[0], orig->m_stride, sub2->m_stride, sub2->m_picWidth, sub2->m_picHeight);
+    extendPicBorder(sub2->m_picOrg[0], sub2->m_stride, sub2->m_picWidth, sub2->m_picHeight, sub2->m_lumaMarginX, sub2->m_lumaMarginY);
+    primitives.frameSubSampleLuma((const pixel *)sub2->m_picOrg[0], sub4->m_picOrg[0], sub2->m_stride, sub4->m_stride, sub4->m_picWidth, sub4->m_picHeight);
+    extendPicBorder(sub4->m_picOrg[0], sub4->m_stride, sub4->m_picWidth, sub4->m_picHeight, sub4->m_lumaMarginX, sub4->m_lumaMarginY);
+    *frame->m_isSubSampled = true;
+}
+
+void TemporalFilter::startMotionEstimation(Frame* frame, TemporalFilterRefPicInfo* m_mcstfRefList)
+{
+    if (!m_metld)
+    {
+        m_numMETLD = m_pool ? m_pool->m_numWorkers + 1 : 1;
+        m_metld = new MotionEstimatorTLD[m_numMETLD];
+    }
+
+    /* the previous frame's search was finished by its compressFrame(), only
+     * peers on their way out may remain */
+    m_motionSearch.waitForExit();
+    m_motionSearch.m_exitedPeerCount.set(0);
+    m_motionSearch.m_bondedPeerCount = 0;
+    m_motionSearch.m_jobAcquired = 0;
+    m_motionSearch.m_jobTotal = frame->m_mcstf->m_numRef;
+    m_motionSearch.m_filter = this;
+    m_motionSearch.m_frame = frame;
+    m_motionSearch.m_refList = m_mcstfRefList;
+    m_motionSearch.m_bMotionSearch = true;
+
+    /* the hierarchical search of each reference is independent of the others */
+    if (m_pool && m_motionSearch.m_jobTotal)
+        m_motionSearch.tryBondPeers(*m_pool, m_motionSearch.m_jobTotal);
+}
+
+void TemporalFilter::finishMotionEstimation()
+{
+    m_motionSearch.processTasks(-1);
+    m_motionSearch.waitForExit();
+}
+
+void TemporalFilter::estimateRefMotion(MotionEstimatorTLD& tld, Frame* frame, TemporalFilterRefPicInfo* ref)
+{
+    subsampleFrame(frame);
+    subsampleFrame(ref->refFrame);
+
+    motionEstimationLuma(tld, ref->mvs0, ref->mvsStride0, frame->m_fencPicSubsampled4, ref->picBufferSubSampled4, 16);
+    motionEstimationLuma(tld, ref->mvs1, ref->mvsStride1, frame->m_fencPicSubsampled2, ref->picBufferSubSampled2, 16, ref->mvs0, ref->mvsStride0, 2);
+    motionEstimationLuma(tld, ref->mvs2, ref->mvsStride2, frame->m_fencPic, ref->picBuffer, 16, ref->mvs1, ref->mvsStride1, 2);
+    motionEstimationLumaDoubleRes(tld, ref->mvs, ref->mvsStride, frame->m_fencPic, ref->picBuffer, 8, ref->mvs2, ref->mvsStride2, 1, ref->error);
+}
+
+void TemporalFilter::motionEstimationLuma(MotionEstimatorTLD& tld, MV *mvs, uint32_t mvStride, PicYuv *orig, PicYuv *buffer, int blockSize,
     MV *previous, uint32_t prevMvStride, int factor)
 {
 
@@ -662,7 +784,7 @@ void TemporalFilter::motionEstimationLuma(MV *mvs, uint32_t mvStride, PicYuv *or
         for (int blockX = 0; blockX + blockSize <= origWidth; blockX += stepSize)
         {
             const intptr_t pelOffset = blockY * orig->m_stride + blockX;
-            m_metld->me.setSourcePU(orig->m_picOrg[0], orig->m_stride, pelOffset, blockSize, blockSize, X265_HEX_SEARCH, 1);
+            tld.me.setSourcePU(orig->m_picOrg[0], orig->m_stride, pelOffset, blockSize, blockSize, X265_HEX_SEARCH, 1);
 
 
             MV best(0, 0);
@@ -689,9 +811,9 @@ void TemporalFilter::motionEstimationLuma(MV *mvs, uint32_t mvStride, PicYuv *or
                             MV old = previous[mvIdx];
 
                             if (m_useSADinME)
-                                error = motionErrorLumaSAD(orig, buffer, blockX, blockY, old.x * factor, old.y * factor, blockSize, leastError);
+                                error = motionErrorLumaSAD(tld, orig, buffer, blockX, blockY, old.x * factor, old.y * factor, blockSize, leastError);
                             else
-                                error = motionErrorLumaSSD(orig, buffer, blockX, blockY, old.x * factor, old.y * factor, blockSize, leastError);
+                                error = motionErrorLumaSSD(tld, orig, buffer, blockX, blockY, old.x * factor, old.y * factor, blockSize, leastError);
 
                             if (error < leastError)
                             {
@@ -703,9 +825,9 @@ void TemporalFilter::motionEstimationLuma(MV *mvs, uint32_t mvStride, PicYuv *or
                 }
 
                 if (m_useSADinME)
-                    error = motionErrorLumaSAD(orig, buffer, blockX, blockY, 0, 0, blockSize, leastError);
+                    error = motionErrorLumaSAD(tld, orig, buffer, blockX, blockY, 0, 0, blockSize, leastError);
                 else
-                    error = motionErrorLumaSSD(orig, buffer, blockX, blockY, 0, 0, blockSize, leastError);
+                    error = motionErrorLumaSSD(tld, orig, buffer, blockX, blockY, 0, 0, blockSize, leastError);
 
                 if (error < leastError)
                 {
@@ -721,9 +843,9 @@ void TemporalFilter::motionEstimationLuma(MV *mvs, uint32_t mvStride, PicYuv *or
                 for (int x2 = prevBest.x / m_motionVectorFactor - range; x2 <= prevBest.x / m_motionVectorFactor + range; x2++)
                 {
                     if (m_useSADinME)
-                        error = motionErrorLumaSAD(orig, buffer, blockX, blockY, x2 * m_motionVectorFactor, y2 * m_motionVectorFactor, blockSize, leastError);
+                        error = motionErrorLumaSAD(tld, orig, buffer, blockX, blockY, x2 * m_motionVectorFactor, y2 * m_motionVectorFactor, blockSize, leastError);
                     else
-                        error = motionErrorLumaSSD(orig, buffer, blockX, blockY, x2 * m_motionVectorFactor, y2 * m_motionVectorFactor, blockSize, leastError);
+                        error = motionErrorLumaSSD(tld, orig, buffer, blockX, blockY, x2 * m_motionVectorFactor, y2 * m_motionVectorFactor, blockSize, leastError);
                     if (error < leastError)
                     {
                         best.set(x2 * m_motionVectorFactor, y2 * m_motionVectorFactor);
@@ -738,9 +860,9 @@ void TemporalFilter::motionEstimationLuma(MV *mvs, uint32_t mvStride, PicYuv *or
                 MV aboveMV = mvs[idx];
 
                 if (m_useSADinME)
-                    error = motionErrorLumaSAD(orig, buffer, blockX, blockY, aboveMV.x, aboveMV.y, blockSize, leastError);
+                    error = motionErrorLumaSAD(tld, orig, buffer, blockX, blockY, aboveMV.x, aboveMV.y, blockSize, leastError);
                 else
-                    error = motionErrorLumaSSD(orig, buffer, blockX, blockY, aboveMV.x, aboveMV.y, blockSize, leastError);
+                    error = motionErrorLumaSSD(tld, orig, buffer, blockX, blockY, aboveMV.x, aboveMV.y, blockSize, leastError);
 
                 if (error < leastError)
                 {
@@ -755,9 +877,9 @@ void TemporalFilter::motionEstimationLuma(MV *mvs, uint32_t mvStride, PicYuv *or
                 MV leftMV = mvs[idx];
 
                 if (m_useSADinME)
-                    error = motionErrorLumaSAD(orig, buffer, blockX, blockY, leftMV.x, leftMV.y, blockSize, leastError);
+                    error = motionErrorLumaSAD(tld, orig, buffer, blockX, blockY, leftMV.x, leftMV.y, blockSize, leastError);
                 else
-                    error = motionErrorLumaSSD(orig, buffer, blockX, blockY, leftMV.x, leftMV.y, blockSize, leastError);
+                    error = motionErrorLumaSSD(tld, orig, buffer, blockX, blockY, leftMV.x, leftMV.y, blockSize, leastError);
 
                 if (error < leastError)
                 {
@@ -797,7 +919,7 @@ void TemporalFilter::motionEstimationLuma(MV *mvs, uint32_t mvStride, PicYuv *or
 }
 
 
-void TemporalFilter::motionEstimationLumaDoubleRes(MV *mvs, uint32_t mvStride, PicYuv *orig, PicYuv *buffer, int blockSize,
+void TemporalFilter::motionEstimationLumaDoubleRes(MotionEstimatorTLD& tld, MV *mvs, uint32_t mvStride, PicYuv *orig, PicYuv *buffer, int blockSize,
     MV *previous, uint32_t prevMvStride, int factor, int* minError)
 {
 
@@ -817,7 +939,7 @@ void TemporalFilter::motionEstimationLumaDoubleRes(MV *mvs, uint32_t mvStride, P
         {
 
             const intptr_t pelOffset = blockY * orig->m_stride + blockX;
-            m_metld->me.setSourcePU(orig->m_picOrg[0], orig->m_stride, pelOffset, blockSize, blockSize, X265_HEX_SEARCH, 1);
+            tld.me.setSourcePU(orig->m_picOrg[0], orig->m_stride, pelOffset, blockSize, blockSize, X265_HEX_SEARCH, 1);
 
             MV best(0, 0);
             int leastError = INT_MAX;
@@ -843,9 +965,9 @@ void TemporalFilter::motionEstimationLumaDoubleRes(MV *mvs, uint32_t mvStride, P
                             MV old = previous[mvIdx];
 
                             if (m_useSADinME)
-                                error = motionErrorLumaSAD(orig, buffer, blockX, blockY, old.x * factor, old.y * factor, blockSize, leastError);
+                                error = motionErrorLumaSAD(tld, orig, buffer, blockX, blockY, old.x * factor, old.y * factor, blockSize, leastError);
                             else
-                                error = motionErrorLumaSSD(orig, buffer, blockX, blockY, old.x * factor, old.y * factor, blockSize, leastError);
+                                error = motionErrorLumaSSD(tld, orig, buffer, blockX, blockY, old.x * factor, old.y * factor, blockSize, leastError);
 
                             if (error < leastError)
                             {
@@ -857,9 +979,9 @@ void TemporalFilter::motionEstimationLumaDoubleRes(MV *mvs, uint32_t mvStride, P
                 }
 
                 if (m_useSADinME)
-                    error = motionErrorLumaSAD(orig, buffer, blockX, blockY, 0, 0, blockSize, leastError);
+                    error = motionErrorLumaSAD(tld, orig, buffer, blockX, blockY, 0, 0, blockSize, leastError);
                 else
-                    error = motionErrorLumaSSD(orig, buffer, blockX, blockY, 0, 0, blockSize, leastError);
+                    error = motionErrorLumaSSD(tld, orig, buffer, blockX, blockY, 0, 0, blockSize, leastError);
 
                 if (error < leastError)
                 {
@@ -875,9 +997,9 @@ void TemporalFilter::motionEstimationLumaDoubleRes(MV *mvs, uint32_t mvStride, P
                 for (int x2 = prevBest.x / m_motionVectorFactor - range; x2 <= prevBest.x / m_motionVectorFactor + range; x2++)
                 {
                     if (m_useSADinME)
-                        error = motionErrorLumaSAD(orig, buffer, blockX, blockY, x2 * m_motionVectorFactor, y2 * m_motionVectorFactor, blockSize, leastError);
+                        error = motionErrorLumaSAD(tld, orig, buffer, blockX, blockY, x2 * m_motionVectorFactor, y2 * m_motionVectorFactor, blockSize, leastError);
                     else
-                        error = motionErrorLumaSSD(orig, buffer, blockX, blockY, x2 * m_motionVectorFactor, y2 * m_motionVectorFactor, blockSize, leastError);
+                        error = motionErrorLumaSSD(tld, orig, buffer, blockX, blockY, x2 * m_motionVectorFactor, y2 * m_motionVectorFactor, blockSize, leastError);
 
                     if (error < leastError)
                     {
@@ -894,9 +1016,9 @@ void TemporalFilter::motionEstimationLumaDoubleRes(MV *mvs, uint32_t mvStride, P
                 for (int x2 = prevBest.x - doubleRange; x2 <= prevBest.x + doubleRange; x2 += 4)
                 {
                     if (m_useSADinME)
-                        error = motionErrorLumaSAD(orig, buffer, blockX, blockY, x2, y2, blockSize, leastError);
+                        error = motionErrorLumaSAD(tld, orig, buffer, blockX, blockY, x2, y2, blockSize, leastError);
                     else
-                        error = motionErrorLumaSSD(orig, buffer, blockX, blockY, x2, y2, blockSize, leastError);
+                        error = motionErrorLumaSSD(tld, orig, buffer, blockX, blockY, x2, y2, blockSize, leastError);
 
                     if (error < leastError)
                     {
@@ -913,9 +1035,9 @@ void TemporalFilter::motionEstimationLumaDoubleRes(MV *mvs, uint32_t mvStride, P
                 for (int x2 = prevBest.x - doubleRange; x2 <= prevBest.x + doubleRange; x2++)
                 {
                     if (m_useSADinME)
-                        error = motionErrorLumaSAD(orig, buffer, blockX, blockY, x2, y2, blockSize, leastError);
+                        error = motionErrorLumaSAD(tld, orig, buffer, blockX, blockY, x2, y2, blockSize, leastError);
                     else
-                        error = motionErrorLumaSSD(orig, buffer, blockX, blockY, x2, y2, blockSize, leastError);
+                        error = motionErrorLumaSSD(tld, orig, buffer, blockX, blockY, x2, y2, blockSize, leastError);
 
                     if (error < leastError)
                     {
@@ -932,9 +1054,9 @@ void TemporalFilter::motionEstimationLumaDoubleRes(MV *mvs, uint32_t mvStride, P
                 MV aboveMV = mvs[idx];
 
                 if (m_useSADinME)
-                    error = motionErrorLumaSAD(orig, buffer, blockX, blockY, aboveMV.x, aboveMV.y, blockSize, leastError);
+                    error = motionErrorLumaSAD(tld, orig, buffer, blockX, blockY, aboveMV.x, aboveMV.y, blockSize, leastError);
                 else
-                    error = motionErrorLumaSSD(orig, buffer, blockX, blockY, aboveMV.x, aboveMV.y, blockSize, leastError);
+                    error = motionErrorLumaSSD(tld, orig, buffer, blockX, blockY, aboveMV.x, aboveMV.y, blockSize, leastError);
 
                 if (error < leastError)
                 {
@@ -949,9 +1071,9 @@ void TemporalFilter::motionEstimationLumaDoubleRes(MV *mvs, uint32_t mvStride, P
                 MV leftMV = mvs[idx];
 
                 if (m_useSADinME)
-                    error = motionErrorLumaSAD(orig, buffer, blockX, blockY, leftMV.x, leftMV.y, blockSize, leastError);
+                    error = motionErrorLumaSAD(tld, orig, buffer, blockX, blockY, leftMV.x, leftMV.y, blockSize, leastError);
                 else
-                    error = motionErrorLumaSSD(orig, buffer, blockX, blockY, leftMV.x, leftMV.y, blockSize, leastError);
+                    error = motionErrorLumaSSD(tld, orig, buffer, blockX, blockY, leftMV.x, leftMV.y, blockSize, leastError);
 
                 if (error < leastError)
                 {
@@ -1015,3 +1137,24 @@ void TemporalFilter::destroyRefPicInfo(TemporalFilterRefPicInfo* curFrame)
             X265_FREE(curFrame->error);
     }
 }
+
+void TemporalFilterGroup::processTasks(int workerThreadID)
+{
+    if (workerThreadID < 0)
+        workerThreadID = m_filter->m_pool ? m_filter->m_pool->m_numWorkers : 0;
+
+    m_lock.acquire();
+    while (m_jobAcquired < m_jobTotal)
+    {
+        int job = m_jobAcquired++;
+        m_lock.release();
+
+        if (m_bMotionSearch)
+            m_filter->estimateRefMotion(m_filter->m_metld[workerThreadID], m_frame, &m_refList[job]);
+        else
+            m_filter->filterRow(m_frame, m_refList, job);
+
+        m_lock.acquire();
+    }
+    m_lock.release();
+}
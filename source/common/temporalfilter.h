@@ -30,6 +30,7 @@
 #include "piclist.h"
 #include "yuv.h"
 #include "motion.h"
+#include "threadpool.h"
 
 const int s_interpolationFilter[16][8] =
 {
@@ -79,14 +80,16 @@ namespace X265_NS {
     struct MotionEstimatorTLD
     {
         MotionEstimate  me;
+        Yuv             predPUYuv;
 
         MotionEstimatorTLD()
         {
             me.init(X265_CSP_I400);
             me.setQP(X265_LOOKAHEAD_QP);
+            predPUYuv.create(FENC_STRIDE, X265_CSP_I400);
         }
 
-        ~MotionEstimatorTLD() {}
+        ~MotionEstimatorTLD() { predPUYuv.destroy(); }
     };
 
     struct TemporalFilterRefPicInfo
@@ -109,16 +112,42 @@ namespace X265_NS {
         bool       isFilteredFrame;
         PicYuv*    compensatedPic;
 
-        int*       isSubsampled;
+        /* the frame owning picBuffer and its subsampled planes; its
+         * m_refPicCnt[1] is held from dispatch until the filtered frame
+         * is output */
+        Frame*     refFrame;
 
         int        slicetype;
     };
 
+    class TemporalFilter;
+
+    class TemporalFilterGroup : public BondedTaskGroup
+    {
+    public:
+
+        TemporalFilter*           m_filter;
+        Frame*                    m_frame;
+        TemporalFilterRefPicInfo* m_refList;
+        bool                      m_bMotionSearch;
+
+        TemporalFilterGroup() : m_filter(NULL), m_frame(NULL), m_refList(NULL), m_bMotionSearch(false) {}
+
+        TemporalFilterGroup(TemporalFilter* tf, Frame* frame, TemporalFilterRefPicInfo* refList, bool bMotionSearch)
+            : m_filter(tf), m_frame(frame), m_refList(refList), m_bMotionSearch(bMotionSearch) {}
+
+        void processTasks(int workerThreadID);
+
+    protected:
+
+        TemporalFilterGroup& operator=(const TemporalFilterGroup&);
+    };
+
     class TemporalFilter
     {
     public:
         TemporalFilter();
-        ~TemporalFilter() {}
+        ~TemporalFilter();
 
         void init(const x265_param* param);
 
@@ -144,21 +173,49 @@ namespace X265_NS {
         int m_numComponents;
         uint8_t m_sliceTypeConfig;
 
+        /* ME and filtering jobs are spread over the workers of this pool;
+         * NULL runs everything on the calling thread */
+        ThreadPool* m_pool;
+
+        /* one ME context per pool worker plus one for the frame encoder
+         * thread, allocated by the first startMotionEstimation() call */
         MotionEstimatorTLD* m_metld;
-        Yuv  predPUYuv;
+        int m_numMETLD;
+
+        TemporalFilterGroup m_motionSearch;
         int m_useSADinME;
 
+        /* sample weight tables of the bilateral filter, one per plane and
+         * noise/error class of a block, allocated on first use */
+        uint16_t* m_weightLut;
+        int m_refStrengthRow;
+        double m_overallStrength;
+
         int createRefPicInfo(TemporalFilterRefPicInfo* refFrame, x265_param* param);
 
+        /* motion search of the frame against every reference, one reference
+         * per job. The encoder starts it on idle pool workers when the frame
+         * is dispatched; the frame encoder does the jobs nobody took and
+         * waits for the rest before filtering */
+        void startMotionEstimation(Frame* frame, TemporalFilterRefPicInfo* mctfRefList);
+        void finishMotionEstimation();
+
+        void estimateRefMotion(MotionEstimatorTLD& tld, Frame* frame, TemporalFilterRefPicInfo* ref);
+
+        /* compensate and filter the frame in place, one row of 8x8 luma
+         * blocks per job */
         void bilateralFilter(Frame* frame, TemporalFilterRefPicInfo* mctfRefList, double overallStrength);
 
-        void motionEstimationLuma(MV *mvs, uint32_t mvStride, PicYuv *orig, PicYuv *buffer, int bs,
+        void filterRow(Frame* frame, TemporalFilterRefPicInfo* mctfRefList, int row);
+
+        void motionEstimationLuma(MotionEstimatorTLD& tld, MV *mvs, uint32_t mvStride, PicYuv *orig, PicYuv *buffer, int bs,
             MV *previous = 0, uint32_t prevmvStride = 0, int factor = 1);
 
-        void motionEstimationLumaDoubleRes(MV *mvs, uint32_t mvStride, PicYuv *orig, PicYuv *buffer, int blockSize,
+        void motionEstimationLumaDoubleRes(MotionEstimatorTLD& tld, MV *mvs, uint32_t mvStride, PicYuv *orig, PicYuv *buffer, int blockSize,
             MV *previous, uint32_t prevMvStride, int factor, int* minError);
 
-        int motionErrorLumaSSD(PicYuv *orig,
+        int motionErrorLumaSSD(MotionEstimatorTLD& tld,
+            PicYuv *orig,
             PicYuv *buffer,
             int x,
             int y,
@@ -167,7 +224,8 @@ namespace X265_NS {
             int bs,
             int besterror = 8 * 8 * 1024 * 1024);
 
-        int motionErrorLumaSAD(PicYuv *orig,
+        int motionErrorLumaSAD(MotionEstimatorTLD& tld,
+            PicYuv *orig,
             PicYuv *buffer,
             int x,
             int y,
@@ -178,7 +236,7 @@ namespace X265_NS {
 
         void destroyRefPicInfo(TemporalFilterRefPicInfo* curFrame);
 
-        void applyMotion(MV *mvs, uint32_t mvsStride, PicYuv *input, PicYuv *output);
+        void applyMotion(MV *mvs, uint32_t mvsStride, PicYuv *input, PicYuv *output, int row);
 
     };
 }
@@ -89,6 +89,48 @@ static int popCount(uint64_t x)
 namespace X265_NS {
 // x265 private namespace
 
+static ThreadBitmap makeFullBitmap()
+{
+    ThreadBitmap map;
+    map.fill();
+    return map;
+}
+
+const ThreadBitmap ALL_POOL_THREADS = makeFullBitmap();
+const ThreadBitmap NO_POOL_THREADS;
+
+void ThreadBitmap::atomicSet(int id)
+{
+    SLEEPBITMAP_OR(&m_words[word(id)], bit(id));
+}
+
+void ThreadBitmap::atomicClear(int id)
+{
+    SLEEPBITMAP_AND(&m_words[word(id)], ~bit(id));
+}
+
+bool ThreadBitmap::atomicAcquire(int id)
+{
+    sleepbitmap_t b = bit(id);
+    return !!(SLEEPBITMAP_AND(&m_words[word(id)], ~b) & b);
+}
+
+int ThreadBitmap::findFirst(const ThreadBitmap& mask) const
+{
+    for (int w = 0; w < SLEEPBITMAP_WORDS; w++)
+    {
+        sleepbitmap_t masked = m_words[w] & mask.m_words[w];
+        if (masked)
+        {
+            unsigned long id;
+            SLEEPBITMAP_CTZ(id, masked);
+            return w * SLEEPBITMAP_BITS + (int)id;
+        }
+    }
+
+    return -1;
+}
+
 class WorkerThread : public Thread
 {
 private:
@@ -96,15 +138,18 @@ private:
     ThreadPool&  m_pool;
     int          m_id;
     Event        m_wakeEvent;
+    uint32_t     m_randState;
 
     WorkerThread& operator =(const WorkerThread&);
 
+    bool trySteal();
+
 public:
 
     JobProvider*     m_curJobProvider;
     BondedTaskGroup* m_bondMaster;
 
-    WorkerThread(ThreadPool& pool, int id) : m_pool(pool), m_id(id) {}
+    WorkerThread(ThreadPool& pool, int id) : m_pool(pool), m_id(id), m_randState(2463534242u + id * 2654435761u) {}
     virtual ~WorkerThread() {}
 
     void threadMain();
@@ -123,12 +168,11 @@ void WorkerThread::threadMain()
 
     m_pool.setCurrentThreadAffinity();
 
-    sleepbitmap_t idBit = (sleepbitmap_t)1 << m_id;
     m_curJobProvider = m_pool.m_jpTable[0];
     m_bondMaster = NULL;
 
-    SLEEPBITMAP_OR(&m_curJobProvider->m_ownerBitmap, idBit);
-    SLEEPBITMAP_OR(&m_pool.m_sleepBitmap, idBit);
+    m_curJobProvider->m_ownerBitmap.atomicSet(m_id);
+    m_pool.m_sleepBitmap.atomicSet(m_id);
     m_wakeEvent.wait();
 
     while (m_pool.m_isActive)
@@ -162,9 +206,9 @@ void WorkerThread::threadMain()
             }
             if (nextProvider != -1 && m_curJobProvider != m_pool.m_jpTable[nextProvider])
             {
-                SLEEPBITMAP_AND(&m_curJobProvider->m_ownerBitmap, ~idBit);
+                m_curJobProvider->m_ownerBitmap.atomicClear(m_id);
                 m_curJobProvider = m_pool.m_jpTable[nextProvider];
-                SLEEPBITMAP_OR(&m_curJobProvider->m_ownerBitmap, idBit);
+                m_curJobProvider->m_ownerBitmap.atomicSet(m_id);
             }
         }
         while (m_curJobProvider->m_helpWanted);
@@ -172,11 +216,60 @@ void WorkerThread::threadMain()
         /* While the worker sleeps, a job-provider or bond-group may acquire this
          * worker's sleep bitmap bit. Once acquired, that thread may modify 
          * m_bondMaster or m_curJobProvider, then waken the thread */
-        SLEEPBITMAP_OR(&m_pool.m_sleepBitmap, idBit);
+        m_pool.m_sleepBitmap.atomicSet(m_id);
+        if (m_pool.m_bWorkStealing && trySteal())
+            continue;
         m_wakeEvent.wait();
     }
 
-    SLEEPBITMAP_OR(&m_pool.m_sleepBitmap, idBit);
+    m_pool.m_sleepBitmap.atomicSet(m_id);
+}
+
+/* Called with this worker's sleep bit set. Polls the provider table, starting
+ * from a random provider each round so idle workers spread over the frame
+ * encoders instead of all piling onto the first one, for a bounded number of
+ * rounds. While polling the worker remains visible as sleeping, so it may still
+ * be acquired by tryWakeOne() or a bond group; in that case the wake event is
+ * (or soon will be) triggered and the caller must wait on it. Returns true if
+ * the worker reclaimed its own sleep bit and switched to a provider wanting
+ * help */
+bool WorkerThread::trySteal()
+{
+    int numProviders = m_pool.m_numProviders;
+
+    for (int round = 0; round < STEAL_SPIN_ROUNDS && m_pool.m_isActive; round++)
+    {
+        if (!m_pool.m_sleepBitmap.test(m_id))
+            return false;
+
+        /* xorshift32 */
+        m_randState ^= m_randState << 13;
+        m_randState ^= m_randState >> 17;
+        m_randState ^= m_randState << 5;
+
+        int start = (int)(m_randState % (uint32_t)numProviders);
+        for (int i = 0; i < numProviders; i++)
+        {
+            JobProvider* victim = m_pool.m_jpTable[(start + i) % numProviders];
+            if (!victim->m_helpWanted)
+                continue;
+
+            if (!m_pool.m_sleepBitmap.atomicAcquire(m_id))
+                return false;
+
+            if (victim != m_curJobProvider)
+            {
+                m_curJobProvider->m_ownerBitmap.atomicClear(m_id);
+                m_curJobProvider = victim;
+                m_curJobProvider->m_ownerBitmap.atomicSet(m_id);
+            }
+            return true;
+        }
+
+        GIVE_UP_TIME();
+    }
+
+    return false;
 }
 
 void JobProvider::tryWakeOne()
@@ -191,51 +284,42 @@ void JobProvider::tryWakeOne()
     WorkerThread& worker = m_pool->m_workers[id];
     if (worker.m_curJobProvider != this) /* poaching */
     {
-        sleepbitmap_t bit = (sleepbitmap_t)1 << id;
-        SLEEPBITMAP_AND(&worker.m_curJobProvider->m_ownerBitmap, ~bit);
+        worker.m_curJobProvider->m_ownerBitmap.atomicClear(id);
         worker.m_curJobProvider = this;
-        SLEEPBITMAP_OR(&worker.m_curJobProvider->m_ownerBitmap, bit);
+        worker.m_curJobProvider->m_ownerBitmap.atomicSet(id);
     }
     worker.awaken();
 }
 
-int ThreadPool::tryAcquireSleepingThread(sleepbitmap_t firstTryBitmap, sleepbitmap_t secondTryBitmap)
+int ThreadPool::tryAcquireSleepingThread(const ThreadBitmap& firstTryBitmap, const ThreadBitmap& secondTryBitmap)
 {
-    unsigned long id;
-
-    sleepbitmap_t masked = m_sleepBitmap & firstTryBitmap;
-    while (masked)
+    int id = m_sleepBitmap.findFirst(firstTryBitmap);
+    while (id >= 0)
     {
-        SLEEPBITMAP_CTZ(id, masked);
+        if (m_sleepBitmap.atomicAcquire(id))
+            return id;
 
-        sleepbitmap_t bit = (sleepbitmap_t)1 << id;
-        if (SLEEPBITMAP_AND(&m_sleepBitmap, ~bit) & bit)
-            return (int)id;
-
-        masked = m_sleepBitmap & firstTryBitmap;
+        id = m_sleepBitmap.findFirst(firstTryBitmap);
     }
 
-    masked = m_sleepBitmap & secondTryBitmap;
-    while (masked)
+    id = m_sleepBitmap.findFirst(secondTryBitmap);
+    while (id >= 0)
     {
-        SLEEPBITMAP_CTZ(id, masked);
-
-        sleepbitmap_t bit = (sleepbitmap_t)1 << id;
-        if (SLEEPBITMAP_AND(&m_sleepBitmap, ~bit) & bit)
-            return (int)id;
+        if (m_sleepBitmap.atomicAcquire(id))
+            return id;
 
-        masked = m_sleepBitmap & secondTryBitmap;
+        id = m_sleepBitmap.findFirst(secondTryBitmap);
     }
 
     return -1;
 }
 
-int ThreadPool::tryBondPeers(int maxPeers, sleepbitmap_t peerBitmap, BondedTaskGroup& master)
+int ThreadPool::tryBondPeers(int maxPeers, const ThreadBitmap& peerBitmap, BondedTaskGroup& master)
 {
     int bondCount = 0;
     do
     {
-        int id = tryAcquireSleepingThread(peerBitmap, 0);
+        int id = tryAcquireSleepingThread(peerBitmap, NO_POOL_THREADS);
         if (id < 0)
             return bondCount;
 
@@ -446,6 +530,7 @@ ThreadPool* ThreadPool::allocThreadPools(x265_param* p, int& numPools, bool isTh
                 numPools = 0;
                 return NULL;
             }
+            pools[i].m_bWorkStealing = !!p->bEnableWorkStealing;
             if (numNumaNodes > 1)
             {
                 char *nodesstr = new char[64 * strlen(",63") + 1];
@@ -536,7 +621,7 @@ void ThreadPool::stopWorkers()
         m_isActive = false;
         for (int i = 0; i < m_numWorkers; i++)
         {
-            while (!(m_sleepBitmap & ((sleepbitmap_t)1 << i)))
+            while (!m_sleepBitmap.test(i))
                 GIVE_UP_TIME();
             m_workers[i].awaken();
             m_workers[i].stop();
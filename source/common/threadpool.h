@@ -40,9 +40,50 @@ typedef uint64_t sleepbitmap_t;
 typedef uint32_t sleepbitmap_t;
 #endif
 
-static const sleepbitmap_t ALL_POOL_THREADS = (sleepbitmap_t)-1;
-enum { MAX_POOL_THREADS = sizeof(sleepbitmap_t) * 8 };
+enum { SLEEPBITMAP_BITS = sizeof(sleepbitmap_t) * 8 };
+#if defined(_WIN32_WINNT) && _WIN32_WINNT >= _WIN32_WINNT_WIN7
+/* pool workers share the affinity of a single processor group, which holds at
+ * most 64 logical CPUs, so there is no point in a wider pool */
+enum { SLEEPBITMAP_WORDS = 1 };
+#else
+enum { SLEEPBITMAP_WORDS = 256 / SLEEPBITMAP_BITS };
+#endif
+enum { MAX_POOL_THREADS = SLEEPBITMAP_BITS * SLEEPBITMAP_WORDS };
 enum { INVALID_SLICE_PRIORITY = 10 }; // a value larger than any X265_TYPE_* macro
+enum { STEAL_SPIN_ROUNDS = 64 };      // polls of the provider table before a stealing worker sleeps
+
+/* A set of worker thread IDs, one bit per worker, spread over as many machine
+ * words as are needed to hold MAX_POOL_THREADS bits. Individual bits are set
+ * and cleared atomically; there is no atomicity across words, which is fine
+ * since every worker is only ever acquired one bit at a time */
+class ThreadBitmap
+{
+public:
+
+    sleepbitmap_t m_words[SLEEPBITMAP_WORDS];
+
+    ThreadBitmap()                     { clear(); }
+
+    void clear()                       { memset(m_words, 0, sizeof(m_words)); }
+    void fill()                        { memset(m_words, 0xff, sizeof(m_words)); }
+
+    static int  word(int id)           { return id / SLEEPBITMAP_BITS; }
+    static sleepbitmap_t bit(int id)   { return (sleepbitmap_t)1 << (id % SLEEPBITMAP_BITS); }
+
+    bool test(int id) const            { return !!(m_words[word(id)] & bit(id)); }
+
+    void atomicSet(int id);
+    void atomicClear(int id);
+
+    /* atomically clear the bit for id, returns true if this call cleared it */
+    bool atomicAcquire(int id);
+
+    /* returns the lowest ID set in both this bitmap and mask, or -1 */
+    int  findFirst(const ThreadBitmap& mask) const;
+};
+
+extern const ThreadBitmap ALL_POOL_THREADS;
+extern const ThreadBitmap NO_POOL_THREADS;
 
 // Frame level job providers. FrameEncoder and Lookahead derive from
 // this class and implement findJob()
@@ -51,7 +92,7 @@ class JobProvider
 public:
 
     ThreadPool*   m_pool;
-    sleepbitmap_t m_ownerBitmap;
+    ThreadBitmap  m_ownerBitmap;
     int           m_jpId;
     int           m_sliceType;
     bool          m_helpWanted;
@@ -59,7 +100,6 @@ public:
 
     JobProvider()
         : m_pool(NULL)
-        , m_ownerBitmap(0)
         , m_jpId(-1)
         , m_sliceType(INVALID_SLICE_PRIORITY)
         , m_helpWanted(false)
@@ -80,7 +120,7 @@ class ThreadPool
 {
 public:
 
-    sleepbitmap_t m_sleepBitmap;
+    ThreadBitmap  m_sleepBitmap;
     int           m_numProviders;
     int           m_numWorkers;
     void*         m_numaMask; // node mask in linux, cpu mask in windows
@@ -88,6 +128,7 @@ public:
     GROUP_AFFINITY m_groupAffinity;
 #endif
     bool          m_isActive;
+    bool          m_bWorkStealing; // idle workers poll other providers before sleeping
 
     JobProvider** m_jpTable;
     WorkerThread* m_workers;
@@ -100,8 +141,8 @@ public:
     void stopWorkers();
     void setCurrentThreadAffinity();
     void setThreadNodeAffinity(void *numaMask);
-    int  tryAcquireSleepingThread(sleepbitmap_t firstTryBitmap, sleepbitmap_t secondTryBitmap);
-    int  tryBondPeers(int maxPeers, sleepbitmap_t peerBitmap, BondedTaskGroup& master);
+    int  tryAcquireSleepingThread(const ThreadBitmap& firstTryBitmap, const ThreadBitmap& secondTryBitmap);
+    int  tryBondPeers(int maxPeers, const ThreadBitmap& peerBitmap, BondedTaskGroup& master);
     static ThreadPool* allocThreadPools(x265_param* p, int& numPools, bool isThreadsReserved);
     static int  getCpuCount();
     static int  getNumaNodeCount();
@@ -0,0 +1,263 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#include "common.h"
+#include "threading.h"
+
+#if _MSC_VER
+#define TRACE_TLS __declspec(thread)
+#else
+#define TRACE_TLS __thread
+#endif
+
+namespace X265_NS {
+// private x265 namespace
+
+namespace {
+
+#define CPU_EVENT(x) #x,
+const char *eventNames[] =
+{
+#include "profile/cpuEvents.h"
+};
+#undef CPU_EVENT
+
+struct TraceRecord
+{
+    int64_t start;
+    int32_t duration;
+    int16_t event;
+    int16_t bAsync;
+    int32_t arg;
+};
+
+struct TraceBuffer
+{
+    TraceRecord* records;
+    uint32_t     count;       // events recorded, the ring keeps the last TRACE_RING_SIZE
+    int          generation;  // trace this buffer belongs to, older buffers are recycled
+    int          tid;
+    char         name[32];
+    TraceBuffer* next;
+};
+
+Lock s_traceLock;
+TraceBuffer*  s_buffers;
+FILE*         s_traceFile;
+char*         s_traceName;
+int           s_traceUsers;
+int           s_nextTid;
+int64_t       s_traceBase;
+volatile int  s_traceGeneration;
+
+TRACE_TLS TraceBuffer* t_buffer;
+TRACE_TLS int          t_generation;
+TRACE_TLS char         t_name[32];
+
+/* The calling thread's buffer for the current trace; a thread which has not
+ * recorded anything in it yet takes over a buffer of an earlier trace or
+ * allocates one */
+TraceBuffer* threadBuffer()
+{
+    if (t_buffer && t_generation == s_traceGeneration)
+        return t_buffer;
+
+    ScopedLock lock(s_traceLock);
+    if (!g_traceActive)
+        return NULL;
+
+    TraceBuffer* buf = s_buffers;
+    while (buf && buf->generation == s_traceGeneration)
+        buf = buf->next;
+    if (!buf)
+    {
+        buf = X265_MALLOC(TraceBuffer, 1);
+        if (!buf)
+            return NULL;
+        buf->records = X265_MALLOC(TraceRecord, TRACE_RING_SIZE);
+        if (!buf->records)
+        {
+            X265_FREE(buf);
+            return NULL;
+        }
+        buf->next = s_buffers;
+        s_buffers = buf;
+    }
+    buf->count = 0;
+    buf->generation = s_traceGeneration;
+    buf->tid = s_nextTid++;
+    if (t_name[0])
+        strcpy(buf->name, t_name);
+    else
+        sprintf(buf->name, "Thread %d", buf->tid);
+
+    t_buffer = buf;
+    t_generation = s_traceGeneration;
+    return buf;
+}
+
+void record(int event, int64_t start, int64_t end, int arg, bool bAsync)
+{
+    if (!g_traceActive)
+        return;
+    TraceBuffer* buf = threadBuffer();
+    if (!buf)
+        return;
+
+    TraceRecord& rec = buf->records[buf->count & (TRACE_RING_SIZE - 1)];
+    rec.start = start;
+    rec.duration = (int32_t)(end - start);
+    rec.event = (int16_t)event;
+    rec.bAsync = bAsync;
+    rec.arg = arg;
+    buf->count++;
+}
+
+void writeTrace(FILE* fp, uint32_t& written, uint32_t& dropped)
+{
+    uint32_t asyncId = 0;
+    bool bFirst = true;
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (TraceBuffer* buf = s_buffers; buf; buf = buf->next)
+    {
+        if (buf->generation != s_traceGeneration)
+            continue;
+
+        fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                bFirst ? "" : ",\n", buf->tid, buf->name);
+        bFirst = false;
+
+        uint32_t num = X265_MIN(buf->count, (uint32_t)TRACE_RING_SIZE);
+        for (uint32_t i = buf->count - num; i != buf->count; i++)
+        {
+            const TraceRecord& rec = buf->records[i & (TRACE_RING_SIZE - 1)];
+            int64_t ts = rec.start - s_traceBase;
+            if (ts < 0)
+                continue;
+            const char* name = eventNames[rec.event];
+            if (rec.bAsync)
+            {
+                fprintf(fp, ",\n{\"name\":\"%s\",\"cat\":\"stall\",\"ph\":\"b\",\"id\":%u,\"pid\":1,\"tid\":%d,\"ts\":" X265_LL ",\"args\":{\"arg\":%d}}",
+                        name, asyncId, buf->tid, ts, rec.arg);
+                fprintf(fp, ",\n{\"name\":\"%s\",\"cat\":\"stall\",\"ph\":\"e\",\"id\":%u,\"pid\":1,\"tid\":%d,\"ts\":" X265_LL "}",
+                        name, asyncId, buf->tid, ts + rec.duration);
+                asyncId++;
+            }
+            else if (rec.arg >= 0)
+                fprintf(fp, ",\n{\"name\":\"%s\",\"cat\":\"x265\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":" X265_LL ",\"dur\":%d,\"args\":{\"arg\":%d}}",
+                        name, buf->tid, ts, rec.duration, rec.arg);
+            else
+                fprintf(fp, ",\n{\"name\":\"%s\",\"cat\":\"x265\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":" X265_LL ",\"dur\":%d}",
+                        name, buf->tid, ts, rec.duration);
+        }
+        written += num;
+        dropped += buf->count - num;
+    }
+    fprintf(fp, "\n]}\n");
+}
+
+}
+
+volatile int g_traceActive;
+
+/* Start recording, or join the trace already being recorded. Every
+ * successful call must be paired with traceStop() */
+bool traceStart(const char* fileName)
+{
+    ScopedLock lock(s_traceLock);
+
+    if (s_traceUsers)
+    {
+        if (strcmp(fileName, s_traceName))
+            x265_log(NULL, X265_LOG_WARNING, "trace: events are already written to %s, %s is ignored\n", s_traceName, fileName);
+        s_traceUsers++;
+        return true;
+    }
+
+    s_traceFile = x265_fopen(fileName, "wb");
+    if (!s_traceFile)
+        return false;
+    s_traceName = strdup(fileName);
+    s_traceUsers = 1;
+    s_nextTid = 1;
+    s_traceBase = x265_mdate();
+    s_traceGeneration++;
+    g_traceActive = 1;
+    return true;
+}
+
+/* The last user to leave writes the trace out */
+void traceStop()
+{
+    ScopedLock lock(s_traceLock);
+
+    if (!s_traceUsers || --s_traceUsers)
+        return;
+
+    g_traceActive = 0;
+
+    uint32_t written = 0, dropped = 0;
+    writeTrace(s_traceFile, written, dropped);
+    fclose(s_traceFile);
+    s_traceFile = NULL;
+
+    x265_log(NULL, X265_LOG_INFO, "trace: %u events written to %s, %u older events overwritten\n", written, s_traceName, dropped);
+
+    free(s_traceName);
+    s_traceName = NULL;
+}
+
+/* Free the per-thread buffers, once no trace is recorded */
+void traceRelease()
+{
+    ScopedLock lock(s_traceLock);
+
+    if (s_traceUsers)
+        return;
+    while (s_buffers)
+    {
+        TraceBuffer* buf = s_buffers;
+        s_buffers = buf->next;
+        X265_FREE(buf->records);
+        X265_FREE(buf);
+    }
+    s_traceGeneration++;
+}
+
+void traceSetThreadName(const char* name, int id)
+{
+    snprintf(t_name, sizeof(t_name), "%s %d", name, id);
+    if (t_buffer && t_generation == s_traceGeneration)
+        strcpy(t_buffer->name, t_name);
+}
+
+void traceEvent(int event, int64_t start, int64_t end, int arg)
+{
+    record(event, start, end, arg, false);
+}
+
+void traceAsyncEvent(int event, int64_t start, int64_t end, int arg)
+{
+    record(event, start, end, arg, true);
+}
+
+}
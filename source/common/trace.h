@@ -0,0 +1,88 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#ifndef X265_TRACE_H
+#define X265_TRACE_H
+
+/* Built-in event tracer, the default backend of ProfileScopeEvent() when
+ * neither PPA nor VTune are enabled. Each thread records the events of the
+ * cpuEvents.h list into its own ring buffer, without locks; the rings are
+ * written out as a Chrome trace (JSON), which Perfetto and chrome://tracing
+ * can open, when the last encoder tracing to the file is closed. PPA and
+ * VTune builds only record the events passed to traceAsyncEvent() */
+
+namespace X265_NS {
+// private x265 namespace
+
+#if !ENABLE_PPA && !ENABLE_VTUNE
+#define CPU_EVENT(x) x,
+enum TraceEventId
+{
+#include "profile/cpuEvents.h"
+    NUM_TRACE_EVENTS
+};
+#undef CPU_EVENT
+#endif
+
+#define TRACE_RING_SIZE (1 << 16) // events kept per thread, older ones are overwritten
+
+extern volatile int g_traceActive;
+
+bool traceStart(const char* fileName);
+void traceStop();
+void traceRelease();
+
+void traceSetThreadName(const char* name, int id);
+
+/* a complete event on the calling thread's track */
+void traceEvent(int event, int64_t start, int64_t end, int arg);
+
+/* an interval which is not bound to the calling thread, such as a wavefront
+ * stall; drawn on a track of its own */
+void traceAsyncEvent(int event, int64_t start, int64_t end, int arg);
+
+#if !ENABLE_PPA && !ENABLE_VTUNE
+struct TraceScopeEvent
+{
+    int64_t m_start;
+    int     m_event;
+    int     m_arg;
+
+    TraceScopeEvent(int e, int arg = -1)
+    {
+        m_event = g_traceActive ? e : -1;
+        if (m_event >= 0)
+        {
+            m_arg = arg;
+            m_start = x265_mdate();
+        }
+    }
+
+    ~TraceScopeEvent()
+    {
+        if (m_event >= 0)
+            traceEvent(m_event, m_start, x265_mdate(), m_arg);
+    }
+};
+#endif
+}
+
+#endif // ifndef X265_TRACE_H
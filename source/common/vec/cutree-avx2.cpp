@@ -0,0 +1,121 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#include "common.h"
+#include "primitives.h"
+#include "slicetype.h"      // LOWRES_COST_SHIFT
+#include <immintrin.h> // AVX2
+
+using namespace X265_NS;
+
+namespace {
+/* (amount * weight + 512) >> 10 in 32-bit lanes, wrapping like the C reference */
+static inline __m256i share8(__m256i amount, __m256i weight)
+{
+    return _mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(amount, weight), _mm256_set1_epi32(512)), 10);
+}
+
+static void propagateList_avx2(int32_t* output, const int32_t* propagateAmount, const MV* mvs, const uint16_t* lowresCosts,
+                               int32_t bipredWeight, int list, int blocky, int len)
+{
+    int32_t* amounts = output;
+    int32_t* cuxs = output + len;
+    int32_t* cuys = output + 2 * len;
+    int32_t* shares = output + 3 * len;
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i three = _mm256_set1_epi32(3);
+    const __m256i mask31 = _mm256_set1_epi32(31);
+    const __m256i thirtyTwo = _mm256_set1_epi32(32);
+    const __m256i weight = _mm256_set1_epi32(bipredWeight);
+    const __m256i row = _mm256_set1_epi32(blocky);
+    const __m128i listShift = _mm_cvtsi32_si128(list);
+    __m256i column = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    int i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        __m256i amount = _mm256_loadu_si256((const __m256i*)(propagateAmount + i));
+        __m256i listsUsed = _mm256_srli_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(lowresCosts + i))), LOWRES_COST_SHIFT);
+
+        /* zero intra blocks and blocks not predicted from this list */
+        __m256i used = _mm256_and_si256(_mm256_srl_epi32(listsUsed, listShift), one);
+        __m256i keep = _mm256_and_si256(_mm256_cmpeq_epi32(used, one), _mm256_cmpgt_epi32(amount, zero));
+        __m256i bipred = _mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(amount, weight), thirtyTwo), 6);
+        amount = _mm256_blendv_epi8(amount, bipred, _mm256_cmpeq_epi32(listsUsed, three));
+        amount = _mm256_and_si256(amount, keep);
+
+        /* MVs are (x, y) pairs of 32-bit words; gather the x and y lanes in block order */
+        __m256i mv0 = _mm256_loadu_si256((const __m256i*)(mvs + i));
+        __m256i mv1 = _mm256_loadu_si256((const __m256i*)(mvs + i + 4));
+        __m256i x = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(mv0), _mm256_castsi256_ps(mv1), _MM_SHUFFLE(2, 0, 2, 0)));
+        __m256i y = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(mv0), _mm256_castsi256_ps(mv1), _MM_SHUFFLE(3, 1, 3, 1)));
+        x = _mm256_permute4x64_epi64(x, _MM_SHUFFLE(3, 1, 2, 0));
+        y = _mm256_permute4x64_epi64(y, _MM_SHUFFLE(3, 1, 2, 0));
+
+        _mm256_storeu_si256((__m256i*)(amounts + i), amount);
+        _mm256_storeu_si256((__m256i*)(cuxs + i), _mm256_add_epi32(_mm256_srai_epi32(x, 5), column));
+        _mm256_storeu_si256((__m256i*)(cuys + i), _mm256_add_epi32(_mm256_srai_epi32(y, 5), row));
+
+        x = _mm256_and_si256(x, mask31);
+        y = _mm256_and_si256(y, mask31);
+        __m256i x0 = _mm256_sub_epi32(thirtyTwo, x);
+        __m256i y0 = _mm256_sub_epi32(thirtyTwo, y);
+
+        _mm256_storeu_si256((__m256i*)(shares + i), share8(amount, _mm256_mullo_epi32(y0, x0)));
+        _mm256_storeu_si256((__m256i*)(shares + i + len), share8(amount, _mm256_mullo_epi32(y0, x)));
+        _mm256_storeu_si256((__m256i*)(shares + i + 2 * len), share8(amount, _mm256_mullo_epi32(y, x0)));
+        _mm256_storeu_si256((__m256i*)(shares + i + 3 * len), share8(amount, _mm256_mullo_epi32(y, x)));
+
+        column = _mm256_add_epi32(column, _mm256_set1_epi32(8));
+    }
+
+    for (; i < len; i++)
+    {
+        int32_t listsUsed = lowresCosts[i] >> LOWRES_COST_SHIFT;
+        int32_t amount = propagateAmount[i];
+        if (amount <= 0 || !((listsUsed >> list) & 1))
+            amount = 0;
+        else if (listsUsed == 3)
+            amount = (amount * bipredWeight + 32) >> 6;
+
+        int32_t x = mvs[i].x;
+        int32_t y = mvs[i].y;
+        amounts[i] = amount;
+        cuxs[i] = (x >> 5) + i;
+        cuys[i] = (y >> 5) + blocky;
+        x &= 31;
+        y &= 31;
+        shares[i] = (amount * (32 - y) * (32 - x) + 512) >> 10;
+        shares[i + len] = (amount * (32 - y) * x + 512) >> 10;
+        shares[i + 2 * len] = (amount * y * (32 - x) + 512) >> 10;
+        shares[i + 3 * len] = (amount * y * x + 512) >> 10;
+    }
+}
+}
+
+namespace X265_NS {
+void setupIntrinsicCutree_avx2(EncoderPrimitives &p)
+{
+    p.propagateList = propagateList_avx2;
+}
+}
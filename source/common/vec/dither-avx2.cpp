@@ -0,0 +1,198 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#include "common.h"
+#include "primitives.h"
+#include <immintrin.h> // AVX2
+
+using namespace X265_NS;
+
+namespace {
+#define DITHER_ROWS 8 // rows of a band, one per 32-bit lane
+
+/* eight samples of a row from column x, zero outside of [0, width) */
+static inline __m128i loadRow(const uint16_t* src, int x, int width)
+{
+    if (x >= 0 && x + 8 <= width)
+        return _mm_loadu_si128((const __m128i*)(src + x));
+
+    ALIGN_VAR_16(uint16_t, tmp[8]);
+    for (int i = 0; i < 8; i++)
+        tmp[i] = (x + i >= 0 && x + i < width) ? src[x + i] : 0;
+    return _mm_load_si128((const __m128i*)tmp);
+}
+
+static inline void storeRow(uint16_t* src, int x, int width, __m128i row, int bitDepth)
+{
+    ALIGN_VAR_16(uint16_t, tmp[8]);
+
+    if (bitDepth == 8)
+    {
+        uint8_t* dst = (uint8_t*)src;
+        if (x >= 0 && x + 8 <= width)
+            _mm_storel_epi64((__m128i*)(dst + x), _mm_packus_epi16(row, row));
+        else
+        {
+            _mm_store_si128((__m128i*)tmp, row);
+            for (int i = X265_MAX(0, -x); i < X265_MIN(8, width - x); i++)
+                dst[x + i] = (uint8_t)tmp[i];
+        }
+    }
+    else
+    {
+        if (x >= 0 && x + 8 <= width)
+            _mm_storeu_si128((__m128i*)(src + x), row);
+        else
+        {
+            _mm_store_si128((__m128i*)tmp, row);
+            for (int i = X265_MAX(0, -x); i < X265_MIN(8, width - x); i++)
+                src[x + i] = tmp[i];
+        }
+    }
+}
+
+static inline void transpose8x8(__m128i* m)
+{
+    __m128i a0 = _mm_unpacklo_epi16(m[0], m[1]);
+    __m128i a1 = _mm_unpackhi_epi16(m[0], m[1]);
+    __m128i a2 = _mm_unpacklo_epi16(m[2], m[3]);
+    __m128i a3 = _mm_unpackhi_epi16(m[2], m[3]);
+    __m128i a4 = _mm_unpacklo_epi16(m[4], m[5]);
+    __m128i a5 = _mm_unpackhi_epi16(m[4], m[5]);
+    __m128i a6 = _mm_unpacklo_epi16(m[6], m[7]);
+    __m128i a7 = _mm_unpackhi_epi16(m[6], m[7]);
+
+    __m128i b0 = _mm_unpacklo_epi32(a0, a2);
+    __m128i b1 = _mm_unpackhi_epi32(a0, a2);
+    __m128i b2 = _mm_unpacklo_epi32(a1, a3);
+    __m128i b3 = _mm_unpackhi_epi32(a1, a3);
+    __m128i b4 = _mm_unpacklo_epi32(a4, a6);
+    __m128i b5 = _mm_unpackhi_epi32(a4, a6);
+    __m128i b6 = _mm_unpacklo_epi32(a5, a7);
+    __m128i b7 = _mm_unpackhi_epi32(a5, a7);
+
+    m[0] = _mm_unpacklo_epi64(b0, b4);
+    m[1] = _mm_unpackhi_epi64(b0, b4);
+    m[2] = _mm_unpacklo_epi64(b1, b5);
+    m[3] = _mm_unpackhi_epi64(b1, b5);
+    m[4] = _mm_unpacklo_epi64(b2, b6);
+    m[5] = _mm_unpackhi_epi64(b2, b6);
+    m[6] = _mm_unpacklo_epi64(b3, b7);
+    m[7] = _mm_unpackhi_epi64(b3, b7);
+}
+
+/* Rows are dithered in bands of eight, as a wavefront: at step k the lane of
+ * band row r handles column k - 2r, whose inputs are the error of its left
+ * neighbour (step k - 1 of the lane) and the errors of columns k - 2r and
+ * k - 2r + 1 of the row above (steps k - 2 and k - 1 of the lane below; for
+ * the first row of the band, the errors[] left by the previous band). Eight
+ * steps at a time, the skewed rows are loaded and stored as 8x8 transposes */
+static void ditherPlane_avx2(uint16_t* src, intptr_t srcStride, int width, int height, int16_t* errors, int bitDepth)
+{
+    ALIGN_VAR_32(int32_t, errTile[8][DITHER_ROWS]);
+    ALIGN_VAR_32(int32_t, top[16]);
+    __m128i m[8];
+
+    const int lShift = 16 - bitDepth;
+    const int rShift = 16 - bitDepth + 2;
+
+    const __m256i half = _mm256_set1_epi32(1 << (16 - bitDepth + 1));
+    const __m256i pixelMax = _mm256_set1_epi32((1 << bitDepth) - 1);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i up = _mm256_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6);
+    const __m256i laneCol = _mm256_setr_epi32(0, -2, -4, -6, -8, -10, -12, -14);
+    const __m256i lastCol = _mm256_set1_epi32(width - 1);
+    const __m256i one = _mm256_set1_epi32(1);
+
+    memset(errors, 0, (width + 1) * sizeof(int16_t));
+
+    for (int y = 0; y < height; y += DITHER_ROWS, src += DITHER_ROWS * srcStride)
+    {
+        const int rows = X265_MIN(DITHER_ROWS, height - y);
+        const int last = rows - 1;
+        const int steps = width + 2 * last;
+        const __m256i laneValid = _mm256_cmpgt_epi32(_mm256_set1_epi32(rows), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+        __m256i prev1 = zero, prev2 = zero;
+        for (int k0 = 0; k0 < steps; k0 += 8)
+        {
+            for (int r = 0; r < DITHER_ROWS; r++)
+                m[r] = r < rows ? loadRow(src + r * srcStride, k0 - 2 * r, width) : _mm_setzero_si128();
+            transpose8x8(m);
+
+            /* errors of the previous band, for the first row */
+            if (k0 + 8 <= width)
+            {
+                _mm256_store_si256((__m256i*)top, _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(errors + k0))));
+                top[8] = errors[k0 + 8];
+            }
+            else
+            {
+                for (int i = 0; i <= 8; i++)
+                    top[i] = k0 + i <= width ? errors[k0 + i] : 0;
+            }
+
+            __m256i col = _mm256_add_epi32(_mm256_set1_epi32(k0), laneCol);
+            for (int i = 0; i < 8; i++)
+            {
+                __m256i s = _mm256_cvtepu16_epi32(m[i]);
+                __m256i s4 = _mm256_add_epi32(_mm256_slli_epi32(s, 2), half);
+
+                /* errors of the row above at columns x and x + 1 */
+                __m256i above0 = _mm256_blend_epi32(_mm256_permutevar8x32_epi32(prev2, up), _mm256_set1_epi32(top[i]), 1);
+                __m256i above1 = _mm256_blend_epi32(_mm256_permutevar8x32_epi32(prev1, up), _mm256_set1_epi32(top[i + 1]), 1);
+
+                __m256i err = _mm256_add_epi32(_mm256_add_epi32(prev1, prev1), _mm256_add_epi32(above0, above1));
+                err = _mm256_srai_epi32(_mm256_slli_epi32(err, 16), 16);
+
+                __m256i d = _mm256_srai_epi32(_mm256_add_epi32(s4, err), rShift);
+                d = _mm256_min_epi32(_mm256_max_epi32(d, zero), pixelMax);
+
+                /* lanes outside the plane carry no error; the error of an
+                 * output, clipped or not, always fits 16 bits */
+                __m256i active = _mm256_andnot_si256(_mm256_or_si256(_mm256_cmpgt_epi32(zero, col), _mm256_cmpgt_epi32(col, lastCol)), laneValid);
+                err = _mm256_and_si256(_mm256_sub_epi32(s, _mm256_slli_epi32(d, lShift)), active);
+
+                m[i] = _mm_packus_epi32(_mm256_castsi256_si128(d), _mm256_extracti128_si256(d, 1));
+                _mm256_store_si256((__m256i*)errTile[i], err);
+
+                prev2 = prev1;
+                prev1 = err;
+                col = _mm256_add_epi32(col, one);
+            }
+
+            transpose8x8(m);
+            for (int r = 0; r < rows; r++)
+                storeRow(src + r * srcStride, k0 - 2 * r, width, m[r], bitDepth);
+
+            for (int i = X265_MAX(0, 2 * last - k0); i < X265_MIN(8, steps - k0); i++)
+                errors[k0 + i - 2 * last] = (int16_t)errTile[i][last];
+        }
+    }
+}
+}
+
+namespace X265_NS {
+void setupIntrinsicDither_avx2(EncoderPrimitives &p)
+{
+    p.ditherPlane = ditherPlane_avx2;
+}
+}
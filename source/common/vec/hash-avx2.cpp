@@ -0,0 +1,138 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#include "common.h"
+#include "primitives.h"
+#include "constants.h"      // g_crcTable
+#include <immintrin.h> // AVX2, PCLMULQDQ
+
+using namespace X265_NS;
+
+namespace {
+static inline uint32_t crcBytes(uint32_t crc, const uint8_t* buf, intptr_t len)
+{
+    for (intptr_t i = 0; i < len; i++)
+        crc = ((crc << 8) & 0xffff) ^ g_crcTable[(crc >> 8) ^ buf[i]];
+
+    return crc;
+}
+
+/* The message is folded 16 bytes at a time with carry-less multiplies: with
+ * F = Fh * x^64 + Fl the leading 128 bits, F * x^128 is congruent to
+ * Fh * (x^192 mod P) + Fl * (x^128 mod P) modulo the CRC polynomial P, an 80
+ * bit value which is added to the next 16 bytes. The last 16 folded bytes and
+ * the tail are then run through the table. Every CPU with AVX2 has PCLMULQDQ */
+static uint32_t pictureCRC_avx2(uint32_t crc, const uint8_t* buf, intptr_t len)
+{
+    if (len >= 32)
+    {
+        const __m128i reverse = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+        const __m128i k = _mm_set_epi64x(0x650b, 0xaefc); // x^192, x^128 mod P
+
+        /* the running CRC is added to the first 16 bits of the message */
+        __m128i f = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)buf), reverse);
+        f = _mm_xor_si128(f, _mm_slli_si128(_mm_cvtsi32_si128((int)crc), 14));
+        buf += 16;
+        len -= 16;
+
+        for (; len >= 16; buf += 16, len -= 16)
+        {
+            __m128i next = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)buf), reverse);
+            f = _mm_xor_si128(_mm_clmulepi64_si128(f, k, 0x11), _mm_clmulepi64_si128(f, k, 0x00));
+            f = _mm_xor_si128(f, next);
+        }
+
+        ALIGN_VAR_16(uint8_t, folded[16]);
+        _mm_store_si128((__m128i*)folded, _mm_shuffle_epi8(f, reverse));
+        crc = crcBytes(0, folded, 16);
+    }
+
+    return crcBytes(crc, buf, len);
+}
+
+/* The masks of consecutive samples are their column numbers XORed with a value
+ * which is constant within each run of 256 columns */
+static uint32_t pictureChecksum_avx2(const pixel* src, int width, int y)
+{
+    const uint32_t rowMask = (y & 0xff) ^ (y >> 8);
+    int x = 0;
+
+#if HIGH_BIT_DEPTH
+    const __m256i lanes = _mm256_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m256i lowByte = _mm256_set1_epi16(0xff);
+    const __m256i one = _mm256_set1_epi16(1);
+    __m256i acc = _mm256_setzero_si256();
+
+    for (; x + 16 <= width; x += 16)
+    {
+        __m256i mask = _mm256_add_epi16(lanes, _mm256_set1_epi16((int16_t)(x & 0xff)));
+        mask = _mm256_xor_si256(mask, _mm256_set1_epi16((uint8_t)((x >> 8) ^ rowMask)));
+
+        __m256i p = _mm256_loadu_si256((const __m256i*)(src + x));
+        __m256i terms = _mm256_add_epi16(_mm256_xor_si256(_mm256_and_si256(p, lowByte), mask),
+                                         _mm256_xor_si256(_mm256_srli_epi16(p, 8), mask));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(terms, one));
+    }
+
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    uint32_t checksum = (uint32_t)_mm_cvtsi128_si32(sum);
+#else
+    const __m256i lanes = _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+                                           16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = zero;
+
+    for (; x + 32 <= width; x += 32)
+    {
+        __m256i mask = _mm256_add_epi8(lanes, _mm256_set1_epi8((char)(x & 0xff)));
+        mask = _mm256_xor_si256(mask, _mm256_set1_epi8((char)((x >> 8) ^ rowMask)));
+
+        __m256i p = _mm256_loadu_si256((const __m256i*)(src + x));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_xor_si256(p, mask), zero));
+    }
+
+    __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    sum = _mm_add_epi64(sum, _mm_unpackhi_epi64(sum, sum));
+    uint32_t checksum = (uint32_t)_mm_cvtsi128_si32(sum);
+#endif
+
+    for (; x < width; x++)
+    {
+        uint32_t mask = (uint8_t)((x & 0xff) ^ (x >> 8) ^ rowMask);
+        checksum += (src[x] & 0xff) ^ mask;
+#if HIGH_BIT_DEPTH
+        checksum += (src[x] >> 8) ^ mask;
+#endif
+    }
+
+    return checksum;
+}
+}
+
+namespace X265_NS {
+void setupIntrinsicHash_avx2(EncoderPrimitives &p)
+{
+    p.pictureCRC = pictureCRC_avx2;
+    p.pictureChecksum = pictureChecksum_avx2;
+}
+}
@@ -0,0 +1,82 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#include "common.h"
+#include "primitives.h"
+#include <immintrin.h> // AVX2
+
+using namespace X265_NS;
+
+namespace {
+static inline uint8_t* escapeBytes(uint8_t* dst, const uint8_t* src, const uint8_t* end)
+{
+    while (src < end)
+    {
+        if (*src <= 0x03 && !dst[-2] && !dst[-1])
+            *dst++ = 0x03;
+        *dst++ = *src++;
+    }
+
+    return dst;
+}
+
+/* Runs of 32 bytes with no byte of value 3 or less after two zero bytes are
+ * stored as they are; the other runs are escaped byte by byte. The source bytes
+ * preceding a run stand in for the output ones: where they differ the output
+ * byte is an inserted 0x03, so the test can only err on the side of escaping */
+static uint8_t* nalEscape_avx2(uint8_t* dst, const uint8_t* src, const uint8_t* end)
+{
+    const uint8_t* head = X265_MIN(src + 2, end);
+    dst = escapeBytes(dst, src, head);
+    src = head;
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i three = _mm256_set1_epi8(3);
+
+    while (end - src >= 32)
+    {
+        __m256i prev2 = _mm256_loadu_si256((const __m256i*)(src - 2));
+        __m256i prev1 = _mm256_loadu_si256((const __m256i*)(src - 1));
+        __m256i cur = _mm256_loadu_si256((const __m256i*)src);
+
+        __m256i hit = _mm256_and_si256(_mm256_cmpeq_epi8(prev2, zero), _mm256_cmpeq_epi8(prev1, zero));
+        hit = _mm256_and_si256(hit, _mm256_cmpeq_epi8(_mm256_min_epu8(cur, three), cur));
+
+        if (_mm256_testz_si256(hit, hit))
+        {
+            _mm256_storeu_si256((__m256i*)dst, cur);
+            dst += 32;
+        }
+        else
+            dst = escapeBytes(dst, src, src + 32);
+        src += 32;
+    }
+
+    return escapeBytes(dst, src, end);
+}
+}
+
+namespace X265_NS {
+void setupIntrinsicNal_avx2(EncoderPrimitives &p)
+{
+    p.nalEscape = nalEscape_avx2;
+}
+}
@@ -0,0 +1,165 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#include "common.h"
+#include "primitives.h"
+#include <immintrin.h> // AVX2
+
+using namespace X265_NS;
+
+namespace {
+/* eight samples widened to 16 bits, or four (upper half zeroed) when wide is false */
+static inline __m128i loadSamples(const pixel* src, bool wide)
+{
+#if HIGH_BIT_DEPTH
+    return wide ? _mm_loadu_si128((const __m128i*)src) : _mm_loadl_epi64((const __m128i*)src);
+#else
+    if (wide)
+        return _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)src));
+    int32_t four;
+    memcpy(&four, src, sizeof(four));
+    return _mm_cvtepu8_epi16(_mm_cvtsi32_si128(four));
+#endif
+}
+
+static inline __m128i loadCoeffs(const int16_t* filter, bool wide)
+{
+    return wide ? _mm_loadu_si128((const __m128i*)filter) : _mm_loadl_epi64((const __m128i*)filter);
+}
+
+/* partial dot products of two outputs (one per 128-bit lane) over one chunk of
+ * taps starting at tap j */
+static inline __m256i dot2(const pixel* src, const int16_t* filter, const int32_t* filterPos, int i, int j, int filterSize,
+                           bool wide, __m256i mask)
+{
+    __m256i s = _mm256_inserti128_si256(_mm256_castsi128_si256(loadSamples(src + filterPos[i] + j, wide)),
+                                        loadSamples(src + filterPos[i + 1] + j, wide), 1);
+    __m256i c = _mm256_inserti128_si256(_mm256_castsi128_si256(loadCoeffs(filter + filterSize * i + j, wide)),
+                                        loadCoeffs(filter + filterSize * (i + 1) + j, wide), 1);
+    return _mm256_madd_epi16(s, _mm256_and_si256(c, mask));
+}
+
+/* Eight outputs per iteration, two per register. The taps are consumed in
+ * chunks of eight (four for short filters); the last chunk is aligned to the
+ * end of the filter and masks the taps it shares with the previous chunk, so
+ * no sample or coefficient outside the filter support is read */
+static void scalerHFilter_avx2(int16_t* dst, int dstW, const pixel* src, const int16_t* filter, const int32_t* filterPos, int filterSize)
+{
+    int i = 0;
+
+    if (filterSize >= 4)
+    {
+        const bool wide = filterSize >= 8;
+        const int chunk = wide ? 8 : 4;
+        const int last = filterSize - chunk;
+        const int overlap = chunk - (filterSize % chunk ? filterSize % chunk : chunk);
+        const __m256i all = _mm256_set1_epi32(-1);
+        const __m256i lanes = _mm256_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7, 0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256i tailMask = _mm256_cmpgt_epi16(lanes, _mm256_set1_epi16((int16_t)(overlap - 1)));
+        const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+        for (; i + 8 <= dstW; i += 8)
+        {
+            __m256i acc[4];
+            for (int k = 0; k < 4; k++)
+            {
+                acc[k] = _mm256_setzero_si256();
+                int j = 0;
+                for (; j < last; j += chunk)
+                    acc[k] = _mm256_add_epi32(acc[k], dot2(src, filter, filterPos, i + 2 * k, j, filterSize, wide, all));
+                acc[k] = _mm256_add_epi32(acc[k], dot2(src, filter, filterPos, i + 2 * k, last, filterSize, wide, j == last ? all : tailMask));
+            }
+
+            /* lane sums in the order 0 2 4 6 | 1 3 5 7, then restore the output order */
+            __m256i sum = _mm256_hadd_epi32(_mm256_hadd_epi32(acc[0], acc[1]), _mm256_hadd_epi32(acc[2], acc[3]));
+            sum = _mm256_srai_epi32(_mm256_permutevar8x32_epi32(sum, order), SCALER_H_SHIFT);
+            _mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1)));
+        }
+    }
+
+    for (; i < dstW; i++)
+    {
+        int val = 0;
+        const pixel* s = src + filterPos[i];
+        for (int j = 0; j < filterSize; j++)
+            val += (int)s[j] * filter[filterSize * i + j];
+        dst[i] = (int16_t)x265_clip3(-(1 << 15), (1 << 15) - 1, val >> SCALER_H_SHIFT);
+    }
+}
+
+/* Sixteen outputs per iteration. Rows are taken in pairs, interleaved so each
+ * madd applies two taps; an odd last row is paired with a zero coefficient */
+static void scalerVFilter_avx2(const int16_t* filter, int filterSize, const int16_t** src, pixel* dst, int dstW)
+{
+    const __m256i round = _mm256_set1_epi32(1 << (SCALER_V_SHIFT - 1));
+    int i = 0;
+
+    for (; i + 16 <= dstW; i += 16)
+    {
+        __m256i lo = round;
+        __m256i hi = round;
+        for (int j = 0; j < filterSize; j += 2)
+        {
+            __m256i a = _mm256_loadu_si256((const __m256i*)(src[j] + i));
+            __m256i b, c;
+            if (j + 1 < filterSize)
+            {
+                b = _mm256_loadu_si256((const __m256i*)(src[j + 1] + i));
+                c = _mm256_set1_epi32((int32_t)(uint16_t)filter[j] | ((int32_t)filter[j + 1] << 16));
+            }
+            else
+            {
+                b = _mm256_setzero_si256();
+                c = _mm256_set1_epi32((uint16_t)filter[j]);
+            }
+            lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), c));
+            hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), c));
+        }
+        lo = _mm256_srai_epi32(lo, SCALER_V_SHIFT);
+        hi = _mm256_srai_epi32(hi, SCALER_V_SHIFT);
+
+#if HIGH_BIT_DEPTH
+        __m256i out = _mm256_min_epu16(_mm256_packus_epi32(lo, hi), _mm256_set1_epi16(SCALER_PIXEL_MAX));
+        _mm256_storeu_si256((__m256i*)(dst + i), out);
+#else
+        __m256i out = _mm256_packs_epi32(lo, hi);
+        out = _mm256_permute4x64_epi64(_mm256_packus_epi16(out, out), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm256_castsi256_si128(out));
+#endif
+    }
+
+    for (; i < dstW; i++)
+    {
+        int val = 1 << (SCALER_V_SHIFT - 1);
+        for (int j = 0; j < filterSize; j++)
+            val += src[j][i] * filter[j];
+        dst[i] = (pixel)x265_clip3(0, SCALER_PIXEL_MAX, val >> SCALER_V_SHIFT);
+    }
+}
+}
+
+namespace X265_NS {
+void setupIntrinsicScaler_avx2(EncoderPrimitives &p)
+{
+    p.scalerHFilter = scalerHFilter_avx2;
+    p.scalerVFilter = scalerVFilter_avx2;
+}
+}
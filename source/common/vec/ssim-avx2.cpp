@@ -0,0 +1,220 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#include "common.h"
+#include "primitives.h"
+#include <immintrin.h> // AVX2
+
+using namespace X265_NS;
+
+namespace {
+#if HIGH_BIT_DEPTH
+static inline __m256i load16(const pixel* src)
+{
+    return _mm256_loadu_si256((const __m256i*)src);
+}
+
+static const float ssim_c1 = (float)(.01 * .01 * PIXEL_MAX * PIXEL_MAX * 64);
+static const float ssim_c2 = (float)(.03 * .03 * PIXEL_MAX * PIXEL_MAX * 64 * 63);
+#else
+static inline __m256i load16(const pixel* src)
+{
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)src));
+}
+
+static const int ssim_c1 = (int)(.01 * .01 * PIXEL_MAX * PIXEL_MAX * 64 + .5);
+static const int ssim_c2 = (int)(.03 * .03 * PIXEL_MAX * PIXEL_MAX * 64 * 63 + .5);
+#endif
+
+static void ssimBlock(const pixel* pix1, intptr_t stride1, const pixel* pix2, intptr_t stride2, int sums[4])
+{
+    uint32_t s1 = 0, s2 = 0, ss = 0, s12 = 0;
+
+    for (int y = 0; y < 4; y++)
+    {
+        for (int x = 0; x < 4; x++)
+        {
+            int a = pix1[x + y * stride1];
+            int b = pix2[x + y * stride2];
+            s1 += a;
+            s2 += b;
+            ss += a * a + b * b;
+            s12 += a * b;
+        }
+    }
+
+    sums[0] = s1;
+    sums[1] = s2;
+    sums[2] = ss;
+    sums[3] = s12;
+}
+
+/* Four blocks per iteration. The row sums of the samples are kept in 16 bits
+ * and the products are summed in pairs by madd, then hadd completes the sums
+ * of each block (two per 128-bit lane) */
+static void ssimRowSums_avx2(const pixel* pix1, intptr_t stride1, const pixel* pix2, intptr_t stride2, int sums[][4], int width)
+{
+    const __m256i one = _mm256_set1_epi16(1);
+    int x = 0;
+
+    for (; x + 4 <= width; x += 4)
+    {
+        __m256i s1 = _mm256_setzero_si256();
+        __m256i s2 = _mm256_setzero_si256();
+        __m256i ss = _mm256_setzero_si256();
+        __m256i s12 = _mm256_setzero_si256();
+
+        for (int y = 0; y < 4; y++)
+        {
+            __m256i a = load16(pix1 + 4 * x + y * stride1);
+            __m256i b = load16(pix2 + 4 * x + y * stride2);
+            s1 = _mm256_add_epi16(s1, a);
+            s2 = _mm256_add_epi16(s2, b);
+            ss = _mm256_add_epi32(ss, _mm256_add_epi32(_mm256_madd_epi16(a, a), _mm256_madd_epi16(b, b)));
+            s12 = _mm256_add_epi32(s12, _mm256_madd_epi16(a, b));
+        }
+
+        /* per lane: s1 s2 of blocks n, n + 1 and ss s12 of blocks n, n + 1 */
+        __m256i x1 = _mm256_hadd_epi32(_mm256_madd_epi16(s1, one), _mm256_madd_epi16(s2, one));
+        __m256i x2 = _mm256_hadd_epi32(ss, s12);
+        x1 = _mm256_shuffle_epi32(x1, _MM_SHUFFLE(3, 1, 2, 0));
+        x2 = _mm256_shuffle_epi32(x2, _MM_SHUFFLE(3, 1, 2, 0));
+
+        __m256i even = _mm256_unpacklo_epi64(x1, x2); // blocks 0 | 2
+        __m256i odd = _mm256_unpackhi_epi64(x1, x2);  // blocks 1 | 3
+        _mm256_storeu_si256((__m256i*)sums[x], _mm256_permute2x128_si256(even, odd, 0x20));
+        _mm256_storeu_si256((__m256i*)sums[x + 2], _mm256_permute2x128_si256(even, odd, 0x31));
+    }
+
+    /* the C reference works in pairs, so an odd width also fills block width */
+    for (; x < width; x++)
+        ssimBlock(pix1 + 4 * x, stride1, pix2 + 4 * x, stride2, sums[x]);
+    if (width & 1)
+        ssimBlock(pix1 + 4 * x, stride1, pix2 + 4 * x, stride2, sums[x]);
+}
+
+/* the sums of window x, as ssim_end_4 */
+static inline __m256i windowSums(int sum0[][4], int sum1[][4], int x)
+{
+    __m256i a = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)sum0[x]), _mm256_loadu_si256((const __m256i*)sum1[x]));
+    __m256i b = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)sum0[x + 1]), _mm256_loadu_si256((const __m256i*)sum1[x + 1]));
+    return _mm256_add_epi32(a, b);
+}
+
+static float ssimWindow(int s1, int s2, int ss, int s12)
+{
+#if HIGH_BIT_DEPTH
+#define type float
+#else
+#define type int
+#endif
+    type fs1 = (type)s1;
+    type fs2 = (type)s2;
+    type fss = (type)ss;
+    type fs12 = (type)s12;
+    type vars = (type)(fss * 64 - fs1 * fs1 - fs2 * fs2);
+    type covar = (type)(fs12 * 64 - fs1 * fs2);
+    return (float)(2 * fs1 * fs2 + ssim_c1) * (float)(2 * covar + ssim_c2)
+           / ((float)(fs1 * fs1 + fs2 * fs2 + ssim_c1) * (float)(vars + ssim_c2));
+#undef type
+}
+
+/* Eight windows per iteration, with the arithmetic of ssim_end_1 in each lane
+ * (integer in 8-bit builds, float otherwise) so every window has the value of
+ * the C reference; only the order of the final sum differs */
+static float ssimRowEnd_avx2(int sum0[][4], int sum1[][4], int width)
+{
+    __m256 acc = _mm256_setzero_ps();
+    int x = 0;
+
+    for (; x + 8 <= width; x += 8)
+    {
+        /* windows x + 2k | x + 2k + 1, transposed to one component per register */
+        __m256i w0 = windowSums(sum0, sum1, x);
+        __m256i w1 = windowSums(sum0, sum1, x + 2);
+        __m256i w2 = windowSums(sum0, sum1, x + 4);
+        __m256i w3 = windowSums(sum0, sum1, x + 6);
+        __m256i t0 = _mm256_unpacklo_epi32(w0, w1);
+        __m256i t1 = _mm256_unpackhi_epi32(w0, w1);
+        __m256i t2 = _mm256_unpacklo_epi32(w2, w3);
+        __m256i t3 = _mm256_unpackhi_epi32(w2, w3);
+        __m256i s1 = _mm256_unpacklo_epi64(t0, t2);
+        __m256i s2 = _mm256_unpackhi_epi64(t0, t2);
+        __m256i ss = _mm256_unpacklo_epi64(t1, t3);
+        __m256i s12 = _mm256_unpackhi_epi64(t1, t3);
+
+#if HIGH_BIT_DEPTH
+        const __m256 c1 = _mm256_set1_ps(ssim_c1);
+        const __m256 c2 = _mm256_set1_ps(ssim_c2);
+        const __m256 two = _mm256_set1_ps(2.0f);
+        const __m256 sixtyFour = _mm256_set1_ps(64.0f);
+        __m256 fs1 = _mm256_cvtepi32_ps(s1);
+        __m256 fs2 = _mm256_cvtepi32_ps(s2);
+        __m256 fss = _mm256_cvtepi32_ps(ss);
+        __m256 fs12 = _mm256_cvtepi32_ps(s12);
+        __m256 s1s1 = _mm256_mul_ps(fs1, fs1);
+        __m256 s2s2 = _mm256_mul_ps(fs2, fs2);
+        __m256 vars = _mm256_sub_ps(_mm256_sub_ps(_mm256_mul_ps(fss, sixtyFour), s1s1), s2s2);
+        __m256 covar = _mm256_sub_ps(_mm256_mul_ps(fs12, sixtyFour), _mm256_mul_ps(fs1, fs2));
+        __m256 num1 = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(two, fs1), fs2), c1);
+        __m256 num2 = _mm256_add_ps(_mm256_mul_ps(two, covar), c2);
+        __m256 den1 = _mm256_add_ps(_mm256_add_ps(s1s1, s2s2), c1);
+        __m256 den2 = _mm256_add_ps(vars, c2);
+#else
+        const __m256i c1 = _mm256_set1_epi32(ssim_c1);
+        const __m256i c2 = _mm256_set1_epi32(ssim_c2);
+        __m256i s1s2 = _mm256_mullo_epi32(s1, s2);
+        __m256i s1s1 = _mm256_mullo_epi32(s1, s1);
+        __m256i s2s2 = _mm256_mullo_epi32(s2, s2);
+        __m256i vars = _mm256_sub_epi32(_mm256_sub_epi32(_mm256_slli_epi32(ss, 6), s1s1), s2s2);
+        __m256i covar = _mm256_sub_epi32(_mm256_slli_epi32(s12, 6), s1s2);
+        __m256 num1 = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_slli_epi32(s1s2, 1), c1));
+        __m256 num2 = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_slli_epi32(covar, 1), c2));
+        __m256 den1 = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_add_epi32(s1s1, s2s2), c1));
+        __m256 den2 = _mm256_cvtepi32_ps(_mm256_add_epi32(vars, c2));
+#endif
+        acc = _mm256_add_ps(acc, _mm256_div_ps(_mm256_mul_ps(num1, num2), _mm256_mul_ps(den1, den2)));
+    }
+
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    float ssim = _mm_cvtss_f32(sum);
+
+    for (; x < width; x++)
+    {
+        ssim += ssimWindow(sum0[x][0] + sum0[x + 1][0] + sum1[x][0] + sum1[x + 1][0],
+                           sum0[x][1] + sum0[x + 1][1] + sum1[x][1] + sum1[x + 1][1],
+                           sum0[x][2] + sum0[x + 1][2] + sum1[x][2] + sum1[x + 1][2],
+                           sum0[x][3] + sum0[x + 1][3] + sum1[x][3] + sum1[x + 1][3]);
+    }
+
+    return ssim;
+}
+}
+
+namespace X265_NS {
+void setupIntrinsicSsim_avx2(EncoderPrimitives &p)
+{
+    p.ssimRowSums = ssimRowSums_avx2;
+    p.ssimRowEnd = ssimRowEnd_avx2;
+}
+}
@@ -0,0 +1,187 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#include "common.h"
+#include "primitives.h"
+#include <immintrin.h> // AVX2
+
+using namespace X265_NS;
+
+namespace {
+static inline __m128i load4(const pixel* src)
+{
+#if HIGH_BIT_DEPTH
+    return _mm_loadl_epi64((const __m128i*)src);
+#else
+    return _mm_cvtsi32_si128(*(const int32_t*)src);
+#endif
+}
+
+/* eight samples; either one row of eight or four from each of two rows */
+static inline __m256i load8(const pixel* src)
+{
+#if HIGH_BIT_DEPTH
+    return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)src));
+#else
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)src));
+#endif
+}
+
+static inline __m256i load4x2(const pixel* src0, const pixel* src1)
+{
+#if HIGH_BIT_DEPTH
+    return _mm256_cvtepu16_epi32(_mm_unpacklo_epi64(load4(src0), load4(src1)));
+#else
+    return _mm256_cvtepu8_epi32(_mm_unpacklo_epi32(load4(src0), load4(src1)));
+#endif
+}
+
+static inline __m128i pack8(__m256i val)
+{
+    __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(val), _mm256_extracti128_si256(val, 1));
+#if HIGH_BIT_DEPTH
+    return words;
+#else
+    return _mm_packus_epi16(words, words);
+#endif
+}
+
+static inline void store8(pixel* dst, __m256i val)
+{
+#if HIGH_BIT_DEPTH
+    _mm_storeu_si128((__m128i*)dst, pack8(val));
+#else
+    _mm_storel_epi64((__m128i*)dst, pack8(val));
+#endif
+}
+
+static inline void store4x2(pixel* dst0, pixel* dst1, __m256i val)
+{
+    __m128i packed = pack8(val);
+#if HIGH_BIT_DEPTH
+    _mm_storel_epi64((__m128i*)dst0, packed);
+    _mm_storel_epi64((__m128i*)dst1, _mm_unpackhi_epi64(packed, packed));
+#else
+    *(int32_t*)dst0 = _mm_cvtsi128_si32(packed);
+    *(int32_t*)dst1 = _mm_extract_epi32(packed, 1);
+#endif
+}
+
+/* (num + den / 2) / den for positive 32-bit lanes, see the SSE4 version */
+static inline __m256i divRound(__m256i num, __m256i den)
+{
+    __m256i val = _mm256_add_epi32(num, _mm256_srai_epi32(den, 1));
+    __m256i quo = _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(val), _mm256_cvtepi32_ps(den)));
+    __m256i rem = _mm256_sub_epi32(val, _mm256_mullo_epi32(quo, den));
+    __m256i neg = _mm256_srai_epi32(rem, 31);
+    quo = _mm256_add_epi32(quo, neg);
+    rem = _mm256_add_epi32(rem, _mm256_and_si256(neg, den));
+    return _mm256_sub_epi32(quo, _mm256_cmpgt_epi32(rem, _mm256_sub_epi32(den, _mm256_set1_epi32(1))));
+}
+
+/* Filter eight samples. refs[i] + offset0 addresses the reference samples
+ * co-located with the first four lanes, refs[i] + offset1 the last four */
+static inline __m256i filter8(__m256i org, const pixel* const* refs, intptr_t offset0, intptr_t offset1, bool bSingleRow,
+                              const int32_t* refWeights, const uint16_t* const* weightLuts, int numRefs)
+{
+    const __m256i round = _mm256_set1_epi32(1 << (MCSTF_WEIGHT_SHIFT - 1));
+    const __m256i mask = _mm256_set1_epi32(0xffff);
+    __m256i num = _mm256_slli_epi32(org, MCSTF_WEIGHT_SHIFT);
+    __m256i den = _mm256_set1_epi32(1 << MCSTF_WEIGHT_SHIFT);
+
+    for (int i = 0; i < numRefs; i++)
+    {
+        __m256i ref = bSingleRow ? load8(refs[i] + offset0) : load4x2(refs[i] + offset0, refs[i] + offset1);
+        __m256i diff = _mm256_abs_epi32(_mm256_sub_epi32(ref, org));
+        __m256i weight = _mm256_and_si256(_mm256_i32gather_epi32((const int*)weightLuts[i], diff, 2), mask);
+        weight = _mm256_mullo_epi32(weight, _mm256_set1_epi32(refWeights[i]));
+        weight = _mm256_srai_epi32(_mm256_add_epi32(weight, round), MCSTF_WEIGHT_SHIFT);
+        num = _mm256_add_epi32(num, _mm256_mullo_epi32(weight, ref));
+        den = _mm256_add_epi32(den, weight);
+    }
+
+    return divRound(num, den);
+}
+
+static inline void filterRow_c(pixel* src, intptr_t srcStride, const pixel* const* refs, intptr_t refStride,
+                               const int32_t* refWeights, const uint16_t* const* weightLuts, int numRefs, int y, int xStart, int xEnd)
+{
+    for (int x = xStart; x < xEnd; x++)
+    {
+        int orgVal = src[y * srcStride + x];
+        int num = orgVal << MCSTF_WEIGHT_SHIFT;
+        int den = 1 << MCSTF_WEIGHT_SHIFT;
+
+        for (int i = 0; i < numRefs; i++)
+        {
+            int refVal = refs[i][y * refStride + x];
+            int weight = (refWeights[i] * weightLuts[i][abs(refVal - orgVal)] + (1 << (MCSTF_WEIGHT_SHIFT - 1))) >> MCSTF_WEIGHT_SHIFT;
+            num += weight * refVal;
+            den += weight;
+        }
+
+        src[y * srcStride + x] = (pixel)((num + (den >> 1)) / den);
+    }
+}
+
+static void mcstfBilateral_avx2(pixel* src, intptr_t srcStride, const pixel* const* refs, intptr_t refStride,
+                                const int32_t* refWeights, const uint16_t* const* weightLuts, int numRefs, int width, int height)
+{
+    int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        for (int y = 0; y < height; y++)
+        {
+            __m256i org = load8(src + y * srcStride + x);
+            store8(src + y * srcStride + x, filter8(org, refs, y * refStride + x, 0, true, refWeights, weightLuts, numRefs));
+        }
+    }
+
+    /* a column of four (chroma blocks) is processed two rows at a time */
+    if (x + 4 <= width)
+    {
+        int y = 0;
+        for (; y + 2 <= height; y += 2)
+        {
+            pixel* src0 = src + y * srcStride + x;
+            pixel* src1 = src0 + srcStride;
+            __m256i org = load4x2(src0, src1);
+            store4x2(src0, src1, filter8(org, refs, y * refStride + x, (y + 1) * refStride + x, false, refWeights, weightLuts, numRefs));
+        }
+        if (y < height)
+            filterRow_c(src, srcStride, refs, refStride, refWeights, weightLuts, numRefs, y, x, x + 4);
+        x += 4;
+    }
+
+    if (x < width)
+    {
+        for (int y = 0; y < height; y++)
+            filterRow_c(src, srcStride, refs, refStride, refWeights, weightLuts, numRefs, y, x, width);
+    }
+}
+}
+
+namespace X265_NS {
+void setupIntrinsicTemporalFilter_avx2(EncoderPrimitives &p)
+{
+    p.mcstfBilateral = mcstfBilateral_avx2;
+}
+}
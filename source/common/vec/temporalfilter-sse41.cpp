@@ -0,0 +1,121 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#include "common.h"
+#include "primitives.h"
+#include <xmmintrin.h> // SSE
+#include <smmintrin.h> // SSE4.1
+
+using namespace X265_NS;
+
+namespace {
+static inline __m128i load4(const pixel* src)
+{
+#if HIGH_BIT_DEPTH
+    return _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)src));
+#else
+    return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(*(const int32_t*)src));
+#endif
+}
+
+static inline void store4(pixel* dst, __m128i val)
+{
+    val = _mm_packus_epi32(val, val);
+#if HIGH_BIT_DEPTH
+    _mm_storel_epi64((__m128i*)dst, val);
+#else
+    *(int32_t*)dst = _mm_cvtsi128_si32(_mm_packus_epi16(val, val));
+#endif
+}
+
+/* (num + den / 2) / den for positive 32-bit lanes. The single precision
+ * quotient is within one of the exact result, so one correction step in each
+ * direction makes it bit exact with the integer division of the C reference */
+static inline __m128i divRound(__m128i num, __m128i den)
+{
+    __m128i val = _mm_add_epi32(num, _mm_srai_epi32(den, 1));
+    __m128i quo = _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(val), _mm_cvtepi32_ps(den)));
+    __m128i rem = _mm_sub_epi32(val, _mm_mullo_epi32(quo, den));
+    __m128i neg = _mm_srai_epi32(rem, 31);
+    quo = _mm_add_epi32(quo, neg);
+    rem = _mm_add_epi32(rem, _mm_and_si128(neg, den));
+    return _mm_sub_epi32(quo, _mm_cmpgt_epi32(rem, _mm_sub_epi32(den, _mm_set1_epi32(1))));
+}
+
+static void mcstfBilateral_sse4(pixel* src, intptr_t srcStride, const pixel* const* refs, intptr_t refStride,
+                                const int32_t* refWeights, const uint16_t* const* weightLuts, int numRefs, int width, int height)
+{
+    const __m128i round = _mm_set1_epi32(1 << (MCSTF_WEIGHT_SHIFT - 1));
+    const __m128i one = _mm_set1_epi32(1 << MCSTF_WEIGHT_SHIFT);
+
+    for (int y = 0; y < height; y++)
+    {
+        int x = 0;
+        for (; x + 4 <= width; x += 4)
+        {
+            __m128i org = load4(src + x);
+            __m128i num = _mm_slli_epi32(org, MCSTF_WEIGHT_SHIFT);
+            __m128i den = one;
+
+            for (int i = 0; i < numRefs; i++)
+            {
+                const uint16_t* lut = weightLuts[i];
+                __m128i ref = load4(refs[i] + y * refStride + x);
+                __m128i diff = _mm_abs_epi32(_mm_sub_epi32(ref, org));
+                __m128i weight = _mm_setr_epi32(lut[_mm_cvtsi128_si32(diff)], lut[_mm_extract_epi32(diff, 1)],
+                                                lut[_mm_extract_epi32(diff, 2)], lut[_mm_extract_epi32(diff, 3)]);
+                weight = _mm_mullo_epi32(weight, _mm_set1_epi32(refWeights[i]));
+                weight = _mm_srai_epi32(_mm_add_epi32(weight, round), MCSTF_WEIGHT_SHIFT);
+                num = _mm_add_epi32(num, _mm_mullo_epi32(weight, ref));
+                den = _mm_add_epi32(den, weight);
+            }
+
+            store4(src + x, divRound(num, den));
+        }
+
+        for (; x < width; x++)
+        {
+            int orgVal = src[x];
+            int num = orgVal << MCSTF_WEIGHT_SHIFT;
+            int den = 1 << MCSTF_WEIGHT_SHIFT;
+
+            for (int i = 0; i < numRefs; i++)
+            {
+                int refVal = refs[i][y * refStride + x];
+                int weight = (refWeights[i] * weightLuts[i][abs(refVal - orgVal)] + (1 << (MCSTF_WEIGHT_SHIFT - 1))) >> MCSTF_WEIGHT_SHIFT;
+                num += weight * refVal;
+                den += weight;
+            }
+
+            src[x] = (pixel)((num + (den >> 1)) / den);
+        }
+
+        src += srcStride;
+    }
+}
+}
+
+namespace X265_NS {
+void setupIntrinsicTemporalFilter_sse41(EncoderPrimitives &p)
+{
+    p.mcstfBilateral = mcstfBilateral_sse4;
+}
+}
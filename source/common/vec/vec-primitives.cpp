@@ -57,6 +57,14 @@ namespace X265_NS {
 void setupIntrinsicDCT_sse3(EncoderPrimitives&);
 void setupIntrinsicDCT_ssse3(EncoderPrimitives&);
 void setupIntrinsicDCT_sse41(EncoderPrimitives&);
+void setupIntrinsicTemporalFilter_sse41(EncoderPrimitives&);
+void setupIntrinsicTemporalFilter_avx2(EncoderPrimitives&);
+void setupIntrinsicCutree_avx2(EncoderPrimitives&);
+void setupIntrinsicScaler_avx2(EncoderPrimitives&);
+void setupIntrinsicNal_avx2(EncoderPrimitives&);
+void setupIntrinsicHash_avx2(EncoderPrimitives&);
+void setupIntrinsicSsim_avx2(EncoderPrimitives&);
+void setupIntrinsicDither_avx2(EncoderPrimitives&);
 
 /* Use primitives for the best available vector architecture */
 void setupInstrinsicPrimitives(EncoderPrimitives &p, int cpuMask)
@@ -77,6 +85,19 @@ void setupInstrinsicPrimitives(EncoderPrimitives &p, int cpuMask)
     if (cpuMask & X265_CPU_SSE4)
     {
         setupIntrinsicDCT_sse41(p);
+        setupIntrinsicTemporalFilter_sse41(p);
+    }
+#endif
+#ifdef HAVE_AVX2
+    if (cpuMask & X265_CPU_AVX2)
+    {
+        setupIntrinsicTemporalFilter_avx2(p);
+        setupIntrinsicCutree_avx2(p);
+        setupIntrinsicScaler_avx2(p);
+        setupIntrinsicNal_avx2(p);
+        setupIntrinsicHash_avx2(p);
+        setupIntrinsicSsim_avx2(p);
+        setupIntrinsicDither_avx2(p);
     }
 #endif
     (void)p;
@@ -0,0 +1,180 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#include "common.h"
+#include "analysiswriter.h"
+#include "ringmem.h"
+
+using namespace X265_NS;
+
+AnalysisWriter::AnalysisWriter()
+{
+    m_file = NULL;
+    m_ring = NULL;
+    memset(m_buffer, 0, sizeof(m_buffer));
+    m_fill = 0;
+    m_pending = -1;
+    m_committedBytes = 0;
+    m_bError = false;
+    m_bExit = false;
+    m_bThreadActive = false;
+}
+
+AnalysisWriter::~AnalysisWriter()
+{
+    for (int i = 0; i < 2; i++)
+        X265_FREE(m_buffer[i].data);
+}
+
+void AnalysisWriter::create(FILE* file)
+{
+    m_file = file;
+    m_committedBytes = 0;
+    int64_t pos = ftello(file);
+    if (pos > 0)
+        m_committedBytes = (uint64_t)pos;
+
+    /* without a worker thread records are written synchronously by commit() */
+    m_bThreadActive = start();
+}
+
+void AnalysisWriter::create(RingMem* ring)
+{
+    m_ring = ring;
+    m_committedBytes = 0;
+    m_bThreadActive = start();
+}
+
+bool AnalysisWriter::destroy()
+{
+    if (m_buffer[m_fill].size)
+        commit();
+    if (m_bThreadActive)
+    {
+        waitIdle();
+        m_lock.acquire();
+        m_bExit = true;
+        m_lock.release();
+        m_dataReady.trigger();
+        stop();
+        m_bThreadActive = false;
+    }
+    return !m_bError;
+}
+
+bool AnalysisWriter::write(const void* data, size_t size)
+{
+    Buffer& buf = m_buffer[m_fill];
+    if (buf.size + size > buf.alloc)
+    {
+        size_t alloc = X265_MAX(buf.alloc * 2, buf.size + size);
+        alloc = X265_MAX(alloc, (size_t)64 * 1024);
+        uint8_t* temp = X265_MALLOC(uint8_t, alloc);
+        if (!temp)
+            return false;
+        if (buf.size)
+            memcpy(temp, buf.data, buf.size);
+        X265_FREE(buf.data);
+        buf.data = temp;
+        buf.alloc = alloc;
+    }
+    if (size)
+        memcpy(buf.data + buf.size, data, size);
+    buf.size += size;
+    return true;
+}
+
+bool AnalysisWriter::commit()
+{
+    Buffer& buf = m_buffer[m_fill];
+    m_committedBytes += buf.size;
+
+    if (!m_bThreadActive)
+    {
+        if (!flush(buf))
+            m_bError = true;
+        buf.size = 0;
+        return !m_bError;
+    }
+
+    /* the other buffer must have been written before it can be refilled */
+    waitIdle();
+
+    m_lock.acquire();
+    m_pending = m_fill;
+    bool bError = m_bError;
+    m_lock.release();
+    m_dataReady.trigger();
+
+    m_fill ^= 1;
+    m_buffer[m_fill].size = 0;
+    return !bError;
+}
+
+bool AnalysisWriter::flush(const Buffer& buf)
+{
+    if (!buf.size)
+        return true;
+    if (m_ring)
+        return buf.size <= (size_t)INT_MAX && m_ring->writeRecord(buf.data, (int32_t)buf.size);
+    return fwrite(buf.data, 1, buf.size, m_file) == buf.size;
+}
+
+void AnalysisWriter::waitIdle()
+{
+    m_lock.acquire();
+    while (m_pending >= 0)
+    {
+        m_lock.release();
+        m_writeDone.wait();
+        m_lock.acquire();
+    }
+    m_lock.release();
+}
+
+void AnalysisWriter::threadMain()
+{
+    THREAD_NAME("AnalysisWriter", 0);
+
+    while (true)
+    {
+        m_dataReady.wait();
+
+        m_lock.acquire();
+        int pending = m_pending;
+        bool bExit = m_bExit;
+        m_lock.release();
+
+        if (pending >= 0)
+        {
+            Buffer& buf = m_buffer[pending];
+            bool bError = !flush(buf);
+
+            m_lock.acquire();
+            m_bError |= bError;
+            m_pending = -1;
+            m_lock.release();
+            m_writeDone.trigger();
+        }
+        else if (bExit)
+            break;
+    }
+}
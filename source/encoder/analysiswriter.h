@@ -0,0 +1,97 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#ifndef X265_ANALYSISWRITER_H
+#define X265_ANALYSISWRITER_H
+
+#include "common.h"
+#include "threading.h"
+
+namespace X265_NS {
+// private x265 namespace
+
+class RingMem;
+
+/* Background writer for analysis save files. Each frame record is serialized
+ * into one contiguous buffer by the encoder thread and handed to a worker
+ * thread that writes it with a single fwrite, while the encoder fills the
+ * second buffer. The encoder only blocks when it completes a record before
+ * the previous one has reached the file */
+class AnalysisWriter : public Thread
+{
+public:
+
+    AnalysisWriter();
+
+    ~AnalysisWriter();
+
+    void create(FILE* file);
+
+    /* send each record to the readers of a shared memory ring instead of a
+     * file; the worker waits there when the slowest reader falls behind */
+    void create(RingMem* ring);
+
+    /* wait for queued records, then stop the worker. Returns false if any
+     * write failed */
+    bool destroy();
+
+    /* append bytes to the record being serialized */
+    bool write(const void* data, size_t size);
+
+    /* queue the serialized record for writing; returns false if an earlier
+     * record failed to write */
+    bool commit();
+
+    /* file offset at which the next appended byte will land */
+    uint64_t tell() const { return m_committedBytes + m_buffer[m_fill].size; }
+
+protected:
+
+    struct Buffer
+    {
+        uint8_t* data;
+        size_t   size;
+        size_t   alloc;
+    };
+
+    FILE*    m_file;
+    RingMem* m_ring;
+    Buffer   m_buffer[2];
+    int      m_fill;            // buffer being serialized by the encoder
+    int      m_pending;         // buffer queued for the worker, -1 if none
+    uint64_t m_committedBytes;
+    bool     m_bError;
+    bool     m_bExit;
+    bool     m_bThreadActive;
+
+    Lock     m_lock;
+    Event    m_dataReady;
+    Event    m_writeDone;
+
+    void threadMain();
+
+    bool flush(const Buffer& buf);
+
+    void waitIdle();
+};
+}
+
+#endif // ifndef X265_ANALYSISWRITER_H
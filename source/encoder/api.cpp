@@ -227,6 +227,13 @@ x265_encoder *x265_encoder_open(x265_param *p)
     if (encoder->m_aborted)
         goto fail;
 
+    if (encoder->m_param->traceFile)
+    {
+        encoder->m_bTracing = traceStart(encoder->m_param->traceFile);
+        if (!encoder->m_bTracing)
+            x265_log(encoder->m_param, X265_LOG_WARNING, "Unable to open trace file <%s>, events are not traced\n", encoder->m_param->traceFile);
+    }
+
     x265_print_params(param);
     return encoder;
 
@@ -770,11 +777,31 @@ int x265_set_analysis_data(x265_encoder *enc, x265_analysis_data *analysis_data,
     return -1;
 }
 
+void* x265_encoder_nal_buffer(x265_encoder *enc)
+{
+    if (!enc)
+        return NULL;
+
+    Encoder *encoder = static_cast<Encoder*>(enc);
+#ifdef SVT_HEVC
+    /* the payloads point into SVT-HEVC's own output buffers */
+    if (encoder->m_param->bEnableSvtHevc)
+        return NULL;
+#endif
+    return encoder->m_nalList.detachBuffer();
+}
+
+void x265_nal_buffer_free(void *buffer)
+{
+    X265_FREE(buffer);
+}
+
 void x265_alloc_analysis_data(x265_param *param, x265_analysis_data* analysis)
 {
     x265_analysis_inter_data *interData = analysis->interData = NULL;
     x265_analysis_intra_data *intraData = analysis->intraData = NULL;
     x265_analysis_distortion_data *distortionData = analysis->distortionData = NULL;
+    analysis->qpAqOffset = analysis->qpCuTreeOffset = NULL;
 
     bool isVbv = param->rc.vbvMaxBitrate > 0 && param->rc.vbvBufferSize > 0;
     int numDir = 2; //irrespective of P or B slices set direction as 2
@@ -815,6 +842,16 @@ void x265_alloc_analysis_data(x265_param *param, x265_analysis_data* analysis)
         CHECKED_MALLOC_ZERO(analysis->lookahead.vbvCost, uint32_t, analysis->numCUsInFrame);
     }
 
+    if (!isMultiPassOpt && param->bDisableLookahead && (param->rc.aqMode || param->rc.cuTree))
+    {
+        /* same grid as the Lowres QP offsets */
+        uint32_t scale = param->rc.qgSize == 8 ? 2 : 1;
+        analysis->qpOffsetCols = scale * (((param->sourceWidth / 2) + X265_LOWRES_CU_SIZE - 1) >> X265_LOWRES_CU_BITS);
+        analysis->qpOffsetRows = scale * (((param->sourceHeight / 2) + X265_LOWRES_CU_SIZE - 1) >> X265_LOWRES_CU_BITS);
+        CHECKED_MALLOC_ZERO(analysis->qpAqOffset, double, analysis->qpOffsetCols * analysis->qpOffsetRows);
+        CHECKED_MALLOC_ZERO(analysis->qpCuTreeOffset, double, analysis->qpOffsetCols * analysis->qpOffsetRows);
+    }
+
     //Allocate memory for weightParam pointer
     if (!isMultiPassOpt && !(param->bAnalysisType == AVC_INFO))
         CHECKED_MALLOC_ZERO(analysis->wt, x265_weight_param, numPlanes * numDir);
@@ -899,6 +936,13 @@ void x265_free_analysis_data(x265_param *param, x265_analysis_data* analysis)
         X265_FREE(analysis->lookahead.intraVbvCost);
     }
 
+    if (!isMultiPassOpt && param->bDisableLookahead && (param->rc.aqMode || param->rc.cuTree))
+    {
+        X265_FREE(analysis->qpAqOffset);
+        X265_FREE(analysis->qpCuTreeOffset);
+        analysis->qpAqOffset = analysis->qpCuTreeOffset = NULL;
+    }
+
     //Free memory for distortionData pointers
     if (analysis->distortionData)
     {
@@ -974,6 +1018,7 @@ void x265_free_analysis_data(x265_param *param, x265_analysis_data* analysis)
 void x265_cleanup(void)
 {
     BitCost::destroy();
+    traceRelease();
 }
 
 x265_picture *x265_picture_alloc()
@@ -1081,7 +1126,9 @@ static const x265_api libapi =
     &x265_calculate_vmaf_framelevelscore,
     &x265_vmaf_encoder_log,
 #endif
-    &PARAM_NS::x265_zone_param_parse
+    &PARAM_NS::x265_zone_param_parse,
+    &x265_encoder_nal_buffer,
+    &x265_nal_buffer_free
 };
 
 typedef const x265_api* (*api_get_func)(int bitDepth);
@@ -1635,48 +1682,6 @@ void x265_csvlog_encode(const x265_param *p, const x265_stats *stats, int padx,
     }
 }
 
-/* The dithering algorithm is based on Sierra-2-4A error diffusion.
- * We convert planes in place (without allocating a new buffer). */
-static void ditherPlane(uint16_t *src, int srcStride, int width, int height, int16_t *errors, int bitDepth)
-{
-    const int lShift = 16 - bitDepth;
-    const int rShift = 16 - bitDepth + 2;
-    const int half = (1 << (16 - bitDepth + 1));
-    const int pixelMax = (1 << bitDepth) - 1;
-
-    memset(errors, 0, (width + 1) * sizeof(int16_t));
-
-    if (bitDepth == 8)
-    {
-        for (int y = 0; y < height; y++, src += srcStride)
-        {
-            uint8_t* dst = (uint8_t *)src;
-            int16_t err = 0;
-            for (int x = 0; x < width; x++)
-            {
-                err = err * 2 + errors[x] + errors[x + 1];
-                int tmpDst = x265_clip3(0, pixelMax, ((src[x] << 2) + err + half) >> rShift);
-                errors[x] = err = (int16_t)(src[x] - (tmpDst << lShift));
-                dst[x] = (uint8_t)tmpDst;
-            }
-        }
-    }
-    else
-    {
-        for (int y = 0; y < height; y++, src += srcStride)
-        {
-            int16_t err = 0;
-            for (int x = 0; x < width; x++)
-            {
-                err = err * 2 + errors[x] + errors[x + 1];
-                int tmpDst = x265_clip3(0, pixelMax, ((src[x] << 2) + err + half) >> rShift);
-                errors[x] = err = (int16_t)(src[x] - (tmpDst << lShift));
-                src[x] = (uint16_t)tmpDst;
-            }
-        }
-    }
-}
-
 void x265_dither_image(x265_picture* picIn, int picWidth, int picHeight, int16_t *errorBuf, int bitDepth)
 {
     const x265_api* api = x265_api_get(0);
@@ -1699,6 +1704,12 @@ void x265_dither_image(x265_picture* picIn, int picWidth, int picHeight, int16_t
         return;
     }
 
+    /* the dither primitive is set up by the first encoder opened, with its
+     * CPU flags; setting them up here would impose ours on that encoder. The
+     * C kernel covers callers which dither before opening an encoder, and
+     * multilib builds whose encoders live in another bit-depth namespace */
+    dither_t ditherPlane = primitives.ditherPlane ? primitives.ditherPlane : ditherPlane_c;
+
     /* This portion of code is from readFrame in x264. */
     for (int i = 0; i < x265_cli_csps[picIn->colorSpace].planes; i++)
     {
@@ -1718,7 +1729,7 @@ void x265_dither_image(x265_picture* picIn, int picWidth, int picHeight, int16_t
         int height = (int)(picHeight >> x265_cli_csps[picIn->colorSpace].height[i]);
         int width = (int)(picWidth >> x265_cli_csps[picIn->colorSpace].width[i]);
 
-        ditherPlane(((uint16_t*)picIn->planes[i]), picIn->stride[i] / 2, width, height, errorBuf, bitDepth);
+        ditherPlane((uint16_t*)picIn->planes[i], picIn->stride[i] / 2, width, height, errorBuf, bitDepth);
     }
 }
 
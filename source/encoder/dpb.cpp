@@ -78,6 +78,7 @@ void DPB::recycleUnreferenced()
         if (!curFrame->m_encData->m_bHasReferences && !curFrame->m_countRefEncoders && !isMCSTFReferenced)
         {
             curFrame->m_bChromaExtended = false;
+            curFrame->releaseInput();
 
             if (curFrame->m_param->bEnableTemporalFilter)
                 *curFrame->m_isSubSampled = false;
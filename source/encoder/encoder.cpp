@@ -39,6 +39,7 @@
 #include "ratecontrol.h"
 #include "dpb.h"
 #include "nal.h"
+#include "analysiswriter.h"
 
 #include "x265.h"
 
@@ -115,13 +116,121 @@ VideoSignalTypePresets vstPresets[] =
 #define PU_2Nx2N 1
 #define MAX_CHROMA_QP_OFFSET 12
 #define CONF_OFFSET_BYTES (2 * sizeof(int))
+
+/* analysis-save files end with an index of (int32 poc, uint64 offset) entries
+ * followed by a trailer: uint64 index offset, uint32 entry count, uint32
+ * version and an 8 byte magic */
+#define ANALYSIS_INDEX_MAGIC "x265aidx"
+#define ANALYSIS_INDEX_VERSION 1
+#define ANALYSIS_INDEX_ENTRY_BYTES (sizeof(int32_t) + sizeof(uint64_t))
+#define ANALYSIS_INDEX_TRAILER_BYTES (sizeof(uint64_t) + 2 * sizeof(uint32_t) + 8)
 static const char* defaultAnalysisFileName = "x265_analysis.dat";
 
+/* analysis records shared in memory are split over 64KB items; the ring holds
+ * 32MB of them, which bounds how far the saving encoder runs ahead */
+#define ANALYSIS_SHARED_MEM_NAME "analysis"
+#define ANALYSIS_SHARED_ITEM_SIZE (64 * 1024)
+#define ANALYSIS_SHARED_ITEM_CNT 512
+
+/* analysis data goes through shared memory when this encoder either saves or
+ * loads it, the same ring cannot carry both directions */
+static bool useAnalysisSharedMem(const x265_param* p)
+{
+    return p->bUseAnalysisFile && p->rc.dataShareMode == X265_SHARE_MODE_SHAREDMEM && p->rc.sharedMemName &&
+           !p->analysisSave != !p->analysisLoad;
+}
+
 using namespace X265_NS;
 
+InputDither::InputDither()
+{
+    m_pic = NULL;
+    m_numPlanes = 0;
+    m_bitDepth = 8;
+    for (int i = 0; i < 3; i++)
+    {
+        m_planes[i] = NULL;
+        m_errors[i] = NULL;
+        m_width[i] = m_height[i] = 0;
+    }
+}
+
+void InputDither::destroy()
+{
+    for (int i = 0; i < 3; i++)
+    {
+        X265_FREE(m_planes[i]);
+        X265_FREE(m_errors[i]);
+    }
+}
+
+bool InputDither::create(const x265_param& param)
+{
+    m_numPlanes = x265_cli_csps[param.internalCsp].planes;
+    m_bitDepth = param.internalBitDepth;
+    for (int i = 0; i < m_numPlanes; i++)
+    {
+        m_width[i] = param.sourceWidth >> x265_cli_csps[param.internalCsp].width[i];
+        m_height[i] = param.sourceHeight >> x265_cli_csps[param.internalCsp].height[i];
+        CHECKED_MALLOC(m_planes[i], uint16_t, m_width[i] * m_height[i]);
+        CHECKED_MALLOC(m_errors[i], int16_t, m_width[i] + 1);
+    }
+    return true;
+
+fail:
+    return false;
+}
+
+void InputDither::dither(x265_picture& out, const x265_picture& in, ThreadPool* pool)
+{
+    m_pic = &in;
+    m_jobTotal = m_numPlanes;
+    m_jobAcquired = 0;
+
+    if (pool)
+        tryBondPeers(*pool, m_numPlanes - 1);
+    processTasks(-1);
+    waitForExit();
+
+    out = in;
+    for (int i = 0; i < m_numPlanes; i++)
+    {
+        out.planes[i] = m_planes[i];
+        out.stride[i] = m_width[i] * sizeof(uint16_t);
+    }
+    out.bitDepth = m_bitDepth;
+}
+
+/* Upconvert a plane to 16 bits, as x265_dither_image() expects, and dither it */
+void InputDither::processTasks(int /* workerThreadId */)
+{
+    m_lock.acquire();
+    while (m_jobAcquired < m_jobTotal)
+    {
+        int plane = m_jobAcquired++;
+        m_lock.release();
+
+        ProfileScopeEvent(inputDither);
+        const uint16_t* src = (const uint16_t*)m_pic->planes[plane];
+        intptr_t stride = m_pic->stride[plane] / sizeof(uint16_t);
+        int shift = 16 - m_pic->bitDepth;
+        uint16_t* dst = m_planes[plane];
+        for (int y = 0; y < m_height[plane]; y++, src += stride, dst += m_width[plane])
+        {
+            for (int x = 0; x < m_width[plane]; x++)
+                dst[x] = (uint16_t)(src[x] << shift);
+        }
+        primitives.ditherPlane(m_planes[plane], m_width[plane], m_width[plane], m_height[plane], m_errors[plane], m_bitDepth);
+
+        m_lock.acquire();
+    }
+    m_lock.release();
+}
+
 Encoder::Encoder()
 {
     m_aborted = false;
+    m_bTracing = false;
     m_reconfigure = false;
     m_reconfigureRc = false;
     m_encodedFrameNum = 0;
@@ -142,6 +251,25 @@ Encoder::Encoder()
     m_threadPool = NULL;
     m_analysisFileIn = NULL;
     m_analysisFileOut = NULL;
+    m_analysisWriter = NULL;
+    m_analysisMap = NULL;
+    m_analysisMapSize = 0;
+    m_analysisMapPos = 0;
+    m_analysisRecordEnd = 0;
+    m_analysisPocOffset = NULL;
+    m_analysisPocCount = 0;
+    m_analysisShrMemIn = NULL;
+    m_analysisShrMemOut = NULL;
+    m_analysisWindow = NULL;
+    m_analysisWindowBase = 0;
+    m_analysisWindowSize = 0;
+    m_analysisWindowAlloc = 0;
+    m_analysisParamBytes = CONF_OFFSET_BYTES;
+    m_analysisConsumedBytes = 0;
+    m_analysisTotalConsumedBytes = 0;
+    m_analysisSaveIndex = NULL;
+    m_analysisSaveCount = 0;
+    m_analysisSaveAlloc = 0;
     m_filmGrainIn = NULL;
     m_naluFile = NULL;
     m_offsetEmergency = NULL;
@@ -363,6 +491,16 @@ void Encoder::create()
     if (m_param->bEnableTemporalFilter)
         m_origPicBuffer = new OrigPicBuffer();
 
+    if (m_param->bEncoderDither)
+    {
+        if (!m_inputDither.create(*m_param))
+        {
+            x265_log(m_param, X265_LOG_ERROR, "Unable to allocate the encoder-dither planes\n");
+            m_aborted = true;
+            return;
+        }
+    }
+
     m_rateControl = new RateControl(*m_param, this);
     if (!m_param->bResetZoneConfig)
     {
@@ -476,7 +614,12 @@ void Encoder::create()
         m_aborted = true;
 
     initRefIdx();
-    if (m_param->analysisSave && m_param->bUseAnalysisFile)
+    if (m_param->analysisSave && m_param->bUseAnalysisFile && useAnalysisSharedMem(m_param))
+    {
+        if (!openAnalysisSharedMem(true))
+            m_aborted = true;
+    }
+    else if (m_param->analysisSave && m_param->bUseAnalysisFile)
     {
         char* temp = strcatFilename(m_param->analysisSave, ".temp");
         if (!temp)
@@ -524,6 +667,16 @@ void Encoder::create()
             }
         }
     }
+    if (m_analysisFileOut)
+    {
+        m_analysisWriter = new AnalysisWriter;
+        m_analysisWriter->create(m_analysisFileOut);
+    }
+    else if (m_analysisShrMemOut)
+    {
+        m_analysisWriter = new AnalysisWriter;
+        m_analysisWriter->create(m_analysisShrMemOut);
+    }
     if (m_param->filmGrain)
     {
         m_filmGrainIn = x265_fopen(m_param->filmGrain, "rb");
@@ -850,6 +1003,9 @@ int Encoder::setAnalysisData(x265_analysis_data *analysis_data, int poc, uint32_
 
 void Encoder::destroy()
 {
+    if (m_bTracing)
+        traceStop();
+
 #if ENABLE_HDR10_PLUS
     if (m_bToneMap)
         m_hdr10plus_api->hdr10plus_clear_movie(m_cim, m_numCimInfo);
@@ -903,6 +1059,8 @@ void Encoder::destroy()
         }
     }
 
+    m_inputDither.destroy();
+
     // thread pools can be cleaned up now that all the JobProviders are
     // known to be shutdown
     delete [] m_threadPool;
@@ -938,12 +1096,41 @@ void Encoder::destroy()
 
         PARAM_NS::x265_param_free(m_latestParam);
     }
+    unmapAnalysisFile();
     if (m_analysisFileIn)
         fclose(m_analysisFileIn);
+    if (m_analysisShrMemIn)
+    {
+        m_analysisShrMemIn->release();
+        delete m_analysisShrMemIn;
+    }
+    X265_FREE(m_analysisWindow);
+
+    if (m_analysisShrMemOut)
+    {
+        /* the readers find the records by scanning, no index is sent */
+        X265_FREE(m_analysisSaveIndex);
+        m_analysisSaveIndex = NULL;
+        if (m_analysisWriter)
+        {
+            if (!m_analysisWriter->destroy())
+                x265_log(NULL, X265_LOG_ERROR, "Error writing analysis data\n");
+            delete m_analysisWriter;
+        }
+        m_analysisShrMemOut->release();
+        delete m_analysisShrMemOut;
+    }
 
     if (m_analysisFileOut)
     {
         int bError = 1;
+        if (m_analysisWriter)
+        {
+            writeAnalysisIndex();
+            if (!m_analysisWriter->destroy())
+                x265_log(NULL, X265_LOG_ERROR, "Error writing analysis data\n");
+            delete m_analysisWriter;
+        }
         fclose(m_analysisFileOut);
         const char* name = m_param->analysisSave ? m_param->analysisSave : m_param->analysisReuseFileName;
         if (!name)
@@ -979,6 +1166,7 @@ void Encoder::destroy()
         free((char*)m_param->analysisReuseFileName);
         free((char*)m_param->scalingLists);
         free((char*)m_param->csvfn);
+        free((char*)m_param->traceFile);
         free((char*)m_param->numaPools);
         free((char*)m_param->masteringDisplayColorVolume);
         free((char*)m_param->toneMapFile);
@@ -1388,7 +1576,7 @@ inline int enqueueRefFrame(FrameEncoder* curframeEncoder, Frame* iterFrame, Fram
     dest->picBufferSubSampled2 = iterFrame->m_fencPicSubsampled2;
     dest->picBufferSubSampled4 = iterFrame->m_fencPicSubsampled4;
     dest->isFilteredFrame = isPreFiltered;
-    dest->isSubsampled = iterFrame->m_isSubSampled;
+    dest->refFrame = iterFrame;
     dest->origOffset = i;
     curFrame->m_mcstf->m_numRef++;
 
@@ -1471,6 +1659,7 @@ int Encoder::encode(const x265_picture* pic_in, x265_picture* pic_out)
         return -1;
 
     const x265_picture* inputPic = NULL;
+    x265_picture ditherPic;
     static int written = 0, read = 0;
     bool dontRead = false;
     bool dropflag = false;
@@ -1512,6 +1701,12 @@ int Encoder::encode(const x265_picture* pic_in, x265_picture* pic_out)
                          pic_in->bitDepth);
                 return -1;
             }
+
+            if (m_param->bEncoderDither && pic_in->bitDepth > m_param->internalBitDepth)
+            {
+                m_inputDither.dither(ditherPic, *pic_in, m_numPools ? m_threadPool : NULL);
+                pic_in = &ditherPic;
+            }
         }
 
         if (m_param->bEnableFrameDuplication)
@@ -1636,13 +1831,26 @@ int Encoder::encode(const x265_picture* pic_in, x265_picture* pic_out)
             inFrame->m_lowres.bScenecut = false;
             inFrame->m_lowres.satdCost = (int64_t)-1;
             inFrame->m_lowresInit = false;
+            inFrame->m_lowresInitClaimed = false;
             inFrame->m_isInsideWindow = 0;
             inFrame->m_tempLayer = 0;
             inFrame->m_sameLayerRefPic = 0;
         }
 
+        if (!m_param->bCopyPicToFrame && !inFrame->m_fencPic->canAliasPicture(*inputPic))
+        {
+            x265_log(m_param, X265_LOG_ERROR, "no-copy-pic: input planes do not match the encoder's frame layout (bit depth, color space, strides or alignment)\n");
+            m_dpb->m_freeList.pushBack(*inFrame);
+            return -1;
+        }
+
         /* Copy input picture into a Frame and PicYuv, send to lookahead */
         inFrame->m_fencPic->copyFromPicture(*inputPic, *m_param, m_sps.conformanceWindow.rightOffset, m_sps.conformanceWindow.bottomOffset);
+        if (!m_param->bCopyPicToFrame)
+        {
+            inFrame->m_releasePlanes = inputPic->releasePlanes;
+            inFrame->m_planesOpaque = inputPic->planesOpaque;
+        }
 
         inFrame->m_poc       = ++m_pocLast;
         inFrame->m_userData  = inputPic->userData;
@@ -1718,16 +1926,16 @@ int Encoder::encode(const x265_picture* pic_in, x265_picture* pic_out)
         if (m_param->analysisLoad)
         {
             /* reads analysis data for the frame and allocates memory based on slicetype */
-            static int paramBytes = CONF_OFFSET_BYTES;
             if (!inFrame->m_poc && m_param->bAnalysisType != HEVC_INFO)
             {
                 x265_analysis_validate saveParam = inputPic->analysisData.saveParam;
-                paramBytes += validateAnalysisData(&saveParam, 0);
-                if (paramBytes == -1)
+                int validateBytes = validateAnalysisData(&saveParam, 0);
+                if (validateBytes == -1)
                 {
                     m_aborted = true;
                     return -1;
                 }
+                m_analysisParamBytes += validateBytes;
             }
             if (m_saveCTUSize)
             {
@@ -1742,10 +1950,10 @@ int Encoder::encode(const x265_picture* pic_in, x265_picture* pic_out)
                 uint32_t outOfBoundaryLowresH = extendedHeight - m_param->sourceHeight / 2;
                 if (outOfBoundaryLowresH * 2 >= m_param->maxCUSize)
                     cuLocInFrame.skipHeight = true;
-                readAnalysisFile(&inFrame->m_analysisData, inFrame->m_poc, inputPic, paramBytes, cuLocInFrame);
+                readAnalysisFile(&inFrame->m_analysisData, inFrame->m_poc, inputPic, m_analysisParamBytes, cuLocInFrame);
             }
             else
-                readAnalysisFile(&inFrame->m_analysisData, inFrame->m_poc, inputPic, paramBytes);
+                readAnalysisFile(&inFrame->m_analysisData, inFrame->m_poc, inputPic, m_analysisParamBytes);
             inFrame->m_poc = inFrame->m_analysisData.poc;
             sliceType = inFrame->m_analysisData.sliceType;
             inFrame->m_lowres.bScenecut = !!inFrame->m_analysisData.bScenecut;
@@ -1764,6 +1972,8 @@ int Encoder::encode(const x265_picture* pic_in, x265_picture* pic_out)
                         inFrame->m_lowres.plannedType[index] = inFrame->m_analysisData.lookahead.plannedType[index];
                     }
                 }
+                if (!m_param->bUseAnalysisFile && inputPic->analysisData.qpAqOffset && inFrame->m_lowres.qpAqOffset)
+                    loadQpOffsets(inFrame, &inputPic->analysisData);
             }
         }
         if (m_param->bUseRcStats && inputPic->rcData)
@@ -1895,6 +2105,12 @@ int Encoder::encode(const x265_picture* pic_in, x265_picture* pic_out)
             if ((m_param->analysisLoad && !m_param->analysisSave) || ((m_param->bAnalysisType == AVC_INFO) && slice->m_sliceType != I_SLICE))
                 x265_free_analysis_data(m_param, &outFrame->m_analysisData);
 
+            /* The frame encoder was the last reader of the lowres cost and MV
+             * slices; the lookahead only visits this frame again as the P0 of
+             * its next window, which reads none of them. Hand them back now
+             * rather than when the frame leaves the DPB */
+            outFrame->m_lowres.releaseSlices();
+
             if (pic_out)
             {
                 PicYuv *recpic = outFrame->m_reconPic;
@@ -1968,6 +2184,16 @@ int Encoder::encode(const x265_picture* pic_in, x265_picture* pic_out)
                             pic_out->analysisData.lookahead.intraVbvCost = outFrame->m_analysisData.lookahead.intraVbvCost;
                             pic_out->analysisData.lookahead.vbvCost = outFrame->m_analysisData.lookahead.vbvCost;
                         }
+                        if (outFrame->m_analysisData.qpAqOffset && outFrame->m_lowres.qpAqOffset)
+                        {
+                            size_t count = outFrame->m_analysisData.qpOffsetCols * outFrame->m_analysisData.qpOffsetRows;
+                            memcpy(outFrame->m_analysisData.qpAqOffset, outFrame->m_lowres.qpAqOffset, count * sizeof(double));
+                            memcpy(outFrame->m_analysisData.qpCuTreeOffset, outFrame->m_lowres.qpCuTreeOffset, count * sizeof(double));
+                            pic_out->analysisData.qpAqOffset = outFrame->m_analysisData.qpAqOffset;
+                            pic_out->analysisData.qpCuTreeOffset = outFrame->m_analysisData.qpCuTreeOffset;
+                            pic_out->analysisData.qpOffsetCols = outFrame->m_analysisData.qpOffsetCols;
+                            pic_out->analysisData.qpOffsetRows = outFrame->m_analysisData.qpOffsetRows;
+                        }
                     }
                     writeAnalysisFile(&pic_out->analysisData, *outFrame->m_encData);
                     pic_out->analysisData.saveParam = pic_out->analysisData.saveParam;
@@ -2102,6 +2328,12 @@ int Encoder::encode(const x265_picture* pic_in, x265_picture* pic_out)
                 curFrame = m_origPicBuffer->m_mcstfOrigPicList.getPOCMCSTF(outFrame->m_poc);
                 X265_CHECK(curFrame, "Outframe not found in OPB's mcstfOrigPicList");
                 curFrame->m_refPicCnt[1]--;
+
+                /* the frame encoder is done searching and filtering against
+                 * its references */
+                for (int i = 0; i < curEncoder->m_mcstfRefsHeld; i++)
+                    curEncoder->m_mcstfRefList[i].refFrame->m_refPicCnt[1]--;
+                curEncoder->m_mcstfRefsHeld = 0;
             }
 
             /* Allow this frame to be recycled if no frame encoders are using it for reference */
@@ -2369,7 +2601,8 @@ int Encoder::encode(const x265_picture* pic_in, x265_picture* pic_out)
             if (m_param->bIntraRefresh)
                  calcRefreshInterval(frameEnc);
 
-            // Generate MCSTF References and perform HME
+            /* Generate MCSTF references; the frame encoder performs the HME
+             * and filtering on its worker threads */
             if (m_param->bEnableTemporalFilter && isFilterThisframe(frameEnc->m_mcstf->m_sliceTypeConfig, frameEnc->m_lowres.sliceType))
             {
 
@@ -2382,38 +2615,6 @@ int Encoder::encode(const x265_picture* pic_in, x265_picture* pic_out)
                 }
 
 
-                if (!*frameEnc->m_isSubSampled)
-                {
-                    primitives.frameSubSampleLuma((const pixel *)frameEnc->m_fencPic->m_picOrg[0],frameEnc->m_fencPicSubsampled2->m_picOrg[0], frameEnc->m_fencPic->m_stride, frameEnc->m_fencPicSubsampled2->m_stride, frameEnc->m_fencPicSubsampled2->m_picWidth, frameEnc->m_fencPicSubsampled2->m_picHeight);
-                    extendPicBorder(frameEnc->m_fencPicSubsampled2->m_picOrg[0], frameEnc->m_fencPicSubsampled2->m_stride, frameEnc->m_fencPicSubsampled2->m_picWidth, frameEnc->m_fencPicSubsampled2->m_picHeight, frameEnc->m_fencPicSubsampled2->m_lumaMarginX, frameEnc->m_fencPicSubsampled2->m_lumaMarginY);
-                    primitives.frameSubSampleLuma((const pixel *)frameEnc->m_fencPicSubsampled2->m_picOrg[0],frameEnc->m_fencPicSubsampled4->m_picOrg[0], frameEnc->m_fencPicSubsampled2->m_stride, frameEnc->m_fencPicSubsampled4->m_stride, frameEnc->m_fencPicSubsampled4->m_picWidth, frameEnc->m_fencPicSubsampled4->m_picHeight);
-                    extendPicBorder(frameEnc->m_fencPicSubsampled4->m_picOrg[0], frameEnc->m_fencPicSubsampled4->m_stride, frameEnc->m_fencPicSubsampled4->m_picWidth, frameEnc->m_fencPicSubsampled4->m_picHeight, frameEnc->m_fencPicSubsampled4->m_lumaMarginX, frameEnc->m_fencPicSubsampled4->m_lumaMarginY);
-                    *frameEnc->m_isSubSampled = true;
-                }
-
-                for (uint8_t i = 1; i <= frameEnc->m_mcstf->m_numRef; i++)
-                {
-                    TemporalFilterRefPicInfo *ref = &curEncoder->m_mcstfRefList[i - 1];
-                    if (!*ref->isSubsampled)
-                    {
-                        primitives.frameSubSampleLuma((const pixel *)ref->picBuffer->m_picOrg[0], ref->picBufferSubSampled2->m_picOrg[0], ref->picBuffer->m_stride, ref->picBufferSubSampled2->m_stride, ref->picBufferSubSampled2->m_picWidth, ref->picBufferSubSampled2->m_picHeight);
-                        extendPicBorder(ref->picBufferSubSampled2->m_picOrg[0], ref->picBufferSubSampled2->m_stride, ref->picBufferSubSampled2->m_picWidth, ref->picBufferSubSampled2->m_picHeight, ref->picBufferSubSampled2->m_lumaMarginX, ref->picBufferSubSampled2->m_lumaMarginY);
-                        primitives.frameSubSampleLuma((const pixel *)ref->picBufferSubSampled2->m_picOrg[0],ref->picBufferSubSampled4->m_picOrg[0], ref->picBufferSubSampled2->m_stride, ref->picBufferSubSampled4->m_stride, ref->picBufferSubSampled4->m_picWidth, ref->picBufferSubSampled4->m_picHeight);
-                        extendPicBorder(ref->picBufferSubSampled4->m_picOrg[0], ref->picBufferSubSampled4->m_stride, ref->picBufferSubSampled4->m_picWidth, ref->picBufferSubSampled4->m_picHeight, ref->picBufferSubSampled4->m_lumaMarginX, ref->picBufferSubSampled4->m_lumaMarginY);
-                        *ref->isSubsampled = true;
-                    }
-                }
-
-                for (uint8_t i = 1; i <= frameEnc->m_mcstf->m_numRef; i++)
-                {
-                    TemporalFilterRefPicInfo *ref = &curEncoder->m_mcstfRefList[i - 1];
-
-                    curEncoder->m_frameEncTF->motionEstimationLuma(ref->mvs0, ref->mvsStride0, frameEnc->m_fencPicSubsampled4, ref->picBufferSubSampled4, 16);
-                    curEncoder->m_frameEncTF->motionEstimationLuma(ref->mvs1, ref->mvsStride1, frameEnc->m_fencPicSubsampled2, ref->picBufferSubSampled2, 16, ref->mvs0, ref->mvsStride0, 2);
-                    curEncoder->m_frameEncTF->motionEstimationLuma(ref->mvs2, ref->mvsStride2, frameEnc->m_fencPic, ref->picBuffer, 16, ref->mvs1, ref->mvsStride1, 2);
-                    curEncoder->m_frameEncTF->motionEstimationLumaDoubleRes(ref->mvs,  ref->mvsStride, frameEnc->m_fencPic, ref->picBuffer, 8, ref->mvs2, ref->mvsStride2, 1, ref->error);
-                }
-
                 for (int i = 0; i < frameEnc->m_mcstf->m_numRef; i++)
                 {
                     TemporalFilterRefPicInfo *ref = &curEncoder->m_mcstfRefList[i];
@@ -2429,6 +2630,14 @@ int Encoder::encode(const x265_picture* pic_in, x265_picture* pic_out)
                             ref->slicetype = X265_TYPE_I;
                     }
                 }
+
+                /* keep the references out of the recycle lists until this
+                 * frame is output, then start the motion search against them
+                 * on idle workers while the frame waits for rate control */
+                for (int i = 0; i < frameEnc->m_mcstf->m_numRef; i++)
+                    curEncoder->m_mcstfRefList[i].refFrame->m_refPicCnt[1]++;
+                curEncoder->m_mcstfRefsHeld = frameEnc->m_mcstf->m_numRef;
+                curEncoder->m_frameEncTF->startMotionEstimation(frameEnc, curEncoder->m_mcstfRefList);
             }
 
             /* Allow FrameEncoder::compressFrame() to start in the frame encoder thread */
@@ -2712,6 +2921,8 @@ void Encoder::printSummary()
             (float)100.0 * m_numLumaWPBiFrames / m_analyzeB.m_numPics,
             (float)100.0 * m_numChromaWPBiFrames / m_analyzeB.m_numPics);
     }
+    if (m_lookahead && m_lookahead->m_slicePool)
+        m_lookahead->m_slicePool->logStats(m_param);
 
     if (m_param->bLossless)
     {
@@ -3071,6 +3282,11 @@ void Encoder::finishFrameStats(Frame* curFrame, FrameEncoder *curEncoder, x265_f
         double psnr = (psnrY * 6 + psnrU + psnrV) / 8;
         frameStats->psnr = psnr;
         frameStats->ssim = ssim;
+        frameStats->ctuPsnrY = curEncData.m_ctuPsnr[0];
+        frameStats->ctuPsnrU = curEncData.m_ctuPsnr[1];
+        frameStats->ctuPsnrV = curEncData.m_ctuPsnr[2];
+        frameStats->ctuSsim = curEncData.m_ctuSsim;
+        frameStats->numCtus = m_param->bEnableCtuMetrics ? slice->m_sps->numCUsInFrame : 0;
         if (!slice->isIntra())
         {
             for (int ref = 0; ref < MAX_NUM_REF; ref++)
@@ -4023,16 +4239,26 @@ void Encoder::configure(x265_param *p)
     uint32_t padsize = 0;
     if (m_param->analysisLoad && m_param->bUseAnalysisFile)
     {
-        m_analysisFileIn = x265_fopen(m_param->analysisLoad, "rb");
-        if (!m_analysisFileIn)
+        if (useAnalysisSharedMem(p))
         {
-            x265_log_file(NULL, X265_LOG_ERROR, "Analysis load: failed to open file %s\n", m_param->analysisLoad);
-            m_aborted = true;
+            if (!openAnalysisSharedMem(false))
+                m_aborted = true;
         }
         else
+        {
+            m_analysisFileIn = x265_fopen(m_param->analysisLoad, "rb");
+            if (!m_analysisFileIn)
+            {
+                x265_log_file(NULL, X265_LOG_ERROR, "Analysis load: failed to open file %s\n", m_param->analysisLoad);
+                m_aborted = true;
+            }
+            else
+                mapAnalysisFile();
+        }
+        if (m_analysisFileIn || m_analysisShrMemIn)
         {
             int rightOffset, bottomOffset;
-            if (fread(&rightOffset, sizeof(int), 1, m_analysisFileIn) != 1)
+            if (readAnalysisBytes(&rightOffset, sizeof(int), 1) != 1)
             {
                 x265_log(NULL, X265_LOG_ERROR, "Error reading analysis data. Conformance window right offset missing\n");
                 m_aborted = true;
@@ -4046,7 +4272,7 @@ void Encoder::configure(x265_param *p)
                 m_conformanceWindow.rightOffset = padsize;
             }
 
-            if (fread(&bottomOffset, sizeof(int), 1, m_analysisFileIn) != 1)
+            if (readAnalysisBytes(&bottomOffset, sizeof(int), 1) != 1)
             {
                 x265_log(NULL, X265_LOG_ERROR, "Error reading analysis data. Conformance window bottom offset missing\n");
                 m_aborted = true;
@@ -4151,6 +4377,12 @@ void Encoder::configure(x265_param *p)
         x265_log(m_param, X265_LOG_WARNING, "Frame-duplication require NAL HRD and VBV parameters. Disabling frame duplication\n");
         m_param->bEnableFrameDuplication = 0;
     }
+
+    if (!p->bCopyPicToFrame && (p->bEnableFrameDuplication || p->bEnableTemporalFilter || p->bEncoderDither))
+    {
+        x265_log(p, X265_LOG_WARNING, "no-copy-pic is not compatible with frame-duplication, mcstf and encoder-dither, which keep their own copies of the input. Enabling copy-pic\n");
+        p->bCopyPicToFrame = 1;
+    }
 #ifdef ENABLE_HDR10_PLUS
     if (m_param->bDhdr10opt && m_param->toneMapFile == NULL)
     {
@@ -4443,7 +4675,7 @@ void Encoder::readAnalysisFile(x265_analysis_data* analysis, int curPoc, const x
         {\
         memcpy(val, src, (size * readSize));\
         }\
-        else if (fread(val, size, readSize, fileOffset) != readSize)\
+        else if (readAnalysisBytes(val, size, readSize) != readSize)\
     {\
         x265_log(NULL, X265_LOG_ERROR, "Error reading analysis data\n");\
         x265_free_analysis_data(m_param, analysis);\
@@ -4451,11 +4683,21 @@ void Encoder::readAnalysisFile(x265_analysis_data* analysis, int curPoc, const x
         return;\
     }\
 
-    static uint64_t consumedBytes = 0;
-    static uint64_t totalConsumedBytes = 0;
     uint32_t depthBytes = 0;
+    bool bIndexed = false;
     if (m_param->bUseAnalysisFile)
-        fseeko(m_analysisFileIn, totalConsumedBytes + paramBytes, SEEK_SET);
+    {
+        /* the POC index of the file locates the record directly, older files
+         * are scanned forward from the last consumed P frame */
+        bIndexed = m_analysisPocOffset && curPoc >= 0 && curPoc < m_analysisPocCount;
+        if (bIndexed && m_analysisPocOffset[curPoc] < 0)
+        {
+            x265_log(NULL, X265_LOG_WARNING, "Error reading analysis data: Cannot find POC %d\n", curPoc);
+            x265_free_analysis_data(m_param, analysis);
+            return;
+        }
+        seekAnalysisFile(bIndexed ? (uint64_t)m_analysisPocOffset[curPoc] : m_analysisTotalConsumedBytes + paramBytes);
+    }
     const x265_analysis_data *picData = &(picIn->analysisData);
     x265_analysis_intra_data *intraPic = picData->intraData;
     x265_analysis_inter_data *interPic = picData->interData;
@@ -4468,18 +4710,18 @@ void Encoder::readAnalysisFile(x265_analysis_data* analysis, int curPoc, const x
 
     if (m_param->bUseAnalysisFile)
     {
-        uint64_t currentOffset = totalConsumedBytes;
+        uint64_t currentOffset = m_analysisTotalConsumedBytes;
 
         /* Seeking to the right frame Record */
-        while (poc != curPoc && !feof(m_analysisFileIn))
+        while (!bIndexed && poc != curPoc && !analysisFileEnd())
         {
             currentOffset += frameRecordSize;
-            fseeko(m_analysisFileIn, currentOffset + paramBytes, SEEK_SET);
+            seekAnalysisFile(currentOffset + paramBytes);
             X265_FREAD(&frameRecordSize, sizeof(uint32_t), 1, m_analysisFileIn, &(picData->frameRecordSize));
             X265_FREAD(&depthBytes, sizeof(uint32_t), 1, m_analysisFileIn, &(picData->depthBytes));
             X265_FREAD(&poc, sizeof(int), 1, m_analysisFileIn, &(picData->poc));
         }
-        if (poc != curPoc || feof(m_analysisFileIn))
+        if (poc != curPoc || analysisFileEnd())
         {
             x265_log(NULL, X265_LOG_WARNING, "Error reading analysis data: Cannot find POC %d\n", curPoc);
             x265_free_analysis_data(m_param, analysis);
@@ -4605,7 +4847,7 @@ void Encoder::readAnalysisFile(x265_analysis_data* analysis, int curPoc, const x
         if (m_param->rc.cuTree)
             X265_FREE(cuQPBuf);
         X265_FREE(tempBuf);
-        consumedBytes += frameRecordSize;
+        m_analysisConsumedBytes += frameRecordSize;
     }
 
     else
@@ -4751,9 +4993,9 @@ void Encoder::readAnalysisFile(x265_analysis_data* analysis, int curPoc, const x
         else
             X265_FREAD((analysis->interData)->ref, sizeof(int32_t), numCUsLoad * X265_MAX_PRED_MODE_PER_CTU * numDir, m_analysisFileIn, interPic->ref);
 
-        consumedBytes += frameRecordSize;
+        m_analysisConsumedBytes += frameRecordSize;
         if (numDir == 1)
-            totalConsumedBytes = consumedBytes;
+            m_analysisTotalConsumedBytes = m_analysisConsumedBytes;
     }
 
 #undef X265_FREAD
@@ -4766,7 +5008,7 @@ void Encoder::readAnalysisFile(x265_analysis_data* analysis, int curPoc, const x
     {\
         memcpy(val, src, (size * readSize));\
     }\
-    else if (fread(val, size, readSize, fileOffset) != readSize)\
+    else if (readAnalysisBytes(val, size, readSize) != readSize)\
     {\
         x265_log(NULL, X265_LOG_ERROR, "Error reading analysis data\n");\
         x265_free_analysis_data(m_param, analysis);\
@@ -4774,11 +5016,21 @@ void Encoder::readAnalysisFile(x265_analysis_data* analysis, int curPoc, const x
         return;\
     }\
 
-    static uint64_t consumedBytes = 0;
-    static uint64_t totalConsumedBytes = 0;
     uint32_t depthBytes = 0;
+    bool bIndexed = false;
     if (m_param->bUseAnalysisFile)
-        fseeko(m_analysisFileIn, totalConsumedBytes + paramBytes, SEEK_SET);
+    {
+        /* the POC index of the file locates the record directly, older files
+         * are scanned forward from the last consumed P frame */
+        bIndexed = m_analysisPocOffset && curPoc >= 0 && curPoc < m_analysisPocCount;
+        if (bIndexed && m_analysisPocOffset[curPoc] < 0)
+        {
+            x265_log(NULL, X265_LOG_WARNING, "Error reading analysis data: Cannot find POC %d\n", curPoc);
+            x265_free_analysis_data(m_param, analysis);
+            return;
+        }
+        seekAnalysisFile(bIndexed ? (uint64_t)m_analysisPocOffset[curPoc] : m_analysisTotalConsumedBytes + paramBytes);
+    }
 
     const x265_analysis_data *picData = &(picIn->analysisData);
     x265_analysis_intra_data *intraPic = picData->intraData;
@@ -4792,18 +5044,18 @@ void Encoder::readAnalysisFile(x265_analysis_data* analysis, int curPoc, const x
 
     if (m_param->bUseAnalysisFile)
     {
-        uint64_t currentOffset = totalConsumedBytes;
+        uint64_t currentOffset = m_analysisTotalConsumedBytes;
 
         /* Seeking to the right frame Record */
-        while (poc != curPoc && !feof(m_analysisFileIn))
+        while (!bIndexed && poc != curPoc && !analysisFileEnd())
         {
             currentOffset += frameRecordSize;
-            fseeko(m_analysisFileIn, currentOffset + paramBytes, SEEK_SET);
+            seekAnalysisFile(currentOffset + paramBytes);
             X265_FREAD(&frameRecordSize, sizeof(uint32_t), 1, m_analysisFileIn, &(picData->frameRecordSize));
             X265_FREAD(&depthBytes, sizeof(uint32_t), 1, m_analysisFileIn, &(picData->depthBytes));
             X265_FREAD(&poc, sizeof(int), 1, m_analysisFileIn, &(picData->poc));
         }
-        if (poc != curPoc || feof(m_analysisFileIn))
+        if (poc != curPoc || analysisFileEnd())
         {
             x265_log(NULL, X265_LOG_WARNING, "Error reading analysis data: Cannot find POC %d\n", curPoc);
             x265_free_analysis_data(m_param, analysis);
@@ -4972,7 +5224,7 @@ void Encoder::readAnalysisFile(x265_analysis_data* analysis, int curPoc, const x
         if (m_param->rc.cuTree)
             X265_FREE(cuQPBuf);
         X265_FREE(tempBuf);
-        consumedBytes += frameRecordSize;
+        m_analysisConsumedBytes += frameRecordSize;
     }
 
     else
@@ -5155,9 +5407,9 @@ void Encoder::readAnalysisFile(x265_analysis_data* analysis, int curPoc, const x
         else
             X265_FREAD((analysis->interData)->ref, sizeof(int32_t), analysis->numCUsInFrame * X265_MAX_PRED_MODE_PER_CTU * numDir, m_analysisFileIn, interPic->ref);
 
-        consumedBytes += frameRecordSize;
+        m_analysisConsumedBytes += frameRecordSize;
         if (numDir == 1)
-            totalConsumedBytes = consumedBytes;
+            m_analysisTotalConsumedBytes = m_analysisConsumedBytes;
     }
 
     /* Restore to the current encode's numPartitions and numCUsInFrame */
@@ -5168,14 +5420,247 @@ void Encoder::readAnalysisFile(x265_analysis_data* analysis, int curPoc, const x
 }
 
 
+void Encoder::mapAnalysisFile()
+{
+    /* map the analysis-load file read-only so that records are copied from the
+     * page cache instead of through stdio, and encoders loading the same file
+     * share its pages. Any failure leaves the stdio path in place */
+    uint64_t size = 0;
+    uint8_t* map = x265_map_file(m_analysisFileIn, &size);
+    if (!map)
+        return;
+    int64_t pos = ftello(m_analysisFileIn);
+    m_analysisMap = map;
+    m_analysisMapSize = size;
+    m_analysisMapPos = pos > 0 ? (uint64_t)pos : 0;
+    m_analysisRecordEnd = size;
+
+    if (size < ANALYSIS_INDEX_TRAILER_BYTES)
+        return;
+    const uint8_t* trailer = map + size - ANALYSIS_INDEX_TRAILER_BYTES;
+    if (memcmp(trailer + sizeof(uint64_t) + 2 * sizeof(uint32_t), ANALYSIS_INDEX_MAGIC, 8))
+        return;
+
+    uint64_t indexOffset;
+    uint32_t count, version;
+    memcpy(&indexOffset, trailer, sizeof(uint64_t));
+    memcpy(&count, trailer + sizeof(uint64_t), sizeof(uint32_t));
+    memcpy(&version, trailer + sizeof(uint64_t) + sizeof(uint32_t), sizeof(uint32_t));
+    if (version != ANALYSIS_INDEX_VERSION || !count ||
+        indexOffset + (uint64_t)count * ANALYSIS_INDEX_ENTRY_BYTES + ANALYSIS_INDEX_TRAILER_BYTES != size)
+    {
+        x265_log(NULL, X265_LOG_WARNING, "Analysis load: ignoring unrecognized POC index\n");
+        return;
+    }
+
+    const uint8_t* entries = map + indexOffset;
+    int32_t maxPoc = -1;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        int32_t poc;
+        memcpy(&poc, entries + i * ANALYSIS_INDEX_ENTRY_BYTES, sizeof(int32_t));
+        maxPoc = X265_MAX(maxPoc, poc);
+    }
+    if (maxPoc < 0)
+        return;
+
+    m_analysisPocOffset = X265_MALLOC(int64_t, maxPoc + 1);
+    if (!m_analysisPocOffset)
+        return;
+    for (int32_t poc = 0; poc <= maxPoc; poc++)
+        m_analysisPocOffset[poc] = -1;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        int32_t poc;
+        uint64_t offset;
+        memcpy(&poc, entries + i * ANALYSIS_INDEX_ENTRY_BYTES, sizeof(int32_t));
+        memcpy(&offset, entries + i * ANALYSIS_INDEX_ENTRY_BYTES + sizeof(int32_t), sizeof(uint64_t));
+        if (poc < 0 || offset >= indexOffset)
+        {
+            x265_log(NULL, X265_LOG_WARNING, "Analysis load: ignoring corrupt POC index\n");
+            X265_FREE(m_analysisPocOffset);
+            m_analysisPocOffset = NULL;
+            return;
+        }
+        m_analysisPocOffset[poc] = (int64_t)offset;
+    }
+    m_analysisPocCount = maxPoc + 1;
+    m_analysisRecordEnd = indexOffset;
+}
+
+void Encoder::unmapAnalysisFile()
+{
+    if (m_analysisMap)
+    {
+        x265_unmap_file(m_analysisMap, m_analysisMapSize);
+        m_analysisMap = NULL;
+        m_analysisMapSize = 0;
+    }
+    X265_FREE(m_analysisPocOffset);
+    m_analysisPocOffset = NULL;
+    m_analysisPocCount = 0;
+}
+
+bool Encoder::openAnalysisSharedMem(bool bWrite)
+{
+    char name[MAX_SHR_NAME_LEN] = { 0 };
+    snprintf(name, sizeof(name) - 1, "%s%s", m_param->rc.sharedMemName, ANALYSIS_SHARED_MEM_NAME);
+
+    RingMem* ring = new RingMem;
+    if (!ring->init(ANALYSIS_SHARED_ITEM_SIZE, ANALYSIS_SHARED_ITEM_CNT, name, false, m_param->sharedMemReaders))
+    {
+        x265_log(NULL, X265_LOG_ERROR, "Analysis %s: failed to open shared memory %s\n", bWrite ? "save" : "load", name);
+        delete ring;
+        return false;
+    }
+    if (bWrite)
+        m_analysisShrMemOut = ring;
+    else
+        m_analysisShrMemIn = ring;
+    return true;
+}
+
+bool Encoder::fillAnalysisWindow(uint64_t end)
+{
+    while (m_analysisWindowBase + m_analysisWindowSize < end)
+    {
+        int32_t size = m_analysisShrMemIn->nextRecordSize();
+        if (size < 0)
+            return false;
+
+        /* records are only revisited from the last consumed P frame on */
+        uint64_t keep = X265_MIN(m_analysisTotalConsumedBytes + m_analysisParamBytes, m_analysisMapPos);
+        if (keep > m_analysisWindowBase)
+        {
+            size_t drop = (size_t)X265_MIN(keep - m_analysisWindowBase, (uint64_t)m_analysisWindowSize);
+            memmove(m_analysisWindow, m_analysisWindow + drop, m_analysisWindowSize - drop);
+            m_analysisWindowBase += drop;
+            m_analysisWindowSize -= drop;
+        }
+
+        if (m_analysisWindowSize + size > m_analysisWindowAlloc)
+        {
+            size_t alloc = X265_MAX(m_analysisWindowAlloc * 2, m_analysisWindowSize + size);
+            uint8_t* temp = X265_MALLOC(uint8_t, alloc);
+            if (!temp)
+                return false;
+            if (m_analysisWindowSize)
+                memcpy(temp, m_analysisWindow, m_analysisWindowSize);
+            X265_FREE(m_analysisWindow);
+            m_analysisWindow = temp;
+            m_analysisWindowAlloc = alloc;
+        }
+        if (!m_analysisShrMemIn->readRecord(m_analysisWindow + m_analysisWindowSize))
+            return false;
+        m_analysisWindowSize += size;
+    }
+    return true;
+}
+
+size_t Encoder::readAnalysisBytes(void* dst, size_t size, size_t count)
+{
+    if (m_analysisShrMemIn)
+    {
+        fillAnalysisWindow(m_analysisMapPos + (uint64_t)size * count);
+        uint64_t end = m_analysisWindowBase + m_analysisWindowSize;
+        if (m_analysisMapPos < m_analysisWindowBase)
+            return 0;
+        uint64_t avail = m_analysisMapPos < end ? end - m_analysisMapPos : 0;
+        if (size && (uint64_t)size * count > avail)
+            count = (size_t)(avail / size);
+        memcpy(dst, m_analysisWindow + (m_analysisMapPos - m_analysisWindowBase), size * count);
+        m_analysisMapPos += size * count;
+        return count;
+    }
+
+    if (!m_analysisMap)
+        return fread(dst, size, count, m_analysisFileIn);
+
+    uint64_t avail = m_analysisMapPos < m_analysisMapSize ? m_analysisMapSize - m_analysisMapPos : 0;
+    if (size && (uint64_t)size * count > avail)
+        count = (size_t)(avail / size);
+    memcpy(dst, m_analysisMap + m_analysisMapPos, size * count);
+    m_analysisMapPos += size * count;
+    return count;
+}
+
+void Encoder::seekAnalysisFile(uint64_t offset)
+{
+    if (m_analysisMap || m_analysisShrMemIn)
+        m_analysisMapPos = offset;
+    else
+        fseeko(m_analysisFileIn, offset, SEEK_SET);
+}
+
+bool Encoder::analysisFileEnd()
+{
+    if (m_analysisShrMemIn)
+        return !fillAnalysisWindow(m_analysisMapPos + 1);
+    if (m_analysisMap)
+        return m_analysisMapPos >= m_analysisRecordEnd;
+    return !!feof(m_analysisFileIn);
+}
+
+bool Encoder::addAnalysisIndexEntry(int poc, int64_t offset)
+{
+    if (offset < 0)
+        return false;
+    if (m_analysisSaveCount == m_analysisSaveAlloc)
+    {
+        int newAlloc = m_analysisSaveAlloc ? m_analysisSaveAlloc * 2 : 1024;
+        AnalysisIndexEntry* entries = X265_MALLOC(AnalysisIndexEntry, newAlloc);
+        if (!entries)
+            return false;
+        if (m_analysisSaveCount)
+            memcpy(entries, m_analysisSaveIndex, m_analysisSaveCount * sizeof(AnalysisIndexEntry));
+        X265_FREE(m_analysisSaveIndex);
+        m_analysisSaveIndex = entries;
+        m_analysisSaveAlloc = newAlloc;
+    }
+    m_analysisSaveIndex[m_analysisSaveCount].poc = poc;
+    m_analysisSaveIndex[m_analysisSaveCount].offset = (uint64_t)offset;
+    m_analysisSaveCount++;
+    return true;
+}
+
+void Encoder::writeAnalysisIndex()
+{
+    if (!m_analysisSaveCount)
+        return;
+
+    uint64_t indexOffset = m_analysisWriter->tell();
+    bool bOk = true;
+    for (int i = 0; i < m_analysisSaveCount && bOk; i++)
+    {
+        int32_t poc = m_analysisSaveIndex[i].poc;
+        bOk = m_analysisWriter->write(&poc, sizeof(int32_t)) &&
+              m_analysisWriter->write(&m_analysisSaveIndex[i].offset, sizeof(uint64_t));
+    }
+    if (bOk)
+    {
+        uint32_t count = (uint32_t)m_analysisSaveCount;
+        uint32_t version = ANALYSIS_INDEX_VERSION;
+        bOk = m_analysisWriter->write(&indexOffset, sizeof(uint64_t)) &&
+              m_analysisWriter->write(&count, sizeof(uint32_t)) &&
+              m_analysisWriter->write(&version, sizeof(uint32_t)) &&
+              m_analysisWriter->write(ANALYSIS_INDEX_MAGIC, 8) &&
+              m_analysisWriter->commit();
+    }
+    if (!bOk)
+        x265_log(NULL, X265_LOG_WARNING, "Analysis save: failed to write POC index\n");
+
+    X265_FREE(m_analysisSaveIndex);
+    m_analysisSaveIndex = NULL;
+    m_analysisSaveCount = m_analysisSaveAlloc = 0;
+}
+
 int Encoder::validateAnalysisData(x265_analysis_validate* saveParam, int writeFlag)
 {
 #define X265_PARAM_VALIDATE(analysisParam, size, bytes, param, errorMsg)\
     if(!writeFlag)\
     {\
-        fileOffset = m_analysisFileIn;\
         if ((!m_param->bUseAnalysisFile && analysisParam != (int)*param) || \
-            (m_param->bUseAnalysisFile && (fread(&readValue, size, bytes, fileOffset) != bytes || (readValue != (int)*param))))\
+            (m_param->bUseAnalysisFile && (readAnalysisBytes(&readValue, size, bytes) != bytes || (readValue != (int)*param))))\
         {\
             x265_log(NULL, X265_LOG_ERROR, "Error reading analysis data. Incompatible option : <%s> \n", #errorMsg);\
             m_aborted = true;\
@@ -5184,10 +5669,9 @@ int Encoder::validateAnalysisData(x265_analysis_validate* saveParam, int writeFl
     }\
     if(writeFlag)\
     {\
-        fileOffset = m_analysisFileOut;\
         if(!m_param->bUseAnalysisFile)\
             analysisParam = *param;\
-        else if(fwrite(param, size, bytes, fileOffset) < bytes)\
+        else if (!m_analysisWriter->write(param, size * bytes))\
         {\
             x265_log(NULL, X265_LOG_ERROR, "Error writing analysis data\n"); \
             m_aborted = true;\
@@ -5201,7 +5685,7 @@ int Encoder::validateAnalysisData(x265_analysis_validate* saveParam, int writeFl
     {\
         memcpy(val, src, (size * readSize));\
     }\
-    else if (fread(val, size, readSize, fileOffset) != readSize)\
+    else if (readAnalysisBytes(val, size, readSize) != readSize)\
     {\
         x265_log(NULL, X265_LOG_ERROR, "Error reading analysis data\n");\
         m_aborted = true;\
@@ -5209,7 +5693,6 @@ int Encoder::validateAnalysisData(x265_analysis_validate* saveParam, int writeFl
     }\
     count++;
 
-    FILE*     fileOffset = NULL;
     int       readValue = 0;
     int       count = 0;
 
@@ -5246,8 +5729,6 @@ int Encoder::validateAnalysisData(x265_analysis_validate* saveParam, int writeFl
     }
     else
     {
-        fileOffset = m_analysisFileIn;
-
         int saveLevel = 0;
         bool isIncompatibleReuseLevel = false;
         int loadLevel = m_param->analysisLoadReuseLevel;
@@ -5566,11 +6047,47 @@ void Encoder::copyDistortionData(x265_analysis_data* analysis, FrameData &curEnc
     }
 }
 
+/* Take the AQ and cuTree offsets of a frame from the lookahead of the encode
+ * whose analysis is reused, resampling the other encode's QP group grid to
+ * ours by nearest neighbour. The offsets are QP deltas and need no scaling */
+void Encoder::loadQpOffsets(Frame* frame, const x265_analysis_data* analysis)
+{
+    Lowres& lowres = frame->m_lowres;
+    uint32_t cols = m_param->rc.qgSize > 8 ? lowres.maxBlocksInRow : lowres.maxBlocksInRowFullRes;
+    uint32_t rows = m_param->rc.qgSize > 8 ? lowres.maxBlocksInCol : lowres.maxBlocksInColFullRes;
+    uint32_t srcCols = analysis->qpOffsetCols;
+    uint32_t srcRows = analysis->qpOffsetRows;
+
+    for (uint32_t y = 0; y < rows; y++)
+    {
+        const double* aq = analysis->qpAqOffset + ((2 * y + 1) * srcRows / (2 * rows)) * srcCols;
+        const double* cuTree = analysis->qpCuTreeOffset + ((2 * y + 1) * srcRows / (2 * rows)) * srcCols;
+        for (uint32_t x = 0; x < cols; x++)
+        {
+            uint32_t srcX = (2 * x + 1) * srcCols / (2 * cols);
+            uint32_t idx = y * cols + x;
+            lowres.qpAqOffset[idx] = aq[srcX];
+            lowres.qpCuTreeOffset[idx] = cuTree[srcX];
+            lowres.invQscaleFactor[idx] = x265_exp2fix8(cuTree[srcX]);
+        }
+    }
+}
+
 void Encoder::writeAnalysisFile(x265_analysis_data* analysis, FrameData &curEncData)
 {
 
-#define X265_FWRITE(val, size, writeSize, fileOffset)\
-    if (fwrite(val, size, writeSize, fileOffset) < writeSize)\
+#define X265_FWRITE(val, size, writeSize)\
+    if (!m_analysisWriter->write(val, (size) * (writeSize)))\
+    {\
+        x265_log(NULL, X265_LOG_ERROR, "Error writing analysis data\n");\
+        x265_free_analysis_data(m_param, analysis);\
+        m_aborted = true;\
+        return;\
+    }\
+
+    /* hands the serialized record to the writer thread */
+#define X265_FCOMMIT()\
+    if (!m_analysisWriter->commit())\
     {\
         x265_log(NULL, X265_LOG_ERROR, "Error writing analysis data\n");\
         x265_free_analysis_data(m_param, analysis);\
@@ -5733,66 +6250,87 @@ void Encoder::writeAnalysisFile(x265_analysis_data* analysis, FrameData &curEncD
     if (!m_param->bUseAnalysisFile)
         return;
 
-    X265_FWRITE(&analysis->frameRecordSize, sizeof(uint32_t), 1, m_analysisFileOut);
-    X265_FWRITE(&depthBytes, sizeof(uint32_t), 1, m_analysisFileOut);
-    X265_FWRITE(&analysis->poc, sizeof(int), 1, m_analysisFileOut);
-    X265_FWRITE(&analysis->sliceType, sizeof(int), 1, m_analysisFileOut);
-    X265_FWRITE(&analysis->bScenecut, sizeof(int), 1, m_analysisFileOut);
-    X265_FWRITE(&analysis->satdCost, sizeof(int64_t), 1, m_analysisFileOut);
-    X265_FWRITE(&analysis->numCUsInFrame, sizeof(int), 1, m_analysisFileOut);
-    X265_FWRITE(&analysis->numPartitions, sizeof(int), 1, m_analysisFileOut);
+    if (!addAnalysisIndexEntry(analysis->poc, m_analysisWriter->tell()))
+    {
+        x265_log(NULL, X265_LOG_ERROR, "Error writing analysis data\n");
+        x265_free_analysis_data(m_param, analysis);
+        m_aborted = true;
+        return;
+    }
+    X265_FWRITE(&analysis->frameRecordSize, sizeof(uint32_t), 1);
+    X265_FWRITE(&depthBytes, sizeof(uint32_t), 1);
+    X265_FWRITE(&analysis->poc, sizeof(int), 1);
+    X265_FWRITE(&analysis->sliceType, sizeof(int), 1);
+    X265_FWRITE(&analysis->bScenecut, sizeof(int), 1);
+    X265_FWRITE(&analysis->satdCost, sizeof(int64_t), 1);
+    X265_FWRITE(&analysis->numCUsInFrame, sizeof(int), 1);
+    X265_FWRITE(&analysis->numPartitions, sizeof(int), 1);
     if (m_param->ctuDistortionRefine == CTU_DISTORTION_INTERNAL)
-        X265_FWRITE((analysis->distortionData)->ctuDistortion, sizeof(sse_t), analysis->numCUsInFrame, m_analysisFileOut);
+        X265_FWRITE((analysis->distortionData)->ctuDistortion, sizeof(sse_t), analysis->numCUsInFrame);
     if (analysis->sliceType > X265_TYPE_I)
-        X265_FWRITE((WeightParam*)analysis->wt, sizeof(WeightParam), numPlanes * numDir, m_analysisFileOut);
+        X265_FWRITE((WeightParam*)analysis->wt, sizeof(WeightParam), numPlanes * numDir);
 
     if (m_param->analysisSaveReuseLevel < 2)
+    {
+        X265_FCOMMIT();
         return;
+    }
 
     if (analysis->sliceType == X265_TYPE_IDR || analysis->sliceType == X265_TYPE_I)
     {
-        X265_FWRITE((analysis->intraData)->depth, sizeof(uint8_t), depthBytes, m_analysisFileOut);
-        X265_FWRITE((analysis->intraData)->chromaModes, sizeof(uint8_t), depthBytes, m_analysisFileOut);
-        X265_FWRITE((analysis->intraData)->partSizes, sizeof(char), depthBytes, m_analysisFileOut);
+        X265_FWRITE((analysis->intraData)->depth, sizeof(uint8_t), depthBytes);
+        X265_FWRITE((analysis->intraData)->chromaModes, sizeof(uint8_t), depthBytes);
+        X265_FWRITE((analysis->intraData)->partSizes, sizeof(char), depthBytes);
         if (m_param->rc.cuTree)
-            X265_FWRITE((analysis->intraData)->cuQPOff, sizeof(int8_t), depthBytes, m_analysisFileOut);
-        X265_FWRITE((analysis->intraData)->modes, sizeof(uint8_t), analysis->numCUsInFrame * analysis->numPartitions, m_analysisFileOut);
+            X265_FWRITE((analysis->intraData)->cuQPOff, sizeof(int8_t), depthBytes);
+        X265_FWRITE((analysis->intraData)->modes, sizeof(uint8_t), analysis->numCUsInFrame * analysis->numPartitions);
     }
     else
     {
-        X265_FWRITE((analysis->interData)->depth, sizeof(uint8_t), depthBytes, m_analysisFileOut);
-        X265_FWRITE((analysis->interData)->modes, sizeof(uint8_t), depthBytes, m_analysisFileOut);
+        X265_FWRITE((analysis->interData)->depth, sizeof(uint8_t), depthBytes);
+        X265_FWRITE((analysis->interData)->modes, sizeof(uint8_t), depthBytes);
         if (m_param->rc.cuTree)
-            X265_FWRITE((analysis->interData)->cuQPOff, sizeof(int8_t), depthBytes, m_analysisFileOut);
+            X265_FWRITE((analysis->interData)->cuQPOff, sizeof(int8_t), depthBytes);
         if (m_param->analysisSaveReuseLevel > 4)
         {
-            X265_FWRITE((analysis->interData)->partSize, sizeof(uint8_t), depthBytes, m_analysisFileOut);
-            X265_FWRITE((analysis->interData)->mergeFlag, sizeof(uint8_t), depthBytes, m_analysisFileOut);
+            X265_FWRITE((analysis->interData)->partSize, sizeof(uint8_t), depthBytes);
+            X265_FWRITE((analysis->interData)->mergeFlag, sizeof(uint8_t), depthBytes);
             if (m_param->analysisSaveReuseLevel == 10)
             {
-                X265_FWRITE((analysis->interData)->interDir, sizeof(uint8_t), depthBytes, m_analysisFileOut);
-                if (bIntraInInter) X265_FWRITE((analysis->intraData)->chromaModes, sizeof(uint8_t), depthBytes, m_analysisFileOut);
+                X265_FWRITE((analysis->interData)->interDir, sizeof(uint8_t), depthBytes);
+                if (bIntraInInter) X265_FWRITE((analysis->intraData)->chromaModes, sizeof(uint8_t), depthBytes);
                 for (uint32_t dir = 0; dir < numDir; dir++)
                 {
-                    X265_FWRITE((analysis->interData)->mvpIdx[dir], sizeof(uint8_t), depthBytes, m_analysisFileOut);
-                    X265_FWRITE((analysis->interData)->refIdx[dir], sizeof(int8_t), depthBytes, m_analysisFileOut);
-                    X265_FWRITE((analysis->interData)->mv[dir], sizeof(MV), depthBytes, m_analysisFileOut);
+                    X265_FWRITE((analysis->interData)->mvpIdx[dir], sizeof(uint8_t), depthBytes);
+                    X265_FWRITE((analysis->interData)->refIdx[dir], sizeof(int8_t), depthBytes);
+                    X265_FWRITE((analysis->interData)->mv[dir], sizeof(MV), depthBytes);
                 }
                 if (bIntraInInter)
-                    X265_FWRITE((analysis->intraData)->modes, sizeof(uint8_t), analysis->numCUsInFrame * analysis->numPartitions, m_analysisFileOut);
+                    X265_FWRITE((analysis->intraData)->modes, sizeof(uint8_t), analysis->numCUsInFrame * analysis->numPartitions);
             }
         }
         if (m_param->analysisSaveReuseLevel != 10)
-            X265_FWRITE((analysis->interData)->ref, sizeof(int32_t), analysis->numCUsInFrame * X265_MAX_PRED_MODE_PER_CTU * numDir, m_analysisFileOut);
+            X265_FWRITE((analysis->interData)->ref, sizeof(int32_t), analysis->numCUsInFrame * X265_MAX_PRED_MODE_PER_CTU * numDir);
 
     }
+    X265_FCOMMIT();
+#undef X265_FCOMMIT
 #undef X265_FWRITE
 }
 
 void Encoder::writeAnalysisFileRefine(x265_analysis_data* analysis, FrameData &curEncData)
 {
-#define X265_FWRITE(val, size, writeSize, fileOffset)\
-    if (fwrite(val, size, writeSize, fileOffset) < writeSize)\
+#define X265_FWRITE(val, size, writeSize)\
+    if (!m_analysisWriter->write(val, (size) * (writeSize)))\
+    {\
+    x265_log(NULL, X265_LOG_ERROR, "Error writing analysis 2 pass data\n"); \
+    x265_free_analysis_data(m_param, analysis); \
+    m_aborted = true; \
+    return; \
+}\
+
+#define X265_FCOMMIT()\
+    if (!m_analysisWriter->commit())\
     {\
     x265_log(NULL, X265_LOG_ERROR, "Error writing analysis 2 pass data\n"); \
     x265_free_analysis_data(m_param, analysis); \
@@ -5869,17 +6407,17 @@ void Encoder::writeAnalysisFileRefine(x265_analysis_data* analysis, FrameData &c
         analysis->frameRecordSize += depthBytes * sizeof(uint8_t) * numDir;
         analysis->frameRecordSize += depthBytes * sizeof(uint8_t);
     }
-    X265_FWRITE(&analysis->frameRecordSize, sizeof(uint32_t), 1, m_analysisFileOut);
-    X265_FWRITE(&depthBytes, sizeof(uint32_t), 1, m_analysisFileOut);
-    X265_FWRITE(&analysis->poc, sizeof(uint32_t), 1, m_analysisFileOut);
-    X265_FWRITE(distortionData->ctuDistortion, sizeof(sse_t), analysis->numCUsInFrame, m_analysisFileOut);
+    X265_FWRITE(&analysis->frameRecordSize, sizeof(uint32_t), 1);
+    X265_FWRITE(&depthBytes, sizeof(uint32_t), 1);
+    X265_FWRITE(&analysis->poc, sizeof(uint32_t), 1);
+    X265_FWRITE(distortionData->ctuDistortion, sizeof(sse_t), analysis->numCUsInFrame);
     if (curEncData.m_slice->m_sliceType == I_SLICE)
     {
-        X265_FWRITE((analysis->intraData)->depth, sizeof(uint8_t), depthBytes, m_analysisFileOut);
+        X265_FWRITE((analysis->intraData)->depth, sizeof(uint8_t), depthBytes);
     }
     else
     {
-        X265_FWRITE((analysis->interData)->depth, sizeof(uint8_t), depthBytes, m_analysisFileOut);
+        X265_FWRITE((analysis->interData)->depth, sizeof(uint8_t), depthBytes);
     }
     if (curEncData.m_slice->m_sliceType != I_SLICE)
     {
@@ -5887,12 +6425,14 @@ void Encoder::writeAnalysisFileRefine(x265_analysis_data* analysis, FrameData &c
         for (int i = 0; i < numDir; i++)
         {
             int32_t* ref = &(analysis->interData)->ref[i * analysis->numPartitions * analysis->numCUsInFrame];
-            X265_FWRITE(interData->mv[i], sizeof(MV), depthBytes, m_analysisFileOut);
-            X265_FWRITE(interData->mvpIdx[i], sizeof(uint8_t), depthBytes, m_analysisFileOut);
-            X265_FWRITE(ref, sizeof(int32_t), depthBytes, m_analysisFileOut);
+            X265_FWRITE(interData->mv[i], sizeof(MV), depthBytes);
+            X265_FWRITE(interData->mvpIdx[i], sizeof(uint8_t), depthBytes);
+            X265_FWRITE(ref, sizeof(int32_t), depthBytes);
         }
-        X265_FWRITE((analysis->interData)->modes, sizeof(uint8_t), depthBytes, m_analysisFileOut);
+        X265_FWRITE((analysis->interData)->modes, sizeof(uint8_t), depthBytes);
     }
+    X265_FCOMMIT();
+#undef X265_FCOMMIT
 #undef X265_FWRITE
 }
 
@@ -27,6 +27,7 @@
 #include "common.h"
 #include "slice.h"
 #include "threading.h"
+#include "threadpool.h"
 #include "scalinglist.h"
 #include "x265.h"
 #include "nal.h"
@@ -100,6 +101,13 @@ struct RefIdxLastGOP
     int numRefIdxl1[MAX_NUM_REF_IDX];
 };
 
+/* one entry of the POC index appended to analysis-save files */
+struct AnalysisIndexEntry
+{
+    int      poc;
+    uint64_t offset;
+};
+
 struct RPSListNode
 {
     int idx;
@@ -157,11 +165,37 @@ struct AdaptiveFrameDuplication
     bool bDup;
 };
 
+/* Dithers high bit depth input pictures into private 16-bit planes of the
+ * encoder's bit depth (--encoder-dither), one plane per job on the pool */
+class InputDither : public BondedTaskGroup
+{
+public:
+
+    const x265_picture* m_pic;
+    uint16_t*  m_planes[3];
+    int16_t*   m_errors[3];
+    int        m_width[3];
+    int        m_height[3];
+    int        m_numPlanes;
+    int        m_bitDepth;
+
+    InputDither();
+
+    bool create(const x265_param& param);
+    void destroy();
+
+    /* out becomes a copy of in whose planes are the dithered ones */
+    void dither(x265_picture& out, const x265_picture& in, ThreadPool* pool);
+
+    void processTasks(int workerThreadId);
+};
+
 class FrameEncoder;
 class DPB;
 class Lookahead;
 class RateControl;
-class ThreadPool;
+class AnalysisWriter;
+class RingMem;
 class FrameData;
 
 #define MAX_SCENECUT_THRESHOLD 1.0
@@ -203,8 +237,37 @@ public:
     FrameEncoder*      m_frameEncoder[X265_MAX_FRAME_THREADS];
     DPB*               m_dpb;
     Frame*             m_exportedPic;
+    InputDither        m_inputDither;
     FILE*              m_analysisFileIn;
     FILE*              m_analysisFileOut;
+    AnalysisWriter*    m_analysisWriter;      // serializes records to m_analysisFileOut off the encode thread
+
+    /* analysis-load file mapped read-only; records are copied out of the
+     * mapping and, when the file carries a POC index, found without a scan */
+    uint8_t*           m_analysisMap;
+    uint64_t           m_analysisMapSize;
+    uint64_t           m_analysisMapPos;
+    uint64_t           m_analysisRecordEnd;
+    int64_t*           m_analysisPocOffset;   // file offset of each POC's record, -1 when absent
+    int                m_analysisPocCount;
+
+    /* analysis records exchanged through shared memory instead of files. The
+     * loading side keeps the records from the last consumed P frame onwards in
+     * a window, addressed by the file offsets the records would have had */
+    RingMem*           m_analysisShrMemIn;
+    RingMem*           m_analysisShrMemOut;
+    uint8_t*           m_analysisWindow;
+    uint64_t           m_analysisWindowBase;
+    size_t             m_analysisWindowSize;
+    size_t             m_analysisWindowAlloc;
+    int                m_analysisParamBytes;
+    uint64_t           m_analysisConsumedBytes;
+    uint64_t           m_analysisTotalConsumedBytes;
+
+    /* record offsets written to the analysis-save file, appended as an index on close */
+    AnalysisIndexEntry* m_analysisSaveIndex;
+    int                m_analysisSaveCount;
+    int                m_analysisSaveAlloc;
     FILE*              m_naluFile;
     x265_param*        m_param;
     x265_param*        m_latestParam;     // Holds latest param during a reconfigure
@@ -233,6 +296,7 @@ public:
     bool               m_reconfigure;      // Encoder reconfigure in progress
     bool               m_reconfigureRc;
     bool               m_reconfigureZone;
+    bool               m_bTracing;         // joined the trace of param->traceFile
 
     int                m_saveCtuDistortionLevel;
 
@@ -352,10 +416,30 @@ public:
 
     void copyDistortionData(x265_analysis_data* analysis, FrameData &curEncData);
 
+    void loadQpOffsets(Frame* frame, const x265_analysis_data* analysis);
+
     void finishFrameStats(Frame* pic, FrameEncoder *curEncoder, x265_frame_stats* frameStats, int inPoc);
 
     int validateAnalysisData(x265_analysis_validate* param, int readWriteFlag);
 
+    void mapAnalysisFile();
+
+    void unmapAnalysisFile();
+
+    size_t readAnalysisBytes(void* dst, size_t size, size_t count);
+
+    void seekAnalysisFile(uint64_t offset);
+
+    bool openAnalysisSharedMem(bool bWrite);
+
+    bool fillAnalysisWindow(uint64_t end);
+
+    bool analysisFileEnd();
+
+    bool addAnalysisIndexEntry(int poc, int64_t offset);
+
+    void writeAnalysisIndex();
+
     void readUserSeiFile(x265_sei_payload& seiMsg, int poc);
 
     void calcRefreshInterval(Frame* frameEnc);
@@ -60,6 +60,7 @@ FrameEncoder::FrameEncoder()
     m_cuGeoms = NULL;
     m_ctuGeomMap = NULL;
     m_localTldIdx = 0;
+    m_mcstfRefsHeld = 0;
     memset(&m_rce, 0, sizeof(RateControlEntry));
 }
 
@@ -105,8 +106,6 @@ void FrameEncoder::destroy()
 
     if (m_param->bEnableTemporalFilter)
     {
-        delete m_frameEncTF->m_metld;
-
         for (int i = 0; i < (m_frameEncTF->m_range << 1); i++)
             m_frameEncTF->destroyRefPicInfo(&m_mcstfRefList[i]);
 
@@ -210,7 +209,10 @@ bool FrameEncoder::init(Encoder *top, int numRows, int numCols)
     {
         m_frameEncTF = new TemporalFilter();
         if (m_frameEncTF)
+        {
             m_frameEncTF->init(m_param);
+            m_frameEncTF->m_pool = m_pool;
+        }
 
         for (int i = 0; i < (m_frameEncTF->m_range << 1); i++)
             ok &= !!m_frameEncTF->createRefPicInfo(&m_mcstfRefList[i], m_param);
@@ -421,6 +423,9 @@ void FrameEncoder::writeTrailingSEIMessages()
     int planes = (m_param->internalCsp != X265_CSP_I400) ? 3 : 1;
     int32_t payloadSize = 0;
 
+    if (m_bAsyncHash)
+        m_pictureHash.finish();
+
     if (m_param->decodedPictureHashSEI == 1)
     {
         m_seiReconPictureDigest.m_method = SEIDecodedPictureHash::MD5;
@@ -449,7 +454,7 @@ void FrameEncoder::writeTrailingSEIMessages()
 
 void FrameEncoder::compressFrame()
 {
-    ProfileScopeEvent(frameThread);
+    ProfileScopeEventArg(frameThread, m_frame->m_poc);
 
     m_startCompressTime = x265_mdate();
     m_totalActiveWorkerCount = 0;
@@ -459,8 +464,13 @@ void FrameEncoder::compressFrame()
     m_countRowBlocks = 0;
     m_allRowsAvailableTime = 0;
     m_stallStartTime = 0;
+    m_bAsyncHash = false;
+    m_pictureHash.master = this;
 
     m_completionCount = 0;
+    m_bAsyncHash = m_param->decodedPictureHashSEI && m_param->bHashAsync && m_pool && m_param->maxSlices == 1;
+    if (m_bAsyncHash)
+        m_pictureHash.reset(m_param->internalCsp != X265_CSP_I400 ? 3 : 1);
     memset((void*)m_bAllRowsStop, 0, sizeof(bool) * m_param->maxSlices);
     memset((void*)m_vbvResetTriggerRow, -1, sizeof(int) * m_param->maxSlices);
     m_rowSliceTotalBits[0] = 0;
@@ -579,7 +589,7 @@ void FrameEncoder::compressFrame()
             if ((bUseWeightP || bUseWeightB) && slice->m_weightPredTable[l][ref][0].wtPresent)
                 w = slice->m_weightPredTable[l][ref];
             slice->m_refReconPicList[l][ref] = slice->m_refFrameList[l][ref]->m_reconPic;
-            m_mref[l][ref].init(slice->m_refReconPicList[l][ref], w, *m_param);
+            m_mref[l][ref].init(slice->m_refFrameList[l][ref], w, *m_param);
         }
         if (m_param->analysisSave && (bUseWeightP || bUseWeightB))
         {
@@ -602,6 +612,10 @@ void FrameEncoder::compressFrame()
 
     if (m_param->bEnableTemporalFilter)
     {
+        /* the MCSTF motion search started at dispatch runs while rate control
+         * blocks; only the filter itself needs its vectors */
+        if (m_top->isFilterThisframe(m_frame->m_mcstf->m_sliceTypeConfig, m_frame->m_lowres.sliceType))
+            m_frameEncTF->finishMotionEstimation();
         m_frameEncTF->m_QP = qp;
         m_frameEncTF->bilateralFilter(m_frame, m_mcstfRefList, m_param->temporalFilterStrength);
     }
@@ -899,11 +913,17 @@ void FrameEncoder::compressFrame()
                         // NOTE: we unnecessary wait row that beyond current slice boundary
                         const int rowIdx = X265_MIN(sliceEndRow, (row + m_refLagRows));
 
-                        while (refpic->m_reconRowFlag[rowIdx].get() == 0)
-                            refpic->m_reconRowFlag[rowIdx].waitForChange(0);
+                        if (refpic->m_reconRowFlag[rowIdx].get() == 0)
+                        {
+                            ProfileScopeEventArg(refWait, m_frame->m_poc);
+                            while (refpic->m_reconRowFlag[rowIdx].get() == 0)
+                                refpic->m_reconRowFlag[rowIdx].waitForChange(0);
+                        }
 
                         if ((bUseWeightP || bUseWeightB) && m_mref[l][ref].isWeighted)
                             m_mref[l][ref].applyWeight(rowIdx, m_numRows, sliceEndRow, sliceId);
+                        if (m_mref[l][ref].hpelPlane[0])
+                            m_mref[l][ref].applyHpel(rowIdx, m_numRows);
                     }
                 }
 
@@ -939,11 +959,17 @@ void FrameEncoder::compressFrame()
                         Frame *refpic = slice->m_refFrameList[list][ref];
 
                         const int rowIdx = X265_MIN(m_numRows - 1, (i + m_refLagRows));
-                        while (refpic->m_reconRowFlag[rowIdx].get() == 0)
-                            refpic->m_reconRowFlag[rowIdx].waitForChange(0);
+                        if (refpic->m_reconRowFlag[rowIdx].get() == 0)
+                        {
+                            ProfileScopeEventArg(refWait, m_frame->m_poc);
+                            while (refpic->m_reconRowFlag[rowIdx].get() == 0)
+                                refpic->m_reconRowFlag[rowIdx].waitForChange(0);
+                        }
 
                         if ((bUseWeightP || bUseWeightB) && m_mref[l][ref].isWeighted)
                             m_mref[list][ref].applyWeight(rowIdx, m_numRows, m_numRows, 0);
+                        if (m_mref[list][ref].hpelPlane[0])
+                            m_mref[list][ref].applyHpel(rowIdx, m_numRows);
                     }
                 }
 
@@ -1125,6 +1151,8 @@ void FrameEncoder::compressFrame()
     if (m_param->decodedPictureHashSEI)
         writeTrailingSEIMessages();
 
+    m_frameFilter.finishMetrics();
+
     uint64_t bytes = 0;
     for (uint32_t i = 0; i < m_nalList.m_numNal; i++)
     {
@@ -1224,75 +1252,128 @@ void FrameEncoder::compressFrame()
 }
 
 void FrameEncoder::initDecodedPictureHashSEI(int row, int cuAddr, int height)
+{
+    int planes = m_param->internalCsp != X265_CSP_I400 ? 3 : 1;
+
+    if (m_param->decodedPictureHashSEI)
+    {
+        for (int plane = 0; plane < planes; plane++)
+            updatePictureHash(plane, row, cuAddr, height);
+    }
+}
+
+void FrameEncoder::updatePictureHash(int plane, int row, int cuAddr, int height)
 {
     PicYuv *reconPic = m_frame->m_reconPic;
-    uint32_t width = reconPic->m_picWidth;	
+    uint32_t width = reconPic->m_picWidth;
     intptr_t stride = reconPic->m_stride;
     uint32_t maxCUHeight = m_param->maxCUSize;
 
-    const uint32_t hChromaShift = CHROMA_H_SHIFT(m_param->internalCsp);
-    const uint32_t vChromaShift = CHROMA_V_SHIFT(m_param->internalCsp);
+    if (plane)
+    {
+        width >>= CHROMA_H_SHIFT(m_param->internalCsp);
+        height >>= CHROMA_V_SHIFT(m_param->internalCsp);
+        stride = reconPic->m_strideC;
+        maxCUHeight >>= CHROMA_V_SHIFT(m_param->internalCsp);
+    }
 
     if (m_param->decodedPictureHashSEI == 1)
     {
         if (!row)
-            MD5Init(&m_seiReconPictureDigest.m_state[0]);
-
-        updateMD5Plane(m_seiReconPictureDigest.m_state[0], reconPic->getLumaAddr(cuAddr), width, height, stride);
-        if (m_param->internalCsp != X265_CSP_I400)
-        {
-            if (!row)
-            {
-                MD5Init(&m_seiReconPictureDigest.m_state[1]);
-                MD5Init(&m_seiReconPictureDigest.m_state[2]);
-            }
-
-            width >>= hChromaShift;
-            height >>= vChromaShift;
-            stride = reconPic->m_strideC;
+            MD5Init(&m_seiReconPictureDigest.m_state[plane]);
 
-            updateMD5Plane(m_seiReconPictureDigest.m_state[1], reconPic->getCbAddr(cuAddr), width, height, stride);
-            updateMD5Plane(m_seiReconPictureDigest.m_state[2], reconPic->getCrAddr(cuAddr), width, height, stride);
-        }
+        updateMD5Plane(m_seiReconPictureDigest.m_state[plane], reconPic->getPlaneAddr(plane, cuAddr), width, height, stride);
     }
     else if (m_param->decodedPictureHashSEI == 2)
     {
-
         if (!row)
-            m_seiReconPictureDigest.m_crc[0] = 0xffff;
+            m_seiReconPictureDigest.m_crc[plane] = PICTURE_CRC_INIT;
 
-        updateCRC(reconPic->getLumaAddr(cuAddr), m_seiReconPictureDigest.m_crc[0], height, width, stride);
-        if (m_param->internalCsp != X265_CSP_I400)
-        {
-            width >>= hChromaShift;
-            height >>= vChromaShift;
-            stride = reconPic->m_strideC;
-            m_seiReconPictureDigest.m_crc[1] = m_seiReconPictureDigest.m_crc[2] = 0xffff;
-
-            updateCRC(reconPic->getCbAddr(cuAddr), m_seiReconPictureDigest.m_crc[1], height, width, stride);
-            updateCRC(reconPic->getCrAddr(cuAddr), m_seiReconPictureDigest.m_crc[2], height, width, stride);
-        }
+        updateCRC(reconPic->getPlaneAddr(plane, cuAddr), m_seiReconPictureDigest.m_crc[plane], height, width, stride);
     }
     else if (m_param->decodedPictureHashSEI == 3)
     {
         if (!row)
-            m_seiReconPictureDigest.m_checksum[0] = 0;
+            m_seiReconPictureDigest.m_checksum[plane] = 0;
 
-        updateChecksum(reconPic->m_picOrg[0], m_seiReconPictureDigest.m_checksum[0], height, width, stride, row, maxCUHeight);
-        if (m_param->internalCsp != X265_CSP_I400)
-        {
-            width >>= hChromaShift;
-            height >>= vChromaShift;
-            stride = reconPic->m_strideC;
-            maxCUHeight >>= vChromaShift;
+        updateChecksum(reconPic->m_picOrg[plane], m_seiReconPictureDigest.m_checksum[plane], height, width, stride, row, maxCUHeight);
+    }
+}
+
+void FrameEncoder::PictureHash::reset(int numPlanes)
+{
+    waitForExit();
+    m_exitedPeerCount.set(0);
+    m_bondedPeerCount = 0;
+    m_numPlanes = numPlanes;
+    m_rowsReady = 0;
+    for (int plane = 0; plane < 3; plane++)
+    {
+        m_rowsHashed[plane] = 0;
+        m_planeBusy[plane] = false;
+    }
+}
 
-            if (!row)
-                m_seiReconPictureDigest.m_checksum[1] = m_seiReconPictureDigest.m_checksum[2] = 0;
+void FrameEncoder::PictureHash::rowDone(int row)
+{
+    ScopedLock lock(m_lock);
 
-            updateChecksum(reconPic->m_picOrg[1], m_seiReconPictureDigest.m_checksum[1], height, width, stride, row, maxCUHeight);
-            updateChecksum(reconPic->m_picOrg[2], m_seiReconPictureDigest.m_checksum[2], height, width, stride, row, maxCUHeight);
-        }
+    m_rowsReady = row + 1;
+
+    int idlePlanes = 0;
+    for (int plane = 0; plane < m_numPlanes; plane++)
+        idlePlanes += !m_planeBusy[plane];
+
+    /* a plane being hashed picks up the new row when its thread is done */
+    if (idlePlanes)
+        tryBondPeers(*master->m_pool, idlePlanes);
+}
+
+void FrameEncoder::PictureHash::finish()
+{
+    waitForExit();
+
+    for (int plane = 0; plane < m_numPlanes; plane++)
+        hashRows(plane);
+}
+
+void FrameEncoder::PictureHash::processTasks(int /* workerThreadId */)
+{
+    bool progress;
+    do
+    {
+        progress = false;
+        for (int plane = 0; plane < m_numPlanes; plane++)
+            progress |= hashRows(plane);
     }
+    while (progress);
+}
+
+/* hash the ready rows of the plane unless another thread is at it, returns
+ * true if any row was hashed */
+bool FrameEncoder::PictureHash::hashRows(int plane)
+{
+    ScopedLock lock(m_lock);
+
+    if (m_planeBusy[plane] || m_rowsHashed[plane] == m_rowsReady)
+        return false;
+
+    m_planeBusy[plane] = true;
+    while (m_rowsHashed[plane] < m_rowsReady)
+    {
+        int begin = m_rowsHashed[plane];
+        int end = m_rowsReady;
+
+        m_lock.release();
+        for (int row = begin; row < end; row++)
+            master->updatePictureHash(plane, row, row * master->m_numCols, master->m_frameFilter.m_parallelFilter[row].getCUHeight());
+        m_lock.acquire();
+
+        m_rowsHashed[plane] = end;
+    }
+    m_planeBusy[plane] = false;
+
+    return true;
 }
 
 void FrameEncoder::encodeSlice(uint32_t sliceAddr)
@@ -1373,7 +1454,12 @@ void FrameEncoder::processRow(int row, int threadId)
 {
     int64_t startTime = x265_mdate();
     if (ATOMIC_INC(&m_activeWorkerCount) == 1 && m_stallStartTime)
-        m_totalNoWorkerTime += x265_mdate() - m_stallStartTime;
+    {
+        int64_t stallStartTime = m_stallStartTime;
+        m_totalNoWorkerTime += x265_mdate() - stallStartTime;
+        if (g_traceActive)
+            traceAsyncEvent(noWorkers, stallStartTime, x265_mdate(), m_frame->m_poc);
+    }
 
     const uint32_t realRow = m_idx_to_row[row >> 1];
     const uint32_t typeNum = m_idx_to_row[row & 1];
@@ -1419,8 +1505,16 @@ void FrameEncoder::processRowEncoder(int intRow, ThreadLocalData& tld)
             return;
         }
         curRow.busy = true;
+
+        if (curRow.stallStartTime)
+        {
+            traceAsyncEvent(rowStall, curRow.stallStartTime, x265_mdate(), (int)row);
+            curRow.stallStartTime = 0;
+        }
     }
 
+    ProfileScopeEventArg(encodeRow, (int)row);
+
     /* When WPP is enabled, every row has its own row coder instance. Otherwise
      * they share row 0 */
     Entropy& rowCoder = m_param->bEnableWavefront ? curRow.rowGoOnCoder : m_rows[0].rowGoOnCoder;
@@ -1844,6 +1938,8 @@ void FrameEncoder::processRowEncoder(int intRow, ThreadLocalData& tld)
             curRow.active = false;
             curRow.busy = false;
             ATOMIC_INC(&m_countRowBlocks);
+            if (g_traceActive)
+                curRow.stallStartTime = x265_mdate();
             return;
         }
     }
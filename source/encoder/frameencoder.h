@@ -100,6 +100,9 @@ struct CTURow
 
     volatile int      reEncode;
 
+    /* time the row was blocked by the row above it, only kept while tracing */
+    int64_t           stallStartTime;
+
     /* called at the start of each frame to initialize state */
     void init(Entropy& initContext, unsigned int sid)
     {
@@ -109,6 +112,7 @@ struct CTURow
         avgQPComputed = 0;
         sliceId = sid;
         reEncode = 0;
+        stallStartTime = 0;
         memset(&rowStats, 0, sizeof(rowStats));
         rowGoOnCoder.load(initContext);
     }
@@ -162,6 +166,7 @@ public:
     Frame *getEncodedPicture(NALList& list);
 
     void initDecodedPictureHashSEI(int row, int cuAddr, int height);
+    void updatePictureHash(int plane, int row, int cuAddr, int height);
 
     Event                    m_enable;
     Event                    m_done;
@@ -237,6 +242,7 @@ public:
     // initialization for mcstf
     TemporalFilter*          m_frameEncTF;
     TemporalFilterRefPicInfo m_mcstfRefList[MAX_MCSTF_TEMPORAL_WINDOW_LENGTH];
+    int                      m_mcstfRefsHeld;      // references whose m_refPicCnt[1] the API thread holds for this frame
 
     class WeightAnalysis : public BondedTaskGroup
     {
@@ -253,6 +259,36 @@ public:
         WeightAnalysis operator=(const WeightAnalysis&);
     };
 
+    /* Decoded picture hash of the reconstructed rows, computed by idle pool
+     * workers as the rows are finished (--hash-async) instead of by the thread
+     * which filtered them. Each plane is hashed by one thread at a time, in row
+     * order; the frame encoder hashes whatever is left before writing the SEI */
+    class PictureHash : public BondedTaskGroup
+    {
+    public:
+
+        FrameEncoder* master;
+        int           m_numPlanes;
+        int           m_rowsReady;     // rows whose reconstruction is final
+        int           m_rowsHashed[3];
+        bool          m_planeBusy[3];
+
+        PictureHash() : master(NULL) { reset(0); }
+
+        void reset(int numPlanes);
+        void rowDone(int row);
+        void finish();
+
+        void processTasks(int workerThreadId);
+
+    protected:
+
+        bool hashRows(int plane);
+    };
+
+    PictureHash              m_pictureHash;
+    bool                     m_bAsyncHash;
+
 protected:
 
     bool initializeGeoms();
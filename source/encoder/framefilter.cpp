@@ -32,7 +32,8 @@
 
 using namespace X265_NS;
 
-static float calculateSSIM(pixel *pix1, intptr_t stride1, pixel *pix2, intptr_t stride2, uint32_t width, uint32_t height, void *buf, uint32_t& cnt);
+static double calculateSSIM(pixel *pix1, intptr_t stride1, pixel *pix2, intptr_t stride2, uint32_t width, uint32_t height, int *buf, uint32_t& cnt,
+                            uint32_t ctuSize, uint32_t numCols, double *ctuSsim);
 
 namespace X265_NS
 {
@@ -159,6 +160,8 @@ namespace X265_NS
 void FrameFilter::destroy()
 {
     X265_FREE(m_ssimBuf);
+    X265_FREE(m_rowMetrics);
+    X265_FREE(m_metrics.m_rowQueue);
 
     if (m_parallelFilter)
     {
@@ -189,8 +192,19 @@ void FrameFilter::init(Encoder *top, FrameEncoder *frame, int numRows, uint32_t
     m_lastWidth = (m_param->sourceWidth % m_param->maxCUSize) ? (m_param->sourceWidth % m_param->maxCUSize) : m_param->maxCUSize;
     integralCompleted.set(0);
 
-    if (m_param->bEnableSsim)
-        m_ssimBuf = X265_MALLOC(int, 8 * (m_param->sourceWidth / 4 + 3));
+    if (m_param->bEnablePsnr || m_param->bEnableSsim)
+    {
+        int numWorkers = frame->m_pool ? frame->m_pool->m_numWorkers : 0;
+
+        m_rowMetrics = X265_MALLOC(RowMetrics, numRows);
+        m_metrics.m_rowQueue = X265_MALLOC(int, numRows);
+        m_metrics.m_frameFilter = this;
+        if (m_param->bEnableSsim)
+        {
+            m_ssimBufSize = 8 * (m_param->sourceWidth / 4 + 3);
+            m_ssimBuf = X265_MALLOC(int, m_ssimBufSize * (numWorkers + 1));
+        }
+    }
 
     m_parallelFilter = new ParallelFilter[numRows];
 
@@ -248,6 +262,10 @@ void FrameFilter::start(Frame *frame, Entropy& initState)
         if (m_useSao)
             m_parallelFilter[0].m_sao.resetStats();
     }
+
+    m_bAsyncMetrics = m_rowMetrics && m_frameEncoder->m_pool;
+    if (m_rowMetrics)
+        m_metrics.reset();
 }
 
 /* restore original YUV samples to recon after SAO (if lossless) */
@@ -563,7 +581,7 @@ void FrameFilter::ParallelFilter::processTasks(int /*workerThreadId*/)
 
 void FrameFilter::processRow(int row)
 {
-    ProfileScopeEvent(filterCTURow);
+    ProfileScopeEventArg(filterCTURow, row);
 
 #if DETAILED_CU_STATS
     ScopedElapsedTime filterPerfScope(m_frameEncoder->m_cuStats.loopFilterElapsedTime);
@@ -653,7 +671,6 @@ void FrameFilter::processRow(int row)
 
 void FrameFilter::processPostRow(int row)
 {
-    PicYuv *reconPic = m_frame->m_reconPic;
     const uint32_t numCols = m_frame->m_encData->m_slice->m_sps->numCuInWidth;
     const uint32_t lineStartCUAddr = row * numCols;
 
@@ -664,62 +681,147 @@ void FrameFilter::processPostRow(int row)
     m_frame->m_reconRowFlag[row].set(1);
 
     uint32_t cuAddr = lineStartCUAddr;
-    if (m_param->bEnablePsnr)
-    {
-        PicYuv* fencPic = m_frame->m_fencPic;
+    if (m_bAsyncMetrics)
+        m_metrics.rowDone(row);
+    else if (m_rowMetrics)
+        measureRow(row, m_ssimBuf);
 
-        intptr_t stride = reconPic->m_stride;
-        uint32_t width  = reconPic->m_picWidth - m_pad[0];
+    if (m_frameEncoder->m_bAsyncHash)
+        m_frameEncoder->m_pictureHash.rowDone(row);
+    else if (m_param->maxSlices == 1)
+    {
         uint32_t height = m_parallelFilter[row].getCUHeight();
+        m_frameEncoder->initDecodedPictureHashSEI(row, cuAddr, height);
+    } // end of (m_param->maxSlices == 1)
 
-        uint64_t ssdY = m_frameEncoder->m_top->computeSSD(fencPic->getLumaAddr(cuAddr), reconPic->getLumaAddr(cuAddr), stride, width, height, m_param);
-        m_frameEncoder->m_SSDY += ssdY;
+    if (ATOMIC_INC(&m_frameEncoder->m_completionCount) == 2 * (int)m_frameEncoder->m_numRows)
+    {
+        m_frameEncoder->m_completionEvent.trigger();
+    }
+}
 
-        if (m_param->internalCsp != X265_CSP_I400)
+/* PSNR and SSIM of a row of CTUs, and their per-CTU maps if exported */
+void FrameFilter::measureRow(int row, int* ssimBuf)
+{
+    PicYuv* reconPic = m_frame->m_reconPic;
+    PicYuv* fencPic = m_frame->m_fencPic;
+    FrameData& encData = *m_frame->m_encData;
+    RowMetrics& metrics = m_rowMetrics[row];
+    const uint32_t cuAddr = row * m_numCols;
+
+    memset(&metrics, 0, sizeof(metrics));
+
+    if (m_param->bEnablePsnr)
+    {
+        const int planes = m_param->internalCsp != X265_CSP_I400 ? 3 : 1;
+        const double maxVal = 255 << (X265_DEPTH - 8);
+
+        for (int plane = 0; plane < planes; plane++)
         {
-            height >>= m_vChromaShift;
-            width >>= m_hChromaShift;
-            stride = reconPic->m_strideC;
+            intptr_t stride = plane ? reconPic->m_strideC : reconPic->m_stride;
+            uint32_t width  = reconPic->m_picWidth - m_pad[0];
+            uint32_t height = m_parallelFilter[row].getCUHeight();
+            int hShift = plane ? m_hChromaShift : 0;
+            int vShift = plane ? m_vChromaShift : 0;
 
-            uint64_t ssdU = m_frameEncoder->m_top->computeSSD(fencPic->getCbAddr(cuAddr), reconPic->getCbAddr(cuAddr), stride, width, height, m_param);
-            uint64_t ssdV = m_frameEncoder->m_top->computeSSD(fencPic->getCrAddr(cuAddr), reconPic->getCrAddr(cuAddr), stride, width, height, m_param);
+            if (!encData.m_ctuPsnr[plane])
+            {
+                metrics.ssd[plane] = m_frameEncoder->m_top->computeSSD(fencPic->getPlaneAddr(plane, cuAddr), reconPic->getPlaneAddr(plane, cuAddr),
+                                                                       stride, width >> hShift, height >> vShift, m_param);
+                continue;
+            }
 
-            m_frameEncoder->m_SSDU += ssdU;
-            m_frameEncoder->m_SSDV += ssdV;
+            for (int col = 0; col < m_numCols; col++)
+            {
+                uint32_t ctuWidth = getCUWidth(col) >> hShift;
+                uint32_t ctuHeight = height >> vShift;
+                uint64_t ssd = m_frameEncoder->m_top->computeSSD(fencPic->getPlaneAddr(plane, cuAddr + col), reconPic->getPlaneAddr(plane, cuAddr + col),
+                                                                 stride, ctuWidth, ctuHeight, m_param);
+                double refValue = maxVal * maxVal * ctuWidth * ctuHeight;
+
+                metrics.ssd[plane] += ssd;
+                encData.m_ctuPsnr[plane][cuAddr + col] = ssd ? 10.0 * log10(refValue / (double)ssd) : 99.99;
+            }
         }
     }
 
-    if (m_param->bEnableSsim && m_ssimBuf)
+    if (m_param->bEnableSsim && ssimBuf)
     {
         pixel *rec = reconPic->m_picOrg[0];
-        pixel *fenc = m_frame->m_fencPic->m_picOrg[0];
+        pixel *fenc = fencPic->m_picOrg[0];
         intptr_t stride1 = reconPic->m_stride;
-        intptr_t stride2 = m_frame->m_fencPic->m_stride;
+        intptr_t stride2 = fencPic->m_stride;
         uint32_t bEnd = ((row) == (this->m_numRows - 1));
         uint32_t bStart = (row == 0);
         uint32_t minPixY = row * m_param->maxCUSize - 4 * !bStart;
         uint32_t maxPixY = X265_MIN((row + 1) * m_param->maxCUSize - 4 * !bEnd, (uint32_t)m_param->sourceHeight);
-        uint32_t ssim_cnt;
         x265_emms();
 
         /* SSIM is done for each row in blocks of 4x4 . The First blocks are offset by 2 pixels to the right
         * to avoid alignment of ssim blocks with DCT blocks. */
         minPixY += bStart ? 2 : -6;
-        m_frameEncoder->m_ssim += calculateSSIM(rec + 2 + minPixY * stride1, stride1, fenc + 2 + minPixY * stride2, stride2,
-                                                m_param->sourceWidth - 2, maxPixY - minPixY, m_ssimBuf, ssim_cnt);
-        m_frameEncoder->m_ssimCnt += ssim_cnt;
+        metrics.ssim = calculateSSIM(rec + 2 + minPixY * stride1, stride1, fenc + 2 + minPixY * stride2, stride2,
+                                     m_param->sourceWidth - 2, maxPixY - minPixY, ssimBuf, metrics.ssimCnt,
+                                     m_param->maxCUSize, m_numCols, encData.m_ctuSsim ? encData.m_ctuSsim + cuAddr : NULL);
     }
+}
+
+/* collect the metrics of the frame once all of its rows are finished */
+void FrameFilter::finishMetrics()
+{
+    if (!m_rowMetrics)
+        return;
+
+    if (m_bAsyncMetrics)
+        m_metrics.finish();
 
-    if (m_param->maxSlices == 1)
+    for (int row = 0; row < m_numRows; row++)
     {
-        uint32_t height = m_parallelFilter[row].getCUHeight();
-        m_frameEncoder->initDecodedPictureHashSEI(row, cuAddr, height);
-    } // end of (m_param->maxSlices == 1)
+        m_frameEncoder->m_SSDY += m_rowMetrics[row].ssd[0];
+        m_frameEncoder->m_SSDU += m_rowMetrics[row].ssd[1];
+        m_frameEncoder->m_SSDV += m_rowMetrics[row].ssd[2];
+        m_frameEncoder->m_ssim += m_rowMetrics[row].ssim;
+        m_frameEncoder->m_ssimCnt += m_rowMetrics[row].ssimCnt;
+    }
+}
 
-    if (ATOMIC_INC(&m_frameEncoder->m_completionCount) == 2 * (int)m_frameEncoder->m_numRows)
+void FrameFilter::FrameMetrics::reset()
+{
+    waitForExit();
+    m_exitedPeerCount.set(0);
+    m_bondedPeerCount = 0;
+    m_jobTotal = m_jobAcquired = 0;
+}
+
+void FrameFilter::FrameMetrics::rowDone(int row)
+{
+    ScopedLock lock(m_lock);
+
+    m_rowQueue[m_jobTotal++] = row;
+    tryBondPeers(*m_frameFilter->m_frameEncoder->m_pool, 1);
+}
+
+/* measure the rows nobody picked up, with the spare SSIM buffer */
+void FrameFilter::FrameMetrics::finish()
+{
+    processTasks(m_frameFilter->m_frameEncoder->m_pool->m_numWorkers);
+    waitForExit();
+}
+
+void FrameFilter::FrameMetrics::processTasks(int workerThreadId)
+{
+    int* ssimBuf = m_frameFilter->m_ssimBuf ? m_frameFilter->m_ssimBuf + workerThreadId * m_frameFilter->m_ssimBufSize : NULL;
+
+    m_lock.acquire();
+    while (m_jobAcquired < m_jobTotal)
     {
-        m_frameEncoder->m_completionEvent.trigger();
+        int row = m_rowQueue[m_jobAcquired++];
+
+        m_lock.release();
+        m_frameFilter->measureRow(row, ssimBuf);
+        m_lock.acquire();
     }
+    m_lock.release();
 }
 
 void FrameFilter::computeMEIntegral(int row)
@@ -825,27 +927,57 @@ void FrameFilter::computeMEIntegral(int row)
 }
 
 /* Function to calculate SSIM for each row */
-static float calculateSSIM(pixel *pix1, intptr_t stride1, pixel *pix2, intptr_t stride2, uint32_t width, uint32_t height, void *buf, uint32_t& cnt)
+static double calculateSSIM(pixel *pix1, intptr_t stride1, pixel *pix2, intptr_t stride2, uint32_t width, uint32_t height, int *buf, uint32_t& cnt,
+                            uint32_t ctuSize, uint32_t numCols, double *ctuSsim)
 {
     uint32_t z = 0;
-    float ssim = 0.0;
+    double ssim = 0.0;
 
     int(*sum0)[4] = (int(*)[4])buf;
     int(*sum1)[4] = sum0 + (width >> 2) + 3;
     width >>= 2;
     height >>= 2;
 
+    /* Window x spans the pixels 4x + 2 to 4x + 9 of the picture row and counts
+     * towards the CTU holding its centre, so the windows of CTU column c start
+     * at cS/4 - 1 (with S a multiple of 16) */
+    uint32_t numWindows = width - 1;
+    if (ctuSsim)
+        memset(ctuSsim, 0, numCols * sizeof(double));
+
     for (uint32_t y = 1; y < height; y++)
     {
         for (; z <= y; z++)
         {
             std::swap(sum0, sum1);
-            for (uint32_t x = 0; x < width; x += 2)
-                primitives.ssim_4x4x2_core(&pix1[4 * (x + (z * stride1))], stride1, &pix2[4 * (x + (z * stride2))], stride2, &sum0[x]);
+            primitives.ssimRowSums(&pix1[4 * z * stride1], stride1, &pix2[4 * z * stride2], stride2, sum0, width);
+        }
+
+        if (!ctuSsim)
+        {
+            ssim += primitives.ssimRowEnd(sum0, sum1, numWindows);
+            continue;
         }
 
-        for (uint32_t x = 0; x < width - 1; x += 4)
-            ssim += primitives.ssim_end_4(sum0 + x, sum1 + x, X265_MIN(4, width - x - 1));
+        for (uint32_t col = 0, x = 0; col < numCols && x < numWindows; col++)
+        {
+            uint32_t end = col + 1 < numCols ? X265_MIN(numWindows, (col + 1) * ctuSize / 4 - 1) : numWindows;
+            double colSsim = primitives.ssimRowEnd(sum0 + x, sum1 + x, end - x);
+
+            ssim += colSsim;
+            ctuSsim[col] += colSsim;
+            x = end;
+        }
+    }
+
+    if (ctuSsim && height > 1)
+    {
+        for (uint32_t col = 0, x = 0; col < numCols; col++)
+        {
+            uint32_t end = col + 1 < numCols ? X265_MIN(numWindows, (col + 1) * ctuSize / 4 - 1) : numWindows;
+            ctuSsim[col] = end > x ? ctuSsim[col] / ((end - x) * (height - 1)) : 0;
+            x = X265_MAX(x, end);
+        }
     }
 
     cnt = (height - 1) * (width - 1);
@@ -60,7 +60,42 @@ public:
     
     ThreadSafeInteger integralCompleted;     /* check if integral calculation is completed in this row */
 
-    void*         m_ssimBuf;        /* Temp storage for ssim computation */
+    int*          m_ssimBuf;        /* Temp storage for ssim computation, one per pool worker plus one */
+    int           m_ssimBufSize;
+
+    /* PSNR and SSIM measured on each row of CTUs, summed in row order once the
+     * frame is complete so the totals do not depend on which thread measured
+     * which row */
+    struct RowMetrics
+    {
+        uint64_t  ssd[3];
+        double    ssim;
+        uint32_t  ssimCnt;
+    };
+
+    RowMetrics*   m_rowMetrics;
+
+    /* Measures the finished rows on idle pool workers rather than on the thread
+     * which filtered them; the frame encoder measures whatever is left once the
+     * frame is complete */
+    class FrameMetrics : public BondedTaskGroup
+    {
+    public:
+
+        FrameFilter* m_frameFilter;
+        int*         m_rowQueue;    // rows in the order they were finished
+
+        FrameMetrics() : m_frameFilter(NULL), m_rowQueue(NULL) {}
+
+        void reset();
+        void rowDone(int row);
+        void finish();
+
+        void processTasks(int workerThreadId);
+    };
+
+    FrameMetrics  m_metrics;
+    bool          m_bAsyncMetrics;
 
 #define MAX_PFILTER_CUS     (4) /* maximum CUs for every thread */
     class ParallelFilter : public Deblock
@@ -114,6 +149,9 @@ public:
         , m_frame(NULL)
         , m_frameEncoder(NULL)
         , m_ssimBuf(NULL)
+        , m_ssimBufSize(0)
+        , m_rowMetrics(NULL)
+        , m_bAsyncMetrics(false)
         , m_parallelFilter(NULL)
     {
     }
@@ -130,6 +168,8 @@ public:
 
     void processRow(int row);
     void processPostRow(int row);
+    void measureRow(int row, int* ssimBuf);
+    void finishMetrics();
     void computeMEIntegral(int row);
 };
 }
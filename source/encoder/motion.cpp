@@ -1607,6 +1607,13 @@ int MotionEstimate::subpelCompare(ReferencePlanes *ref, const MV& qmv, pixelcmp_
     
     if (!(yFrac | xFrac))
         cost = cmp(fencPUYuv.m_buf[0], fencStride, fref, refStride);
+    else if (!((xFrac | yFrac) & 1) && ref->hpelPlane[0] &&
+             (int)(blockOffset / refStride) + (qmv.y >> 2) + blockheight <= ref->hpelLines)
+    {
+        /* half-pel position already interpolated by MotionReference::applyHpel() */
+        int hpel = ((yFrac & 2) | (xFrac >> 1)) - 1;
+        cost = cmp(fencPUYuv.m_buf[0], fencStride, ref->hpelPlane[hpel] + (fref - ref->fpelPlane[0]), refStride);
+    }
     else
     {
         /* we are taking a short-cut here if the reference is weighted. To be
@@ -24,6 +24,7 @@
 
 #include "common.h"
 #include "bitstream.h"
+#include "primitives.h"
 #include "nal.h"
 
 using namespace X265_NS;
@@ -57,6 +58,17 @@ void NALList::takeContents(NALList& other)
     other.m_buffer = X265_MALLOC(uint8_t, m_allocSize);
 }
 
+/* hand the buffer holding the payloads of m_nal[] over to the caller, who
+ * releases it with X265_FREE; the next access unit brings a buffer of its own */
+uint8_t* NALList::detachBuffer()
+{
+    uint8_t* buffer = m_buffer;
+    m_buffer = NULL;
+    m_allocSize = 0;
+    m_occupancy = 0;
+    return buffer;
+}
+
 void NALList::serialize(NalUnitType nalUnitType, const Bitstream& bs, uint8_t temporalID)
 {
     static const char startCodePrefix[] = { 0, 0, 0, 1 };
@@ -121,18 +133,20 @@ void NALList::serialize(NalUnitType nalUnitType, const Bitstream& bs, uint8_t te
      * any byte-aligned position:
      *  - 0x000000
      *  - 0x000001
-     *  - 0x000002 */
-    for (uint32_t i = 0; i < payloadSize; i++)
+     *  - 0x000002
+     * The last payload byte is not escaped; a trailing zero is dealt with below */
+    if (payloadSize > 2 && nalUnitType != NAL_UNIT_UNSPECIFIED)
     {
-        if (i > 2 && !out[bytes - 2] && !out[bytes - 3] && out[bytes - 1] <= 0x03 && nalUnitType != NAL_UNIT_UNSPECIFIED)
-        {
-            /* inject 0x03 to prevent emulating a start code */
-            out[bytes] = out[bytes - 1];
-            out[bytes - 1] = 0x03;
-            bytes++;
-        }
-
-        out[bytes++] = bpayload[i];
+        out[bytes++] = bpayload[0];
+        out[bytes++] = bpayload[1];
+        uint8_t* end = primitives.nalEscape(out + bytes, bpayload + 2, bpayload + payloadSize - 1);
+        *end++ = bpayload[payloadSize - 1];
+        bytes = (uint32_t)(end - out);
+    }
+    else
+    {
+        memcpy(out + bytes, bpayload, payloadSize);
+        bytes += payloadSize;
     }
 
     X265_CHECK(bytes <= 4 + 2 + payloadSize + (payloadSize >> 1), "NAL buffer overflow\n");
@@ -208,16 +222,12 @@ uint32_t NALList::serializeSubstreams(uint32_t* streamSizeBytes, uint32_t stream
 
         if (inBytes)
         {
-            for (uint32_t i = 0; i < inSize; i++)
-            {
-                if (bytes >= 2 && !out[bytes - 2] && !out[bytes - 1] && inBytes[i] <= 0x03)
-                {
-                    /* inject 0x03 to prevent emulating a start code */
-                    out[bytes++] = 3;
-                }
-
+            /* the escaping looks back at the last two bytes of the concatenation */
+            uint32_t i = 0;
+            for (; bytes < 2 && i < inSize; i++)
                 out[bytes++] = inBytes[i];
-            }
+
+            bytes = (uint32_t)(primitives.nalEscape(out + bytes, inBytes + i, inBytes + inSize) - out);
         }
 
         if (s < streamCount - 1)
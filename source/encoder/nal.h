@@ -56,6 +56,8 @@ public:
 
     void takeContents(NALList& other);
 
+    uint8_t* detachBuffer();
+
     void serialize(NalUnitType nalUnitType, const Bitstream& bs, uint8_t temporalID = 1);
 
     uint32_t serializeSubstreams(uint32_t* streamSizeBytes, uint32_t streamCount, const Bitstream* streams);
@@ -108,6 +108,54 @@ inline char *strcatFilename(const char *input, const char *suffix)
     return output;
 }
 
+/* Binary stats file (--binary-stats): a StatsFileHeader followed by the
+ * NUL terminated options string, one StatsFileRecord per frame in encode
+ * order, each directly followed by cutreeSize packed cutree offsets, then
+ * the file offset of every record as uint64 and a StatsFileTrailer */
+#define STATS_FILE_MAGIC   "x265stat"
+#define STATS_INDEX_MAGIC  "x265sidx"
+#define STATS_FILE_VERSION 1
+
+struct StatsFileHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t optionsSize;
+};
+
+struct StatsFileRecord
+{
+    int32_t  poc;
+    int32_t  encodeOrder;
+    int32_t  type;              // 'I', 'i', 'P', 'B' or 'b' as in the text stats
+    int32_t  coeffBits;
+    int32_t  mvBits;
+    int32_t  miscBits;
+    int32_t  scenecut;
+    int32_t  cutreeType;
+    double   qpRc;
+    double   qpAq;
+    double   qpNoVbv;
+    double   qRceq;
+    double   iCuCount;
+    double   pCuCount;
+    double   skipCuCount;
+    int32_t  numberOfPictures;
+    int32_t  numberOfNegativePictures;
+    int32_t  numberOfPositivePictures;
+    int32_t  cutreeSize;
+    int32_t  deltaPOC[MAX_NUM_REF_PICS];
+    uint8_t  bUsed[MAX_NUM_REF_PICS];
+};
+
+struct StatsFileTrailer
+{
+    uint64_t indexOffset;
+    uint32_t count;
+    uint32_t version;
+    char     magic[8];
+};
+
 typedef struct CUTreeSharedDataItem
 {
     uint8_t  *type;
@@ -244,6 +292,15 @@ RateControl::RateControl(x265_param& p, Encoder *top)
     m_lastAbrResetPoc = -1;
     m_statFileOut = NULL;
     m_cutreeStatFileOut = m_cutreeStatFileIn = NULL;
+    m_bBinaryStatsOut = false;
+    m_statsIn = NULL;
+    m_statsInSize = 0;
+    m_bStatsInMapped = false;
+    m_statsIndexOffset = 0;
+    m_statsInCount = 0;
+    m_statsCutreePos = 0;
+    m_statsOutOffset = NULL;
+    m_statsOutCount = m_statsOutAlloc = 0;
     m_cutreeShrMem = NULL;
     m_rce2Pass = NULL;
     m_encOrder = NULL;
@@ -385,7 +442,8 @@ bool RateControl::initCUTreeSharedMem()
         strcpy(shrname, m_param->rc.sharedMemName);
         strcat(shrname, CUTREE_SHARED_MEM_NAME);
 
-        if (!m_cutreeShrMem->init(itemSize, itemCnt, shrname))
+        ///< the reading encoders each consume every item, the first pass waits for the slowest
+        if (!m_cutreeShrMem->init(itemSize, itemCnt, shrname, false, m_param->sharedMemReaders))
         {
             return false;
         }
@@ -505,10 +563,21 @@ bool RateControl::init(const SPS& sps)
                 m_expectedBitsSum = 0;
                 char *p, *statsIn, *statsBuf;
                 /* read 1st pass stats */
-                statsIn = statsBuf = x265_slurp_file(fileName);
+                if (!openBinaryStats(fileName))
+                    return false;
+                if (m_statsIn)
+                {
+                    /* present the options of binary stats like the text header */
+                    const char* options = (const char*)m_statsIn + sizeof(StatsFileHeader);
+                    statsIn = statsBuf = X265_MALLOC(char, strlen(options) + 12);
+                    if (statsBuf)
+                        sprintf(statsBuf, "#options: %s\n", options);
+                }
+                else
+                    statsIn = statsBuf = x265_slurp_file(fileName);
                 if (!statsBuf)
                     return false;
-                if (m_param->rc.cuTree)
+                if (m_param->rc.cuTree && !m_statsIn)
                 {
                     char *tmpFile = strcatFilename(fileName, ".cutree");
                     if (!tmpFile)
@@ -616,8 +685,13 @@ bool RateControl::init(const SPS& sps)
                 /* find number of pics */
                 p = statsIn;
                 int numEntries;
-                for (numEntries = -1; p; numEntries++)
-                    p = strchr(p + 1, ';');
+                if (m_statsIn)
+                    numEntries = m_statsInCount;
+                else
+                {
+                    for (numEntries = -1; p; numEntries++)
+                        p = strchr(p + 1, ';');
+                }
                 if (!numEntries)
                 {
                     x265_log(m_param, X265_LOG_ERROR, "empty stats file\n");
@@ -661,76 +735,84 @@ bool RateControl::init(const SPS& sps)
                 /* read stats */
                 p = statsIn;
                 double totalQpAq = 0;
-                for (int i = 0; i < m_numEntries; i++)
+                if (m_statsIn)
                 {
-                    RateControlEntry *rce, *rcePocOrder;
-                    int frameNumber;
-                    int encodeOrder;
-                    char picType;
-                    int e;
-                    char *next;
-                    double qpRc, qpAq, qNoVbv, qRceq;
-                    next = strstr(p, ";");
-                    if (next)
-                        *next++ = 0;
-                    e = sscanf(p, " in:%d out:%d", &frameNumber, &encodeOrder);
-                    if (frameNumber < 0 || frameNumber >= m_numEntries)
-                    {
-                        x265_log(m_param, X265_LOG_ERROR, "bad frame number (%d) at stats line %d\n", frameNumber, i);
+                    if (!readBinaryStats())
                         return false;
-                    }
-                    rce = &m_rce2Pass[encodeOrder];
-                    rcePocOrder = &m_rce2Pass[frameNumber];
-                    m_encOrder[frameNumber] = encodeOrder;
-                    if (!m_param->bMultiPassOptRPS)
-                    {
-                        int scenecut = 0;
-                        e += sscanf(p, " in:%*d out:%*d type:%c q:%lf q-aq:%lf q-noVbv:%lf q-Rceq:%lf tex:%d mv:%d misc:%d icu:%lf pcu:%lf scu:%lf sc:%d",
-                            &picType, &qpRc, &qpAq, &qNoVbv, &qRceq, &rce->coeffBits,
-                            &rce->mvBits, &rce->miscBits, &rce->iCuCount, &rce->pCuCount,
-                            &rce->skipCuCount, &scenecut);
-                        rcePocOrder->scenecut = scenecut != 0;
-                    }
-                    else
-                    {
-                        char deltaPOC[128];
-                        char bUsed[40];
-                        memset(deltaPOC, 0, sizeof(deltaPOC));
-                        memset(bUsed, 0, sizeof(bUsed));
-                        e += sscanf(p, " in:%*d out:%*d type:%c q:%lf q-aq:%lf q-noVbv:%lf q-Rceq:%lf tex:%d mv:%d misc:%d icu:%lf pcu:%lf scu:%lf nump:%d numnegp:%d numposp:%d deltapoc:%s bused:%s",
-                            &picType, &qpRc, &qpAq, &qNoVbv, &qRceq, &rce->coeffBits,
-                            &rce->mvBits, &rce->miscBits, &rce->iCuCount, &rce->pCuCount,
-                            &rce->skipCuCount, &rce->rpsData.numberOfPictures, &rce->rpsData.numberOfNegativePictures, &rce->rpsData.numberOfPositivePictures, deltaPOC, bUsed);
-                        splitdeltaPOC(deltaPOC, rce);
-                        splitbUsed(bUsed, rce);
-                        rce->rpsIdx = -1;
-                    }
-                    rce->keptAsRef = true;
-                    rce->isIdr = false;
-                    if (picType == 'b' || picType == 'p')
-                        rce->keptAsRef = false;
-                    if (picType == 'I')
-                        rce->isIdr = true;
-                    if (picType == 'I' || picType == 'i')
-                        rce->sliceType = I_SLICE;
-                    else if (picType == 'P' || picType == 'p')
-                        rce->sliceType = P_SLICE;
-                    else if (picType == 'B' || picType == 'b')
-                        rce->sliceType = B_SLICE;
-                    else
-                        e = -1;
-                    if (e < 10)
+                }
+                else
+                {
+                    for (int i = 0; i < m_numEntries; i++)
                     {
-                        x265_log(m_param, X265_LOG_ERROR, "statistics are damaged at line %d, parser out=%d\n", i, e);
-                        return false;
+                        RateControlEntry *rce, *rcePocOrder;
+                        int frameNumber;
+                        int encodeOrder;
+                        char picType;
+                        int e;
+                        char *next;
+                        double qpRc, qpAq, qNoVbv, qRceq;
+                        next = strstr(p, ";");
+                        if (next)
+                            *next++ = 0;
+                        e = sscanf(p, " in:%d out:%d", &frameNumber, &encodeOrder);
+                        if (frameNumber < 0 || frameNumber >= m_numEntries)
+                        {
+                            x265_log(m_param, X265_LOG_ERROR, "bad frame number (%d) at stats line %d\n", frameNumber, i);
+                            return false;
+                        }
+                        rce = &m_rce2Pass[encodeOrder];
+                        rcePocOrder = &m_rce2Pass[frameNumber];
+                        m_encOrder[frameNumber] = encodeOrder;
+                        if (!m_param->bMultiPassOptRPS)
+                        {
+                            int scenecut = 0;
+                            e += sscanf(p, " in:%*d out:%*d type:%c q:%lf q-aq:%lf q-noVbv:%lf q-Rceq:%lf tex:%d mv:%d misc:%d icu:%lf pcu:%lf scu:%lf sc:%d",
+                                &picType, &qpRc, &qpAq, &qNoVbv, &qRceq, &rce->coeffBits,
+                                &rce->mvBits, &rce->miscBits, &rce->iCuCount, &rce->pCuCount,
+                                &rce->skipCuCount, &scenecut);
+                            rcePocOrder->scenecut = scenecut != 0;
+                        }
+                        else
+                        {
+                            char deltaPOC[128];
+                            char bUsed[40];
+                            memset(deltaPOC, 0, sizeof(deltaPOC));
+                            memset(bUsed, 0, sizeof(bUsed));
+                            e += sscanf(p, " in:%*d out:%*d type:%c q:%lf q-aq:%lf q-noVbv:%lf q-Rceq:%lf tex:%d mv:%d misc:%d icu:%lf pcu:%lf scu:%lf nump:%d numnegp:%d numposp:%d deltapoc:%s bused:%s",
+                                &picType, &qpRc, &qpAq, &qNoVbv, &qRceq, &rce->coeffBits,
+                                &rce->mvBits, &rce->miscBits, &rce->iCuCount, &rce->pCuCount,
+                                &rce->skipCuCount, &rce->rpsData.numberOfPictures, &rce->rpsData.numberOfNegativePictures, &rce->rpsData.numberOfPositivePictures, deltaPOC, bUsed);
+                            splitdeltaPOC(deltaPOC, rce);
+                            splitbUsed(bUsed, rce);
+                            rce->rpsIdx = -1;
+                        }
+                        rce->keptAsRef = true;
+                        rce->isIdr = false;
+                        if (picType == 'b' || picType == 'p')
+                            rce->keptAsRef = false;
+                        if (picType == 'I')
+                            rce->isIdr = true;
+                        if (picType == 'I' || picType == 'i')
+                            rce->sliceType = I_SLICE;
+                        else if (picType == 'P' || picType == 'p')
+                            rce->sliceType = P_SLICE;
+                        else if (picType == 'B' || picType == 'b')
+                            rce->sliceType = B_SLICE;
+                        else
+                            e = -1;
+                        if (e < 10)
+                        {
+                            x265_log(m_param, X265_LOG_ERROR, "statistics are damaged at line %d, parser out=%d\n", i, e);
+                            return false;
+                        }
+                        rce->qScale = rce->newQScale = x265_qp2qScale(qpRc);
+                        totalQpAq += qpAq;
+                        rce->qpNoVbv = qNoVbv;
+                        rce->qpaRc = qpRc;
+                        rce->qpAq = qpAq;
+                        rce->qRceq = qRceq;
+                        p = next;
                     }
-                    rce->qScale = rce->newQScale = x265_qp2qScale(qpRc);
-                    totalQpAq += qpAq;
-                    rce->qpNoVbv = qNoVbv;
-                    rce->qpaRc = qpRc;
-                    rce->qpAq = qpAq;
-                    rce->qRceq = qRceq;
-                    p = next;
                 }
                 X265_FREE(statsBuf);
                 if (m_param->rc.rateControlMode != X265_RC_CQP)
@@ -768,13 +850,37 @@ bool RateControl::init(const SPS& sps)
                 x265_log_file(m_param, X265_LOG_ERROR, "can't open stats file %s.temp\n", fileName);
                 return false;
             }
+            /* a pass that reads stats keeps the format of its input */
+            if (X265_SHARE_MODE_FILE == m_param->rc.dataShareMode)
+                m_bBinaryStatsOut = m_param->rc.bStatRead ? m_statsIn != NULL : !!m_param->bBinaryStats;
+            if (m_param->rc.bStatRead && m_param->bBinaryStats && !m_bBinaryStatsOut)
+                x265_log(m_param, X265_LOG_WARNING, "text stats file is rewritten as text\n");
             p = x265_param2string(m_param, sps.conformanceWindow.rightOffset, sps.conformanceWindow.bottomOffset);
-            if (p)
+            if (m_bBinaryStatsOut)
+            {
+                StatsFileHeader header;
+                const char* options = p ? p : "";
+                memcpy(header.magic, STATS_FILE_MAGIC, sizeof(header.magic));
+                header.version = STATS_FILE_VERSION;
+                header.optionsSize = (uint32_t)strlen(options) + 1;
+                if (fwrite(&header, sizeof(header), 1, m_statFileOut) != 1 ||
+                    fwrite(options, 1, header.optionsSize, m_statFileOut) != header.optionsSize)
+                {
+                    x265_log_file(m_param, X265_LOG_ERROR, "can't write stats file %s.temp\n", fileName);
+                    X265_FREE(p);
+                    return false;
+                }
+            }
+            else if (p)
                 fprintf(m_statFileOut, "#options: %s\n", p);
             X265_FREE(p);
             if (m_param->rc.cuTree && !m_param->rc.bStatRead)
             {
-                if (X265_SHARE_MODE_FILE == m_param->rc.dataShareMode)
+                if (m_bBinaryStatsOut)
+                {
+                    /* cutree data is stored with the frame records */
+                }
+                else if (X265_SHARE_MODE_FILE == m_param->rc.dataShareMode)
                 {
                     statFileTmpname = strcatFilename(fileName, ".cutree.temp");
                     if (!statFileTmpname)
@@ -1792,7 +1898,12 @@ bool RateControl::cuTreeReadFor2Pass(Frame* frame)
             {
                 m_cuTreeStats.qpBufPos++;
 
-                if (X265_SHARE_MODE_FILE == m_param->rc.dataShareMode)
+                if (m_statsIn)
+                {
+                    if (!readBinaryCutree(&type, m_cuTreeStats.qpBuffer[m_cuTreeStats.qpBufPos], ncu))
+                        goto fail;
+                }
+                else if (X265_SHARE_MODE_FILE == m_param->rc.dataShareMode)
                 {
                     if (!fread(&type, 1, 1, m_cutreeStatFileIn))
                         goto fail;
@@ -1809,7 +1920,8 @@ bool RateControl::cuTreeReadFor2Pass(Frame* frame)
                     CUTreeSharedDataItem shrItem;
                     shrItem.type = &type;
                     shrItem.stats = m_cuTreeStats.qpBuffer[m_cuTreeStats.qpBufPos];
-                    m_cutreeShrMem->readNext(&shrItem, ReadSharedCUTreeData);
+                    if (!m_cutreeShrMem->readNext(&shrItem, ReadSharedCUTreeData))
+                        goto fail;
                 }
 
                 if (type != sliceTypeActual && m_cuTreeStats.qpBufPos == 1)
@@ -3208,7 +3320,10 @@ int RateControl::writeRateControlFrameStats(Frame* curFrame, RateControlEntry* r
     char cType = rce->sliceType == I_SLICE ? (curFrame->m_lowres.sliceType == X265_TYPE_IDR ? 'I' : 'i')
         : rce->sliceType == P_SLICE ? 'P'
         : IS_REFERENCED(curFrame) ? 'B' : 'b';
-    
+
+    if (m_bBinaryStatsOut)
+        return writeBinaryFrameStats(curFrame, rce, cType);
+
     if (!curEncData.m_param->bMultiPassOptRPS)
     {
         if (fprintf(m_statFileOut,
@@ -3282,7 +3397,8 @@ int RateControl::writeRateControlFrameStats(Frame* curFrame, RateControlEntry* r
             CUTreeSharedDataItem shrItem;
             shrItem.type = &sliceType;
             shrItem.stats = m_cuTreeStats.qpBuffer[0];
-            m_cutreeShrMem->writeData(&shrItem, WriteSharedCUTreeData);
+            if (!m_cutreeShrMem->writeData(&shrItem, WriteSharedCUTreeData))
+                goto writeFailure;
         } 
     }
     return 0;
@@ -3322,6 +3438,8 @@ void RateControl::destroy()
 
     if (m_statFileOut)
     {
+        if (m_bBinaryStatsOut)
+            writeBinaryStatsIndex();
         fclose(m_statFileOut);
         char *tmpFileName = strcatFilename(fileName, ".temp");
         int bError = 1;
@@ -3359,6 +3477,13 @@ void RateControl::destroy()
     if (m_cutreeStatFileIn)
         fclose(m_cutreeStatFileIn);
 
+    if (m_bStatsInMapped)
+        x265_unmap_file(m_statsIn, m_statsInSize);
+    else
+        X265_FREE(m_statsIn);
+    m_statsIn = NULL;
+    X265_FREE(m_statsOutOffset);
+
     if (m_cutreeShrMem)
     {
         m_cutreeShrMem->release();
@@ -3376,6 +3501,271 @@ void RateControl::destroy()
 
 }
 
+/* Checks whether the stats file is binary and, if so, maps it (or reads it
+ * into memory when it cannot be mapped) and validates its framing. Returns
+ * false only for a damaged binary file; text stats leave m_statsIn NULL */
+bool RateControl::openBinaryStats(const char* fileName)
+{
+    FILE* fh = x265_fopen(fileName, "rb");
+    if (!fh)
+        return true; /* reported by the text reader */
+
+    StatsFileHeader header;
+    if (fread(&header, sizeof(header), 1, fh) != 1 || memcmp(header.magic, STATS_FILE_MAGIC, sizeof(header.magic)))
+    {
+        fclose(fh);
+        return true;
+    }
+
+    m_statsIn = x265_map_file(fh, &m_statsInSize);
+    m_bStatsInMapped = !!m_statsIn;
+    if (!m_statsIn)
+    {
+        int64_t size;
+        if (!fseeko(fh, 0, SEEK_END) && (size = ftello(fh)) > 0 && !fseeko(fh, 0, SEEK_SET))
+        {
+            m_statsIn = X265_MALLOC(uint8_t, size);
+            m_statsInSize = (uint64_t)size;
+            if (m_statsIn && fread(m_statsIn, 1, (size_t)size, fh) != (size_t)size)
+            {
+                X265_FREE(m_statsIn);
+                m_statsIn = NULL;
+            }
+        }
+    }
+    fclose(fh);
+    if (!m_statsIn)
+    {
+        x265_log_file(m_param, X265_LOG_ERROR, "unable to read stats file %s\n", fileName);
+        return false;
+    }
+
+    StatsFileTrailer trailer;
+    bool bValid = header.version == STATS_FILE_VERSION && header.optionsSize &&
+                  m_statsInSize >= sizeof(header) + header.optionsSize + sizeof(trailer) &&
+                  !m_statsIn[sizeof(header) + header.optionsSize - 1];
+    if (bValid)
+    {
+        memcpy(&trailer, m_statsIn + m_statsInSize - sizeof(trailer), sizeof(trailer));
+        bValid = !memcmp(trailer.magic, STATS_INDEX_MAGIC, sizeof(trailer.magic)) &&
+                 trailer.version == STATS_FILE_VERSION && trailer.count && trailer.count <= INT_MAX &&
+                 trailer.indexOffset >= sizeof(header) + header.optionsSize &&
+                 trailer.indexOffset + (uint64_t)trailer.count * sizeof(uint64_t) + sizeof(trailer) == m_statsInSize;
+    }
+    if (!bValid)
+    {
+        x265_log(m_param, X265_LOG_ERROR, "binary stats file %s is damaged or incomplete\n", fileName);
+        return false;
+    }
+    m_statsIndexOffset = trailer.indexOffset;
+    m_statsInCount = (int)trailer.count;
+    m_statsCutreePos = 0;
+    return true;
+}
+
+/* returns the record of the given encode order, or NULL when its offset or
+ * cutree payload would run past the record area */
+const uint8_t* RateControl::binaryStatsRecord(int index)
+{
+    uint64_t offset;
+    int32_t cutreeSize;
+    memcpy(&offset, m_statsIn + m_statsIndexOffset + (uint64_t)index * sizeof(uint64_t), sizeof(offset));
+    if (offset + sizeof(StatsFileRecord) > m_statsIndexOffset)
+        return NULL;
+    memcpy(&cutreeSize, m_statsIn + offset + offsetof(StatsFileRecord, cutreeSize), sizeof(cutreeSize));
+    if (cutreeSize < 0 || offset + sizeof(StatsFileRecord) + (uint64_t)cutreeSize * sizeof(uint16_t) > m_statsIndexOffset)
+        return NULL;
+    return m_statsIn + offset;
+}
+
+bool RateControl::readBinaryStats()
+{
+    for (int i = 0; i < m_numEntries; i++)
+    {
+        const uint8_t* ptr = binaryStatsRecord(i);
+        StatsFileRecord rec;
+        if (!ptr)
+        {
+            x265_log(m_param, X265_LOG_ERROR, "statistics are damaged at record %d\n", i);
+            return false;
+        }
+        memcpy(&rec, ptr, sizeof(rec));
+        if (rec.poc < 0 || rec.poc >= m_numEntries || rec.encodeOrder < 0 || rec.encodeOrder >= m_numEntries)
+        {
+            x265_log(m_param, X265_LOG_ERROR, "bad frame number (%d) at stats record %d\n", rec.poc, i);
+            return false;
+        }
+
+        RateControlEntry *rce = &m_rce2Pass[rec.encodeOrder];
+        RateControlEntry *rcePocOrder = &m_rce2Pass[rec.poc];
+        m_encOrder[rec.poc] = rec.encodeOrder;
+        rce->coeffBits = rec.coeffBits;
+        rce->mvBits = rec.mvBits;
+        rce->miscBits = rec.miscBits;
+        rce->iCuCount = rec.iCuCount;
+        rce->pCuCount = rec.pCuCount;
+        rce->skipCuCount = rec.skipCuCount;
+        if (!m_param->bMultiPassOptRPS)
+            rcePocOrder->scenecut = rec.scenecut != 0;
+        else
+        {
+            if (rec.numberOfPictures < 0 || rec.numberOfPictures > MAX_NUM_REF_PICS)
+            {
+                x265_log(m_param, X265_LOG_ERROR, "statistics are damaged at record %d\n", i);
+                return false;
+            }
+            rce->rpsData.numberOfPictures = rec.numberOfPictures;
+            rce->rpsData.numberOfNegativePictures = rec.numberOfNegativePictures;
+            rce->rpsData.numberOfPositivePictures = rec.numberOfPositivePictures;
+            for (int j = 0; j < rec.numberOfPictures; j++)
+            {
+                rce->rpsData.deltaPOC[j] = rec.deltaPOC[j];
+                rce->rpsData.bUsed[j] = !!rec.bUsed[j];
+            }
+            rce->rpsIdx = -1;
+        }
+        char picType = (char)rec.type;
+        rce->keptAsRef = picType != 'b' && picType != 'p';
+        rce->isIdr = picType == 'I';
+        if (picType == 'I' || picType == 'i')
+            rce->sliceType = I_SLICE;
+        else if (picType == 'P' || picType == 'p')
+            rce->sliceType = P_SLICE;
+        else if (picType == 'B' || picType == 'b')
+            rce->sliceType = B_SLICE;
+        else
+        {
+            x265_log(m_param, X265_LOG_ERROR, "statistics are damaged at record %d\n", i);
+            return false;
+        }
+        rce->qScale = rce->newQScale = x265_qp2qScale(rec.qpRc);
+        rce->qpNoVbv = rec.qpNoVbv;
+        rce->qpaRc = rec.qpRc;
+        rce->qpAq = rec.qpAq;
+        rce->qRceq = rec.qRceq;
+    }
+    return true;
+}
+
+/* the cutree data of the next record, in file order, that carries some */
+bool RateControl::readBinaryCutree(uint8_t* type, uint16_t* qpBuffer, int ncu)
+{
+    while (m_statsCutreePos < m_statsInCount)
+    {
+        const uint8_t* ptr = binaryStatsRecord(m_statsCutreePos++);
+        if (!ptr)
+            return false;
+        StatsFileRecord rec;
+        memcpy(&rec, ptr, sizeof(rec));
+        if (!rec.cutreeSize)
+            continue;
+        if (rec.cutreeSize != ncu)
+            return false;
+        *type = (uint8_t)rec.cutreeType;
+        memcpy(qpBuffer, ptr + sizeof(rec), ncu * sizeof(uint16_t));
+        return true;
+    }
+    return false;
+}
+
+int RateControl::writeBinaryFrameStats(Frame* curFrame, RateControlEntry* rce, char cType)
+{
+    FrameData& curEncData = *curFrame->m_encData;
+    RPS* rps = &curEncData.m_slice->m_rps;
+    int ncu = (m_param->rc.qgSize == 8) ? m_ncu * 4 : m_ncu;
+    const void* cutree = NULL;
+
+    StatsFileRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.poc = rce->poc;
+    rec.encodeOrder = rce->encodeOrder;
+    rec.type = cType;
+    rec.qpRc = curEncData.m_avgQpRc;
+    rec.qpAq = curEncData.m_avgQpAq;
+    rec.qpNoVbv = rce->qpNoVbv;
+    rec.qRceq = rce->qRceq;
+    rec.coeffBits = curEncData.m_frameStats.coeffBits;
+    rec.mvBits = curEncData.m_frameStats.mvBits;
+    rec.miscBits = curEncData.m_frameStats.miscBits;
+    rec.iCuCount = curEncData.m_frameStats.percent8x8Intra * m_ncu;
+    rec.pCuCount = curEncData.m_frameStats.percent8x8Inter * m_ncu;
+    rec.skipCuCount = curEncData.m_frameStats.percent8x8Skip * m_ncu;
+    rec.scenecut = curFrame->m_lowres.bScenecut;
+    rec.numberOfPictures = rps->numberOfPictures;
+    rec.numberOfNegativePictures = rps->numberOfNegativePictures;
+    rec.numberOfPositivePictures = rps->numberOfPositivePictures;
+    for (int i = 0; i < rps->numberOfPictures && i < MAX_NUM_REF_PICS; i++)
+    {
+        rec.deltaPOC[i] = rps->deltaPOC[i];
+        rec.bUsed[i] = rps->bUsed[i];
+    }
+
+    if (m_param->rc.cuTree && !m_param->rc.bStatRead && IS_REFERENCED(curFrame))
+    {
+        primitives.fix8Pack(m_cuTreeStats.qpBuffer[0], curFrame->m_lowres.qpCuTreeOffset, ncu);
+        rec.cutreeType = rce->sliceType;
+        rec.cutreeSize = ncu;
+        cutree = m_cuTreeStats.qpBuffer[0];
+    }
+    else if (m_param->rc.cuTree && m_statsIn)
+    {
+        /* the stats file is being rewritten, carry over the cutree data of
+         * the frame from the file that was read */
+        const uint8_t* ptr = rce->encodeOrder < m_statsInCount ? binaryStatsRecord(rce->encodeOrder) : NULL;
+        StatsFileRecord in;
+        if (!ptr)
+            goto writeFailure;
+        memcpy(&in, ptr, sizeof(in));
+        if (in.encodeOrder != rce->encodeOrder)
+            goto writeFailure;
+        rec.cutreeType = in.cutreeType;
+        rec.cutreeSize = in.cutreeSize;
+        cutree = ptr + sizeof(in);
+    }
+
+    if (m_statsOutCount == m_statsOutAlloc)
+    {
+        int newAlloc = m_statsOutAlloc ? m_statsOutAlloc * 2 : 1024;
+        uint64_t* offsets = X265_MALLOC(uint64_t, newAlloc);
+        if (!offsets)
+            goto writeFailure;
+        if (m_statsOutCount)
+            memcpy(offsets, m_statsOutOffset, m_statsOutCount * sizeof(uint64_t));
+        X265_FREE(m_statsOutOffset);
+        m_statsOutOffset = offsets;
+        m_statsOutAlloc = newAlloc;
+    }
+    {
+        int64_t offset = ftello(m_statFileOut);
+        if (offset < 0)
+            goto writeFailure;
+        m_statsOutOffset[m_statsOutCount++] = (uint64_t)offset;
+    }
+    if (fwrite(&rec, sizeof(rec), 1, m_statFileOut) != 1)
+        goto writeFailure;
+    if (rec.cutreeSize && fwrite(cutree, sizeof(uint16_t), rec.cutreeSize, m_statFileOut) != (size_t)rec.cutreeSize)
+        goto writeFailure;
+    return 0;
+
+writeFailure:
+    x265_log(m_param, X265_LOG_ERROR, "RatecontrolEnd: stats file write failure\n");
+    return 1;
+}
+
+void RateControl::writeBinaryStatsIndex()
+{
+    StatsFileTrailer trailer;
+    int64_t offset = ftello(m_statFileOut);
+    trailer.indexOffset = offset > 0 ? (uint64_t)offset : 0;
+    trailer.count = (uint32_t)m_statsOutCount;
+    trailer.version = STATS_FILE_VERSION;
+    memcpy(trailer.magic, STATS_INDEX_MAGIC, sizeof(trailer.magic));
+    if (offset < 0 ||
+        (m_statsOutCount && fwrite(m_statsOutOffset, sizeof(uint64_t), m_statsOutCount, m_statFileOut) != (size_t)m_statsOutCount) ||
+        fwrite(&trailer, sizeof(trailer), 1, m_statFileOut) != 1)
+        x265_log(m_param, X265_LOG_ERROR, "stats file index write failure\n");
+}
+
 void RateControl::splitdeltaPOC(char deltapoc[], RateControlEntry *rce)
 {
     int idx = 0, length = 0;
@@ -238,6 +238,18 @@ public:
     FILE*   m_statFileOut;
     FILE*   m_cutreeStatFileOut;
     FILE*   m_cutreeStatFileIn;
+    /* binary stats (--binary-stats): the file being read is mapped and its
+     * records parsed in place, cutree data is fetched lazily per frame */
+    bool      m_bBinaryStatsOut;
+    uint8_t*  m_statsIn;          // binary stats being read, NULL for text stats
+    uint64_t  m_statsInSize;
+    bool      m_bStatsInMapped;
+    uint64_t  m_statsIndexOffset; // start of the record index in m_statsIn
+    int       m_statsInCount;
+    int       m_statsCutreePos;   // next record searched for cutree data
+    uint64_t* m_statsOutOffset;   // offsets of the records written so far
+    int       m_statsOutCount;
+    int       m_statsOutAlloc;
     ///< store the cutree data in memory instead of file
     RingMem *m_cutreeShrMem;
     double  m_lastAccumPNorm;
@@ -317,6 +329,12 @@ protected:
     bool   findUnderflow(double *fills, int *t0, int *t1, int over, int framesCount);
     bool   fixUnderflow(int t0, int t1, double adjustment, double qscaleMin, double qscaleMax);
     double tuneQScaleForGrain(double rcOverflow);
+    bool   openBinaryStats(const char* fileName);
+    bool   readBinaryStats();
+    bool   readBinaryCutree(uint8_t* type, uint16_t* qpBuffer, int ncu);
+    const uint8_t* binaryStatsRecord(int index);
+    int    writeBinaryFrameStats(Frame* curFrame, RateControlEntry* rce, char cType);
+    void   writeBinaryStatsIndex();
     void   splitdeltaPOC(char deltapoc[], RateControlEntry *rce);
     void   splitbUsed(char deltapoc[], RateControlEntry *rce);
     void   checkAndResetCRF(RateControlEntry* rce);
@@ -28,6 +28,8 @@
 #include "slice.h"
 #include "picyuv.h"
 
+#include "frame.h"
+#include "framedata.h"
 #include "reference.h"
 
 using namespace X265_NS;
@@ -37,6 +39,10 @@ MotionReference::MotionReference()
     weightBuffer[0] = NULL;
     weightBuffer[1] = NULL;
     weightBuffer[2] = NULL;
+    hpelBuffer[0] = NULL;
+    hpelBuffer[1] = NULL;
+    hpelBuffer[2] = NULL;
+    hpelShared = NULL;
     numSliceWeightedRows = NULL;
 }
 
@@ -46,10 +52,14 @@ MotionReference::~MotionReference()
     X265_FREE(weightBuffer[0]);
     X265_FREE(weightBuffer[1]);
     X265_FREE(weightBuffer[2]);
+    X265_FREE(hpelBuffer[0]);
+    X265_FREE(hpelBuffer[1]);
+    X265_FREE(hpelBuffer[2]);
 }
 
-int MotionReference::init(PicYuv* recPic, WeightParam *wp, const x265_param& p)
+int MotionReference::init(Frame* refFrame, WeightParam *wp, const x265_param& p)
 {
+    PicYuv* recPic = refFrame->m_reconPic;
     reconPic = recPic;
     lumaStride = recPic->m_stride;
     chromaStride = recPic->m_strideC;
@@ -113,6 +123,44 @@ int MotionReference::init(PicYuv* recPic, WeightParam *wp, const x265_param& p)
         isWeighted = true;
     }
 
+    hpelPlane[0] = hpelPlane[1] = hpelPlane[2] = NULL;
+    hpelShared = NULL;
+    if (p.bEnableHpelCache && p.maxSlices == 1)
+    {
+        int marginX = reconPic->m_lumaMarginX;
+        int marginY = reconPic->m_lumaMarginY;
+        pixel* const* planes = hpelBuffer;
+
+        if (fpelPlane[0] == recPic->m_picOrg[0])
+        {
+            /* unweighted, the planes of the picture are interpolated once for
+             * all the frame encoders referencing it */
+            planes = refFrame->m_encData->m_hpelBuffer;
+            hpelShared = refFrame;
+        }
+        else
+        {
+            uint32_t numCUinHeight = (reconPic->m_picHeight + p.maxCUSize - 1) / p.maxCUSize;
+            size_t padheight = (numCUinHeight * p.maxCUSize) + marginY * 2;
+
+            for (int i = 0; i < 3; i++)
+            {
+                if (!hpelBuffer[i])
+                    hpelBuffer[i] = X265_MALLOC(pixel, lumaStride * padheight);
+            }
+        }
+
+        /* without the planes, every half-pel candidate is interpolated on demand */
+        if (planes[0] && planes[1] && planes[2])
+        {
+            for (int i = 0; i < 3; i++)
+                hpelPlane[i] = planes[i] + marginY * lumaStride + marginX;
+        }
+
+        /* the first lines of the top margin lack the filter taps above them */
+        hpelLines = 4 - marginY;
+    }
+
     return 0;
 }
 
@@ -183,3 +231,65 @@ void MotionReference::applyWeight(uint32_t finishedRows, uint32_t maxNumRows, ui
 
     numSliceWeightedRows[sliceId] = finishedRows;
 }
+
+/* Interpolate the half-pel lines [firstLine, lastLine) of fpelPlane[0] into
+ * hpelPlane[], in 16x4 blocks from the first column with three columns of the
+ * margin to its left to the last with four to its right */
+void MotionReference::interpolateHpel(int firstLine, int lastLine)
+{
+    int marginX = reconPic->m_lumaMarginX;
+    intptr_t stride = reconPic->m_stride;
+    int width = reconPic->m_picWidth;
+    int firstCol = 16 - marginX;
+    int numBlocks = (width + marginX - 4 - firstCol) / 16;
+
+    for (int y = firstLine; y < lastLine; y += 4)
+    {
+        intptr_t offset = y * stride + firstCol;
+        for (int i = 0; i < numBlocks; i++, offset += 16)
+        {
+            const pixel* src = fpelPlane[0] + offset;
+            primitives.pu[LUMA_16x4].luma_hpp(src, stride, hpelPlane[0] + offset, stride, 2);
+            primitives.pu[LUMA_16x4].luma_vpp(src, stride, hpelPlane[1] + offset, stride, 2);
+            primitives.pu[LUMA_16x4].luma_hvpp(src, stride, hpelPlane[2] + offset, stride, 2, 2);
+        }
+    }
+}
+
+/* Interpolate the half-pel planes of the lines whose 8-tap filter input is
+ * complete once the reference rows before finishedRows are reconstructed (and
+ * weighted), the last row also completing the bottom margin. The samples are
+ * the ones subpel refinement would interpolate from fpelPlane[0] at the same
+ * positions, so reading them instead does not change the search. The planes
+ * of an unweighted reference belong to the picture: the first frame encoder
+ * to need a line interpolates it, the others only see it done */
+void MotionReference::applyHpel(uint32_t finishedRows, uint32_t maxNumRows)
+{
+    int marginY = reconPic->m_lumaMarginY;
+
+    /* each half-pel line needs the four full-pel lines below it */
+    int lastLine;
+    if (finishedRows == maxNumRows - 1)
+        lastLine = reconPic->m_picHeight + marginY - 4;
+    else
+        lastLine = finishedRows * reconPic->m_param->maxCUSize - 4;
+    if (hpelLines >= lastLine)
+        return;
+
+    if (hpelShared)
+    {
+        ScopedLock lock(hpelShared->m_hpelLock);
+        FrameData* data = hpelShared->m_encData;
+        int firstLine = X265_MAX(data->m_hpelLines, hpelLines);
+        if (firstLine < lastLine)
+        {
+            interpolateHpel(firstLine, lastLine);
+            data->m_hpelLines = lastLine;
+        }
+        hpelLines = data->m_hpelLines;
+        return;
+    }
+
+    interpolateHpel(hpelLines, lastLine);
+    hpelLines = lastLine;
+}
@@ -34,6 +34,7 @@ namespace X265_NS {
 // private x265 namespace
 
 struct WeightParam;
+class Frame;
 
 class MotionReference : public ReferencePlanes
 {
@@ -41,10 +42,14 @@ public:
 
     MotionReference();
     ~MotionReference();
-    int  init(PicYuv*, WeightParam* wp, const x265_param& p);
+    int  init(Frame* refFrame, WeightParam* wp, const x265_param& p);
     void applyWeight(uint32_t finishedRows, uint32_t maxNumRows, uint32_t maxNumRowsInSlice, uint32_t sliceId);
+    void applyHpel(uint32_t finishedRows, uint32_t maxNumRows);
+    void interpolateHpel(int firstLine, int lastLine);
 
     pixel*      weightBuffer[3];
+    pixel*      hpelBuffer[3];
+    Frame*      hpelShared;      // owner of the half-pel planes when they are the picture's own
     int         numInterpPlanes;
     uint32_t*   numSliceWeightedRows;
 
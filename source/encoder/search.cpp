@@ -1973,7 +1973,7 @@ MV Search::getLowresMV(const CUData& cu, const PredictionUnit& pu, int list, int
         return 0;
 
     MV* mvs = m_frame->m_lowres.lowresMvs[list][diffPoc];
-    if (mvs[0].x == 0x7FFF)
+    if (!mvs || mvs[0].x == 0x7FFF)
         /* this motion search was not estimated by lookahead */
         return 0;
 
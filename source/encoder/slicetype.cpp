@@ -732,6 +732,9 @@ void LookaheadTLD::lowresIntraEstimate(Lowres& fenc, uint32_t qgSize)
 
     int costEst = 0, costEstAq = 0;
 
+    if (!fenc.takeCostSlice(0, 0))
+        return;
+
     for (int cuY = 0; cuY < heightInCU; cuY++)
     {
         fenc.rowSatds[0][0][cuY] = 0;
@@ -987,9 +990,13 @@ Lookahead::Lookahead(x265_param *param, ThreadPool* pool)
     m_lastNonB = NULL;
     m_isSceneTransition = false;
     m_scratch  = NULL;
+    m_propagateList = NULL;
+    m_slicePool = NULL;
     m_tld      = NULL;
     m_filled   = false;
     m_outputSignalRequired = false;
+    m_preAnalysisWaiting = false;
+    m_preAnalysisBusy = 0;
     m_isActive = true;
     m_inputCount = 0;
     m_extendGopBoundary = false;
@@ -1032,6 +1039,13 @@ Lookahead::Lookahead(x265_param *param, ThreadPool* pool)
      * of work */
     m_bBatchFrameCosts = m_bBatchMotionSearch;
 
+    /* With a thread pool, idle workers pre-analyse pictures as they arrive
+     * rather than leaving it all to the next slicetypeDecide(), so that the
+     * pre-analysis of later pictures overlaps the slice decisions and cuTree
+     * of the current mini-GOP. Zone reconfiguration swaps m_param inside
+     * slicetypeDecide(), so that case keeps the pre-analysis in-line */
+    m_bPipelinePreAnalysis = m_pool && !m_param->bResetZoneConfig;
+
     if (m_param->lookaheadSlices && !m_pool)
     {
         x265_log(param, X265_LOG_WARNING, "No pools found; disabling lookahead-slices\n");
@@ -1136,8 +1150,10 @@ bool Lookahead::create()
     for (int i = 0; i < numTLD; i++)
         m_tld[i].init(m_8x8Width, m_8x8Height, m_8x8Blocks);
     m_scratch = X265_MALLOC(int, m_tld[0].widthInCU);
+    m_propagateList = X265_MALLOC(int32_t, CUTREE_LIST_PLANES * m_tld[0].widthInCU);
+    m_slicePool = new LowresSlicePool(m_param->bframes);
 
-    return m_tld && m_scratch;
+    return m_tld && m_scratch && m_propagateList;
 }
 
 void Lookahead::stopJobs()
@@ -1151,6 +1167,17 @@ void Lookahead::stopJobs()
 
         if (wait)
             m_outputSignal.wait();
+
+        /* wait for workers still pre-analysing pictures of the input queue */
+        m_inputLock.acquire();
+        while (m_preAnalysisBusy)
+        {
+            m_preAnalysisWaiting = true;
+            m_inputLock.release();
+            m_preAnalysisDone.wait();
+            m_inputLock.acquire();
+        }
+        m_inputLock.release();
     }
     if (m_pool && m_param->lookaheadThreads > 0)
     {
@@ -1176,7 +1203,12 @@ void Lookahead::destroy()
         delete curFrame;
     }
 
+    /* frames still held by the DPB release the pool when they are destroyed */
+    if (m_slicePool)
+        m_slicePool->release();
+
     X265_FREE(m_scratch);
+    X265_FREE(m_propagateList);
     delete [] m_tld;
     if (m_param->lookaheadThreads > 0)
         delete [] m_pool;
@@ -1199,6 +1231,12 @@ void Lookahead::destroy()
 /* Called by API thread */
 void Lookahead::addPicture(Frame& curFrame, int sliceType)
 {
+    if (!curFrame.m_lowres.slicePool)
+    {
+        curFrame.m_lowres.slicePool = m_slicePool;
+        m_slicePool->addRef();
+    }
+
     if (m_param->analysisLoad && m_param->bDisableLookahead)
     {
         if (!m_filled)
@@ -1220,6 +1258,8 @@ void Lookahead::addPicture(Frame& curFrame)
 {
     m_inputLock.acquire();
     m_inputQueue.pushBack(curFrame);
+    if (m_bPipelinePreAnalysis && m_isActive)
+        tryWakeOne();
     m_inputLock.release();
     m_inputCount++;
 }
@@ -1256,17 +1296,55 @@ void Lookahead::setLookaheadQueue()
     m_fullQueueSize = X265_MAX(1, m_param->lookaheadDepth);
 }
 
-void Lookahead::findJob(int /*workerThreadID*/)
+void Lookahead::findJob(int workerThreadID)
 {
     bool doDecide;
+    Frame* preFrame = NULL;
 
     m_inputLock.acquire();
     if (m_inputQueue.size() >= m_fullQueueSize && !m_sliceTypeBusy && m_isActive)
         doDecide = m_sliceTypeBusy = true;
     else
-        doDecide = m_helpWanted = false;
+    {
+        doDecide = false;
+
+        /* while the queue fills or slicetypeDecide() is busy with the current
+         * mini-GOP, pool workers pre-analyse the pictures it has not reached.
+         * The API thread shares its TLD with slicetypeDecide() so it never
+         * takes these jobs */
+        if (m_bPipelinePreAnalysis && m_isActive && workerThreadID >= 0)
+        {
+            for (Frame* curFrame = m_inputQueue.first(); curFrame; curFrame = curFrame->m_next)
+            {
+                if (!curFrame->m_lowresInitClaimed)
+                {
+                    preFrame = curFrame;
+                    preFrame->m_lowresInitClaimed = true;
+                    m_preAnalysisBusy++;
+                    break;
+                }
+            }
+        }
+        m_helpWanted = !!preFrame;
+    }
     m_inputLock.release();
 
+    if (preFrame)
+    {
+        preAnalyse(*preFrame, m_tld[workerThreadID], true);
+
+        m_inputLock.acquire();
+        preFrame->m_lowresInit = true;
+        m_preAnalysisBusy--;
+        if (m_preAnalysisWaiting)
+        {
+            m_preAnalysisDone.trigger();
+            m_preAnalysisWaiting = false;
+        }
+        m_inputLock.release();
+        return;
+    }
+
     if (!doDecide)
         return;
 
@@ -1544,34 +1622,6 @@ void LookaheadTLD::computePictureStatistics(Frame *curFrame)
     curFrame->m_lowres.picAvgVarianceCr = (uint16_t)(picTotVariance / maxRowChroma);
 }
 
-/*
-* Compute histogram of n-bins for the input
-*/
-void LookaheadTLD::calculateHistogram(
-    pixel     *inputSrc,
-    uint32_t   inputWidth,
-    uint32_t   inputHeight,
-    intptr_t   stride,
-    uint8_t    dsFactor,
-    uint32_t  *histogram,
-    uint64_t  *sum)
-
-{
-    *sum = 0;
-
-    for (uint32_t verticalIdx = 0; verticalIdx < inputHeight; verticalIdx += dsFactor)
-    {
-        for (uint32_t horizontalIdx = 0; horizontalIdx < inputWidth; horizontalIdx += dsFactor)
-        {
-            ++(histogram[inputSrc[horizontalIdx]]);
-            *sum += inputSrc[horizontalIdx];
-        }
-        inputSrc += (stride << (dsFactor >> 1));
-    }
-
-    return;
-}
-
 /*
 * Compute histogram bins and chroma pixel intensity *
 */
@@ -1604,14 +1654,13 @@ void LookaheadTLD::computeIntensityHistogramBinsChroma(
 
 
             // U Histogram
-            calculateHistogram(
+            sum = primitives.histogram(
                 curFrame->m_fencPic->m_picOrg[1] + ((segmentInFrameWidthIndex * segmentWidth) >> 1) + (((segmentInFrameHeightIndex * segmentHeight) >> 1) * curFrame->m_fencPic->m_strideC),
+                curFrame->m_fencPic->m_strideC,
                 (segmentWidth + segmentWidthOffset) >> 1,
                 (segmentHeight + segmentHeightOffset) >> 1,
-                curFrame->m_fencPic->m_strideC,
                 dsFactor,
-                curFrame->m_lowres.picHistogram[segmentInFrameWidthIndex][segmentInFrameHeightIndex][1],
-                &sum);
+                curFrame->m_lowres.picHistogram[segmentInFrameWidthIndex][segmentInFrameHeightIndex][1]);
 
             sum = (sum << dsFactor);
             *sumAverageIntensityCb += sum;
@@ -1624,14 +1673,13 @@ void LookaheadTLD::computeIntensityHistogramBinsChroma(
             }
 
             // V Histogram
-            calculateHistogram(
+            sum = primitives.histogram(
                 curFrame->m_fencPic->m_picOrg[2] + ((segmentInFrameWidthIndex * segmentWidth) >> 1) + (((segmentInFrameHeightIndex * segmentHeight) >> 1) * curFrame->m_fencPic->m_strideC),
+                curFrame->m_fencPic->m_strideC,
                 (segmentWidth + segmentWidthOffset) >> 1,
                 (segmentHeight + segmentHeightOffset) >> 1,
-                curFrame->m_fencPic->m_strideC,
                 dsFactor,
-                curFrame->m_lowres.picHistogram[segmentInFrameWidthIndex][segmentInFrameHeightIndex][2],
-                &sum);
+                curFrame->m_lowres.picHistogram[segmentInFrameWidthIndex][segmentInFrameHeightIndex][2]);
 
             sum = (sum << dsFactor);
             *sumAverageIntensityCr += sum;
@@ -1676,14 +1724,13 @@ void LookaheadTLD::computeIntensityHistogramBinsLuma(
                 curFrame->m_lowres.quarterSampleLowResHeight - (NUMBER_OF_SEGMENTS_IN_HEIGHT * segmentHeight) : 0;
 
             // Y Histogram
-            calculateHistogram(
+            sum = primitives.histogram(
                 curFrame->m_lowres.quarterSampleLowResBuffer + (curFrame->m_lowres.quarterSampleLowResOriginX + segmentInFrameWidthIndex * segmentWidth) + ((curFrame->m_lowres.quarterSampleLowResOriginY + segmentInFrameHeightIndex * segmentHeight) * curFrame->m_lowres.quarterSampleLowResStrideY),
+                curFrame->m_lowres.quarterSampleLowResStrideY,
                 segmentWidth + segmentWidthOffset,
                 segmentHeight + segmentHeightOffset,
-                curFrame->m_lowres.quarterSampleLowResStrideY,
                 1,
-                curFrame->m_lowres.picHistogram[segmentInFrameWidthIndex][segmentInFrameHeightIndex][0],
-                &sum);
+                curFrame->m_lowres.picHistogram[segmentInFrameWidthIndex][segmentInFrameHeightIndex][0]);
 
             curFrame->m_lowres.averageIntensityPerSegment[segmentInFrameWidthIndex][segmentInFrameHeightIndex][0] = (uint8_t)((sum + (((segmentWidth + segmentWidthOffset)*(segmentWidth + segmentHeightOffset)) >> 1)) / ((segmentWidth + segmentWidthOffset)*(segmentHeight + segmentHeightOffset)));
             (*sumAvgIntensityTotalSegmentsLuma) += (sum << 4);
@@ -1696,11 +1743,8 @@ void LookaheadTLD::computeIntensityHistogramBinsLuma(
     }
 }
 
-void LookaheadTLD::collectPictureStatistics(Frame *curFrame)
+void LookaheadTLD::collectLumaStatistics(Frame *curFrame)
 {
-
-    uint64_t sumAverageIntensityCb = 0;
-    uint64_t sumAverageIntensityCr = 0;
     uint64_t sumAverageIntensity = 0;
 
     // Histogram bins for Luma
@@ -1708,19 +1752,26 @@ void LookaheadTLD::collectPictureStatistics(Frame *curFrame)
         curFrame,
         &sumAverageIntensity);
 
+    curFrame->m_lowres.averageIntensity[0] = (uint8_t)((sumAverageIntensity + ((curFrame->m_lowres.widthFullRes * curFrame->m_lowres.heightFullRes) >> 1)) / (curFrame->m_lowres.widthFullRes * curFrame->m_lowres.heightFullRes));
+
+    curFrame->m_lowres.bHistScenecutAnalyzed = false;
+}
+
+void LookaheadTLD::collectChromaStatistics(Frame *curFrame)
+{
+    uint64_t sumAverageIntensityCb = 0;
+    uint64_t sumAverageIntensityCr = 0;
+
     // Histogram bins for Chroma
     computeIntensityHistogramBinsChroma(
         curFrame,
         &sumAverageIntensityCb,
         &sumAverageIntensityCr);
 
-    curFrame->m_lowres.averageIntensity[0] = (uint8_t)((sumAverageIntensity + ((curFrame->m_lowres.widthFullRes * curFrame->m_lowres.heightFullRes) >> 1)) / (curFrame->m_lowres.widthFullRes * curFrame->m_lowres.heightFullRes));
     curFrame->m_lowres.averageIntensity[1] = (uint8_t)((sumAverageIntensityCb + ((curFrame->m_lowres.widthFullRes * curFrame->m_lowres.heightFullRes) >> 3)) / ((curFrame->m_lowres.widthFullRes * curFrame->m_lowres.heightFullRes) >> 2));
     curFrame->m_lowres.averageIntensity[2] = (uint8_t)((sumAverageIntensityCr + ((curFrame->m_lowres.widthFullRes * curFrame->m_lowres.heightFullRes) >> 3)) / ((curFrame->m_lowres.widthFullRes * curFrame->m_lowres.heightFullRes) >> 2));
 
     computePictureStatistics(curFrame);
-
-    curFrame->m_lowres.bHistScenecutAnalyzed = false;
 }
 
 void PreLookaheadGroup::processTasks(int workerThreadID)
@@ -1732,25 +1783,39 @@ void PreLookaheadGroup::processTasks(int workerThreadID)
     m_lock.acquire();
     while (m_jobAcquired < m_jobTotal)
     {
-        Frame* preFrame = m_preframes[m_jobAcquired++];
-        ProfileLookaheadTime(m_lookahead.m_preLookaheadElapsedTime, m_lookahead.m_countPreLookahead);
-        ProfileScopeEvent(prelookahead);
+        int job = m_jobAcquired++;
+        Frame* preFrame = m_preframes[job % m_numFrames];
         m_lock.release();
-        preFrame->m_lowres.init(preFrame->m_fencPic, preFrame->m_poc);
-        if (m_lookahead.m_bAdaptiveQuant)
-            tld.calcAdaptiveQuantFrame(preFrame, m_lookahead.m_param);
-
-        if (m_lookahead.m_param->bHistBasedSceneCut)
-            tld.collectPictureStatistics(preFrame);
 
-        tld.lowresIntraEstimate(preFrame->m_lowres, m_lookahead.m_param->rc.qgSize);
-        preFrame->m_lowresInit = true;
+        if (job < m_numFrames)
+            m_lookahead.preAnalyse(*preFrame, tld, m_jobTotal == m_numFrames);
+        else
+            tld.collectChromaStatistics(preFrame);
 
         m_lock.acquire();
     }
     m_lock.release();
 }
 
+void Lookahead::preAnalyse(Frame& curFrame, LookaheadTLD& tld, bool bChromaStatistics)
+{
+    ProfileLookaheadTime(m_preLookaheadElapsedTime, m_countPreLookahead);
+    ProfileScopeEvent(prelookahead);
+
+    curFrame.m_lowres.init(curFrame.m_fencPic, curFrame.m_poc);
+    if (m_bAdaptiveQuant)
+        tld.calcAdaptiveQuantFrame(&curFrame, m_param);
+
+    if (m_param->bHistBasedSceneCut)
+    {
+        tld.collectLumaStatistics(&curFrame);
+        if (bChromaStatistics)
+            tld.collectChromaStatistics(&curFrame);
+    }
+
+    tld.lowresIntraEstimate(curFrame.m_lowres, m_param->rc.qgSize);
+}
+
 
 void Lookahead::placeBref(Frame** frames, int start, int end, int num, int *brefs)
 {
@@ -1808,6 +1873,7 @@ void Lookahead::slicetypeDecide()
     memset(list, 0, sizeof(list));
     int maxSearch = X265_MIN(m_param->lookaheadDepth, X265_LOOKAHEAD_MAX);
     maxSearch = X265_MAX(1, maxSearch);
+    bool bPreAnalysisPending = false;
 
     {
         ScopedLock lock(m_inputLock);
@@ -1840,8 +1906,13 @@ void Lookahead::slicetypeDecide()
             if (!curFrame) break;
             frames[j + 1] = &curFrame->m_lowres;
 
-            if (!curFrame->m_lowresInit)
+            if (!curFrame->m_lowresInitClaimed)
+            {
+                curFrame->m_lowresInitClaimed = true;
                 pre.m_preframes[pre.m_jobTotal++] = curFrame;
+            }
+            else if (!curFrame->m_lowresInit)
+                bPreAnalysisPending = true;
 
             curFrame = curFrame->m_next;
         }
@@ -1849,13 +1920,44 @@ void Lookahead::slicetypeDecide()
         maxSearch = j;
     }
 
-    /* perform pre-analysis on frames which need it, using a bonded task group */
+    /* perform pre-analysis on frames which need it, using a bonded task group.
+     * The chroma statistics of hist-scenecut are separate jobs, so that they
+     * run alongside the lowres init of the same picture */
     if (pre.m_jobTotal)
     {
+        pre.m_numFrames = pre.m_jobTotal;
+        if (m_pool && m_param->bHistBasedSceneCut)
+            pre.m_jobTotal += pre.m_numFrames;
+
         if (m_pool)
             pre.tryBondPeers(*m_pool, pre.m_jobTotal);
         pre.processTasks(-1);
         pre.waitForExit();
+
+        for (int i = 0; i < pre.m_numFrames; i++)
+            pre.m_preframes[i]->m_lowresInit = true;
+    }
+
+    /* wait for the pictures of this window still being pre-analysed by
+     * workers outside of slicetypeDecide() */
+    if (bPreAnalysisPending)
+    {
+        m_inputLock.acquire();
+        for (;;)
+        {
+            Frame* curFrame = m_inputQueue.first();
+            int j;
+            for (j = 0; j < maxSearch && curFrame->m_lowresInit; j++)
+                curFrame = curFrame->m_next;
+            if (j == maxSearch)
+                break;
+
+            m_preAnalysisWaiting = true;
+            m_inputLock.release();
+            m_preAnalysisDone.wait();
+            m_inputLock.acquire();
+        }
+        m_inputLock.release();
     }
 
     if(m_param->bEnableFades)
@@ -2678,12 +2780,12 @@ void Lookahead::slicetypeAnalyse(Lowres **frames, bool bKeyframe)
                     continue;
 
                 /* Skip search if already done */
-                if (frames[b]->lowresMvs[0][i][0].x != 0x7FFF)
+                if (frames[b]->hasMvs(0, i))
                     continue;
 
                 /* perform search to p1 at same distance, if possible */
                 int p1 = b + i;
-                if (p1 >= numFrames || frames[b]->lowresMvs[1][i][0].x != 0x7FFF)
+                if (p1 >= numFrames || frames[b]->hasMvs(1, i))
                     p1 = b;
 
                 estGroup.add(p0, p1, b);
@@ -2705,7 +2807,7 @@ void Lookahead::slicetypeAnalyse(Lowres **frames, bool bKeyframe)
 
                     /* only measure frame cost in this pass if motion searches
                      * are already done */
-                    if (frames[b]->lowresMvs[0][i][0].x == 0x7FFF)
+                    if (!frames[b]->hasMvs(0, i))
                         continue;
 
                     int p0 = b - i;
@@ -2717,7 +2819,7 @@ void Lookahead::slicetypeAnalyse(Lowres **frames, bool bKeyframe)
                             break;
 
                         /* ensure P1 search is done */
-                        if (j && frames[b]->lowresMvs[1][j][0].x == 0x7FFF)
+                        if (j && !frames[b]->hasMvs(1, j))
                             continue;
 
                         /* ensure frame cost is not done */
@@ -3534,70 +3636,61 @@ void Lookahead::estimateCUPropagate(Lowres **frames, double averageDuration, int
         if (referenced)
             propagateCost += m_8x8Width;
 
-        for (uint16_t blockx = 0; blockx < m_8x8Width; blockx++, cuIndex++)
+        /* Follow the MVs to the previous frame(s). The list 1 MVs of a P frame
+         * (b == p1) are never used */
+        for (int list = 0; list < (b < p1 ? 2 : 1); list++)
         {
-            int32_t propagate_amount = m_scratch[blockx];
-            /* Don't propagate for an intra block. */
-            if (propagate_amount > 0)
+            MV *mvs = frames[b]->lowresMvs[list][listDist[list]] + cuIndex;
+            uint16_t *listCosts = refCosts[list];
+
+            primitives.propagateList(m_propagateList, m_scratch, mvs, frames[b]->lowresCosts[b - p0][p1 - b] + cuIndex,
+                                     bipredWeights[list], list, blocky, m_8x8Width);
+
+            const int32_t* amounts = m_propagateList;
+            const int32_t* cuxs = m_propagateList + m_8x8Width;
+            const int32_t* cuys = m_propagateList + 2 * m_8x8Width;
+            const int32_t* shares = m_propagateList + 3 * m_8x8Width;
+
+            for (int blockx = 0; blockx < m_8x8Width; blockx++)
             {
-                /* Access width-2 bitfield. */
-                int32_t lists_used = frames[b]->lowresCosts[b - p0][p1 - b][cuIndex] >> LOWRES_COST_SHIFT;
-                /* Follow the MVs to the previous frame(s). */
-                for (uint16_t list = 0; list < 2; list++)
-                {
-                    if ((lists_used >> list) & 1)
-                    {
-#define CLIP_ADD(s, x) (s) = (uint16_t)X265_MIN((s) + (x), (1 << 16) - 1)
-                        int32_t listamount = propagate_amount;
-                        /* Apply bipred weighting. */
-                        if (lists_used == 3)
-                            listamount = (listamount * bipredWeights[list] + 32) >> 6;
+                /* Don't propagate for an intra block or a list it does not use */
+                if (amounts[blockx] <= 0)
+                    continue;
 
-                        MV *mvs = frames[b]->lowresMvs[list][listDist[list]];
+#define CLIP_ADD(s, x) (s) = (uint16_t)X265_MIN((s) + (x), (1 << 16) - 1)
+                /* Early termination for simple case of mv0. */
+                if (!mvs[blockx].word)
+                {
+                    CLIP_ADD(listCosts[cuIndex + blockx], amounts[blockx]);
+                    continue;
+                }
 
-                        /* Early termination for simple case of mv0. */
-                        if (!mvs[cuIndex].word)
-                        {
-                            CLIP_ADD(refCosts[list][cuIndex], listamount);
-                            continue;
-                        }
+                int32_t cux = cuxs[blockx];
+                int32_t cuy = cuys[blockx];
+                int32_t idx0 = cux + cuy * strideInCU;
+                int32_t idx1 = idx0 + 1;
+                int32_t idx2 = idx0 + strideInCU;
+                int32_t idx3 = idx0 + strideInCU + 1;
 
-                        int32_t x = mvs[cuIndex].x;
-                        int32_t y = mvs[cuIndex].y;
-                        int32_t cux = (x >> 5) + blockx;
-                        int32_t cuy = (y >> 5) + blocky;
-                        int32_t idx0 = cux + cuy * strideInCU;
-                        int32_t idx1 = idx0 + 1;
-                        int32_t idx2 = idx0 + strideInCU;
-                        int32_t idx3 = idx0 + strideInCU + 1;
-                        x &= 31;
-                        y &= 31;
-                        int32_t idx0weight = (32 - y) * (32 - x);
-                        int32_t idx1weight = (32 - y) * x;
-                        int32_t idx2weight = y * (32 - x);
-                        int32_t idx3weight = y * x;
-
-                        /* We could just clip the MVs, but pixels that lie outside the frame probably shouldn't
-                         * be counted. */
-                        if (cux < m_8x8Width - 1 && cuy < m_8x8Height - 1 && cux >= 0 && cuy >= 0)
-                        {
-                            CLIP_ADD(refCosts[list][idx0], (listamount * idx0weight + 512) >> 10);
-                            CLIP_ADD(refCosts[list][idx1], (listamount * idx1weight + 512) >> 10);
-                            CLIP_ADD(refCosts[list][idx2], (listamount * idx2weight + 512) >> 10);
-                            CLIP_ADD(refCosts[list][idx3], (listamount * idx3weight + 512) >> 10);
-                        }
-                        else /* Check offsets individually */
-                        {
-                            if (cux < m_8x8Width && cuy < m_8x8Height && cux >= 0 && cuy >= 0)
-                                CLIP_ADD(refCosts[list][idx0], (listamount * idx0weight + 512) >> 10);
-                            if (cux + 1 < m_8x8Width && cuy < m_8x8Height && cux + 1 >= 0 && cuy >= 0)
-                                CLIP_ADD(refCosts[list][idx1], (listamount * idx1weight + 512) >> 10);
-                            if (cux < m_8x8Width && cuy + 1 < m_8x8Height && cux >= 0 && cuy + 1 >= 0)
-                                CLIP_ADD(refCosts[list][idx2], (listamount * idx2weight + 512) >> 10);
-                            if (cux + 1 < m_8x8Width && cuy + 1 < m_8x8Height && cux + 1 >= 0 && cuy + 1 >= 0)
-                                CLIP_ADD(refCosts[list][idx3], (listamount * idx3weight + 512) >> 10);
-                        }
-                    }
+                /* We could just clip the MVs, but pixels that lie outside the frame probably shouldn't
+                 * be counted. */
+                if (cux < m_8x8Width - 1 && cuy < m_8x8Height - 1 && cux >= 0 && cuy >= 0)
+                {
+                    CLIP_ADD(listCosts[idx0], shares[blockx]);
+                    CLIP_ADD(listCosts[idx1], shares[blockx + m_8x8Width]);
+                    CLIP_ADD(listCosts[idx2], shares[blockx + 2 * m_8x8Width]);
+                    CLIP_ADD(listCosts[idx3], shares[blockx + 3 * m_8x8Width]);
+                }
+                else /* Check offsets individually */
+                {
+                    if (cux < m_8x8Width && cuy < m_8x8Height && cux >= 0 && cuy >= 0)
+                        CLIP_ADD(listCosts[idx0], shares[blockx]);
+                    if (cux + 1 < m_8x8Width && cuy < m_8x8Height && cux + 1 >= 0 && cuy >= 0)
+                        CLIP_ADD(listCosts[idx1], shares[blockx + m_8x8Width]);
+                    if (cux < m_8x8Width && cuy + 1 < m_8x8Height && cux >= 0 && cuy + 1 >= 0)
+                        CLIP_ADD(listCosts[idx2], shares[blockx + 2 * m_8x8Width]);
+                    if (cux + 1 < m_8x8Width && cuy + 1 < m_8x8Height && cux + 1 >= 0 && cuy + 1 >= 0)
+                        CLIP_ADD(listCosts[idx3], shares[blockx + 3 * m_8x8Width]);
                 }
             }
         }
@@ -3881,6 +3974,9 @@ int64_t Lookahead::frameCostRecalculate(Lowres** frames, int p0, int p1, int b)
 
 int64_t CostEstimateGroup::singleCost(int p0, int p1, int b, bool intraPenalty)
 {
+    if (!m_frames[b]->takeSlices(b - p0, p1 - b))
+        return 0;
+
     LookaheadTLD& tld = m_lookahead.m_tld[m_lookahead.m_pool ? m_lookahead.m_pool->m_numWorkers : 0];
     return estimateFrameCost(tld, p0, p1, b, intraPenalty);
 }
@@ -3890,6 +3986,10 @@ void CostEstimateGroup::add(int p0, int p1, int b)
     X265_CHECK(m_batchMode || !m_jobTotal, "single CostEstimateGroup instance cannot mix batch modes\n");
     m_batchMode = true;
 
+    /* slices are taken here, the batch jobs only write to them */
+    if (!m_frames[b]->takeSlices(b - p0, p1 - b))
+        return;
+
     Estimate& e = m_estimates[m_jobTotal++];
     e.p0 = p0;
     e.p1 = p1;
@@ -4139,7 +4239,7 @@ void CostEstimateGroup::estimateCUCost(LookaheadTLD& tld, int cuX, int cuY, int
             if (cuX < widthInCU - 1)
                 MVC(fencMV[widthInCU + 1]);
         }
-        if (fenc->lowerResMvs[0][0] && !hme && fenc->lowerResMvCosts[i][listDist[i]][cuXY_4x4] > 0)
+        if (fenc->bEnableHME && !hme && fenc->lowerResMvCosts[i][listDist[i]][cuXY_4x4] > 0)
         {
             MVC((fenc->lowerResMvs[i][listDist[i]][cuXY_4x4]) * 2);
         }
@@ -111,7 +111,10 @@ struct LookaheadTLD
 
     ~LookaheadTLD() { X265_FREE(wbuffer[0]); }
 
-    void collectPictureStatistics(Frame *curFrame);
+    /* hist-scenecut statistics; the luma histograms need the lowres planes,
+     * the chroma histograms and block variances only need the source picture */
+    void collectLumaStatistics(Frame *curFrame);
+    void collectChromaStatistics(Frame *curFrame);
     void computeIntensityHistogramBinsLuma(Frame *curFrame, uint64_t *sumAvgIntensityTotalSegmentsLuma);
 
     void computeIntensityHistogramBinsChroma(
@@ -119,15 +122,6 @@ struct LookaheadTLD
         uint64_t *sumAverageIntensityCb,
         uint64_t *sumAverageIntensityCr);
 
-    void calculateHistogram(
-        pixel    *inputSrc,
-        uint32_t  inputWidth,
-        uint32_t  inputHeight,
-        intptr_t  stride,
-        uint8_t   dsFactor,
-        uint32_t *histogram,
-        uint64_t *sum);
-
     void computePictureStatistics(Frame *curFrame);
 
     uint32_t calcVariance(pixel* src, intptr_t stride, intptr_t blockOffset, uint32_t plane);
@@ -157,10 +151,13 @@ public:
     Lock          m_inputLock;
     Lock          m_outputLock;
     Event         m_outputSignal;
+    Event         m_preAnalysisDone;
     LookaheadTLD* m_tld;
     x265_param*   m_param;
     Lowres*       m_lastNonB;
     int*          m_scratch;         // temp buffer for cutree propagate
+    int32_t*      m_propagateList;   // MV splat of one cutree row, CUTREE_LIST_PLANES planes
+    LowresSlicePool* m_slicePool;    // cost and MV slices of the frames in flight
 
     /* pre-lookahead */
     int           m_fullQueueSize;
@@ -184,6 +181,9 @@ public:
     bool          m_outputSignalRequired;
     bool          m_bBatchMotionSearch;
     bool          m_bBatchFrameCosts;
+    bool          m_bPipelinePreAnalysis;
+    bool          m_preAnalysisWaiting;
+    int           m_preAnalysisBusy;  // pictures being pre-analysed outside slicetypeDecide()
     bool          m_filled;
     bool          m_isSceneTransition;
     int           m_numPools;
@@ -225,6 +225,10 @@ public:
     void    setLookaheadQueue();
     int     findSliceType(int poc);
 
+    /* lowres init, adaptive quant and intra estimate of one picture. The
+     * chroma statistics of hist-scenecut may be left to a separate job */
+    void    preAnalyse(Frame& curFrame, LookaheadTLD& tld, bool bChromaStatistics);
+
 protected:
 
     void    findJob(int workerThreadID);
@@ -263,9 +267,12 @@ class PreLookaheadGroup : public BondedTaskGroup
 public:
 
     Frame* m_preframes[X265_LOOKAHEAD_MAX];
+    int    m_numFrames;
     Lookahead& m_lookahead;
 
-    PreLookaheadGroup(Lookahead& l) : m_lookahead(l) {}
+    /* with hist-scenecut each picture is two jobs; job m_numFrames + i
+     * collects the chroma statistics of m_preframes[i] */
+    PreLookaheadGroup(Lookahead& l) : m_numFrames(0), m_lookahead(l) {}
 
     void processTasks(int workerThreadID);
 
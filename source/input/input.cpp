@@ -24,12 +24,19 @@
 #include "input.h"
 #include "yuv.h"
 #include "y4m.h"
+#ifndef _WIN32
+#include "yuvasync.h"
+#endif
 #ifdef HAVE_VPY
 #include "vpy.h"
 #endif
 #ifdef HAVE_AVS
 #include "avs.h"
 #endif
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 using namespace X265_NS;
 
@@ -46,7 +53,39 @@ InputFile* InputFile::open(InputFileInfo& info, bool bForceY4m)
 #ifdef HAVE_AVS
     else if (s && !strcmp(s, ".avs"))
         return new AVSInput(info);
+#endif
+#ifndef _WIN32
+    else if (AsyncYUVInput::isRequested(info))
+        return new AsyncYUVInput(info);
 #endif
     else
         return new YUVInput(info);
 }
+
+const char* InputFile::readerOption(const char* opts, const char* key)
+{
+    size_t len = strlen(key);
+    const char* p = opts;
+    while (p && *p)
+    {
+        if (!strncmp(p, key, len) && p[len] == '=')
+            return p + len + 1;
+        p = strchr(p, ';');
+        if (p)
+            p++;
+    }
+    return NULL;
+}
+
+void InputFile::prefetchMapped(const uint8_t* map, uint64_t mapSize, uint64_t offset, uint64_t len)
+{
+#ifndef _WIN32
+    if (offset >= mapSize)
+        return;
+    len = X265_MIN(len, mapSize - offset);
+    uint64_t start = offset & ~((uint64_t)sysconf(_SC_PAGESIZE) - 1);
+    madvise((void*)(map + start), (size_t)(offset + len - start), MADV_WILLNEED);
+#else
+    (void)map; (void)mapSize; (void)offset; (void)len;
+#endif
+}
@@ -72,6 +72,12 @@ public:
 
     static InputFile* open(InputFileInfo& info, bool bForceY4m);
 
+    /* value of key in the key=value;... reader options, or NULL */
+    static const char* readerOption(const char* opts, const char* key);
+
+    /* hint that a range of a mapped input file is about to be read */
+    static void prefetchMapped(const uint8_t* map, uint64_t mapSize, uint64_t offset, uint64_t len);
+
     virtual void startReader() = 0;
 
     virtual void stopReader() = 0;
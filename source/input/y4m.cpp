@@ -59,6 +59,10 @@ Y4MInput::Y4MInput(InputFileInfo& info)
     frameCount = -1;
 
     ifs = NULL;
+    map = NULL;
+    mapSize = mapFirstHeader = mapStride = 0;
+    mapFirstFrame = 0;
+    mapEof = false;
     if (!strcmp(info.filename, "-"))
     {
         ifs = stdin;
@@ -77,8 +81,27 @@ Y4MInput::Y4MInput(InputFileInfo& info)
             framesize += (stride * (height >> x265_cli_csps[colorSpace].height[i]));
         }
 
+        /* a mapped file is read in place: seeking is free and the page cache
+         * is shared with other encoders reading the same file */
+        const char* mmapOpt = readerOption(info.readerOpts, "mmap");
+        if (mmapOpt && atoi(mmapOpt) && ifs != stdin)
+        {
+            int64_t headerEnd = ftello(ifs);
+            if (headerEnd > 0)
+                map = x265_map_file(ifs, &mapSize);
+            if (map)
+            {
+                mapFirstHeader = (uint64_t)headerEnd;
+                if (mapFirstHeader + sizeof(header) < mapSize && !memcmp(map + mapFirstHeader, header, sizeof(header)) &&
+                    map[mapFirstHeader + sizeof(header)] == '\n')
+                    mapStride = framesize + sizeof(header) + 1;
+            }
+            else
+                x265_log(NULL, X265_LOG_WARNING, "y4m: unable to map %s, reading it sequentially\n", info.filename);
+        }
+
         threadActive = true;
-        for (int q = 0; q < QUEUE_SIZE; q++)
+        for (int q = 0; !map && q < QUEUE_SIZE; q++)
         {
             buf[q] = X265_MALLOC(char, framesize);
             if (!buf[q])
@@ -120,7 +143,9 @@ Y4MInput::Y4MInput(InputFileInfo& info)
                 info.frameCount = (int)((size - cur) / estFrameSize);
         }
     }
-    if (info.skipFrames)
+    if (map)
+        mapFirstFrame = info.skipFrames;
+    else if (info.skipFrames)
     {
         if (ifs != stdin)
             fseeko(ifs, (int64_t)estFrameSize * info.skipFrames, SEEK_CUR);
@@ -132,6 +157,7 @@ Y4MInput::Y4MInput(InputFileInfo& info)
 }
 Y4MInput::~Y4MInput()
 {
+    x265_unmap_file(map, mapSize);
     if (ifs && ifs != stdin)
         fclose(ifs);
     for (int i = 0; i < QUEUE_SIZE; i++)
@@ -348,7 +374,7 @@ bool Y4MInput::parseHeader()
 void Y4MInput::startReader()
 {
 #if ENABLE_THREADING
-    if (threadActive)
+    if (threadActive && !map)
         start();
 #endif
 }
@@ -402,24 +428,80 @@ bool Y4MInput::populateFrameQueue()
         return false;
 }
 
+/* Offset of the samples of a frame in the mapped file. While every FRAME header
+ * is bare the frames are a fixed stride apart, so any frame is found directly;
+ * the first header carrying parameters switches to an index of the frames,
+ * built by walking the headers from the start as far as frames are asked for */
+bool Y4MInput::mapFrame(int frame, uint64_t& offset)
+{
+    if (mapStride)
+    {
+        uint64_t pos = mapFirstHeader + frame * mapStride;
+        if (pos + mapStride > mapSize)
+            return false;
+        if (!memcmp(map + pos, header, sizeof(header)) && map[pos + sizeof(header)] == '\n')
+        {
+            offset = pos + sizeof(header) + 1;
+            return true;
+        }
+        mapStride = 0;
+    }
+
+    while ((int)mapIndex.size() <= frame)
+    {
+        uint64_t pos = mapIndex.empty() ? mapFirstHeader : mapIndex.back() + framesize;
+        if (pos + sizeof(header) > mapSize || memcmp(map + pos, header, sizeof(header)))
+        {
+            if (pos < mapSize)
+                x265_log(NULL, X265_LOG_ERROR, "y4m: frame header missing\n");
+            return false;
+        }
+        const uint8_t* lf = (const uint8_t*)memchr(map + pos, '\n', (size_t)(mapSize - pos));
+        if (!lf || (uint64_t)(lf + 1 - map) + framesize > mapSize)
+            return false;
+        mapIndex.push_back((uint64_t)(lf + 1 - map));
+    }
+    offset = mapIndex[frame];
+    return true;
+}
+
 bool Y4MInput::readPicture(x265_picture& pic)
 {
     int read = readCount.get();
-    int written = writeCount.get();
+    char* frame = NULL;
+
+    if (map)
+    {
+        uint64_t offset;
+        if (!mapEof && mapFrame(mapFirstFrame + read, offset))
+        {
+            frame = (char*)map + offset;
+            prefetchMapped(map, mapSize, offset + framesize, framesize + sizeof(header) + 1);
+        }
+        else
+            mapEof = true;
+    }
+    else
+    {
+        int written = writeCount.get();
 
 #if ENABLE_THREADING
 
-    /* only wait if the read thread is still active */
-    while (threadActive && read == written)
-        written = writeCount.waitForChange(written);
+        /* only wait if the read thread is still active */
+        while (threadActive && read == written)
+            written = writeCount.waitForChange(written);
 
 #else
 
-    populateFrameQueue();
+        populateFrameQueue();
 
 #endif // if ENABLE_THREADING
 
-    if (read < written)
+        if (read < written)
+            frame = buf[read % QUEUE_SIZE];
+    }
+
+    if (frame)
     {
         int pixelbytes = depth > 8 ? 2 : 1;
         pic.bitDepth = depth;
@@ -430,7 +512,7 @@ bool Y4MInput::readPicture(x265_picture& pic)
         pic.stride[0] = width * pixelbytes;
         pic.stride[1] = pic.stride[0] >> x265_cli_csps[colorSpace].width[1];
         pic.stride[2] = pic.stride[0] >> x265_cli_csps[colorSpace].width[2];
-        pic.planes[0] = buf[read % QUEUE_SIZE];
+        pic.planes[0] = frame;
         pic.planes[1] = (char*)pic.planes[0] + pic.stride[0] * height;
         pic.planes[2] = (char*)pic.planes[1] + pic.stride[1] * (height >> x265_cli_csps[colorSpace].height[1]);
         readCount.incr();
@@ -27,6 +27,7 @@
 #include "input.h"
 #include "threading.h"
 #include <fstream>
+#include <vector>
 
 #define QUEUE_SIZE 5
 
@@ -64,7 +65,17 @@ protected:
     ThreadSafeInteger writeCount;
     char* buf[QUEUE_SIZE];
     FILE *ifs;
+
+    uint8_t* map;        // whole file, with reader option mmap=1
+    uint64_t mapSize;
+    uint64_t mapFirstHeader;
+    uint64_t mapStride;  // frame stride while every FRAME header is bare, else 0
+    std::vector<uint64_t> mapIndex; // frame data offsets, built once headers vary
+    int mapFirstFrame;
+    bool mapEof;
+
     bool parseHeader();
+    bool mapFrame(int frame, uint64_t& offset);
     void threadMain();
 
     bool populateFrameQueue();
@@ -75,7 +86,7 @@ public:
 
     virtual ~Y4MInput();
     void release();
-    bool isEof() const            { return ifs && feof(ifs); }
+    bool isEof() const            { return map ? mapEof : ifs && feof(ifs); }
     bool isFail()                 { return !(ifs && !ferror(ifs) && threadActive); }
     void startReader();
     void stopReader() {}
@@ -51,6 +51,9 @@ YUVInput::YUVInput(InputFileInfo& info)
     colorSpace = info.csp;
     threadActive = false;
     ifs = NULL;
+    map = NULL;
+    mapSize = 0;
+    mapFirstFrame = 0;
 
     uint32_t pixelbytes = depth > 8 ? 2 : 1;
     framesize = 0;
@@ -85,7 +88,17 @@ YUVInput::YUVInput(InputFileInfo& info)
         return;
     }
 
-    for (uint32_t i = 0; i < QUEUE_SIZE; i++)
+    /* a mapped file is read in place: seeking is free and the page cache is
+     * shared with other encoders reading the same file */
+    const char* mmapOpt = readerOption(info.readerOpts, "mmap");
+    if (mmapOpt && atoi(mmapOpt) && ifs != stdin)
+    {
+        map = x265_map_file(ifs, &mapSize);
+        if (!map)
+            x265_log(NULL, X265_LOG_WARNING, "yuv: unable to map %s, reading it sequentially\n", info.filename);
+    }
+
+    for (uint32_t i = 0; !map && i < QUEUE_SIZE; i++)
     {
         buf[i] = X265_MALLOC(char, framesize);
         if (buf[i] == NULL)
@@ -110,7 +123,9 @@ YUVInput::YUVInput(InputFileInfo& info)
                 info.frameCount = (int)((size - cur) / framesize);
         }
     }
-    if (info.skipFrames)
+    if (map)
+        mapFirstFrame = info.skipFrames;
+    else if (info.skipFrames)
     {
         if (ifs != stdin)
             fseeko(ifs, (int64_t)framesize * info.skipFrames, SEEK_CUR);
@@ -122,6 +137,7 @@ YUVInput::YUVInput(InputFileInfo& info)
 }
 YUVInput::~YUVInput()
 {
+    x265_unmap_file(map, mapSize);
     if (ifs && ifs != stdin)
         fclose(ifs);
     for (int i = 0; i < QUEUE_SIZE; i++)
@@ -139,7 +155,7 @@ void YUVInput::release()
 void YUVInput::startReader()
 {
 #if ENABLE_THREADING
-    if (threadActive)
+    if (threadActive && !map)
         start();
 #endif
 }
@@ -183,21 +199,38 @@ bool YUVInput::populateFrameQueue()
 bool YUVInput::readPicture(x265_picture& pic)
 {
     int read = readCount.get();
-    int written = writeCount.get();
+    char* frame = NULL;
+
+    if (map)
+    {
+        uint64_t offset = (uint64_t)(mapFirstFrame + read) * framesize;
+        if (offset + framesize <= mapSize)
+        {
+            frame = (char*)map + offset;
+            prefetchMapped(map, mapSize, offset + framesize, framesize);
+        }
+    }
+    else
+    {
+        int written = writeCount.get();
 
 #if ENABLE_THREADING
 
-    /* only wait if the read thread is still active */
-    while (threadActive && read == written)
-        written = writeCount.waitForChange(written);
+        /* only wait if the read thread is still active */
+        while (threadActive && read == written)
+            written = writeCount.waitForChange(written);
 
 #else
 
-    populateFrameQueue();
+        populateFrameQueue();
 
 #endif // if ENABLE_THREADING
 
-    if (read < written)
+        if (read < written)
+            frame = buf[read % QUEUE_SIZE];
+    }
+
+    if (frame)
     {
         uint32_t pixelbytes = depth > 8 ? 2 : 1;
         pic.colorSpace = colorSpace;
@@ -208,7 +241,7 @@ bool YUVInput::readPicture(x265_picture& pic)
         pic.stride[0] = width * pixelbytes;
         pic.stride[1] = pic.stride[0] >> x265_cli_csps[colorSpace].width[1];
         pic.stride[2] = pic.stride[0] >> x265_cli_csps[colorSpace].width[2];
-        pic.planes[0] = buf[read % QUEUE_SIZE];
+        pic.planes[0] = frame;
         pic.planes[1] = (char*)pic.planes[0] + pic.stride[0] * height;
         pic.planes[2] = (char*)pic.planes[1] + pic.stride[1] * (height >> x265_cli_csps[colorSpace].height[1]);
         readCount.incr();
@@ -49,7 +49,11 @@ protected:
 
     bool threadActive;
 
-    ThreadSafeInteger readCount;
+    mutable ThreadSafeInteger readCount;
+
+    uint8_t* map;        // whole file, with reader option mmap=1
+    uint64_t mapSize;
+    int mapFirstFrame;
 
     ThreadSafeInteger writeCount;
     char* buf[QUEUE_SIZE];
@@ -65,7 +69,7 @@ public:
 
     virtual ~YUVInput();
     void release();
-    bool isEof() const                            { return ifs && feof(ifs); }
+    bool isEof() const                            { return map ? (uint64_t)(mapFirstFrame + readCount.get() + 1) * framesize > mapSize : ifs && feof(ifs); }
     bool isFail()                                 { return !(ifs && !ferror(ifs) && threadActive); }
     void startReader();
     void stopReader() {}
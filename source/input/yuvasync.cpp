@@ -0,0 +1,493 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+#define _FILE_OFFSET_BITS 64
+#define _LARGEFILE_SOURCE
+#include "yuvasync.h"
+#include "common.h"
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#if HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace X265_NS;
+
+namespace X265_NS {
+/* io_uring without liburing: the submission and completion rings mapped from
+ * the kernel, one READV per frame with its iovec kept per slot */
+struct AsyncUring
+{
+    int           fd;
+    void*         sqRing;
+    void*         cqRing;
+    size_t        sqRingSize;
+    size_t        cqRingSize;
+#if HAVE_IO_URING
+    unsigned*     sqHead;
+    unsigned*     sqTail;
+    unsigned*     sqArray;
+    unsigned      sqMask;
+    unsigned*     cqHead;
+    unsigned*     cqTail;
+    unsigned      cqMask;
+    io_uring_sqe* sqes;
+    io_uring_cqe* cqes;
+    size_t        sqesSize;
+    struct iovec  iov[ASYNC_MAX_QUEUE];
+#endif
+};
+}
+
+static void closeRing(AsyncUring* ring)
+{
+#if HAVE_IO_URING
+    if (ring->sqes && ring->sqes != MAP_FAILED)
+        munmap(ring->sqes, ring->sqesSize);
+    if (ring->cqRing && ring->cqRing != MAP_FAILED && ring->cqRing != ring->sqRing)
+        munmap(ring->cqRing, ring->cqRingSize);
+    if (ring->sqRing && ring->sqRing != MAP_FAILED)
+        munmap(ring->sqRing, ring->sqRingSize);
+    close(ring->fd);
+#endif
+    delete ring;
+}
+
+bool AsyncYUVInput::isRequested(const InputFileInfo& info)
+{
+    const char* opts = info.readerOpts;
+    if (!opts || !strcmp(info.filename, "-"))
+        return false;
+    return strstr(opts, "io=") || strstr(opts, "queue=") || strstr(opts, "threads=") || strstr(opts, "direct=");
+}
+
+AsyncYUVInput::AsyncYUVInput(InputFileInfo& info)
+{
+    for (int i = 0; i < ASYNC_MAX_QUEUE; i++)
+    {
+        m_slotBuf[i] = NULL;
+        m_slotDelta[i] = 0;
+    }
+    for (int i = 0; i < ASYNC_MAX_THREADS; i++)
+        m_workers[i].m_input = this;
+
+    m_depth = info.depth;
+    m_width = info.width;
+    m_height = info.height;
+    m_colorSpace = info.csp;
+    m_fd = -1;
+    m_ring = NULL;
+    m_threadActive = false;
+    m_bDirect = false;
+    m_queueDepth = 8;
+    m_numThreads = 4;
+    m_totalFrames = 0;
+    m_firstOffset = 0;
+
+    uint32_t pixelbytes = m_depth > 8 ? 2 : 1;
+    m_framesize = 0;
+    for (int i = 0; i < x265_cli_csps[m_colorSpace].planes; i++)
+    {
+        uint32_t w = m_width >> x265_cli_csps[m_colorSpace].width[i];
+        uint32_t h = m_height >> x265_cli_csps[m_colorSpace].height[i];
+        m_framesize += w * h * pixelbytes;
+    }
+    m_slotSize = m_framesize;
+
+    if (m_width == 0 || m_height == 0 || info.fpsNum == 0 || info.fpsDenom == 0)
+    {
+        x265_log(NULL, X265_LOG_ERROR, "yuv: width, height, and FPS must be specified\n");
+        return;
+    }
+
+    bool bUring = true;
+    parseOptions(info.readerOpts, bUring);
+
+    if (m_bDirect)
+    {
+        m_fd = ::open(info.filename, O_RDONLY | O_DIRECT);
+        if (m_fd < 0)
+        {
+            x265_log(NULL, X265_LOG_WARNING, "yuv: O_DIRECT not supported for %s, using buffered reads\n", info.filename);
+            m_bDirect = false;
+        }
+    }
+    if (m_fd < 0)
+        m_fd = ::open(info.filename, O_RDONLY);
+    if (m_fd < 0)
+        return;
+
+    struct stat st;
+    if (fstat(m_fd, &st) || !S_ISREG(st.st_mode))
+    {
+        x265_log(NULL, X265_LOG_ERROR, "yuv: asynchronous reads need a regular file\n");
+        close(m_fd);
+        m_fd = -1;
+        return;
+    }
+
+    info.frameCount = (int)(st.st_size / m_framesize);
+    m_firstOffset = (int64_t)m_framesize * info.skipFrames;
+    m_totalFrames = X265_MAX(info.frameCount - info.skipFrames, 0);
+    if (info.encodeToFrame)
+        m_totalFrames = X265_MIN(m_totalFrames, info.encodeToFrame);
+
+    /* O_DIRECT reads whole pages around the frame, which starts anywhere in the first one */
+    if (m_bDirect)
+        m_slotSize = (m_framesize + 2 * ASYNC_ALIGN - 1) & ~(ASYNC_ALIGN - 1);
+
+    for (int i = 0; i < m_queueDepth; i++)
+    {
+        void* buf = NULL;
+        if (posix_memalign(&buf, ASYNC_ALIGN, m_slotSize))
+        {
+            x265_log(NULL, X265_LOG_ERROR, "yuv: buffer allocation failure, aborting\n");
+            close(m_fd);
+            m_fd = -1;
+            return;
+        }
+        m_slotBuf[i] = (char*)buf;
+    }
+
+    if (bUring && !openRing())
+        x265_log(NULL, X265_LOG_INFO, "yuv: io_uring unavailable, using pread\n");
+
+    x265_log(NULL, X265_LOG_INFO, "yuv: async reader, %s, queue %d frames%s\n",
+             m_ring ? "io_uring" : "pread", m_queueDepth, m_bDirect ? ", O_DIRECT" : "");
+}
+
+AsyncYUVInput::~AsyncYUVInput()
+{
+    if (m_ring)
+        closeRing(m_ring);
+    if (m_fd >= 0)
+        close(m_fd);
+    for (int i = 0; i < ASYNC_MAX_QUEUE; i++)
+        free(m_slotBuf[i]);
+}
+
+/* options are key=value pairs separated by ';', as for the avs reader */
+void AsyncYUVInput::parseOptions(const char* opts, bool& bUring)
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", opts ? opts : "");
+
+    for (char* opt = buf; opt && *opt;)
+    {
+        char* end = strchr(opt, ';');
+        if (end)
+            *end++ = 0;
+
+        char* value = strchr(opt, '=');
+        if (value)
+            *value++ = 0;
+
+        if (value && !strcmp(opt, "io"))
+        {
+            if (!strcmp(value, "uring"))
+                bUring = true;
+            else if (!strcmp(value, "pread"))
+                bUring = false;
+            else
+                x265_log(NULL, X265_LOG_WARNING, "yuv: unknown io engine %s ignored\n", value);
+        }
+        else if (value && !strcmp(opt, "queue"))
+            m_queueDepth = x265_clip3(ASYNC_MIN_QUEUE, ASYNC_MAX_QUEUE, atoi(value));
+        else if (value && !strcmp(opt, "threads"))
+            m_numThreads = x265_clip3(1, ASYNC_MAX_THREADS, atoi(value));
+        else if (value && !strcmp(opt, "direct"))
+            m_bDirect = !!atoi(value);
+        else if (*opt)
+            x265_log(NULL, X265_LOG_WARNING, "yuv: invalid reader option \"%s\" ignored\n", opt);
+
+        opt = end;
+    }
+}
+
+bool AsyncYUVInput::openRing()
+{
+#if HAVE_IO_URING
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = (int)syscall(__NR_io_uring_setup, m_queueDepth, &params);
+    if (fd < 0)
+        return false;
+
+    AsyncUring* ring = new AsyncUring;
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = fd;
+    ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        ring->sqRingSize = ring->cqRingSize = X265_MAX(ring->sqRingSize, ring->cqRingSize);
+    ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+    ring->sqRing = mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->sqRing != MAP_FAILED)
+    {
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+            ring->cqRing = ring->sqRing;
+        else
+            ring->cqRing = mmap(NULL, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    }
+    if (ring->sqRing != MAP_FAILED && ring->cqRing != MAP_FAILED)
+        ring->sqes = (io_uring_sqe*)mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqRing == MAP_FAILED || ring->cqRing == MAP_FAILED || !ring->sqes || ring->sqes == MAP_FAILED)
+    {
+        closeRing(ring);
+        return false;
+    }
+
+    char* sq = (char*)ring->sqRing;
+    char* cq = (char*)ring->cqRing;
+    ring->sqHead = (unsigned*)(sq + params.sq_off.head);
+    ring->sqTail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sqArray = (unsigned*)(sq + params.sq_off.array);
+    ring->sqMask = *(unsigned*)(sq + params.sq_off.ring_mask);
+    ring->cqHead = (unsigned*)(cq + params.cq_off.head);
+    ring->cqTail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cqMask = *(unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    m_ring = ring;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void AsyncYUVInput::startReader()
+{
+    if (m_fd < 0 || !m_totalFrames)
+        return;
+
+    m_threadActive = true;
+    int numThreads = m_ring ? 1 : m_numThreads;
+    for (int i = 0; i < numThreads; i++)
+        m_workers[i].start();
+}
+
+void AsyncYUVInput::stopReader()
+{
+    m_threadActive = false;
+    m_readCount.poke();
+    for (int i = 0; i < m_queueDepth; i++)
+        m_slotFrame[i].poke();
+}
+
+void AsyncYUVInput::release()
+{
+    stopReader();
+    for (int i = 0; i < ASYNC_MAX_THREADS; i++)
+        m_workers[i].stop();
+    delete this;
+}
+
+bool AsyncYUVInput::isEof() const
+{
+    return m_readCount.get() >= m_totalFrames;
+}
+
+void AsyncYUVInput::Worker::threadMain()
+{
+    THREAD_NAME("YUVRead", 0);
+    if (m_input->m_ring)
+        m_input->uringMain();
+    else
+        m_input->preadMain();
+}
+
+/* A frame may be read into its slot once the frame that last used the slot has
+ * been returned and the caller moved on from it, so the picture handed out by
+ * the latest readPicture() stays valid until the next call */
+bool AsyncYUVInput::canIssue(int frame, int& read)
+{
+    read = m_readCount.get();
+    return frame <= read + m_queueDepth - 2;
+}
+
+void AsyncYUVInput::issueRange(int frame, int64_t& offset, uint32_t& len)
+{
+    int64_t start = m_firstOffset + (int64_t)frame * m_framesize;
+    if (m_bDirect)
+    {
+        offset = start & ~(int64_t)(ASYNC_ALIGN - 1);
+        m_slotDelta[frame % m_queueDepth] = (uint32_t)(start - offset);
+        len = (uint32_t)(start - offset + m_framesize + ASYNC_ALIGN - 1) & ~(ASYNC_ALIGN - 1);
+    }
+    else
+    {
+        offset = start;
+        len = m_framesize;
+    }
+}
+
+void AsyncYUVInput::frameDone(int frame, int64_t bytes)
+{
+    int slot = frame % m_queueDepth;
+    if (bytes >= (int64_t)m_slotDelta[slot] + m_framesize)
+        m_slotFrame[slot].set(frame + 1);
+    else
+    {
+        x265_log(NULL, X265_LOG_ERROR, "yuv: read of frame %d failed\n", frame);
+        m_slotFrame[slot].set(-1);
+    }
+}
+
+void AsyncYUVInput::preadMain()
+{
+    while (m_threadActive)
+    {
+        int frame = m_nextFrame.getIncr();
+        if (frame >= m_totalFrames)
+            break;
+
+        int read;
+        while (m_threadActive && !canIssue(frame, read))
+            m_readCount.waitForChange(read);
+        if (!m_threadActive)
+            break;
+
+        int64_t offset;
+        uint32_t len;
+        issueRange(frame, offset, len);
+
+        ProfileScopeEvent(frameRead);
+        char* dst = m_slotBuf[frame % m_queueDepth];
+        int64_t bytes = 0;
+        while (bytes < len)
+        {
+            ssize_t ret = pread(m_fd, dst + bytes, len - bytes, offset + bytes);
+            if (ret < 0 && errno == EINTR)
+                continue;
+            if (ret <= 0)
+                break;
+            bytes += ret;
+        }
+        frameDone(frame, bytes);
+    }
+}
+
+void AsyncYUVInput::uringMain()
+{
+#if HAVE_IO_URING
+    AsyncUring& ring = *m_ring;
+    int next = 0, inflight = 0, read = 0;
+    unsigned pending = 0;
+
+    /* reads in flight are always reaped, the kernel writes into the slots */
+    while ((m_threadActive && next < m_totalFrames) || inflight)
+    {
+        unsigned tail = *ring.sqTail;
+        while (m_threadActive && next < m_totalFrames && inflight < m_queueDepth && canIssue(next, read))
+        {
+            int slot = next % m_queueDepth;
+            int64_t offset;
+            uint32_t len;
+            issueRange(next, offset, len);
+            ring.iov[slot].iov_base = m_slotBuf[slot];
+            ring.iov[slot].iov_len = len;
+
+            unsigned idx = tail & ring.sqMask;
+            io_uring_sqe* sqe = &ring.sqes[idx];
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_READV;
+            sqe->fd = m_fd;
+            sqe->addr = (uint64_t)(uintptr_t)&ring.iov[slot];
+            sqe->len = 1;
+            sqe->off = (uint64_t)offset;
+            sqe->user_data = (uint64_t)next;
+            ring.sqArray[idx] = idx;
+
+            tail++;
+            next++;
+            inflight++;
+            pending++;
+        }
+        __atomic_store_n(ring.sqTail, tail, __ATOMIC_RELEASE);
+
+        if (!inflight)
+        {
+            m_readCount.waitForChange(read);
+            continue;
+        }
+
+        int ret = (int)syscall(__NR_io_uring_enter, ring.fd, pending, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret < 0 && errno != EINTR)
+        {
+            x265_log(NULL, X265_LOG_ERROR, "yuv: io_uring_enter failed (%s)\n", strerror(errno));
+            for (int i = 0; i < m_queueDepth; i++)
+                m_slotFrame[i].set(-1);
+            break;
+        }
+        if (ret > 0)
+            pending -= X265_MIN((unsigned)ret, pending);
+
+        unsigned head = *ring.cqHead;
+        unsigned cqTail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+        for (; head != cqTail; head++)
+        {
+            io_uring_cqe* cqe = &ring.cqes[head & ring.cqMask];
+            frameDone((int)cqe->user_data, cqe->res);
+            inflight--;
+        }
+        __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+    }
+#endif
+}
+
+bool AsyncYUVInput::readPicture(x265_picture& pic)
+{
+    int read = m_readCount.get();
+    if (m_fd < 0 || read >= m_totalFrames)
+        return false;
+
+    int slot = read % m_queueDepth;
+    int ready = m_slotFrame[slot].get();
+    while (m_threadActive && ready != read + 1 && ready >= 0)
+        ready = m_slotFrame[slot].waitForChange(ready);
+    if (ready != read + 1)
+        return false;
+
+    uint32_t pixelbytes = m_depth > 8 ? 2 : 1;
+    pic.colorSpace = m_colorSpace;
+    pic.bitDepth = m_depth;
+    pic.framesize = m_framesize;
+    pic.height = m_height;
+    pic.width = m_width;
+    pic.stride[0] = m_width * pixelbytes;
+    pic.stride[1] = pic.stride[0] >> x265_cli_csps[m_colorSpace].width[1];
+    pic.stride[2] = pic.stride[0] >> x265_cli_csps[m_colorSpace].width[2];
+    pic.planes[0] = m_slotBuf[slot] + m_slotDelta[slot];
+    pic.planes[1] = (char*)pic.planes[0] + pic.stride[0] * m_height;
+    pic.planes[2] = (char*)pic.planes[1] + pic.stride[1] * (m_height >> x265_cli_csps[m_colorSpace].height[1]);
+    m_readCount.incr();
+    return true;
+}
+
+#endif // ifndef _WIN32
@@ -0,0 +1,120 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#ifndef X265_YUVASYNC_H
+#define X265_YUVASYNC_H
+
+#include "input.h"
+#include "threading.h"
+
+#define ASYNC_MIN_QUEUE     3
+#define ASYNC_MAX_QUEUE     64
+#define ASYNC_MAX_THREADS   16
+#define ASYNC_ALIGN         4096
+
+namespace X265_NS {
+// private x265 namespace
+
+struct AsyncUring;
+
+/* Raw YUV reader for regular files that keeps several frame reads in flight,
+ * through io_uring when the kernel allows it or else through a few threads
+ * issuing pread, optionally with O_DIRECT into page aligned buffers. Selected
+ * by the reader options io=uring|pread, queue=<frames>, threads=<n> and
+ * direct=<0|1> */
+class AsyncYUVInput : public InputFile
+{
+protected:
+
+    class Worker : public Thread
+    {
+    public:
+
+        AsyncYUVInput* m_input;
+
+        void threadMain();
+    };
+
+    int      m_width;
+    int      m_height;
+    int      m_colorSpace;
+    uint32_t m_depth;
+    uint32_t m_framesize;
+
+    int      m_fd;
+    bool     m_bDirect;
+    AsyncUring* m_ring;
+    bool     m_threadActive;
+    int      m_queueDepth;
+    int      m_numThreads;
+    int      m_totalFrames;
+    int64_t  m_firstOffset;
+    uint32_t m_slotSize;
+
+    char*    m_slotBuf[ASYNC_MAX_QUEUE];
+    uint32_t m_slotDelta[ASYNC_MAX_QUEUE];   // frame start within the slot (O_DIRECT)
+
+    /* frame index + 1 once the frame is in its slot (frame % m_queueDepth), -1 on error */
+    ThreadSafeInteger m_slotFrame[ASYNC_MAX_QUEUE];
+    mutable ThreadSafeInteger m_readCount;   // frames returned by readPicture()
+    ThreadSafeInteger m_nextFrame;           // next frame to be issued (pread workers)
+
+    Worker   m_workers[ASYNC_MAX_THREADS];
+
+    void parseOptions(const char* opts, bool& bUring);
+    bool openRing();
+    bool canIssue(int frame, int& read);
+    void issueRange(int frame, int64_t& offset, uint32_t& len);
+    void frameDone(int frame, int64_t bytes);
+    void preadMain();
+    void uringMain();
+
+public:
+
+    AsyncYUVInput(InputFileInfo& info);
+
+    virtual ~AsyncYUVInput();
+
+    static bool isRequested(const InputFileInfo& info);
+
+    void release();
+
+    bool isEof() const;
+
+    bool isFail()                                 { return m_fd < 0; }
+
+    void startReader();
+
+    void stopReader();
+
+    bool readPicture(x265_picture&);
+
+    const char *getName() const                   { return "yuv"; }
+
+    int getWidth() const                          { return m_width; }
+
+    int getHeight() const                         { return m_height; }
+
+    int outputFrame()                             { return m_readCount.get(); }
+};
+}
+
+#endif // ifndef X265_YUVASYNC_H
@@ -44,3 +44,13 @@ OutputFile* OutputFile::open(const char *fname, InputFileInfo& inputInfo)
 {
     return new RAWOutput(fname, inputInfo);
 }
+
+int OutputFile::writeFrames(OutputUnit* units, int count)
+{
+    int bytes = 0;
+
+    for (int i = 0; i < count; i++)
+        bytes += writeFrame(units[i].nal, units[i].nalCount, units[i].pic);
+
+    return bytes;
+}
@@ -31,6 +31,14 @@
 namespace X265_NS {
 // private x265 namespace
 
+/* An access unit queued for output; its NALs stay valid until it is written */
+struct OutputUnit
+{
+    x265_nal*    nal;
+    uint32_t     nalCount;
+    x265_picture pic;
+};
+
 class ReconFile
 {
 protected:
@@ -79,6 +87,9 @@ public:
 
     virtual int writeFrame(const x265_nal* nal, uint32_t nalcount, x265_picture& pic) = 0;
 
+    /* write several access units at once, by default one writeFrame() each */
+    virtual int writeFrames(OutputUnit* units, int count);
+
     virtual void closeFile(int64_t largest_pts, int64_t second_largest_pts) = 0;
 };
 }
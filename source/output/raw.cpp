@@ -28,6 +28,15 @@
 #if defined(_MSC_VER)
 #pragma warning(disable: 4996) // POSIX setmode and fileno deprecated
 #endif
+#else
+#include <sys/uio.h>
+#include <limits.h>
+#include <errno.h>
+#if defined(IOV_MAX) && IOV_MAX < 1024
+#define RAW_MAX_IOV IOV_MAX
+#else
+#define RAW_MAX_IOV 1024 // NALs per writev()
+#endif
 #endif
 
 using namespace X265_NS;
@@ -81,6 +90,69 @@ int RAWOutput::writeFrame(const x265_nal* nal, uint32_t nalcount, x265_picture&)
     return bytes;
 }
 
+#ifndef _WIN32
+/* writev() the vectors completely, resuming after short writes; after an
+ * error nothing more is written */
+static void writeVectors(int fd, struct iovec* iov, int count, bool& bFail)
+{
+    while (count && !bFail)
+    {
+        ssize_t ret = writev(fd, iov, count);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            general_log(NULL, "raw", X265_LOG_ERROR, "write failed: %s\n", strerror(errno));
+            bFail = true;
+            return;
+        }
+
+        while (count && (size_t)ret >= iov->iov_len)
+        {
+            ret -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count)
+        {
+            iov->iov_base = (char*)iov->iov_base + ret;
+            iov->iov_len -= ret;
+        }
+    }
+}
+
+/* The NALs of all the access units go out with as few writev() calls as
+ * IOV_MAX allows, bypassing the stdio buffer */
+int RAWOutput::writeFrames(OutputUnit* units, int count)
+{
+    struct iovec iov[RAW_MAX_IOV];
+    uint32_t bytes = 0;
+    int numVec = 0;
+
+    /* the headers went through fwrite() */
+    fflush(ofs);
+    int fd = fileno(ofs);
+
+    for (int i = 0; i < count; i++)
+    {
+        for (uint32_t j = 0; j < units[i].nalCount; j++)
+        {
+            iov[numVec].iov_base = units[i].nal[j].payload;
+            iov[numVec].iov_len = units[i].nal[j].sizeBytes;
+            bytes += units[i].nal[j].sizeBytes;
+            if (++numVec == RAW_MAX_IOV)
+            {
+                writeVectors(fd, iov, numVec, b_fail);
+                numVec = 0;
+            }
+        }
+    }
+    writeVectors(fd, iov, numVec, b_fail);
+
+    return bytes;
+}
+#endif
+
 void RAWOutput::closeFile(int64_t, int64_t)
 {
     if (ofs != stdout)
@@ -57,6 +57,10 @@ public:
 
     int writeFrame(const x265_nal* nal, uint32_t nalcount, x265_picture&);
 
+#ifndef _WIN32
+    int writeFrames(OutputUnit* units, int count);
+#endif
+
     void closeFile(int64_t largest_pts, int64_t second_largest_pts);
 };
 }
@@ -0,0 +1,261 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#include "common.h"
+#include "writer.h"
+
+using namespace X265_NS;
+
+AsyncWriter::AsyncWriter()
+    : m_threadActive(false)
+{}
+
+void AsyncWriter::startWriter()
+{
+    m_threadActive = start();
+}
+
+void AsyncWriter::drain()
+{
+    int written = m_writeCount.get();
+    int read = m_readCount.get();
+
+    while (read != written)
+        read = m_readCount.waitForChange(read);
+}
+
+void AsyncWriter::stopWriter()
+{
+    if (!m_threadActive)
+        return;
+
+    drain();
+
+    /* wake the thread without an entry; it finds the writer inactive and
+     * exits. The counters are then balanced again for synchronous writes */
+    m_threadActive = false;
+    m_writeCount.incr();
+    stop();
+    m_readCount.incr();
+}
+
+int AsyncWriter::acquireEntry()
+{
+    int written = m_writeCount.get();
+    int read = m_readCount.get();
+
+    while (written - read >= WRITER_QUEUE_SIZE)
+        read = m_readCount.waitForChange(read);
+
+    return written % WRITER_QUEUE_SIZE;
+}
+
+void AsyncWriter::commitEntry(int index)
+{
+    if (!m_threadActive)
+    {
+        writeEntries(index, 1);
+        m_readCount.incr();
+    }
+    m_writeCount.incr();
+}
+
+void AsyncWriter::threadMain()
+{
+    THREAD_NAME("OutputWriter", 0);
+
+    int read = m_readCount.get();
+    for (;;)
+    {
+        int written = m_writeCount.get();
+        while (written == read)
+            written = m_writeCount.waitForChange(written);
+
+        if (!m_threadActive)
+            break;
+
+        /* all entries queued since the last write, up to the end of the ring */
+        int first = read % WRITER_QUEUE_SIZE;
+        int count = X265_MIN(written - read, WRITER_QUEUE_SIZE - first);
+        writeEntries(first, count);
+
+        read += count;
+        m_readCount.set(read);
+    }
+}
+
+BitstreamWriter::BitstreamWriter(OutputFile* output, const x265_api* api, x265_encoder* encoder)
+    : m_output(output)
+    , m_api(api)
+    , m_encoder(encoder)
+{
+    for (int i = 0; i < WRITER_QUEUE_SIZE; i++)
+    {
+        m_units[i].nal = NULL;
+        m_units[i].nalCount = 0;
+        m_nalAlloc[i] = 0;
+        m_taken[i] = NULL;
+        m_copy[i] = NULL;
+        m_copyAlloc[i] = 0;
+    }
+}
+
+BitstreamWriter::~BitstreamWriter()
+{
+    stopWriter();
+
+    for (int i = 0; i < WRITER_QUEUE_SIZE; i++)
+    {
+        X265_FREE(m_units[i].nal);
+        X265_FREE(m_copy[i]);
+    }
+}
+
+uint32_t BitstreamWriter::writeFrame(const x265_nal* nal, uint32_t nalCount, const x265_picture& pic)
+{
+    int index = acquireEntry();
+    OutputUnit& unit = m_units[index];
+
+    uint32_t bytes = 0;
+    for (uint32_t i = 0; i < nalCount; i++)
+        bytes += nal[i].sizeBytes;
+
+    if (nalCount > m_nalAlloc[index])
+    {
+        X265_FREE(unit.nal);
+        unit.nal = X265_MALLOC(x265_nal, nalCount);
+        m_nalAlloc[index] = unit.nal ? nalCount : 0;
+    }
+    if (unit.nal)
+    {
+        memcpy(unit.nal, nal, nalCount * sizeof(x265_nal));
+        m_taken[index] = m_api->encoder_nal_buffer(m_encoder);
+        if (!m_taken[index])
+        {
+            if (bytes > m_copyAlloc[index])
+            {
+                X265_FREE(m_copy[index]);
+                m_copy[index] = X265_MALLOC(uint8_t, bytes);
+                m_copyAlloc[index] = m_copy[index] ? bytes : 0;
+            }
+
+            uint8_t* payload = m_copy[index];
+            for (uint32_t i = 0; payload && i < nalCount; i++)
+            {
+                memcpy(payload, nal[i].payload, nal[i].sizeBytes);
+                unit.nal[i].payload = payload;
+                payload += nal[i].sizeBytes;
+            }
+        }
+    }
+
+    if (!unit.nal || (!m_taken[index] && !m_copy[index]))
+    {
+        /* out of memory, write it right away */
+        x265_picture out = pic;
+        drain();
+        return m_output->writeFrame(nal, nalCount, out);
+    }
+
+    unit.nalCount = nalCount;
+    unit.pic = pic;
+    commitEntry(index);
+
+    return bytes;
+}
+
+void BitstreamWriter::writeEntries(int first, int count)
+{
+    m_output->writeFrames(m_units + first, count);
+
+    for (int i = first; i < first + count; i++)
+    {
+        if (m_taken[i])
+        {
+            m_api->nal_buffer_free(m_taken[i]);
+            m_taken[i] = NULL;
+        }
+    }
+}
+
+ReconWriter::ReconWriter(ReconFile* recon, int height)
+    : m_recon(recon)
+    , m_height(height)
+{
+    for (int i = 0; i < WRITER_QUEUE_SIZE; i++)
+    {
+        m_frameData[i] = NULL;
+        m_frameAlloc[i] = 0;
+    }
+}
+
+ReconWriter::~ReconWriter()
+{
+    stopWriter();
+
+    for (int i = 0; i < WRITER_QUEUE_SIZE; i++)
+        X265_FREE(m_frameData[i]);
+}
+
+void ReconWriter::writePicture(const x265_picture& pic)
+{
+    int index = acquireEntry();
+    const x265_cli_csp& csp = x265_cli_csps[pic.colorSpace];
+
+    /* the planes are copied with their strides, as the ReconFile reads them */
+    size_t planeSize[3] = { 0, 0, 0 };
+    size_t frameSize = 0;
+    for (int i = 0; i < csp.planes; i++)
+    {
+        planeSize[i] = (size_t)pic.stride[i] * (m_height >> csp.height[i]);
+        frameSize += planeSize[i];
+    }
+
+    if (frameSize > m_frameAlloc[index])
+    {
+        X265_FREE(m_frameData[index]);
+        m_frameData[index] = X265_MALLOC(char, frameSize);
+        m_frameAlloc[index] = m_frameData[index] ? frameSize : 0;
+    }
+    if (!m_frameData[index])
+    {
+        drain();
+        m_recon->writePicture(pic);
+        return;
+    }
+
+    m_pics[index] = pic;
+    char* dst = m_frameData[index];
+    for (int i = 0; i < csp.planes; i++)
+    {
+        memcpy(dst, pic.planes[i], planeSize[i]);
+        m_pics[index].planes[i] = dst;
+        dst += planeSize[i];
+    }
+
+    commitEntry(index);
+}
+
+void ReconWriter::writeEntries(int first, int count)
+{
+    for (int i = first; i < first + count; i++)
+        m_recon->writePicture(m_pics[i]);
+}
@@ -0,0 +1,125 @@
+/*****************************************************************************
+ * Copyright (C) 2013-2020 MulticoreWare, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at license @ x265.com.
+ *****************************************************************************/
+
+#ifndef X265_WRITER_H
+#define X265_WRITER_H
+
+#include "output.h"
+#include "threading.h"
+
+#define WRITER_QUEUE_SIZE 16 // entries a writer may fall behind before the encoder waits
+
+namespace X265_NS {
+// private x265 namespace
+
+/* Takes output off the encode loop: the encoder thread fills entries of a
+ * ring and a thread of the writer writes them out, every entry queued since
+ * its last wake-up at once. The encoder only waits on the writer when the
+ * ring is full. If the thread cannot be started, entries are written as they
+ * are queued */
+class AsyncWriter : public Thread
+{
+public:
+
+    AsyncWriter();
+
+    virtual ~AsyncWriter() {}
+
+    void startWriter();
+
+    /* wait for the queued entries to be written, then end the thread */
+    void stopWriter();
+
+protected:
+
+    bool m_threadActive;
+
+    ThreadSafeInteger m_writeCount; // entries queued
+    ThreadSafeInteger m_readCount;  // entries written
+
+    /* wait for a free entry, returns its index in the ring */
+    int  acquireEntry();
+    void commitEntry(int index);
+
+    /* wait for the queued entries to be written */
+    void drain();
+
+    /* write entries [first, first + count) of the ring, on the writer thread */
+    virtual void writeEntries(int first, int count) = 0;
+
+    void threadMain();
+};
+
+/* Access units of an encode, written through OutputFile::writeFrames().
+ * Queued access units own their payloads, taken from the encoder with
+ * x265_encoder_nal_buffer() or else copied */
+class BitstreamWriter : public AsyncWriter
+{
+public:
+
+    BitstreamWriter(OutputFile* output, const x265_api* api, x265_encoder* encoder);
+
+    virtual ~BitstreamWriter();
+
+    /* queue the NALs last returned by the encoder, returns their size */
+    uint32_t writeFrame(const x265_nal* nal, uint32_t nalCount, const x265_picture& pic);
+
+protected:
+
+    OutputFile*     m_output;
+    const x265_api* m_api;
+    x265_encoder*   m_encoder;
+
+    OutputUnit m_units[WRITER_QUEUE_SIZE];
+    uint32_t   m_nalAlloc[WRITER_QUEUE_SIZE];
+    void*      m_taken[WRITER_QUEUE_SIZE];     // payloads taken from the encoder, freed once written
+    uint8_t*   m_copy[WRITER_QUEUE_SIZE];      // payloads copied when they could not be taken
+    uint32_t   m_copyAlloc[WRITER_QUEUE_SIZE];
+
+    void writeEntries(int first, int count);
+};
+
+/* Reconstructed pictures, copied with their strides and written through
+ * ReconFile::writePicture() */
+class ReconWriter : public AsyncWriter
+{
+public:
+
+    ReconWriter(ReconFile* recon, int height);
+
+    virtual ~ReconWriter();
+
+    void writePicture(const x265_picture& pic);
+
+protected:
+
+    ReconFile* m_recon;
+    int        m_height;
+
+    x265_picture m_pics[WRITER_QUEUE_SIZE];
+    char*        m_frameData[WRITER_QUEUE_SIZE];
+    size_t       m_frameAlloc[WRITER_QUEUE_SIZE];
+
+    void writeEntries(int first, int count);
+};
+}
+
+#endif // ifndef X265_WRITER_H
@@ -9,3 +9,8 @@ CPU_EVENT(estCostSingle)
 CPU_EVENT(estCostCoop)
 CPU_EVENT(pmode)
 CPU_EVENT(pme)
+CPU_EVENT(encodeRow)
+CPU_EVENT(rowStall)
+CPU_EVENT(noWorkers)
+CPU_EVENT(refWait)
+CPU_EVENT(inputDither)
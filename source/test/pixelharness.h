@@ -68,6 +68,7 @@ protected:
     ALIGN_VAR_64(uint8_t,  uchar_test_buff[TEST_CASES][BUFFSIZE]);
     ALIGN_VAR_64(double,   double_test_buff[TEST_CASES][BUFFSIZE]);
     ALIGN_VAR_64(int16_t,  residual_test_buff[TEST_CASES][BUFFSIZE]);
+    ALIGN_VAR_64(uint16_t, mcstf_lut_buff[4][PIXEL_MAX + 2]);
 
     bool check_pixelcmp(pixelcmp_t ref, pixelcmp_t opt);
     bool check_pixel_sse(pixel_sse_t ref, pixel_sse_t opt);
@@ -121,6 +122,15 @@ protected:
     bool check_planecopy_sp(planecopy_sp_t ref, planecopy_sp_t opt);
     bool check_planecopy_cp(planecopy_cp_t ref, planecopy_cp_t opt);
     bool check_cutree_propagate_cost(cutree_propagate_cost ref, cutree_propagate_cost opt);
+    bool check_cutree_propagate_list(cutree_propagate_list ref, cutree_propagate_list opt);
+    bool check_histogram(histogram_t ref, histogram_t opt);
+    bool check_scaler_hfilter(scaler_hfilter_t ref, scaler_hfilter_t opt);
+    bool check_scaler_vfilter(scaler_vfilter_t ref, scaler_vfilter_t opt);
+    bool check_nal_escape(nal_escape_t ref, nal_escape_t opt);
+    bool check_picture_crc(picture_crc_t ref, picture_crc_t opt);
+    bool check_picture_checksum(picture_checksum_t ref, picture_checksum_t opt);
+    bool check_ssim_row_sums(ssim_row_sums_t ref, ssim_row_sums_t opt);
+    bool check_ssim_row_end(ssim_row_end_t ref, ssim_row_end_t opt);
     bool check_cutree_fix8_pack(cutree_fix8_pack ref, cutree_fix8_pack opt);
     bool check_cutree_fix8_unpack(cutree_fix8_unpack ref, cutree_fix8_unpack opt);
     bool check_psyCost_pp(pixelcmp_t ref, pixelcmp_t opt);
@@ -139,6 +149,9 @@ protected:
     bool check_ssimDist(ssimDistortion_t ref, ssimDistortion_t opt);
     bool check_normFact(normFactor_t ref, normFactor_t opt, int block);
     bool check_downscaleluma_t(downscaleluma_t ref, downscaleluma_t opt);
+    bool check_mcstf_bilateral(mcstf_bilateral_t ref, mcstf_bilateral_t opt);
+    bool check_mcstf_bilateral_double(mcstf_bilateral_t opt);
+    bool check_dither_plane(dither_t ref, dither_t opt);
 
 public:
 
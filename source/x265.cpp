@@ -209,6 +209,22 @@ static bool parseAbrConfig(FILE* abrConfig, CLIOptions cliopt[], uint8_t numEnco
                 cliopt[i].api->param_free(cliopt[i].param);
             exit(1);
         }
+
+        /* a rung reading the input of the rung before it at another resolution
+         * scales the input pictures of that rung instead of reading its own.
+         * The Scaler keeps the samples at the encoder depth, which they must have */
+        x265_param* prev = i ? cliopt[i - 1].param : NULL;
+        x265_param* cur = cliopt[i].param;
+        if (prev && cliopt[i].inputName && cliopt[i - 1].inputName && !strcmp(cliopt[i].inputName, cliopt[i - 1].inputName) &&
+            cliopt[i].seek == cliopt[i - 1].seek && (cur->sourceWidth != prev->sourceWidth || cur->sourceHeight != prev->sourceHeight))
+        {
+            if (cur->internalCsp == prev->internalCsp && prev->sourceBitDepth == cur->internalBitDepth &&
+                cur->sourceBitDepth == cur->internalBitDepth)
+                cliopt[i].enableScaler = true;
+            else
+                x265_log(NULL, X265_LOG_WARNING, "%s differs from %s in color space or bit depth, reading its own input instead of scaling\n",
+                         cliopt[i].encName, cliopt[i - 1].encName);
+        }
     }
     return true;
 }
@@ -244,6 +260,32 @@ static bool setRefContext(CLIOptions cliopt[], uint32_t numEncodes)
             }
         }
     }
+
+    /* An encode reusing the lookahead of its reference skips its own; the
+     * reference keeps running its lookahead and exports the frame types,
+     * VBV lookahead data and AQ/cuTree offsets along with its analysis */
+    for (uint32_t curEnc = 0; curEnc < numEncodes; curEnc++)
+    {
+        if (!cliopt[curEnc].bReuseLookahead)
+            continue;
+        if (cliopt[curEnc].refId < 0 || !cliopt[curEnc].loadLevel)
+        {
+            x265_log(NULL, X265_LOG_ERROR, "--abr-reuse-lookahead needs a reference encode and a reuse level for %s\n",
+                cliopt[curEnc].encName);
+            return false;
+        }
+        cliopt[curEnc].param->bDisableLookahead = 1;
+        cliopt[cliopt[curEnc].refId].param->bDisableLookahead = 1;
+    }
+    for (uint32_t curEnc = 0; curEnc < numEncodes; curEnc++)
+    {
+        if (cliopt[curEnc].param->bDisableLookahead && cliopt[curEnc].loadLevel && !cliopt[curEnc].bReuseLookahead)
+        {
+            x265_log(NULL, X265_LOG_ERROR, "%s shares its lookahead with other encodes and must reuse the lookahead of %s too\n",
+                cliopt[curEnc].encName, cliopt[curEnc].reuseName);
+            return false;
+        }
+    }
     return true;
 }
 /* CLI return codes:
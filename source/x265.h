@@ -233,6 +233,13 @@ typedef struct x265_analysis_data
     int                               list0POC[MAX_NUM_REF];
     int                               list1POC[MAX_NUM_REF];
     double                            totalIntraPercent;
+    /* AQ and cuTree QP offsets of the lookahead, one per QP group on a
+     * qpOffsetCols x qpOffsetRows grid. Only exported along with the
+     * lookahead data (bDisableLookahead) and never written to analysis files */
+    double*                           qpAqOffset;
+    double*                           qpCuTreeOffset;
+    uint32_t                          qpOffsetCols;
+    uint32_t                          qpOffsetRows;
 } x265_analysis_data;
 
 /* cu statistics */
@@ -313,6 +320,17 @@ typedef struct x265_frame_stats
     double           bufferFillFinal;
     double           unclippedBufferFillFinal;
     uint8_t          tLayer;
+
+    /* Per-CTU PSNR of each plane and SSIM of luma, in raster order, when
+     * bEnableCtuMetrics is set; NULL for the metrics which are not enabled.
+     * The maps are owned by the encoder and remain valid until the next call
+     * to x265_encoder_encode(). SSIM windows count towards the CTU holding
+     * their centre */
+    double*          ctuPsnrY;
+    double*          ctuPsnrU;
+    double*          ctuPsnrV;
+    double*          ctuSsim;
+    uint32_t         numCtus;
 } x265_frame_stats;
 
 typedef struct x265_ctu_info_t
@@ -487,6 +505,13 @@ typedef struct x265_picture
     uint32_t picStruct;
 
     int    width;
+
+    /* Zero-copy input (param.bCopyPicToFrame = 0): when non-NULL, called with
+     * planesOpaque once the encoder no longer reads or writes the planes of
+     * this picture, after which the application may reuse them. The planes
+     * must follow the encoder's own frame layout, see --no-copy-pic */
+    void   (*releasePlanes)(void* planesOpaque);
+    void*  planesOpaque;
 } x265_picture;
 
 typedef enum
@@ -1782,7 +1807,10 @@ typedef struct x265_param
         Use stats file by default.
         The stats file mode would be used among the encoders running in sequence.
         The shared memory mode could only be used among the encoders running in parallel.
-        Now only the cutree data could be shared among shared memory. More data would be support in the future.*/
+        The cutree data is shared through shared memory, and so is the analysis data of an
+        encoder which either saves or loads it (but not both) with bUseAnalysisFile; its
+        analysisSave/analysisLoad file is then neither written nor read.
+        One writing encoder may feed up to 16 reading encoders, see sharedMemReaders.*/
         int       dataShareMode;
 
         /* Unique shared memory name. Required if the shared memory mode enabled. NULL by default */
@@ -2047,7 +2075,15 @@ typedef struct x265_param
 
     /* Reuse MV information obtained through API */
     int       bAnalysisType;
-    /* Allow the encoder to have a copy of the planes of x265_picture in Frame */
+    /* Allow the encoder to have a copy of the planes of x265_picture in Frame.
+     * When disabled the encoder works in place on the application's planes,
+     * which must be 16-byte aligned, have the bit depth and color space of the
+     * encoder, a luma stride of ((sourceWidth + maxCUSize - 1) / maxCUSize *
+     * maxCUSize + 2 * (maxCUSize + 32)) pixels (chroma: the CTU-aligned width
+     * shifted by the chroma subsampling plus the same margins) and margins of
+     * maxCUSize + 32 columns and maxCUSize + 16 rows (chroma rows scaled by the
+     * vertical subsampling) around the CTU-aligned picture. See
+     * x265_picture.releasePlanes. Default enabled */
     int       bCopyPicToFrame;
 
     /*Number of frames for GOP boundary decision lookahead.If a scenecut frame is found
@@ -2272,6 +2308,65 @@ typedef struct x265_param
 
     /*SBRC*/
     int      bEnableSBRC;
+
+    /* Enable work stealing in the thread pools. When a worker runs out of work
+     * it polls the other job providers of its pool in a randomized order for a
+     * short while before going to sleep, so rows that become ready at the end
+     * of a frame are picked up without the latency of waking a sleeping
+     * thread. Costs some spinning on idle cores. Default disabled */
+    int      bEnableWorkStealing;
+
+    /* Write the multi-pass stats as a single binary file holding the frame
+     * records, the cutree offsets and an index, instead of the text log and
+     * its .cutree side file. The format of a stats file being read is detected
+     * automatically; a pass which reads and writes stats keeps the format of
+     * its input. Default disabled */
+    int      bBinaryStats;
+
+    /* Number of encoders reading the data shared in rc.sharedMemName by this
+     * encoder when rc.dataShareMode is X265_SHARE_MODE_SHAREDMEM. Each reader
+     * receives every cutree and analysis record, and the writer waits for the
+     * slowest of them before reusing shared memory, however late they attach. A
+     * reader beyond this count which attaches after the writer wrapped around
+     * the shared memory is refused with an error. Ignored by the readers.
+     * Range 1 to 16, default 1 */
+    int      sharedMemReaders;
+
+    /* Compute the decoded picture hash SEI of each frame on idle pool workers
+     * as its rows are reconstructed, instead of on the threads which filter
+     * them. The planes are hashed concurrently, in parallel with the encoding
+     * of the remaining rows and of the other frames in flight. Needs a thread
+     * pool and a single slice, otherwise ignored. Default disabled */
+    int      bHashAsync;
+
+    /* Export per-CTU maps of the metrics enabled by bEnablePsnr and bEnableSsim
+     * through x265_frame_stats. Default disabled */
+    int      bEnableCtuMetrics;
+
+    /* Record the work of the encoder threads (frames, CTU rows and CTUs,
+     * lookahead batches, wavefront and reference stalls) in per-thread ring
+     * buffers and write them to this file as a Chrome trace, which can be
+     * opened in Perfetto or chrome://tracing, when the encoder is closed.
+     * Encoders of one process tracing at the same time share one file.
+     * Default NULL, disabled */
+    const char* traceFile;
+
+    /* Interpolate the horizontal, vertical and diagonal half-pel planes of
+     * each reconstructed picture once, as the frame encoders referencing it
+     * wait for its rows, and read the half-pel candidates of the subpel
+     * refinement from them instead of filtering every candidate block again.
+     * Costs three luma planes per picture, plus three per weighted reference
+     * of each frame encoder; most useful at subme 5 and above with several
+     * references. Needs a single slice, otherwise ignored. Default disabled */
+    int      bEnableHpelCache;
+
+    /* Dither input pictures of a higher bit depth than the encoder's down to
+     * the internal bit depth within x265_encoder_encode(), as
+     * x265_dither_image() does, instead of shifting them down. The planes are
+     * dithered into a private copy, in parallel on the encoder's thread pool,
+     * so the caller's pictures are left untouched. Implies copy-pic. Default
+     * disabled */
+    int      bEncoderDither;
 } x265_param;
 
 /* x265_param_alloc:
@@ -2509,6 +2604,18 @@ int x265_get_ref_frame_list(x265_encoder *encoder, x265_picyuv**, x265_picyuv**,
  *     returns negative on error, 0 access unit were output. */
 int x265_set_analysis_data(x265_encoder *encoder, x265_analysis_data *analysis_data, int poc, uint32_t cuBytes);
 
+/* x265_encoder_nal_buffer:
+ *     transfers the buffer holding the payloads of the NALs last returned by
+ *     x265_encoder_headers() or x265_encoder_encode() to the caller, so they
+ *     remain valid across later calls; the buffer must be released with
+ *     x265_nal_buffer_free(). Returns NULL when the payloads cannot be taken
+ *     over (SVT-HEVC), in which case they must be copied as before */
+void* x265_encoder_nal_buffer(x265_encoder *encoder);
+
+/* x265_nal_buffer_free:
+ *     release a buffer returned by x265_encoder_nal_buffer() */
+void x265_nal_buffer_free(void *buffer);
+
 /* x265_cleanup:
  *       release library static allocations, reset configured CTU size */
 void x265_cleanup(void);
@@ -2531,7 +2638,8 @@ void x265_csvlog_frame(const x265_param *, const x265_picture *);
 void x265_csvlog_encode(const x265_param*, const x265_stats *, int padx, int pady, int argc, char** argv);
 
 /* In-place downshift from a bit-depth greater than 8 to a bit-depth of 8, using
- * the residual bits to dither each row. */
+ * the residual bits to dither each row. Uses the optimized primitive once an
+ * encoder has been opened, and the C reference before that. */
 void x265_dither_image(x265_picture *, int picWidth, int picHeight, int16_t *errorBuf, int bitDepth);
 #if ENABLE_LIBVMAF
 /* x265_calculate_vmafScore:
@@ -2610,6 +2718,8 @@ typedef struct x265_api
     void          (*vmaf_encoder_log)(x265_encoder*, int, char**, x265_param *, x265_vmaf_data *);
 #endif
     int           (*zone_param_parse)(x265_param*, const char*, const char*);
+    void*         (*encoder_nal_buffer)(x265_encoder*);
+    void          (*nal_buffer_free)(void*);
     /* add new pointers to the end, or increment X265_MAJOR_VERSION */
 } x265_api;
 
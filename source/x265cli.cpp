@@ -73,6 +73,7 @@ namespace X265_NS {
         H0("   --progress-readframes         Add read frames counter from input into progress\n");
         H0("   --csv <filename>              Comma separated log file, if csv-log-level > 0 frame level statistics, else one line per run\n");
         H0("   --csv-log-level <integer>     Level of csv logging, if csv-log-level > 0 frame level statistics, else one line per run: 0-2\n");
+        H1("   --trace <filename>            Chrome trace (JSON) of the frame, row, CTU and lookahead work of each thread\n");
         H0("\nInput Options:\n");
         H0("   --input <filename>            %sRaw YUV or Y4M input file name. `-` for stdin\n", x265_extra_readers.c_str());
         H1("   --y4m                         Force parsing of input stream as YUV4MPEG2 regardless of file extension\n");
@@ -98,6 +99,7 @@ namespace X265_NS {
         H0("   --[no-]field                  Enable or disable field coding. Default %s\n", OPT(param->bField));
         H1("   --dither                      Enable dither if downscaling to 8 bit pixels. Default disabled\n");
         H0("   --[no-]copy-pic               Copy buffers of input picture in frame. Default %s\n", OPT(param->bCopyPicToFrame));
+        H1("   --[no-]encoder-dither         Dither high bit depth input inside the encoder, on its thread pool. Default %s\n", OPT(param->bEncoderDither));
         H0("   --reader-options              Pass reader-specific options to input file reader\n");
 #ifdef HAVE_AVS
         H0("\nAvisynth reader options:\n");
@@ -110,9 +112,19 @@ namespace X265_NS {
         H0("     requests                    Override async requests (derived from Vapoursynth threads by default)\n");
         H0("     use-script-sar              Use script's reported SAR. Default 0:0\n");
 #endif
+#ifndef _WIN32
+        H0("\nRaw YUV file reader options (any of them enables asynchronous reads):\n");
+        H0("     io                          I/O engine, uring or pread. Default uring, pread when io_uring is unavailable\n");
+        H0("     queue                       Frames kept in flight, 3 to 64. Default 8\n");
+        H0("     threads                     Reader threads for the pread engine. Default 4\n");
+        H0("     direct                      Read with O_DIRECT into page aligned buffers. Default 0\n");
+#endif
+        H0("\nRaw YUV and Y4M file reader options:\n");
+        H0("     mmap                        Map the whole file and read frames in place, for free seeking. Default 0\n");
         H0("\nQuality reporting metrics:\n");
         H0("   --[no-]ssim                   Enable reporting SSIM metric scores. Default %s\n", OPT(param->bEnableSsim));
         H0("   --[no-]psnr                   Enable reporting PSNR metric scores. Default %s\n", OPT(param->bEnablePsnr));
+        H1("   --[no-]ctu-metrics            Export per-CTU PSNR and SSIM maps through the frame stats. Default %s\n", OPT(param->bEnableCtuMetrics));
         H0("\nProfile, Level, Tier:\n");
         H0("-P/--profile <string>            Enforce an encode profile: main, main10, mainstillpicture\n");
         H0("   --level-idc <integer|float>   Force a minimum required decoder level (as '5.0' or '50')\n");
@@ -122,6 +134,7 @@ namespace X265_NS {
         H0("\nThreading, performance:\n");
         H0("   --pools <integer,...>         Comma separated thread count per thread pool (pool per NUMA node)\n");
         H0("                                 '-' implies no threads on node, '+' implies one thread per core on node\n");
+        H0("   --[no-]work-stealing          Idle pool workers poll for work from other providers before sleeping. Default %s\n", OPT(param->bEnableWorkStealing));
         H0("-F/--frame-threads <integer>     Number of concurrently encoded frames. 0: auto-determined by core count\n");
         H0("   --[no-]wpp                    Enable Wavefront Parallel Processing. Default %s\n", OPT(param->bEnableWavefront));
         H0("   --[no-]slices <integer>       Enable Multiple Slices feature. Default %d\n", param->maxSlices);
@@ -173,6 +186,7 @@ namespace X265_NS {
         H0("   --me <string>                 Motion search method dia hex umh star full. Default %d\n", param->searchMethod);
         H0("-m/--subme <integer>             Amount of subpel refinement to perform (0:least .. 7:most). Default %d \n", param->subpelRefine);
         H0("   --merange <integer>           Motion search range. Default %d\n", param->searchRange);
+        H1("   --[no-]hpel-cache             Interpolate half-pel reference planes once per reconstructed row. Default %s\n", OPT(param->bEnableHpelCache));
         H0("   --[no-]rect                   Enable rectangular motion partitions Nx2N and 2NxN. Default %s\n", OPT(param->bEnableRectInter));
         H0("   --[no-]amp                    Enable asymmetric motion partitions, requires --rect. Default %s\n", OPT(param->bEnableAMP));
         H0("   --[no-]limit-modes            Limit rectangular and asymmetric motion predictions. Default %d\n", param->limitModes);
@@ -249,6 +263,7 @@ namespace X265_NS {
         H0("   --[no-]multi-pass-opt-distortion Use distortion of CTU from pass 1 to refine qp in 2 pass\n");
         H0("   --[no-]vbv-live-multi-pass    Enable realtime VBV in rate control 2 pass.Default %s\n", OPT(param->bliveVBV2pass));
         H0("   --stats                       Filename for stats file in multipass pass rate control. Default x265_2pass.log\n");
+        H0("   --[no-]binary-stats           Write multipass stats and cutree data as one indexed binary file. Default %s\n", OPT(param->bBinaryStats));
         H0("   --[no-]analyze-src-pics       Motion estimation uses source frame planes. Default disable\n");
         H0("   --[no-]slow-firstpass         Enable a slow first pass in a multipass rate control mode. Default %s\n", OPT(param->rc.bEnableSlowFirstPass));
         H0("   --[no-]strict-cbr             Enable stricter conditions and tolerance for bitrate deviations in CBR mode. Default %s\n", OPT(param->rc.bStrictCbr));
@@ -380,6 +395,7 @@ namespace X265_NS {
         H0("   --[no-]eob                    Emit end of bitstream nal unit at the end of the bitstream. Default %s\n", OPT(param->bEnableEndOfBitstream));
         H0("   --[no-]eos                    Emit end of sequence nal unit at the end of every coded video sequence. Default %s\n", OPT(param->bEnableEndOfSequence));
         H1("   --hash <integer>              Decoded Picture Hash SEI 0: disabled, 1: MD5, 2: CRC, 3: Checksum. Default %d\n", param->decodedPictureHashSEI);
+        H1("   --[no-]hash-async             Compute the picture hash on idle pool workers. Default %s\n", OPT(param->bHashAsync));
         H0("   --atc-sei <integer>           Emit the alternative transfer characteristics SEI message where the integer is the preferred transfer characteristics. Default disabled\n");
         H0("   --pic-struct <integer>        Set the picture structure and emits it in the picture timing SEI message. Values in the range 0..12. See D.3.3 of the HEVC spec. for a detailed explanation.\n");
         H0("   --log2-max-poc-lsb <integer>  Maximum of the picture order count\n");
@@ -412,6 +428,7 @@ namespace X265_NS {
 #endif
         H0(" ABR-ladder settings\n");
         H0("   --abr-ladder <file>           File containing config settings required for the generation of ABR-ladder\n");
+        H0("   --abr-reuse-lookahead         In an ABR-ladder line, follow the lookahead of the reference encode instead of running one\n");
         H1("\nExecutable return codes:\n");
         H1("    0 - encode successful\n");
         H1("    1 - unable to parse command line\n");
@@ -765,6 +782,7 @@ namespace X265_NS {
                 OPT("recon") reconfn = optarg;
                 OPT("input-depth") inputBitDepth = (uint32_t)x265_atoi(optarg, bError);
                 OPT("dither") this->bDither = true;
+                OPT("abr-reuse-lookahead") this->bReuseLookahead = true;
                 OPT("recon-depth") reconFileBitDepth = (uint32_t)x265_atoi(optarg, bError);
                 OPT("y4m") this->bForceY4m = true;
                 OPT("profile") /* handled above */;
@@ -863,7 +881,7 @@ namespace X265_NS {
 #endif
 
         InputFileInfo info;
-        info.filename = inputfn;
+        info.filename = this->inputName = inputfn;
         info.depth = inputBitDepth;
         info.csp = param->internalCsp;
         info.width = param->sourceWidth;
@@ -30,6 +30,7 @@
 #include "input/input.h"
 #include "output/output.h"
 #include "output/reconplay.h"
+#include "output/writer.h"
 
 #include <getopt.h>
 
@@ -56,6 +57,8 @@ static const struct option long_options[] =
     { "no-asm",               no_argument, NULL, 0 },
     { "pools",          required_argument, NULL, 0 },
     { "numa-pools",     required_argument, NULL, 0 },
+    { "work-stealing",        no_argument, NULL, 0 },
+    { "no-work-stealing",     no_argument, NULL, 0 },
     { "preset",         required_argument, NULL, 'p' },
     { "tune",           required_argument, NULL, 't' },
     { "frame-threads",  required_argument, NULL, 'F' },
@@ -73,6 +76,7 @@ static const struct option long_options[] =
     { "no-allow-non-conformance",no_argument, NULL, 0 },
     { "csv",            required_argument, NULL, 0 },
     { "csv-log-level",  required_argument, NULL, 0 },
+    { "trace",          required_argument, NULL, 0 },
     { "no-cu-stats",          no_argument, NULL, 0 },
     { "cu-stats",             no_argument, NULL, 0 },
     { "y4m",                  no_argument, NULL, 0 },
@@ -107,6 +111,8 @@ static const struct option long_options[] =
     { "subme",          required_argument, NULL, 'm' },
     { "merange",        required_argument, NULL, 0 },
     { "max-merge",      required_argument, NULL, 0 },
+    { "hpel-cache",           no_argument, NULL, 0 },
+    { "no-hpel-cache",        no_argument, NULL, 0 },
     { "no-temporal-mvp",      no_argument, NULL, 0 },
     { "temporal-mvp",         no_argument, NULL, 0 },
     { "hme",                  no_argument, NULL, 0 },
@@ -230,7 +236,11 @@ static const struct option long_options[] =
     { "ssim",                 no_argument, NULL, 0 },
     { "no-psnr",              no_argument, NULL, 0 },
     { "psnr",                 no_argument, NULL, 0 },
+    { "ctu-metrics",          no_argument, NULL, 0 },
+    { "no-ctu-metrics",       no_argument, NULL, 0 },
     { "hash",           required_argument, NULL, 0 },
+    { "hash-async",           no_argument, NULL, 0 },
+    { "no-hash-async",        no_argument, NULL, 0 },
     { "no-strong-intra-smoothing", no_argument, NULL, 0 },
     { "strong-intra-smoothing",    no_argument, NULL, 0 },
     { "no-cutree",                 no_argument, NULL, 0 },
@@ -286,6 +296,8 @@ static const struct option long_options[] =
     { "nr-inter",       required_argument, NULL, 0 },
     { "stats",          required_argument, NULL, 0 },
     { "pass",           required_argument, NULL, 0 },
+    { "binary-stats",         no_argument, NULL, 0 },
+    { "no-binary-stats",      no_argument, NULL, 0 },
     { "multi-pass-opt-analysis", no_argument, NULL, 0 },
     { "no-multi-pass-opt-analysis",    no_argument, NULL, 0 },
     { "multi-pass-opt-distortion",     no_argument, NULL, 0 },
@@ -342,6 +354,8 @@ static const struct option long_options[] =
     { "refine-analysis-type", required_argument, NULL, 0 },
     { "copy-pic",             no_argument, NULL, 0 },
     { "no-copy-pic",          no_argument, NULL, 0 },
+    { "encoder-dither",       no_argument, NULL, 0 },
+    { "no-encoder-dither",    no_argument, NULL, 0 },
     { "max-ausize-factor", required_argument, NULL, 0 },
     { "idr-recovery-sei",     no_argument, NULL, 0 },
     { "no-idr-recovery-sei",  no_argument, NULL, 0 },
@@ -383,6 +397,7 @@ static const struct option long_options[] =
     { "no-cll", no_argument, NULL, 0 },
     { "hme-range", required_argument, NULL, 0 },
     { "abr-ladder", required_argument, NULL, 0 },
+    { "abr-reuse-lookahead", no_argument, NULL, 0 },
     { "min-vbv-fullness", required_argument, NULL, 0 },
     { "max-vbv-fullness", required_argument, NULL, 0 },
     { "scenecut-qp-config", required_argument, NULL, 0 },
@@ -416,6 +431,7 @@ static const struct option long_options[] =
         int64_t startTime;
         int64_t prevUpdateTime;
         const char* readerOpts;
+        const char* inputName;
         bool bReadFrames;
 
         int argCnt;
@@ -431,6 +447,7 @@ static const struct option long_options[] =
         uint32_t loadLevel;
         uint32_t saveLevel;
         uint32_t numRefs;
+        bool     bReuseLookahead;
 
         /* in microseconds */
         static const int UPDATE_INTERVAL = 250000;
@@ -463,8 +480,10 @@ static const struct option long_options[] =
             loadLevel = 0;
             saveLevel = 0;
             numRefs = 0;
+            bReuseLookahead = false;
             argCnt = 0;
             readerOpts = NULL;
+            inputName = NULL;
             bReadFrames = false;
         }
 